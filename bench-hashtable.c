@@ -0,0 +1,319 @@
+/**
+ * @file bench-hashtable.c
+ * @brief measure the operations of hashtable.h: add_Htable_value, get_Htable_value of keys in
+ *        the table and not, get_Htable_content and del_Htable_key, for tables of 1000 entries up
+ *        to max_entries (1000000 by default, by powers of ten), several key lengths and several
+ *        load factors (entries per bucket).
+ *        Usage: bench-hashtable [-j] [max_entries]
+ *        Each operation is reported in ns, allocations and cache misses per operation (the
+ *        latter from perf_event_open, "-" when the system does not allow it). With -j, each
+ *        measure is a line of JSON instead, to compare runs with one another.
+ *        The allocations are counted by wrapping malloc, calloc and realloc at link time
+ *        (-Wl,--wrap, see the Makefile).
+ *
+ */
+
+#define _GNU_SOURCE // for syscall
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "error.h"
+#include "hashtable.h"
+
+#define DEFAULT_MAX_ENTRIES 1000000
+#define MIN_ENTRIES 1000
+
+/**
+ * @brief operations measured at least this many times per configuration: the small tables are
+ *        filled and emptied again as many times as needed
+ */
+#define MIN_OPS (1 << 20)
+
+/**
+ * @brief gets of keys not in the table, at most, per round
+ */
+#define MAX_MISSES (1 << 20)
+
+#define VALUE "0123456789abcdef"
+
+static const size_t KEY_LENGTHS[] = {16, 64};
+static const double LOAD_FACTORS[] = {0.75, 4, 16};
+
+typedef enum {
+    OP_ADD,
+    OP_GET_HIT,
+    OP_GET_MISS,
+    OP_CONTENT,
+    OP_DEL,
+    OP_LAST
+} op_t;
+
+static const char *const OP_NAMES[OP_LAST] = {"add", "get_hit", "get_miss", "content", "del"};
+
+/**
+ * @brief what was measured of an operation over the rounds of a configuration
+ */
+typedef struct {
+    double ns;
+    size_t ops;
+    size_t allocs;
+    long long cache_misses;   // -1 if not counted
+} measure_t;
+
+//Allocations counted by the wrappers, see the Makefile
+static size_t nb_allocs = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    ++nb_allocs;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    ++nb_allocs;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    ++nb_allocs;
+    return __real_realloc(ptr, size);
+}
+
+//Current time in nanoseconds
+static double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec * 1e9 + (double) t.tv_nsec;
+}
+
+//Counter of the cache misses of this process in user space, -1 if the system does not give one
+static int open_cache_misses(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.size           = sizeof(attr);
+    attr.config         = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * @brief a measure being taken
+ */
+typedef struct {
+    int counter;
+    double start_ns;
+    size_t start_allocs;
+} probe_t;
+
+static void probe_start(probe_t *probe) {
+    if (probe->counter >= 0) {
+        ioctl(probe->counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(probe->counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    probe->start_allocs = nb_allocs;
+    probe->start_ns     = now_ns();
+}
+
+static void probe_stop(probe_t *probe, measure_t *measure, size_t ops) {
+    const double end_ns = now_ns();
+    const size_t allocs = nb_allocs - probe->start_allocs;
+    long long misses = 0;
+    if (probe->counter >= 0) {
+        ioctl(probe->counter, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(probe->counter, &misses, sizeof(misses)) != sizeof(misses)) {
+            misses = -1;
+        }
+    }
+    measure->ns     += end_ns - probe->start_ns;
+    measure->ops    += ops;
+    measure->allocs += allocs;
+    measure->cache_misses = probe->counter < 0 || misses < 0 || measure->cache_misses < 0 ? -1
+                            : measure->cache_misses + misses;
+}
+
+//Keys of key_len characters, the first one given and then the rank, padded with zeros
+static char *make_keys(size_t n, size_t key_len, char first) {
+    char *keys = malloc(n * (key_len + 1));
+    if (keys == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        char *key = keys + i * (key_len + 1);
+        snprintf(key, key_len + 1, "%c%0*zu", first, (int) key_len - 1, i);
+    }
+    return keys;
+}
+
+static size_t gcd(size_t a, size_t b) {
+    while (b != 0) {
+        const size_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+//Run the rounds of a configuration, 0 if the memory ran out
+static int run(size_t n, size_t key_len, double load_factor, int counter, measure_t measures[OP_LAST]) {
+
+    const size_t nb_misses = n < MAX_MISSES ? n : MAX_MISSES;
+    char *keys   = make_keys(n, key_len, 'k');
+    char *misses = make_keys(nb_misses, key_len, 'm');
+    if (keys == NULL || misses == NULL) {
+        free(keys);
+        free(misses);
+        return 0;
+    }
+#define KEY(keys, i) ((keys) + (i) * (key_len + 1))
+
+    //The keys are visited with a stride, so that consecutive operations do not hit the same lines
+    size_t stride = 7919 % n;
+    while (gcd(stride, n) != 1) {
+        ++stride;
+    }
+
+    const size_t nb_buckets = (size_t) ((double) n / load_factor) + 1;
+    const size_t rounds = n >= MIN_OPS ? 1 : (MIN_OPS + n - 1) / n;
+    memset(measures, 0, OP_LAST * sizeof(measure_t));
+    probe_t probe = {counter, 0, 0};
+    int ok = 1;
+
+    for (size_t r = 0; r < rounds && ok; ++r) {
+        Htable_t table = construct_Htable(nb_buckets);
+        if (table == NULL) {
+            ok = 0;
+            break;
+        }
+
+        size_t i = 0;
+        probe_start(&probe);
+        for (size_t k = 0; k < n; ++k, i = (i + stride) % n) {
+            ok &= add_Htable_value(table, KEY(keys, i), VALUE) == ERR_NONE;
+        }
+        probe_stop(&probe, &measures[OP_ADD], n);
+
+        probe_start(&probe);
+        for (size_t k = 0; k < n; ++k, i = (i + stride) % n) {
+            pps_value_t value = get_Htable_value(table, KEY(keys, i));
+            ok &= value != NULL;
+            free((void *) value);
+        }
+        probe_stop(&probe, &measures[OP_GET_HIT], n);
+
+        probe_start(&probe);
+        for (size_t k = 0; k < nb_misses; ++k) {
+            ok &= get_Htable_value(table, KEY(misses, k)) == NULL;
+        }
+        probe_stop(&probe, &measures[OP_GET_MISS], nb_misses);
+
+        //Per entry read
+        probe_start(&probe);
+        kv_list_t *content = get_Htable_content(table);
+        probe_stop(&probe, &measures[OP_CONTENT], n);
+        ok &= content != NULL && content->size == n;
+        kv_list_free(content);
+
+        probe_start(&probe);
+        for (size_t k = 0; k < n; ++k, i = (i + stride) % n) {
+            ok &= del_Htable_key(table, KEY(keys, i)) == ERR_NONE;
+        }
+        probe_stop(&probe, &measures[OP_DEL], n);
+
+        delete_Htable_and_content(&table);
+    }
+#undef KEY
+
+    free(keys);
+    free(misses);
+    return ok;
+}
+
+static void print_measure(int json, op_t op, size_t n, size_t key_len, double load_factor, const measure_t *measure) {
+
+    const double ops = (double) measure->ops;
+    if (json) {
+        printf("{\"op\": \"%s\", \"entries\": %zu, \"key_len\": %zu, \"load_factor\": %g, "
+               "\"ns_per_op\": %.2f, \"allocs_per_op\": %.3f, \"cache_misses_per_op\": ",
+               OP_NAMES[op], n, key_len, load_factor, measure->ns / ops, (double) measure->allocs / ops);
+        if (measure->cache_misses < 0) {
+            printf("null}\n");
+        } else {
+            printf("%.3f}\n", (double) measure->cache_misses / ops);
+        }
+        return;
+    }
+
+    printf("%-9s %10zu %7zu %6g %10.1f %10.3f", OP_NAMES[op], n, key_len, load_factor, measure->ns / ops,
+           (double) measure->allocs / ops);
+    if (measure->cache_misses < 0) {
+        printf(" %12s\n", "-");
+    } else {
+        printf(" %12.3f\n", (double) measure->cache_misses / ops);
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    int json = 0;
+    size_t max_entries = DEFAULT_MAX_ENTRIES;
+    int i = 1;
+    if (i < argc && strcmp(argv[i], "-j") == 0) {
+        json = 1;
+        ++i;
+    }
+    if (i < argc && (sscanf(argv[i++], "%zu", &max_entries) != 1 || max_entries < MIN_ENTRIES)) {
+        i = argc + 1;
+    }
+    if (i != argc) {
+        fprintf(stderr, "usage: %s [-j] [max_entries]\n", argv[0]);
+        return ERR_BAD_PARAMETER;
+    }
+
+    const int counter = open_cache_misses();
+    if (!json) {
+        if (counter < 0) {
+            printf("cache misses not counted: perf_event_open not allowed\n");
+        }
+        printf("%-9s %10s %7s %6s %10s %10s %12s\n", "op", "entries", "key_len", "load", "ns/op", "allocs/op",
+               "misses/op");
+    }
+
+    measure_t measures[OP_LAST];
+    for (size_t n = MIN_ENTRIES; n <= max_entries; n *= 10) {
+        for (size_t k = 0; k < sizeof(KEY_LENGTHS) / sizeof(KEY_LENGTHS[0]); ++k) {
+            for (size_t l = 0; l < sizeof(LOAD_FACTORS) / sizeof(LOAD_FACTORS[0]); ++l) {
+
+                if (!run(n, KEY_LENGTHS[k], LOAD_FACTORS[l], counter, measures)) {
+                    fprintf(stderr, "%zu entries of keys of %zu bytes: out of memory or wrong results\n",
+                            n, KEY_LENGTHS[k]);
+                    if (counter >= 0) {
+                        close(counter);
+                    }
+                    return ERR_NOMEM;
+                }
+                for (op_t op = OP_ADD; op < OP_LAST; ++op) {
+                    print_measure(json, op, n, KEY_LENGTHS[k], LOAD_FACTORS[l], &measures[op]);
+                }
+                fflush(stdout);
+            }
+        }
+    }
+
+    if (counter >= 0) {
+        close(counter);
+    }
+    return 0;
+}
@@ -0,0 +1,346 @@
+/**
+ * @file pps-bench.c
+ * @brief load the cluster of the servers file with gets and puts (see pipeline.h) and report the
+ *        throughput and the latency percentiles of each operation.
+ *        Usage: pps-bench [-n N] [-w W] [-r R] [-k keys] [-z theta] [-v size[:max]] [-g get_ratio]
+ *                         [-c concurrency] [-a ops_per_s] [-t seconds] [-s seed] [-l] [-T trace]
+ *        Closed loop by default: -c operations are kept out (32 by default). With -a, the
+ *        operations arrive at that rate (exponential inter-arrival times) whether or not the
+ *        cluster keeps up, at most -c of them out (PIPELINE_MAX_DEPTH by default). With -T, the
+ *        operations of a trace (see workload_parse_trace_line) are replayed at their times.
+ *        The latency of an operation is counted from the time it was due, not from the time it
+ *        could be sent: with -a and -T, an operation delayed because the cluster fell behind
+ *        counts the delay ("coordinated omission").
+ *        -k, -z and -v describe the synthetic operations: the key space ("bench-0" to
+ *        "bench-<keys - 1>", 1000 keys by default), its Zipfian exponent (0, uniform, by default)
+ *        and the range of the sizes of the values (16 bytes by default); -g is the share of gets
+ *        (0.9 by default). -l writes all the keys first, so that the gets find them.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "config.h"
+#include "error.h"
+#include "system.h"
+#include "util.h" // for argv_size
+#include "client.h"
+#include "pipeline.h"
+#include "histogram.h"
+#include "workload.h"
+
+#define USAGE "usage: pps-bench [-n N] [-w W] [-r R] [-k keys] [-z theta] [-v size[:max]] [-g get_ratio] " \
+              "[-c concurrency] [-a ops_per_s] [-t seconds] [-s seed] [-l] [-T trace]"
+
+#define BENCH_DEFAULT_KEYS 1000
+#define BENCH_DEFAULT_VALUE_SIZE 16
+#define BENCH_DEFAULT_GET_RATIO 0.9
+#define BENCH_DEFAULT_SECONDS 10
+
+/**
+ * @brief options of a run
+ */
+typedef struct {
+    size_t nb_keys;
+    double theta;
+    size_t min_value_size;
+    size_t max_value_size;
+    double get_ratio;
+    size_t concurrency;       // 0 if not given
+    double rate;              // operations per second, 0 for a closed loop
+    double seconds;
+    uint64_t seed;
+    int preload;
+    const char *trace;        // NULL for synthetic operations
+} bench_options_t;
+
+/**
+ * @brief times the operations out were due (a FIFO: their results come in order), and what was
+ *        measured
+ */
+typedef struct {
+    double due_ms[PIPELINE_MAX_DEPTH + 1];
+    size_t first;
+    size_t nb_out;
+    histogram_t latencies[2]; // in microseconds, of the gets and of the puts that succeeded
+    uint64_t failed[2];
+    int recording;            // 0 while preloading
+} bench_t;
+
+static void push_due(bench_t *bench, double due_ms) {
+    bench->due_ms[(bench->first + bench->nb_out) % (PIPELINE_MAX_DEPTH + 1)] = due_ms;
+    ++bench->nb_out;
+}
+
+static void on_done(pipeline_op_t op, const char *key, error_code error, const char *value, double done_ms, void *arg) {
+    (void) key;
+    (void) value;
+    bench_t *bench = arg;
+    const double due_ms = bench->due_ms[bench->first];
+    bench->first = (bench->first + 1) % (PIPELINE_MAX_DEPTH + 1);
+    --bench->nb_out;
+
+    if (error != ERR_NONE) {
+        bench->failed[op] += 1;
+    } else if (bench->recording) {
+        histogram_record(&bench->latencies[op], done_ms > due_ms ? (uint64_t) ((done_ms - due_ms) * 1000) : 0);
+    }
+}
+
+//Submit an operation due at due_ms (it may wait for room, its results being recorded meanwhile)
+static void submit(pipeline_t *pipeline, bench_t *bench, pipeline_op_t op, const char *key, const char *value,
+                   double due_ms) {
+    push_due(bench, due_ms);
+    if (pipeline_submit(pipeline, op, key, value) != ERR_NONE) {
+        //Not submitted: its time was the last one pushed
+        --bench->nb_out;
+        bench->failed[op] += 1;
+    }
+}
+
+static int is_full(const pipeline_t *pipeline) {
+    return pipeline->next_seq - pipeline->oldest_seq == pipeline->depth;
+}
+
+static void preload(pipeline_t *pipeline, bench_t *bench, workload_t *workload) {
+    char key[WORKLOAD_KEY_SIZE];
+    for (size_t k = 0; k < workload->nb_keys; ++k) {
+        //Not as many out as an open loop may keep: the servers would drop some of the writes
+        while (pipeline->next_seq - pipeline->oldest_seq >= PIPELINE_DEFAULT_DEPTH) {
+            pipeline_wait(pipeline, PIPELINE_TIMEOUT_MS);
+        }
+        snprintf(key, sizeof(key), WORKLOAD_KEY_FORMAT, k);
+        submit(pipeline, bench, PIPELINE_PUT, key, workload_next_value(workload), get_time_ms());
+    }
+    pipeline_flush(pipeline);
+}
+
+static void run_synthetic(pipeline_t *pipeline, bench_t *bench, workload_t *workload, const bench_options_t *options) {
+
+    const double start = get_time_ms();
+    const double end   = start + options->seconds * 1000;
+    double due = start;
+    char key[WORKLOAD_KEY_SIZE];
+    for (double now = start; now < end; now = get_time_ms()) {
+        if (options->rate > 0) {
+            if (now < due) {
+                pipeline_wait(pipeline, due - now);
+                continue;
+            }
+        } else if (is_full(pipeline)) {
+            //Closed loop: an operation is due once there is room for it
+            pipeline_wait(pipeline, end - now);
+            continue;
+        } else {
+            due = now;
+        }
+
+        const pipeline_op_t op = workload_uniform(workload) < options->get_ratio ? PIPELINE_GET : PIPELINE_PUT;
+        snprintf(key, sizeof(key), WORKLOAD_KEY_FORMAT, workload_next_key(workload));
+        submit(pipeline, bench, op, key, op == PIPELINE_PUT ? workload_next_value(workload) : NULL, due);
+
+        if (options->rate > 0) {
+            //Poisson arrivals
+            due += -log(1 - workload_uniform(workload)) / options->rate * 1000;
+        }
+    }
+}
+
+static error_code run_trace(pipeline_t *pipeline, bench_t *bench, const char *path) {
+
+    FILE *file = fopen(path, "r");
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(file, ERR_IO);
+
+    static char line[2 * MAX_MSG_SIZE];
+    static workload_trace_op_t op;
+    const double start = get_time_ms();
+    size_t nb_line = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        ++nb_line;
+        if (line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        if (workload_parse_trace_line(line, &op) != ERR_NONE) {
+            fprintf(stderr, "%s:%zu: not an operation, skipped\n", path, nb_line);
+            continue;
+        }
+        const double due = start + op.t_ms;
+        for (double now = get_time_ms(); now < due; now = get_time_ms()) {
+            pipeline_wait(pipeline, due - now);
+        }
+        submit(pipeline, bench, op.op, op.key, op.op == PIPELINE_PUT ? op.value : NULL, due);
+    }
+
+    fclose(file);
+    return ERR_NONE;
+}
+
+static void print_row(const char *name, const histogram_t *latencies, uint64_t failed, double seconds) {
+    static const double percentiles[] = {50, 90, 99, 99.9, 99.99};
+    printf("%-4s %10llu %8llu %10.0f %8.3f", name, (unsigned long long) latencies->total,
+           (unsigned long long) failed, (double) latencies->total / seconds, histogram_mean(latencies) / 1000);
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i) {
+        printf(" %8.3f", (double) histogram_percentile(latencies, percentiles[i]) / 1000);
+    }
+    printf(" %8.3f\n", (double) latencies->max / 1000 * (latencies->total > 0));
+}
+
+static void report(const bench_t *bench, double seconds) {
+    printf("%-4s %10s %8s %10s %8s %8s %8s %8s %8s %8s %8s\n", "op", "ok", "failed", "ops/s", "mean_ms",
+           "p50", "p90", "p99", "p99.9", "p99.99", "max");
+    print_row("get", &bench->latencies[PIPELINE_GET], bench->failed[PIPELINE_GET], seconds);
+    print_row("put", &bench->latencies[PIPELINE_PUT], bench->failed[PIPELINE_PUT], seconds);
+
+    histogram_t all;
+    histogram_init(&all);
+    histogram_merge(&all, &bench->latencies[PIPELINE_GET]);
+    histogram_merge(&all, &bench->latencies[PIPELINE_PUT]);
+    print_row("all", &all, bench->failed[PIPELINE_GET] + bench->failed[PIPELINE_PUT], seconds);
+}
+
+//Options after the ones of the client, 0 if they are not valid
+static int parse_options(char **argv, bench_options_t *options) {
+
+    for (size_t i = 0; i < argv_size(argv); ++i) {
+        const char *option = argv[i];
+        if (strcmp(option, "-l") == 0) {
+            options->preload = 1;
+            continue;
+        }
+        const char *value = argv[++i];
+        if (value == NULL || strlen(option) != 2 || option[0] != '-') {
+            return 0;
+        }
+        int valid = 0;
+        switch (option[1]) {
+        case 'k':
+            valid = sscanf(value, "%zu", &options->nb_keys) == 1 && options->nb_keys > 0;
+            break;
+        case 'z':
+            valid = sscanf(value, "%lf", &options->theta) == 1 && options->theta >= 0 && options->theta < 1;
+            break;
+        case 'v':
+            valid = sscanf(value, "%zu", &options->min_value_size) == 1;
+            options->max_value_size = options->min_value_size;
+            if (valid && strchr(value, ':') != NULL) {
+                valid = sscanf(strchr(value, ':') + 1, "%zu", &options->max_value_size) == 1;
+            }
+            valid = valid && options->min_value_size <= options->max_value_size
+                    && options->max_value_size <= MAX_MSG_ELEM_SIZE;
+            break;
+        case 'g':
+            valid = sscanf(value, "%lf", &options->get_ratio) == 1 && options->get_ratio >= 0 && options->get_ratio <= 1;
+            break;
+        case 'c':
+            valid = sscanf(value, "%zu", &options->concurrency) == 1 && options->concurrency > 0
+                    && options->concurrency <= PIPELINE_MAX_DEPTH;
+            break;
+        case 'a':
+            valid = sscanf(value, "%lf", &options->rate) == 1 && options->rate > 0;
+            break;
+        case 't':
+            valid = sscanf(value, "%lf", &options->seconds) == 1 && options->seconds > 0;
+            break;
+        case 's':
+            valid = sscanf(value, "%llu", (unsigned long long *) &options->seed) == 1;
+            break;
+        case 'T':
+            options->trace = value;
+            valid = 1;
+            break;
+        default:
+            break;
+        }
+        if (!valid) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+
+    //Client initialization
+    client_t client;
+
+    client_init_args_t init = {&argv, (size_t) argc, SIZE_MAX, TOTAL_SERVERS | PUT_NEEDED | GET_NEEDED, &client};
+
+    error_code error = client_init(init);
+    M_EXIT_IF_ERR(error, "problem while initializing the client");
+
+    bench_options_t options = {BENCH_DEFAULT_KEYS, 0, BENCH_DEFAULT_VALUE_SIZE, BENCH_DEFAULT_VALUE_SIZE,
+                               BENCH_DEFAULT_GET_RATIO, 0, 0, BENCH_DEFAULT_SECONDS, 0, 0, NULL};
+    if (!parse_options(argv, &options)) {
+        client_end(&client);
+        fprintf(stderr, "%s\n", USAGE);
+        return ERR_BAD_PARAMETER;
+    }
+    //An open loop keeps as many operations out as it takes, up to the maximum
+    const int open_loop = options.rate > 0 || options.trace != NULL;
+    const size_t depth  = options.concurrency > 0 ? options.concurrency
+                          : open_loop ? PIPELINE_MAX_DEPTH : PIPELINE_DEFAULT_DEPTH;
+
+    static bench_t bench;
+    workload_t workload;
+    pipeline_t pipeline;
+    error = workload_init(&workload, options.seed, options.nb_keys, options.theta, options.min_value_size,
+                          options.max_value_size);
+    if (error == ERR_NONE) {
+        error = pipeline_init(&pipeline, &client, depth, on_done, &bench);
+        if (error != ERR_NONE) {
+            workload_end(&workload);
+        }
+    }
+    if (error != ERR_NONE) {
+        client_end(&client);
+    }
+    M_EXIT_IF_ERR(error, "cannot start the benchmark");
+
+    if (options.preload) {
+        preload(&pipeline, &bench, &workload);
+        if (bench.failed[PIPELINE_PUT] > 0) {
+            fprintf(stderr, "%llu of the %zu keys could not be written\n",
+                    (unsigned long long) bench.failed[PIPELINE_PUT], options.nb_keys);
+        }
+        bench.failed[PIPELINE_PUT] = 0;
+    }
+    bench.recording = 1;
+    histogram_init(&bench.latencies[PIPELINE_GET]);
+    histogram_init(&bench.latencies[PIPELINE_PUT]);
+
+    if (options.trace != NULL) {
+        printf("replay of %s, at most %zu operations out\n", options.trace, depth);
+    } else if (open_loop) {
+        printf("open loop at %.0f ops/s for %.0f s, at most %zu operations out\n", options.rate, options.seconds, depth);
+    } else {
+        printf("closed loop of %zu operations out for %.0f s\n", depth, options.seconds);
+    }
+    if (options.trace == NULL) {
+        printf("%zu keys, Zipfian exponent %.2f, values of %zu to %zu bytes, %.0f%% gets\n", options.nb_keys,
+               options.theta, options.min_value_size, options.max_value_size, options.get_ratio * 100);
+    }
+
+    const double start = get_time_ms();
+    if (options.trace != NULL) {
+        error = run_trace(&pipeline, &bench, options.trace);
+    } else {
+        run_synthetic(&pipeline, &bench, &workload, &options);
+    }
+    pipeline_flush(&pipeline);
+    const double seconds = (get_time_ms() - start) / 1000;
+
+    if (error == ERR_NONE) {
+        report(&bench, seconds);
+    } else {
+        fprintf(stderr, "cannot read %s\n", options.trace);
+    }
+
+    pipeline_end(&pipeline);
+    workload_end(&workload);
+    client_end(&client);
+
+    return error;
+}
@@ -0,0 +1,188 @@
+/**
+ * @file bulk.c
+ * @brief Implementation of bulk.h
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "bulk.h"
+#include "config.h"
+#include "system.h"
+
+//Sizes of the lengths starting a record and of the CRC-32 ending it
+#define BULK_LENGTHS_SIZE 8
+#define BULK_CRC_SIZE 4
+
+static uint32_t crc_table[256];
+static int crc_table_ready = 0;
+
+//Table of the reflected polynomial, one entry per byte value
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        }
+        crc_table[i] = crc;
+    }
+    crc_table_ready = 1;
+}
+
+uint32_t bulk_crc32(uint32_t crc, const void *data, size_t len) {
+    if (!crc_table_ready) {
+        crc_init();
+    }
+    const unsigned char *in = data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i) {
+        crc = crc_table[(crc ^ in[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+error_code bulk_update_membership(int socket, ring_t *ring) {
+
+    M_REQUIRE_NON_NULL(ring);
+    M_REQUIRE(set_receive_timeout_ms(socket, BULK_PING_TIMEOUT_MS) == ERR_NONE, ERR_NETWORK, "%s", "cannot set the timeout");
+
+    int *alive = calloc(ring->nb_servers, sizeof(int));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(alive, ERR_NOMEM);
+
+    size_t nb_alive = 0;
+    for (int attempt = 0; attempt < BULK_PING_RETRIES && nb_alive < ring->nb_servers; ++attempt) {
+        for (size_t i = 0; i < ring->nb_servers; ++i) {
+            if (!alive[i]) {
+                sendto(socket, NULL, 0, 0, &ring->servers[i].addr, sizeof(ring->servers[i].addr));
+            }
+        }
+
+        //Pings are answered by an empty datagram
+        char reply[1];
+        struct sockaddr from;
+        socklen_t from_len = sizeof(from);
+        ssize_t len = 0;
+        while (nb_alive < ring->nb_servers
+               && (len = recvfrom(socket, reply, sizeof(reply), 0, &from, &from_len)) != -1) {
+            for (size_t i = 0; i < ring->nb_servers && len == 0; ++i) {
+                if (!alive[i] && memcmp(&from, &ring->servers[i].addr, from_len) == 0) {
+                    alive[i] = 1;
+                    ++nb_alive;
+                }
+            }
+            from_len = sizeof(from);
+        }
+    }
+
+    error_code error = nb_alive > 0 ? ring_update_membership(ring, alive) : ERR_NETWORK;
+    free(alive);
+    return error;
+}
+
+static void write_u32(unsigned char *out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = (unsigned char) (value >> (24 - 8 * i));
+    }
+}
+
+static uint32_t read_u32(const unsigned char *in) {
+    return (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16 | (uint32_t) in[2] << 8 | in[3];
+}
+
+static error_code write_bytes(FILE *file, const void *data, size_t len) {
+    return len == 0 || fwrite(data, 1, len, file) == len ? ERR_NONE : ERR_IO;
+}
+
+static error_code read_bytes(FILE *file, void *data, size_t len) {
+    return len == 0 || fread(data, 1, len, file) == len ? ERR_NONE : ERR_IO;
+}
+
+error_code bulk_write_header(FILE *file) {
+    M_REQUIRE_NON_NULL(file);
+    return write_bytes(file, BULK_MAGIC, BULK_MAGIC_SIZE);
+}
+
+error_code bulk_write_pair(FILE *file, const char *key, size_t key_len, const char *value, size_t value_len) {
+
+    M_REQUIRE_NON_NULL(file);
+    M_REQUIRE_NON_NULL(key);
+    M_REQUIRE_NON_NULL(value);
+    M_REQUIRE(key_len > 0 && key_len <= MAX_MSG_ELEM_SIZE && value_len <= MAX_MSG_ELEM_SIZE,
+              ERR_BAD_PARAMETER, "pair of lengths %zu and %zu", key_len, value_len);
+
+    unsigned char lengths[BULK_LENGTHS_SIZE];
+    write_u32(lengths, (uint32_t) key_len);
+    write_u32(lengths + 4, (uint32_t) value_len);
+
+    unsigned char crc[BULK_CRC_SIZE];
+    uint32_t sum = bulk_crc32(0, lengths, sizeof(lengths));
+    sum = bulk_crc32(sum, key, key_len);
+    write_u32(crc, bulk_crc32(sum, value, value_len));
+
+    M_REQUIRE(write_bytes(file, lengths, sizeof(lengths)) == ERR_NONE && write_bytes(file, key, key_len) == ERR_NONE
+              && write_bytes(file, value, value_len) == ERR_NONE && write_bytes(file, crc, sizeof(crc)) == ERR_NONE,
+              ERR_IO, "%s", "cannot write a pair");
+    return ERR_NONE;
+}
+
+error_code bulk_write_end(FILE *file, uint64_t count) {
+
+    M_REQUIRE_NON_NULL(file);
+
+    unsigned char end[BULK_LENGTHS_SIZE + 8 + BULK_CRC_SIZE] = {0};
+    write_u32(end + BULK_LENGTHS_SIZE, (uint32_t) (count >> 32));
+    write_u32(end + BULK_LENGTHS_SIZE + 4, (uint32_t) count);
+    write_u32(end + BULK_LENGTHS_SIZE + 8, bulk_crc32(0, end, BULK_LENGTHS_SIZE + 8));
+
+    return write_bytes(file, end, sizeof(end));
+}
+
+error_code bulk_read_header(FILE *file) {
+
+    M_REQUIRE_NON_NULL(file);
+
+    char magic[BULK_MAGIC_SIZE];
+    M_REQUIRE(read_bytes(file, magic, sizeof(magic)) == ERR_NONE && memcmp(magic, BULK_MAGIC, BULK_MAGIC_SIZE) == 0,
+              ERR_IO, "%s", "not a bulk file");
+    return ERR_NONE;
+}
+
+error_code bulk_read_pair(FILE *file, char *key, size_t *key_len, char *value, size_t *value_len, uint64_t *count) {
+
+    M_REQUIRE_NON_NULL(file);
+    M_REQUIRE_NON_NULL(key);
+    M_REQUIRE_NON_NULL(key_len);
+    M_REQUIRE_NON_NULL(value);
+    M_REQUIRE_NON_NULL(value_len);
+    M_REQUIRE_NON_NULL(count);
+
+    unsigned char lengths[BULK_LENGTHS_SIZE];
+    M_REQUIRE(read_bytes(file, lengths, sizeof(lengths)) == ERR_NONE, ERR_IO, "%s", "truncated file");
+    const uint32_t klen = read_u32(lengths);
+    const uint32_t vlen = read_u32(lengths + 4);
+    uint32_t sum = bulk_crc32(0, lengths, sizeof(lengths));
+
+    unsigned char tail[8 + BULK_CRC_SIZE];
+    if (klen == 0) {
+        M_REQUIRE(vlen == 0 && read_bytes(file, tail, sizeof(tail)) == ERR_NONE, ERR_IO, "%s", "truncated end");
+        M_REQUIRE(read_u32(tail + 8) == bulk_crc32(sum, tail, 8), ERR_IO, "%s", "corrupted end");
+        *count   = (uint64_t) read_u32(tail) << 32 | read_u32(tail + 4);
+        *key_len = 0;
+        *value_len = 0;
+        return ERR_NONE;
+    }
+
+    M_REQUIRE(klen <= MAX_MSG_ELEM_SIZE && vlen <= MAX_MSG_ELEM_SIZE, ERR_IO, "pair of lengths %u and %u", klen, vlen);
+    M_REQUIRE(read_bytes(file, key, klen) == ERR_NONE && read_bytes(file, value, vlen) == ERR_NONE
+              && read_bytes(file, tail, BULK_CRC_SIZE) == ERR_NONE, ERR_IO, "%s", "truncated pair");
+    sum = bulk_crc32(sum, key, klen);
+    M_REQUIRE(read_u32(tail) == bulk_crc32(sum, value, vlen), ERR_IO, "%s", "corrupted pair");
+
+    key[klen]   = '\0';
+    value[vlen] = '\0';
+    *key_len    = klen;
+    *value_len  = vlen;
+    return ERR_NONE;
+}
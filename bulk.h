@@ -0,0 +1,89 @@
+#pragma once
+
+/**
+ * @file bulk.h
+ * @brief Binary files of pairs, written by pps-export and read by pps-import. A file is a magic
+ *        string, then one record per pair: the length of the key and of the value (4 bytes each),
+ *        the key, the value and a CRC-32 of all of these. It ends with a record of two zero lengths
+ *        (keys are never empty), the number of pairs (8 bytes) and a CRC-32 of these, so that a
+ *        truncated file is told from a complete one.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "error.h"
+#include "ring.h"
+
+#define BULK_MAGIC      "PPSBULK1"
+#define BULK_MAGIC_SIZE 8
+
+/**
+ * @brief sizes of the header of a batch of writes (opcode, sequence number, number of pairs) and
+ *        of its reply (opcode, sequence number, status), see PPS_OP_PUT_BATCH
+ */
+#define BULK_BATCH_HEADER_SIZE 8
+#define BULK_BATCH_REPLY_SIZE  7
+
+/**
+ * @brief a server is taken as down when it answers no ping in this long, this many times
+ */
+#define BULK_PING_TIMEOUT_MS 300
+#define BULK_PING_RETRIES 3
+
+/**
+ * @brief ping every server of a ring and mark the ones not answering down, so that the replicas of
+ *        a key are its first alive servers
+ * @param socket the socket to use (its receive timeout is changed)
+ * @param ring the (initialized) ring
+ * @return ERR_NETWORK if no server answers
+ */
+error_code bulk_update_membership(int socket, ring_t *ring);
+
+/**
+ * @brief CRC-32 (IEEE 802.3) of some bytes, going on from the CRC-32 of the bytes before them
+ * @param crc CRC-32 of the bytes before (0 for the first ones)
+ * @param data the bytes
+ * @param len their number
+ * @return the CRC-32 of all the bytes
+ */
+uint32_t bulk_crc32(uint32_t crc, const void *data, size_t len);
+
+/**
+ * @brief write the magic string starting a file
+ * @return ERR_IO if it cannot be written
+ */
+error_code bulk_write_header(FILE *file);
+
+/**
+ * @brief write the record of a pair
+ * @param key_len length of the key, not 0
+ * @param value_len length of the value
+ * @return ERR_BAD_PARAMETER for an empty or too long key or value, ERR_IO if it cannot be written
+ */
+error_code bulk_write_pair(FILE *file, const char *key, size_t key_len, const char *value, size_t value_len);
+
+/**
+ * @brief write the end of a file
+ * @param count number of pairs written
+ * @return ERR_IO if it cannot be written
+ */
+error_code bulk_write_end(FILE *file, uint64_t count);
+
+/**
+ * @brief read the magic string starting a file
+ * @return ERR_IO if the file does not start with it
+ */
+error_code bulk_read_header(FILE *file);
+
+/**
+ * @brief read the next record of a file
+ * @param key (OUT) the key, nul-terminated, of MAX_MSG_ELEM_SIZE + 1 bytes
+ * @param key_len (OUT) its length, 0 at the end of the file
+ * @param value (OUT) the value, nul-terminated, of MAX_MSG_ELEM_SIZE + 1 bytes
+ * @param value_len (OUT) its length
+ * @param count (OUT) at the end of the file, the number of pairs written in it
+ * @return ERR_IO if the record is truncated, too long or does not match its CRC-32
+ */
+error_code bulk_read_pair(FILE *file, char *key, size_t *key_len, char *value, size_t *value_len, uint64_t *count);
@@ -0,0 +1,153 @@
+/**
+ * @file cache.c
+ * @brief Implementation of cache.h
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "cache.h"
+#include "config.h"
+#include "system.h"
+
+#define TIMEOUT 1
+
+static void clear_entry(cache_entry_t *entry) {
+    free(entry->key);
+    free(entry->value);
+    entry->key   = NULL;
+    entry->value = NULL;
+}
+
+client_cache_t *cache_alloc(size_t capacity) {
+
+    M_REQUIRE(capacity > 0, NULL, "%s", "empty cache");
+
+    client_cache_t *cache = calloc(1, sizeof(client_cache_t));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(cache, NULL);
+
+    cache->entries = calloc(capacity, sizeof(cache_entry_t));
+    cache->socket  = get_socket(TIMEOUT);
+    if (cache->entries == NULL || cache->socket == -1) {
+        if (cache->socket != -1) {
+            close(cache->socket);
+        }
+        free(cache->entries);
+        free(cache);
+        return NULL;
+    }
+    cache->capacity = capacity;
+
+    return cache;
+}
+
+void cache_free(client_cache_t *cache) {
+    if (cache != NULL) {
+        for (size_t i = 0; i < cache->capacity; ++i) {
+            clear_entry(&cache->entries[i]);
+        }
+        free(cache->entries);
+        close(cache->socket);
+        free(cache);
+    }
+}
+
+int cache_handle(client_cache_t *cache, const char *msg, size_t len) {
+
+    if (cache == NULL || msg == NULL || len < 2 || msg[0] != PPS_OP_PREFIX || msg[1] != PPS_OP_INVALIDATE) {
+        return 0;
+    }
+
+    char key[MAX_MSG_ELEM_SIZE + 1];
+    const size_t key_len = len - 2 < MAX_MSG_ELEM_SIZE ? len - 2 : MAX_MSG_ELEM_SIZE;
+    memcpy(key, msg + 2, key_len);
+    key[key_len] = '\0';
+
+    cache_entry_t *entry = &cache->entries[hash_function(key, cache->capacity)];
+    if (entry->key != NULL && strcmp(entry->key, key) == 0) {
+        clear_entry(entry);
+        cache->invalidations += 1;
+    }
+
+    return 1;
+}
+
+void cache_poll(client_cache_t *cache) {
+
+    if (cache == NULL) {
+        return;
+    }
+
+    char msg[MAX_MSG_ELEM_SIZE + 2];
+    ssize_t len;
+    while ((len = recv(cache->socket, msg, sizeof(msg), MSG_DONTWAIT)) >= 0) {
+        //Anything else is a late answer to a previous read
+        cache_handle(cache, msg, (size_t) len);
+    }
+}
+
+pps_value_t cache_get(client_cache_t *cache, pps_key_t key, double now) {
+
+    if (cache == NULL || key == NULL) {
+        return NULL;
+    }
+
+    cache_entry_t *entry = &cache->entries[hash_function(key, cache->capacity)];
+    if (entry->key == NULL || strcmp(entry->key, key) != 0) {
+        cache->misses += 1;
+        return NULL;
+    }
+    if (entry->expires <= now) {
+        clear_entry(entry);
+        cache->expirations += 1;
+        cache->misses      += 1;
+        return NULL;
+    }
+
+    pps_value_t value = strdup(entry->value);
+    if (value != NULL) {
+        cache->hits += 1;
+    }
+    return value;
+}
+
+void cache_put(client_cache_t *cache, pps_key_t key, pps_value_t value, double expires) {
+
+    if (cache == NULL || key == NULL || value == NULL) {
+        return;
+    }
+
+    cache_entry_t *entry = &cache->entries[hash_function(key, cache->capacity)];
+    clear_entry(entry);
+
+    entry->key   = strdup(key);
+    entry->value = strdup(value);
+    if (entry->key == NULL || entry->value == NULL) {
+        clear_entry(entry);
+        return;
+    }
+    entry->expires = expires;
+}
+
+void cache_drop(client_cache_t *cache, pps_key_t key) {
+    if (cache != NULL && key != NULL) {
+        cache_entry_t *entry = &cache->entries[hash_function(key, cache->capacity)];
+        if (entry->key != NULL && strcmp(entry->key, key) == 0) {
+            clear_entry(entry);
+        }
+    }
+}
+
+void cache_print_stats(const client_cache_t *cache, FILE *out) {
+    if (cache != NULL && out != NULL) {
+        const size_t reads = cache->hits + cache->misses;
+        fprintf(out, "cache: %zu reads, %zu hits (%.1f%%), %zu invalidations, %zu expirations\n",
+                reads, cache->hits, reads > 0 ? 100.0 * (double) cache->hits / (double) reads : 0.0,
+                cache->invalidations, cache->expirations);
+    }
+}
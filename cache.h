@@ -0,0 +1,105 @@
+#pragma once
+
+/**
+ * @file cache.h
+ * @brief Client-side read cache: values read with leases (see lease.h) are served locally
+ *        until their lease expires or a server invalidates them. The requests are sent from
+ *        the socket of the cache, so that invalidations reach it.
+ *        The cache is in the memory of the client and goes with it: only a process that reads
+ *        the same keys again, like pps-client-batch or pps-bench, gets hits, while each run of
+ *        pps-client-get starts with an empty one and only takes leases it never uses.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "hashtable.h"
+
+/**
+ * @brief number of entries of the cache (direct-mapped: a key evicts the key in its slot)
+ */
+#define CACHE_DEFAULT_CAPACITY 1024
+
+/**
+ * @brief a cached value
+ */
+typedef struct {
+    char *key;                // NULL if the slot is empty
+    char *value;
+    double expires;           // end of the shortest lease of the value
+} cache_entry_t;
+
+/**
+ * @brief the cache of a client
+ */
+typedef struct {
+    int socket;               // socket of the leased reads, which receives the invalidations
+    uint32_t next_seq;        // sequence number of the next leased read, to tell late answers apart
+    cache_entry_t *entries;
+    size_t capacity;
+    size_t hits;
+    size_t misses;
+    size_t invalidations;
+    size_t expirations;
+} client_cache_t;
+
+/**
+ * @brief allocate an empty cache and its socket
+ * @param capacity number of entries
+ * @return the cache, NULL on error
+ */
+client_cache_t *cache_alloc(size_t capacity);
+
+/**
+ * @brief free the cache and close its socket
+ * @param cache the cache to free
+ */
+void cache_free(client_cache_t *cache);
+
+/**
+ * @brief handle a message if it is an invalidation
+ * @param cache the cache
+ * @param msg the message
+ * @param len length of the message
+ * @return 1 if the message was an invalidation, 0 otherwise
+ */
+int cache_handle(client_cache_t *cache, const char *msg, size_t len);
+
+/**
+ * @brief handle the invalidations waiting on the socket of the cache
+ * @param cache the cache
+ */
+void cache_poll(client_cache_t *cache);
+
+/**
+ * @brief look up a key (call cache_poll first)
+ * @param cache the cache
+ * @param key the key
+ * @param now current time (get_time_ms)
+ * @return a copy of the value (to be freed by the caller), NULL if not cached or expired
+ */
+pps_value_t cache_get(client_cache_t *cache, pps_key_t key, double now);
+
+/**
+ * @brief cache a value until its lease expires
+ * @param cache the cache
+ * @param key the key
+ * @param value the value
+ * @param expires end of the lease
+ */
+void cache_put(client_cache_t *cache, pps_key_t key, pps_value_t value, double expires);
+
+/**
+ * @brief drop a key from the cache, e.g. when the client writes it
+ * @param cache the cache
+ * @param key the key
+ */
+void cache_drop(client_cache_t *cache, pps_key_t key);
+
+/**
+ * @brief print the hit rate and the invalidation and expiration counts
+ * @param cache the cache
+ * @param out where to print
+ */
+void cache_print_stats(const client_cache_t *cache, FILE *out);
@@ -0,0 +1,45 @@
+/**
+ * @file pps-client-append.c
+ * @brief Client to append a suffix to the value of a key of the DHT, on the servers
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "network.h"
+#include "config.h"
+#include "client.h"
+
+#define NB_ARGS 2
+
+int main(int argc, char *argv[]) {
+    //Client initialization
+    client_t client;
+
+    client_init_args_t init = {&argv, (size_t) argc, NB_ARGS, TOTAL_SERVERS | PUT_NEEDED, &client};
+
+    error_code error = client_init(init);
+    M_EXIT_IF_ERR(error, "problem while initializing the client");
+
+    char *key    = argv[0];
+    char *suffix = argv[1];
+
+    if (strlen(key) > MAX_MSG_ELEM_SIZE || strlen(suffix) > MAX_MSG_ELEM_SIZE) {
+        printf("FAIL\n");
+        client_end(&client);
+        return ERR_BAD_PARAMETER;
+    }
+
+    //Send the suffix to the servers of the key
+    if (network_append(client, key, suffix) == ERR_NONE) {
+        printf("OK\n");
+    } else {
+        printf("FAIL\n");
+    }
+
+    //Client closing
+    client_end(&client);
+
+    return 0;
+}
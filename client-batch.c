@@ -0,0 +1,165 @@
+/**
+ * @file pps-client-batch.c
+ * @brief run the gets and puts read on stdin over one client, several of them out at once (see
+ *        pipeline.h), and print their results in order.
+ *        Usage: pps-client-batch [-n N] [-w W] [-r R] [-d depth] [-b]
+ *        A line is "get key" or "put key value" (the value is the rest of the line), its result
+ *        "OK value", "OK" or "FAIL" as with pps-client-get and pps-client-put.
+ *        With -b, the operations are frames: 'g' or 'p', the length of the key and of the value
+ *        (4 bytes each, big endian), the key and the value; the results are frames of a status
+ *        (0 if the operation succeeded), the length of the value (4 bytes) and the value.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "error.h"
+#include "util.h" // for argv_size
+#include "client.h"
+#include "pipeline.h"
+
+#define USAGE "usage: pps-client-batch [-n N] [-w W] [-r R] [-d depth] [-b]"
+
+//Length of the key, of the value and of the status in the frames
+#define FRAME_HEADER_SIZE 9
+#define RESULT_HEADER_SIZE 5
+
+static void print_line(pipeline_op_t op, const char *key, error_code error, const char *value, double done_ms, void *arg) {
+    (void) key;
+    (void) done_ms;
+    (void) arg;
+    if (error != ERR_NONE) {
+        printf("FAIL\n");
+    } else if (op == PIPELINE_GET) {
+        printf("OK %s\n", value);
+    } else {
+        printf("OK\n");
+    }
+}
+
+static void write_u32(unsigned char *out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = (unsigned char) (value >> (24 - 8 * i));
+    }
+}
+
+static uint32_t read_u32(const unsigned char *in) {
+    return (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16 | (uint32_t) in[2] << 8 | in[3];
+}
+
+static void print_frame(pipeline_op_t op, const char *key, error_code error, const char *value, double done_ms, void *arg) {
+    (void) op;
+    (void) key;
+    (void) done_ms;
+    (void) arg;
+    const size_t value_len = error == ERR_NONE && value != NULL ? strlen(value) : 0;
+    unsigned char header[RESULT_HEADER_SIZE];
+    header[0] = error != ERR_NONE;
+    write_u32(header + 1, (uint32_t) value_len);
+    fwrite(header, 1, sizeof(header), stdout);
+    fwrite(value, 1, value_len, stdout);
+}
+
+//An operation that cannot be submitted fails in its turn, after those before it
+static void fail_now(pipeline_t *pipeline, pipeline_op_t op, int binary) {
+    pipeline_flush(pipeline);
+    (binary ? print_frame : print_line)(op, NULL, ERR_BAD_PARAMETER, NULL, 0, NULL);
+}
+
+static void run_lines(pipeline_t *pipeline) {
+
+    //A command, a key and a value
+    static char line[MAX_MSG_SIZE + 16];
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0] == '\0') {
+            continue;
+        }
+
+        char *key = strchr(line, ' ');
+        if (key != NULL) {
+            *key++ = '\0';
+        }
+        pipeline_op_t op = strcmp(line, "put") == 0 ? PIPELINE_PUT : PIPELINE_GET;
+        char *value = NULL;
+        if (op == PIPELINE_PUT && key != NULL && (value = strchr(key, ' ')) != NULL) {
+            *value++ = '\0';
+        }
+
+        const int valid = key != NULL && (strcmp(line, "get") == 0 || value != NULL);
+        if (!valid || pipeline_submit(pipeline, op, key, value) != ERR_NONE) {
+            fail_now(pipeline, op, 0);
+        }
+    }
+}
+
+static void run_frames(pipeline_t *pipeline) {
+
+    static char key[MAX_MSG_ELEM_SIZE + 1];
+    static char value[MAX_MSG_ELEM_SIZE + 1];
+    unsigned char header[FRAME_HEADER_SIZE];
+    while (fread(header, 1, sizeof(header), stdin) == sizeof(header)) {
+        const pipeline_op_t op = header[0] == 'p' ? PIPELINE_PUT : PIPELINE_GET;
+        const size_t key_len   = read_u32(header + 1);
+        const size_t value_len = read_u32(header + 5);
+        if (key_len > MAX_MSG_ELEM_SIZE || value_len > MAX_MSG_ELEM_SIZE
+            || fread(key, 1, key_len, stdin) != key_len || fread(value, 1, value_len, stdin) != value_len) {
+            //Out of step with the frames: nothing after can be read
+            fail_now(pipeline, op, 1);
+            return;
+        }
+        key[key_len]     = '\0';
+        value[value_len] = '\0';
+
+        //Keys and values are strings: one holding a nul byte is refused
+        const int valid = (header[0] == 'g' || header[0] == 'p') && strlen(key) == key_len && strlen(value) == value_len;
+        if (!valid || pipeline_submit(pipeline, op, key, op == PIPELINE_PUT ? value : NULL) != ERR_NONE) {
+            fail_now(pipeline, op, 1);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    //Client initialization
+    client_t client;
+
+    client_init_args_t init = {&argv, (size_t) argc, SIZE_MAX, TOTAL_SERVERS | PUT_NEEDED | GET_NEEDED, &client};
+
+    error_code error = client_init(init);
+    M_EXIT_IF_ERR(error, "problem while initializing the client");
+
+    size_t depth  = PIPELINE_DEFAULT_DEPTH;
+    int    binary = 0;
+    for (size_t i = 0; i < argv_size(argv); ++i) {
+        if (strcmp(argv[i], "-b") == 0) {
+            binary = 1;
+        } else if (strcmp(argv[i], "-d") != 0 || argv[i + 1] == NULL || sscanf(argv[++i], "%zu", &depth) != 1
+                   || depth == 0 || depth > PIPELINE_MAX_DEPTH) {
+            client_end(&client);
+            fprintf(stderr, "%s\n", USAGE);
+            return ERR_BAD_PARAMETER;
+        }
+    }
+
+    pipeline_t pipeline;
+    error = pipeline_init(&pipeline, &client, depth, binary ? print_frame : print_line, NULL);
+    if (error != ERR_NONE) {
+        client_end(&client);
+    }
+    M_EXIT_IF_ERR(error, "cannot start the pipeline");
+
+    if (binary) {
+        run_frames(&pipeline);
+    } else {
+        run_lines(&pipeline);
+    }
+
+    pipeline_end(&pipeline);
+    client_end(&client);
+
+    return 0;
+}
@@ -1,6 +1,6 @@
 /**
  * @file pps-client-cat.c
- * @brief concatenate value of the dht
+ * @brief concatenate value of the dht (on the servers storing the result)
  *
  */
 
@@ -34,34 +34,10 @@ int main(int argc, char *argv[]) {
 
     M_EXIT_IF(number_keys < MIN_NB_ARGS, ERR_BAD_PARAMETER, "input", " %s ", "not enough keys");
 
-    char concatenation [MAX_MSG_ELEM_SIZE + 1];
-    memset(concatenation, 0, MAX_MSG_ELEM_SIZE + 1);
-
-    /** We need to get and concatenate the values of all the keys except the last one */
-    for (size_t i = 0; i < number_keys - 1; ++i) {
-
-        char *value = NULL;
-
-        if (network_get(client, keys[i], (pps_value_t *) &value) != ERR_NONE) {
-            printf("FAIL\n");
-            client_end(&client);
-            return ERR_NETWORK;
-        }
-
-        if (strlen(value) + strlen(concatenation)  >= MAX_MSG_ELEM_SIZE) {
-            printf("FAIL\n");
-            client_end(&client);
-            return ERR_NOMEM;
-        }
-
-        strncat(concatenation, value, MAX_MSG_ELEM_SIZE);
-
-        free(value);
-    }
-
-
-    if (network_put(client, keys[number_keys - 1], concatenation) != ERR_NONE) {
+    /** The servers storing the last key concatenate the values of all the others */
+    if (network_concat(client, keys[number_keys - 1], (pps_key_t *) keys, number_keys - 1) != ERR_NONE) {
         printf("FAIL\n");
+        client_end(&client);
         return 1;
     } else {
         printf("OK\n");
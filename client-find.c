@@ -25,38 +25,19 @@ int main(int argc, char *argv[]) {
     M_EXIT_IF_ERR(error, "problem while initializing the client");
 
 
-    char *key1   = argv[0];
-    char *key2   = argv[1];
-    char *value1 = NULL;
-    char *value2 = NULL;
+    char *key1 = argv[0];
+    char *key2 = argv[1];
 
     M_EXIT_IF(strlen(key1) > MAX_MSG_ELEM_SIZE || strlen(key2) > MAX_MSG_ELEM_SIZE, ERR_BAD_PARAMETER, "argv", "%s", "key too long");
 
-    if (network_get(client, key1, (pps_value_t *) &value1) != ERR_NONE) {
+    //The replicas of key1 search it, the values do not come to the client
+    long response = -1;
+    if (network_find(client, key1, key2, &response) != ERR_NONE) {
         printf("FAIL\n");
         return 1;
     }
 
-    if (network_get(client, key2, (pps_value_t *) &value2) != ERR_NONE) {
-        free(value1);
-        printf("FAIL\n");
-        return 1;
-    }
-
-    int response = 0;
-
-    char *position = strstr(value1, value2);
-
-    if (position == NULL) {
-        response = -1;
-    } else {
-        response = (int) (position - value1);
-    }
-
-    printf("OK %d\n", response);
-
-    free(value1);
-    free(value2);
+    printf("OK %ld\n", response);
 
     client_end(&client);
 
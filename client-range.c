@@ -0,0 +1,214 @@
+/**
+ * @file pps-client-range.c
+ * @brief print the keys of the cluster under a prefix, in key order: the sorted pages of every
+ *        server of the servers file are merged, each key printed once.
+ *        Usage: pps-client-range [-l limit] prefix
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "config.h"
+#include "system.h"
+#include "error.h"
+#include "ring.h"
+#include "util.h"
+#include "scan.h"
+
+#define RANGE_TIMEOUT_MS 500
+#define RANGE_MAX_RETRIES 3
+
+#define USAGE "usage: pps-client-range [-l limit] prefix"
+
+/**
+ * @brief the page of a server being merged
+ */
+typedef struct {
+    char **keys;              // in order
+    size_t nb_keys;
+    size_t next;              // next key to merge
+    char *after;              // last key of the page, where the next one starts
+    uint32_t id;              // of the query waiting for its reply, 0 if none
+    int more;                 // the server has keys after the page
+    int failed;
+} server_page_t;
+
+static uint32_t next_id = 1;
+
+static void clear_page(server_page_t *page) {
+    for (size_t i = 0; i < page->nb_keys; ++i) {
+        free(page->keys[i]);
+    }
+    free(page->keys);
+    page->keys    = NULL;
+    page->nb_keys = 0;
+    page->next    = 0;
+}
+
+static void request_page(int socket, const ring_t *ring, size_t i, server_page_t *page, const char *prefix) {
+    static char request[RANGE_REQUEST_HEADER_SIZE + 2 * MAX_MSG_ELEM_SIZE + 1];
+    page->id = next_id++;
+    const size_t len = range_request(request, page->id, SCAN_DEFAULT_LIMIT, prefix, page->after);
+    sendto(socket, request, len, 0, &ring->servers[i].addr, sizeof(ring->servers[i].addr));
+}
+
+//Keep the keys of a reply as the new page of the server
+static error_code fill_page(server_page_t *page, scan_part_t *part) {
+    static char key[MAX_MSG_ELEM_SIZE + 1];
+    clear_page(page);
+    page->keys = calloc(part->count, sizeof(char *));
+    M_REQUIRE(part->count == 0 || page->keys != NULL, ERR_NOMEM, "%s", "no memory for the page");
+    while (scan_next_key(part, key)) {
+        page->keys[page->nb_keys] = strdup(key);
+        M_REQUIRE_NON_NULL_CUSTOM_ERR(page->keys[page->nb_keys], ERR_NOMEM);
+        page->nb_keys += 1;
+    }
+    if (page->nb_keys > 0) {
+        free(page->after);
+        page->after = strdup(page->keys[page->nb_keys - 1]);
+        M_REQUIRE_NON_NULL_CUSTOM_ERR(page->after, ERR_NOMEM);
+    }
+    page->more = !part->last && page->nb_keys > 0;
+    page->id   = 0;
+    return ERR_NONE;
+}
+
+//Wait for the replies of the queries sent, asking again the ones lost
+static error_code collect_pages(int socket, const ring_t *ring, server_page_t *pages, const char *prefix) {
+
+    static char reply[MAX_MSG_SIZE];
+    int retries = 0;
+    while (1) {
+        size_t waiting = 0;
+        for (size_t k = 0; k < ring->nb_servers; ++k) {
+            waiting += pages[k].id != 0;
+        }
+        if (waiting == 0) {
+            return ERR_NONE;
+        }
+
+        struct sockaddr from;
+        socklen_t       from_len = sizeof(from);
+        ssize_t len = recvfrom(socket, reply, sizeof(reply), 0, &from, &from_len);
+        if (len == -1) {
+            for (size_t k = 0; k < ring->nb_servers; ++k) {
+                if (pages[k].id == 0) {
+                    continue;
+                }
+                if (retries >= RANGE_MAX_RETRIES) {
+                    fprintf(stderr, "no answer from server %zu\n", k);
+                    clear_page(&pages[k]);
+                    pages[k].id     = 0;
+                    pages[k].more   = 0;
+                    pages[k].failed = 1;
+                } else {
+                    request_page(socket, ring, k, &pages[k], prefix);
+                }
+            }
+            ++retries;
+            continue;
+        }
+
+        scan_part_t part;
+        if (!scan_parse_part(reply, (size_t) len, &part)) {
+            continue;
+        }
+        for (size_t k = 0; k < ring->nb_servers; ++k) {
+            if (pages[k].id != 0 && pages[k].id == part.id && memcmp(&from, &ring->servers[k].addr, from_len) == 0) {
+                M_EXIT_IF_ERR(fill_page(&pages[k], &part), "cannot keep the page");
+                break;
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+
+    size_t limit = 0;
+    int i = 1;
+    if (argc == 4 && strcmp(argv[1], "-l") == 0 && sscanf(argv[2], "%zu", &limit) == 1) {
+        i = 3;
+    }
+    M_EXIT_IF(i != argc - 1, ERR_BAD_PARAMETER, "pps-client-range", "%s", USAGE);
+    const char *prefix = argv[i];
+    M_EXIT_IF_TOO_LONG(prefix, MAX_MSG_ELEM_SIZE, "too long prefix");
+
+    ring_t *ring = ring_alloc();
+    M_REQUIRE_NON_NULL(ring);
+    error_code error = ring_init(ring);
+    if (error != ERR_NONE) {
+        ring_free(ring);
+    }
+    M_EXIT_IF_ERR(error, "cannot read the servers file");
+
+    int s = get_socket(0);
+    server_page_t *pages = calloc(ring->nb_servers, sizeof(server_page_t));
+    if (s == -1 || set_receive_timeout_ms(s, RANGE_TIMEOUT_MS) != ERR_NONE || pages == NULL) {
+        free(pages);
+        ring_free(ring);
+        fprintf(stderr, "cannot start the query\n");
+        return ERR_NETWORK;
+    }
+
+    //The first pages of all the servers at the same time
+    for (size_t k = 0; k < ring->nb_servers; ++k) {
+        request_page(s, ring, k, &pages[k], prefix);
+    }
+    error = collect_pages(s, ring, pages, prefix);
+
+    //Merge: the smallest key at the head of a page, once even if several replicas have it
+    char  *last    = NULL;
+    size_t printed = 0;
+    while (error == ERR_NONE && (limit == 0 || printed < limit)) {
+
+        //A server whose page is merged must give the next one before any key is compared to it
+        int asked = 0;
+        for (size_t k = 0; k < ring->nb_servers; ++k) {
+            if (pages[k].next == pages[k].nb_keys && pages[k].more) {
+                request_page(s, ring, k, &pages[k], prefix);
+                asked = 1;
+            }
+        }
+        if (asked) {
+            error = collect_pages(s, ring, pages, prefix);
+            continue;
+        }
+
+        size_t min = SIZE_MAX;
+        for (size_t k = 0; k < ring->nb_servers; ++k) {
+            if (pages[k].next < pages[k].nb_keys
+                && (min == SIZE_MAX || strcmp(pages[k].keys[pages[k].next], pages[min].keys[pages[min].next]) < 0)) {
+                min = k;
+            }
+        }
+        if (min == SIZE_MAX) {
+            break;
+        }
+
+        char *key = pages[min].keys[pages[min].next++];
+        if (last == NULL || strcmp(key, last) != 0) {
+            printf("%s\n", key);
+            ++printed;
+            free(last);
+            last = strdup(key);
+        }
+    }
+
+    size_t nb_failed = 0;
+    for (size_t k = 0; k < ring->nb_servers; ++k) {
+        nb_failed += pages[k].failed;
+        clear_page(&pages[k]);
+        free(pages[k].after);
+    }
+    free(pages);
+    free(last);
+    ring_free(ring);
+
+    //Keys of the servers that did not answer may be missing
+    return error != ERR_NONE ? error : nb_failed == 0 ? ERR_NONE : ERR_NETWORK;
+}
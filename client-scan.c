@@ -0,0 +1,189 @@
+/**
+ * @file pps-client-scan.c
+ * @brief print the keys of the cluster matching a pattern: every server of the servers file scans
+ *        its own table in parallel, and the keys are printed as they come back, once each.
+ *        Usage: pps-client-scan [-k] [-v] [-P] [-l limit] pattern
+ *        (-k matches the keys, the default, -v the values, -P the pattern as a prefix)
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "config.h"
+#include "system.h"
+#include "error.h"
+#include "ring.h"
+#include "hashtable.h"
+#include "util.h"
+#include "scan.h"
+
+#define SCAN_TIMEOUT_MS 500
+#define SCAN_MAX_RETRIES 3
+
+#define USAGE "usage: pps-client-scan [-k] [-v] [-P] [-l limit] pattern"
+
+/**
+ * @brief progress of the scan of a server
+ */
+typedef struct {
+    uint32_t cursor;          // of the page requested
+    uint32_t id;              // of the current request
+    uint16_t next_part;       // number of the part expected
+    int lost;                 // a part of the page went missing: the page must be asked again
+    int done;
+    int retries;              // requests of the page left unanswered
+} server_scan_t;
+
+static uint32_t next_id = 1;
+
+static void request_page(int socket, const ring_t *ring, size_t i, server_scan_t *scan, uint8_t flags,
+                         const char *pattern) {
+    char request[SCAN_REQUEST_HEADER_SIZE + MAX_MSG_ELEM_SIZE];
+    scan->id        = next_id++;
+    scan->next_part = 0;
+    scan->lost      = 0;
+    const size_t len = scan_request(request, scan->id, scan->cursor, SCAN_DEFAULT_LIMIT, flags, pattern);
+    sendto(socket, request, len, 0, &ring->servers[i].addr, sizeof(ring->servers[i].addr));
+}
+
+//Print the keys of a part not printed yet, return how many
+static size_t print_keys(scan_part_t *part, Htable_t seen, size_t room) {
+    static char key[MAX_MSG_ELEM_SIZE + 1];
+    size_t printed = 0;
+    while (printed < room && scan_next_key(part, key)) {
+        pps_value_t known = get_Htable_value(seen, key);
+        if (known == NULL && add_Htable_value(seen, key, "") == ERR_NONE) {
+            printf("%s\n", key);
+            ++printed;
+        }
+        free_const_ptr(known);
+    }
+    fflush(stdout);
+    return printed;
+}
+
+int main(int argc, char **argv) {
+
+    uint8_t flags = 0;
+    size_t limit = 0;
+    int i = 1;
+    for (; i < argc - 1 && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "-k") == 0) {
+            flags |= SCAN_MATCH_KEY;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            flags |= SCAN_MATCH_VALUE;
+        } else if (strcmp(argv[i], "-P") == 0) {
+            flags |= SCAN_MATCH_PREFIX;
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc - 1 && sscanf(argv[i + 1], "%zu", &limit) == 1) {
+            ++i;
+        } else {
+            break;
+        }
+    }
+    M_EXIT_IF(i != argc - 1, ERR_BAD_PARAMETER, "pps-client-scan", "%s", USAGE);
+    const char *pattern = argv[i];
+    M_EXIT_IF_TOO_LONG(pattern, MAX_MSG_ELEM_SIZE, "too long pattern");
+
+    ring_t *ring = ring_alloc();
+    M_REQUIRE_NON_NULL(ring);
+    error_code error = ring_init(ring);
+    if (error != ERR_NONE) {
+        ring_free(ring);
+    }
+    M_EXIT_IF_ERR(error, "cannot read the servers file");
+
+    int s = get_socket(0);
+    if (s == -1 || set_receive_timeout_ms(s, SCAN_TIMEOUT_MS) != ERR_NONE) {
+        ring_free(ring);
+        fprintf(stderr, "problem with socket\n");
+        return ERR_NETWORK;
+    }
+
+    server_scan_t *scans = calloc(ring->nb_servers, sizeof(server_scan_t));
+    Htable_t seen = construct_Htable(HTABLE_SIZE);
+    if (scans == NULL || seen == NULL) {
+        free(scans);
+        if (seen != NULL) {
+            delete_Htable_and_content(&seen);
+        }
+        ring_free(ring);
+        return ERR_NOMEM;
+    }
+
+    //Every server scans its table at the same time
+    for (size_t k = 0; k < ring->nb_servers; ++k) {
+        scans[k].cursor = SCAN_CURSOR_START;
+        request_page(s, ring, k, &scans[k], flags, pattern);
+    }
+
+    static char reply[MAX_MSG_SIZE];
+    size_t nb_done   = 0;
+    size_t nb_failed = 0;
+    size_t printed   = 0;
+    while (nb_done < ring->nb_servers && (limit == 0 || printed < limit)) {
+        struct sockaddr from;
+        socklen_t       from_len = sizeof(from);
+        ssize_t len = recvfrom(s, reply, sizeof(reply), 0, &from, &from_len);
+
+        //Nothing for a while: ask again the pages not complete
+        if (len == -1) {
+            for (size_t k = 0; k < ring->nb_servers; ++k) {
+                if (scans[k].done) {
+                    continue;
+                }
+                if (++scans[k].retries > SCAN_MAX_RETRIES) {
+                    fprintf(stderr, "no answer from server %zu\n", k);
+                    scans[k].done = 1;
+                    ++nb_done;
+                    ++nb_failed;
+                } else {
+                    request_page(s, ring, k, &scans[k], flags, pattern);
+                }
+            }
+            continue;
+        }
+
+        scan_part_t part;
+        if (!scan_parse_part(reply, (size_t) len, &part)) {
+            continue;
+        }
+        size_t k = 0;
+        while (k < ring->nb_servers && memcmp(&from, &ring->servers[k].addr, from_len) != 0) {
+            ++k;
+        }
+        if (k == ring->nb_servers || scans[k].done || part.id != scans[k].id) {
+            continue;
+        }
+        server_scan_t *scan = &scans[k];
+        scan->retries = 0;
+
+        //The keys of a page are printed even if some of its parts are lost: they are not printed twice
+        scan->lost |= part.number != scan->next_part;
+        scan->next_part = (uint16_t) (part.number + 1);
+        printed += print_keys(&part, seen, limit == 0 ? SIZE_MAX : limit - printed);
+
+        if (part.last) {
+            if (!scan->lost) {
+                scan->cursor = part.next;
+            }
+            if (scan->cursor == SCAN_CURSOR_END) {
+                scan->done = 1;
+                ++nb_done;
+            } else {
+                request_page(s, ring, k, scan, flags, pattern);
+            }
+        }
+    }
+
+    free(scans);
+    delete_Htable_and_content(&seen);
+    ring_free(ring);
+
+    //Keys of the servers that did not answer may be missing
+    return nb_failed == 0 ? ERR_NONE : ERR_NETWORK;
+}
@@ -6,6 +6,7 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #include "client.h"
 #include "config.h" // for PPS_DEFAULT_IP and PPS_DEFAULT_PORT
 #include "system.h"
@@ -13,6 +14,7 @@
 #include "args.h"
 #include "node_list.h"
 #include "ring.h"
+#include "gossip.h"
 
 
 error_code client_init(client_init_args_t init_args) {
@@ -51,13 +53,26 @@ error_code client_init(client_init_args_t init_args) {
 
     // Create the nodes from the file
     ring_t *server = ring_alloc();
+    if (server == NULL) {
+        free(args);
+        return ERR_IO;
+    }
     error = ring_init(server);
     if (error != ERR_NONE) {
         free(args);
+        ring_free(server);
     }
     M_EXIT_IF_ERR(error, "problem while initializing the nodes");
 
-    if (init_args.supported_args & TOTAL_SERVERS && args->N > server->size) {
+    //Leave out the servers the cluster knows to be dead (all are kept if no server answers)
+    const char *membership = getenv(PPS_MEMBERSHIP_ENV);
+    if (membership != NULL && strcmp(membership, "0") != 0 && gossip_fetch_membership(server) != ERR_NONE) {
+        debug_print("%s", "no membership available, using all the servers");
+    }
+
+    //N can be at most the number of servers: the lookups return the alive ones among the N
+    if (init_args.supported_args & TOTAL_SERVERS
+        && (args->N > server->nb_servers || args->N > RING_MAX_PREFERENCE_SIZE)) {
         free(args);
         ring_free(server);
         return ERR_BAD_PARAMETER;
@@ -66,11 +81,30 @@ error_code client_init(client_init_args_t init_args) {
     client->args   = args;
     client->server = server;
     client->name   = name;
+    client->zone   = getenv(PPS_ZONE_ENV);
+
+    const char *selection = getenv(PPS_READ_SELECTION_ENV);
+    client->selection = selection != NULL && strcmp(selection, PPS_READ_SELECTION_C3) == 0 ? selection_alloc(server) : NULL;
+
+    const char *cache = getenv(PPS_CACHE_ENV);
+    const long capacity = cache != NULL ? strtol(cache, NULL, 10) : 0;
+    client->cache = capacity > 0 ? cache_alloc((size_t) capacity) : NULL;
+
+    const char *sloppy = getenv(PPS_SLOPPY_QUORUM_ENV);
+    client->sloppy_quorum = sloppy != NULL && strcmp(sloppy, "0") != 0;
+
+    //Reads of hot keys go to replicas chosen at random
+    client->spread = calloc(1, sizeof(spread_t));
+    srand((unsigned int) (unsigned long long) (get_time_ms() * 1e3));
 
     return ERR_NONE;
 }
 
 void client_end(client_t *client) {
+    cache_print_stats(client->cache, stderr);
+    cache_free(client->cache);
+    free(client->spread);
+    selection_free(client->selection);
     ring_free(client->server);
     free(client->args);
 }
@@ -14,6 +14,9 @@
 #include "node_list.h" // weeks 6 to 10
 #include "args.h"      // weeks 10 and after
 #include "ring.h"      // weeks 11 and after
+#include "selection.h"
+#include "cache.h"
+#include "spread.h"
 
 /**
  * @brief client state
@@ -23,6 +26,11 @@ typedef struct
     const char* name;
     ring_t* server; // not sure if that's what we're supposed to modify
     args_t* args;
+    const char* zone; // zone of the client (PPS_ZONE_ENV), NULL if unknown
+    selection_t* selection; // latency-aware reads (PPS_READ_SELECTION_ENV), NULL to read from all replicas
+    client_cache_t* cache; // leased reads cached locally (PPS_CACHE_ENV), NULL for no cache
+    spread_t* spread; // hot keys whose reads are spread over more replicas
+    int sloppy_quorum; // writes of late replicas handed to other servers (PPS_SLOPPY_QUORUM_ENV)
 }client_t;
 
 /**
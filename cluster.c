@@ -0,0 +1,447 @@
+/**
+ * @file pps-cluster.c
+ * @brief run pps-bench against clusters of local servers, one per configuration, and report
+ *        the throughput, the latency percentiles and the share of the operations that failed
+ *        to reach their quorum (R or W replicas) for each of them.
+ *        Usage: pps-cluster [-k nodes,...] [-v vnodes,...] [-q N:R:W,...] [-t seconds]
+ *                           [-f kill_s[:restart_s]] [-p base_port] [-d dir] [-- bench options]
+ *        Every combination of the lists is run (those with N above the number of nodes are
+ *        skipped): a servers file of the nodes on 127.0.0.1, from base_port on (21000 by
+ *        default), each with its virtual nodes, is written in dir (a new directory in /tmp by
+ *        default), the servers are started there, and pps-bench is run for the given seconds (5
+ *        by default) with the bench options (see pps-bench). With -f, the first server is killed
+ *        kill_s seconds into the run, and started again (empty) restart_s seconds into it.
+ *        The logs of the servers and the output of pps-bench are kept in dir.
+ *        The servers and pps-bench are looked for next to pps-cluster.
+ *
+ */
+
+#define _GNU_SOURCE // for mkdtemp, kill
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "config.h"
+#include "error.h"
+#include "system.h"
+#include "ring.h" // for RING_MAX_PREFERENCE_SIZE
+
+#define USAGE "usage: pps-cluster [-k nodes,...] [-v vnodes,...] [-q N:R:W,...] [-t seconds] " \
+              "[-f kill_s[:restart_s]] [-p base_port] [-d dir] [-- bench options]"
+
+#define CLUSTER_MAX_CONFIGS 16
+#define CLUSTER_MAX_NODES 64
+#define CLUSTER_DEFAULT_PORT 21000
+#define CLUSTER_DEFAULT_SECONDS 5
+
+/**
+ * @brief time the servers have to answer their first ping, and between two pings
+ */
+#define CLUSTER_STARTUP_MS 3000
+#define CLUSTER_PING_MS 50
+
+#define CLUSTER_BENCH_OUTPUT "bench.txt"
+
+/**
+ * @brief the quorum of a configuration
+ */
+typedef struct {
+    size_t N;
+    size_t R;
+    size_t W;
+} quorum_t;
+
+/**
+ * @brief options of the harness
+ */
+typedef struct {
+    size_t nodes[CLUSTER_MAX_CONFIGS];
+    size_t nb_nodes;
+    size_t vnodes[CLUSTER_MAX_CONFIGS];
+    size_t nb_vnodes;
+    quorum_t quorums[CLUSTER_MAX_CONFIGS];
+    size_t nb_quorums;
+    double seconds;
+    double kill_s;            // < 0 for no fault
+    double restart_s;         // < 0 not to start the server again
+    int base_port;
+    const char *dir;          // NULL for a new directory
+    char **bench_argv;        // options given to pps-bench, NULL-terminated
+} cluster_options_t;
+
+/**
+ * @brief what pps-bench measured, in ms, of one row of its report
+ */
+typedef struct {
+    unsigned long long ok;
+    unsigned long long failed;
+    double ops_per_s;
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double p999;
+    double p9999;
+    double max;
+} bench_row_t;
+
+//Directory of the executables
+static char bin_dir[4096];
+
+//Comma separated list of sizes
+static int parse_sizes(const char *list, size_t *sizes, size_t *nb) {
+    *nb = 0;
+    while (*list != '\0' && *nb < CLUSTER_MAX_CONFIGS) {
+        int read = 0;
+        if (sscanf(list, "%zu%n", &sizes[*nb], &read) != 1 || sizes[*nb] == 0) {
+            return 0;
+        }
+        ++*nb;
+        list += read;
+        list += *list == ',';
+    }
+    return *list == '\0';
+}
+
+static int parse_quorums(const char *list, quorum_t *quorums, size_t *nb) {
+    *nb = 0;
+    while (*list != '\0' && *nb < CLUSTER_MAX_CONFIGS) {
+        quorum_t *q = &quorums[*nb];
+        int read = 0;
+        if (sscanf(list, "%zu:%zu:%zu%n", &q->N, &q->R, &q->W, &read) != 3 || q->N == 0 || q->R == 0
+            || q->W == 0 || q->R > q->N || q->W > q->N || q->N > RING_MAX_PREFERENCE_SIZE) {
+            return 0;
+        }
+        ++*nb;
+        list += read;
+        list += *list == ',';
+    }
+    return *list == '\0';
+}
+
+static int parse_options(int argc, char *argv[], cluster_options_t *options) {
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--") == 0) {
+            options->bench_argv = argv + i + 1;
+            return 1;
+        }
+        const char *value = argv[i + 1];
+        if (value == NULL || strlen(argv[i]) != 2 || argv[i][0] != '-') {
+            return 0;
+        }
+        int valid = 0;
+        switch (argv[i][1]) {
+        case 'k':
+            valid = parse_sizes(value, options->nodes, &options->nb_nodes);
+            break;
+        case 'v':
+            valid = parse_sizes(value, options->vnodes, &options->nb_vnodes);
+            break;
+        case 'q':
+            valid = parse_quorums(value, options->quorums, &options->nb_quorums);
+            break;
+        case 't':
+            valid = sscanf(value, "%lf", &options->seconds) == 1 && options->seconds > 0;
+            break;
+        case 'f':
+            options->restart_s = -1;
+            valid = sscanf(value, "%lf:%lf", &options->kill_s, &options->restart_s) >= 1 && options->kill_s >= 0
+                    && (options->restart_s < 0 || options->restart_s > options->kill_s);
+            break;
+        case 'p':
+            valid = sscanf(value, "%d", &options->base_port) == 1 && options->base_port > 0
+                    && options->base_port < UINT16_MAX - CLUSTER_MAX_NODES;
+            break;
+        case 'd':
+            options->dir = value;
+            valid = 1;
+            break;
+        default:
+            break;
+        }
+        if (!valid) {
+            return 0;
+        }
+        ++i;
+    }
+    return 1;
+}
+
+//Sleep until a time given by get_time_ms
+static void sleep_until(double when_ms) {
+    for (double now = get_time_ms(); now < when_ms; now = get_time_ms()) {
+        usleep((useconds_t) ((when_ms - now) * 1000));
+    }
+}
+
+//Start a server of the cluster, whose address is read on its standard input
+static pid_t start_server(int port, size_t N) {
+
+    int address[2];
+    if (pipe(address) == -1) {
+        return -1;
+    }
+    const pid_t pid = fork();
+    if (pid == 0) {
+        char log[32];
+        snprintf(log, sizeof(log), "server-%d.log", port);
+        const int out = open(log, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        dup2(address[0], STDIN_FILENO);
+        dup2(out, STDOUT_FILENO);
+        dup2(out, STDERR_FILENO);
+        close(address[0]);
+        close(address[1]);
+        close(out);
+
+        char path[sizeof(bin_dir) + 32];
+        char replicas[32];
+        snprintf(path, sizeof(path), "%s/pps-launch-server", bin_dir);
+        snprintf(replicas, sizeof(replicas), "%zu", N);
+        execl(path, path, "-n", replicas, (char *) NULL);
+        _exit(127);
+    }
+    close(address[0]);
+    if (pid > 0) {
+        dprintf(address[1], "127.0.0.1 %d\n", port);
+    }
+    close(address[1]);
+    return pid;
+}
+
+static void stop_server(pid_t *pid) {
+    if (*pid > 0) {
+        kill(*pid, SIGKILL);
+        waitpid(*pid, NULL, 0);
+        *pid = -1;
+    }
+}
+
+//Wait for the servers to answer pings (see the empty datagram of the protocol)
+static error_code wait_for_servers(int base_port, size_t nb_servers) {
+
+    const int s = get_socket(0);
+    M_REQUIRE(s != -1, ERR_NETWORK, "%s", "no socket");
+    error_code error = set_receive_timeout_ms(s, CLUSTER_PING_MS);
+
+    int up[CLUSTER_MAX_NODES] = {0};
+    size_t nb_up = 0;
+    const double deadline = get_time_ms() + CLUSTER_STARTUP_MS;
+    while (error == ERR_NONE && nb_up < nb_servers && get_time_ms() < deadline) {
+        for (size_t i = 0; i < nb_servers; ++i) {
+            struct sockaddr_in addr;
+            if (!up[i] && get_server_addr("127.0.0.1", (uint16_t) (base_port + (int) i), &addr) == ERR_NONE) {
+                sendto(s, NULL, 0, 0, (struct sockaddr *) &addr, sizeof(addr));
+            }
+        }
+        char reply[1];
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        while (nb_up < nb_servers
+               && recvfrom(s, reply, sizeof(reply), 0, (struct sockaddr *) &from, &from_len) == 0) {
+            const int i = ntohs(from.sin_port) - base_port;
+            if (i >= 0 && (size_t) i < nb_servers && !up[i]) {
+                up[i] = 1;
+                ++nb_up;
+            }
+            from_len = sizeof(from);
+        }
+    }
+
+    close(s);
+    return error != ERR_NONE ? error : nb_up == nb_servers ? ERR_NONE : ERR_NETWORK;
+}
+
+static error_code write_servers_file(int base_port, size_t nb_servers, size_t vnodes) {
+    FILE *file = fopen(PPS_SERVERS_LIST_FILENAME, "w");
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(file, ERR_IO);
+    for (size_t i = 0; i < nb_servers; ++i) {
+        fprintf(file, "127.0.0.1 %d %zu\n", base_port + (int) i, vnodes);
+    }
+    return fclose(file) == 0 ? ERR_NONE : ERR_IO;
+}
+
+//Start pps-bench, its output in CLUSTER_BENCH_OUTPUT
+static pid_t start_bench(const cluster_options_t *options, const quorum_t *q) {
+
+    const pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+    const int out = open(CLUSTER_BENCH_OUTPUT, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    dup2(out, STDOUT_FILENO);
+    dup2(out, STDERR_FILENO);
+    close(out);
+
+    char path[sizeof(bin_dir) + 32];
+    snprintf(path, sizeof(path), "%s/pps-bench", bin_dir);
+    char n[32], w[32], r[32], t[32];
+    snprintf(n, sizeof(n), "%zu", q->N);
+    snprintf(w, sizeof(w), "%zu", q->W);
+    snprintf(r, sizeof(r), "%zu", q->R);
+    snprintf(t, sizeof(t), "%g", options->seconds);
+
+    //The quorum and the length of the run, the keys written first, then the options given
+    char *argv[64] = {path, "-n", n, "-w", w, "-r", r, "-t", t, "-l"};
+    size_t argc = 10;
+    for (char **arg = options->bench_argv; arg != NULL && *arg != NULL && argc < 63; ++arg) {
+        argv[argc++] = *arg;
+    }
+    argv[argc] = NULL;
+    execv(path, argv);
+    _exit(127);
+}
+
+//Rows of the report of pps-bench, 0 if it has none
+static int read_bench(bench_row_t rows[3]) {
+
+    FILE *file = fopen(CLUSTER_BENCH_OUTPUT, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    static const char *const NAMES[3] = {"get", "put", "all"};
+    char line[512];
+    int found = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        for (int i = 0; i < 3; ++i) {
+            bench_row_t *row = &rows[i];
+            char name[8];
+            if (sscanf(line, "%7s %llu %llu %lf %lf %lf %lf %lf %lf %lf %lf", name, &row->ok, &row->failed,
+                       &row->ops_per_s, &row->mean, &row->p50, &row->p90, &row->p99, &row->p999, &row->p9999,
+                       &row->max) == 11 && strcmp(name, NAMES[i]) == 0) {
+                found |= 1 << i;
+            }
+        }
+    }
+    fclose(file);
+    return found == 7;
+}
+
+static double failure_rate(const bench_row_t *row) {
+    const unsigned long long total = row->ok + row->failed;
+    return total == 0 ? 0 : 100.0 * (double) row->failed / (double) total;
+}
+
+//Run one configuration, 0 if it could not be
+static int run_config(const cluster_options_t *options, size_t nb_servers, size_t vnodes, const quorum_t *q) {
+
+    pid_t servers[CLUSTER_MAX_NODES];
+    for (size_t i = 0; i < nb_servers; ++i) {
+        servers[i] = -1;
+    }
+    int ok = write_servers_file(options->base_port, nb_servers, vnodes) == ERR_NONE;
+    for (size_t i = 0; i < nb_servers && ok; ++i) {
+        servers[i] = start_server(options->base_port + (int) i, q->N);
+        ok = servers[i] > 0;
+    }
+    ok = ok && wait_for_servers(options->base_port, nb_servers) == ERR_NONE;
+
+    pid_t bench = ok ? start_bench(options, q) : -1;
+    ok = bench > 0;
+    if (ok && options->kill_s >= 0) {
+        //pps-bench writes the keys first: the run is timed from its start, which is close enough
+        const double start = get_time_ms();
+        sleep_until(start + options->kill_s * 1000);
+        stop_server(&servers[0]);
+        if (options->restart_s >= 0) {
+            sleep_until(start + options->restart_s * 1000);
+            servers[0] = start_server(options->base_port, q->N);
+        }
+    }
+    int status = 0;
+    ok = ok && waitpid(bench, &status, 0) == bench && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    for (size_t i = 0; i < nb_servers; ++i) {
+        stop_server(&servers[i]);
+    }
+
+    bench_row_t rows[3];
+    memset(rows, 0, sizeof(rows));
+    if (!ok || !read_bench(rows)) {
+        printf("%5zu %6zu %2zu %2zu %2zu  failed, see %s and the server logs\n", nb_servers, vnodes, q->N, q->R,
+               q->W, CLUSTER_BENCH_OUTPUT);
+        return 0;
+    }
+    printf("%5zu %6zu %2zu %2zu %2zu %10.0f %8.3f %8.3f %8.3f %8.3f %8.3f %9.2f %9.2f\n", nb_servers, vnodes, q->N,
+           q->R, q->W, rows[2].ops_per_s, rows[2].mean, rows[2].p50, rows[2].p99, rows[2].p999, rows[2].max,
+           failure_rate(&rows[0]), failure_rate(&rows[1]));
+
+    //Kept for this configuration
+    char kept[64];
+    snprintf(kept, sizeof(kept), "bench-%zu-%zu-%zu-%zu-%zu.txt", nb_servers, vnodes, q->N, q->R, q->W);
+    rename(CLUSTER_BENCH_OUTPUT, kept);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+
+    cluster_options_t options;
+    memset(&options, 0, sizeof(options));
+    options.nodes[0]  = 3;
+    options.nb_nodes  = 1;
+    options.vnodes[0] = 3;
+    options.nb_vnodes = 1;
+    options.quorums[0] = (quorum_t) {3, 2, 2};
+    options.nb_quorums = 1;
+    options.seconds    = CLUSTER_DEFAULT_SECONDS;
+    options.kill_s     = -1;
+    options.restart_s  = -1;
+    options.base_port  = CLUSTER_DEFAULT_PORT;
+
+    M_EXIT_IF(!parse_options(argc, argv, &options), ERR_BAD_PARAMETER, "pps-cluster", "%s", USAGE);
+    for (size_t k = 0; k < options.nb_nodes; ++k) {
+        M_EXIT_IF(options.nodes[k] > CLUSTER_MAX_NODES, ERR_BAD_PARAMETER, "pps-cluster", "at most %d nodes",
+                  CLUSTER_MAX_NODES);
+    }
+
+    //The executables, before leaving the current directory
+    const ssize_t len = readlink("/proc/self/exe", bin_dir, sizeof(bin_dir) - 1);
+    M_EXIT_IF(len <= 0, ERR_IO, "pps-cluster", "%s", "cannot find the executables");
+    bin_dir[len] = '\0';
+    *strrchr(bin_dir, '/') = '\0';
+
+    static char dir[] = "/tmp/pps-cluster-XXXXXX";
+    const char *work_dir = options.dir;
+    if (work_dir == NULL) {
+        work_dir = mkdtemp(dir);
+    } else if (mkdir(work_dir, 0755) == -1 && errno != EEXIST) {
+        work_dir = NULL;
+    }
+    M_EXIT_IF(work_dir == NULL || chdir(work_dir) == -1, ERR_IO, "pps-cluster", "%s", "cannot create the directory");
+
+    printf("servers on 127.0.0.1:%d and up, runs of %g s", options.base_port, options.seconds);
+    if (options.kill_s >= 0) {
+        printf(", first server killed at %g s", options.kill_s);
+        if (options.restart_s >= 0) {
+            printf(" and restarted at %g s", options.restart_s);
+        }
+    }
+    printf(", logs in %s\n", work_dir);
+    printf("%5s %6s %2s %2s %2s %10s %8s %8s %8s %8s %8s %9s %9s\n", "nodes", "vnodes", "N", "R", "W", "ops/s",
+           "mean_ms", "p50", "p99", "p99.9", "max", "get_fail%", "put_fail%");
+    fflush(stdout);
+
+    int all_ok = 1;
+    for (size_t k = 0; k < options.nb_nodes; ++k) {
+        for (size_t v = 0; v < options.nb_vnodes; ++v) {
+            for (size_t q = 0; q < options.nb_quorums; ++q) {
+                if (options.quorums[q].N > options.nodes[k]) {
+                    continue;
+                }
+                all_ok &= run_config(&options, options.nodes[k], options.vnodes[v], &options.quorums[q]);
+                fflush(stdout);
+            }
+        }
+    }
+
+    return all_ok ? 0 : ERR_NETWORK;
+}
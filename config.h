@@ -27,6 +27,43 @@
  */
 #define PPS_SERVERS_LIST_FILENAME "servers.txt"
 
+/**
+ * @brief environment variable giving the zone of a client (see zone= in the servers file):
+ *        reads go to the replicas of that zone first
+ */
+#define PPS_ZONE_ENV "PPS_ZONE"
+
+/**
+ * @brief environment variable selecting how a client picks the replicas it reads from:
+ *        "c3" sends reads only to the R replicas with the best latency and load scores
+ *        (see selection.h), anything else to all N replicas. Only worth it for clients
+ *        that read many keys in one run (pps-client-batch)
+ */
+#define PPS_READ_SELECTION_ENV "PPS_READ_SELECTION"
+#define PPS_READ_SELECTION_C3 "c3"
+
+/**
+ * @brief environment variable enabling the client read cache (see cache.h):
+ *        its number of entries, unset or 0 for no cache. The cache lasts as long as the
+ *        client process, so it is for pps-client-batch rather than the one-shot clients
+ */
+#define PPS_CACHE_ENV "PPS_CACHE"
+
+/**
+ * @brief environment variable enabling the sloppy quorum of writes (see hints.h): the writes of
+ *        the replicas that do not answer in time go to other servers as hints. Unset or 0 to only
+ *        count the acks of the replicas.
+ */
+#define PPS_SLOPPY_QUORUM_ENV "PPS_SLOPPY_QUORUM"
+
+/**
+ * @brief environment variable making a client ask the servers for the membership when it starts
+ *        (see gossip_fetch_membership), to leave out the servers the cluster knows to be dead:
+ *        worth it for long-lived clients, while a one-shot tool would wait up to
+ *        GOSSIP_FETCH_TIMEOUT_MS for it. Unset or 0 to use all the servers of the servers file.
+ */
+#define PPS_MEMBERSHIP_ENV "PPS_MEMBERSHIP"
+
 /**
  * @brief maximum number of bytes in a key or a value in messages without '\0'
  */
@@ -44,3 +81,119 @@
  */
 #define MAX_MSG_SIZE (MAX_MSG_ELEM_SIZE * 2 + 1)
 
+/**
+ * @brief control messages are made of a nul byte, an opcode and the opcode payload.
+ *        (A nul byte alone is the dump request and an empty datagram the liveness check.)
+ */
+#define PPS_OP_PREFIX '\0'
+
+/**
+ * @brief opcodes of the SWIM gossip protocol between servers (see gossip.h)
+ */
+#define PPS_OP_GOSSIP_PING     0x01
+#define PPS_OP_GOSSIP_ACK      0x02
+#define PPS_OP_GOSSIP_PING_REQ 0x03
+
+/**
+ * @brief opcodes for clients to get the membership (and gossip statistics) of a server
+ */
+#define PPS_OP_MEMBERSHIP       0x04
+#define PPS_OP_MEMBERSHIP_REPLY 0x05
+#define PPS_OP_GOSSIP_STATS     0x06
+
+/**
+ * @brief opcodes of the data migration between servers (see migration.h)
+ */
+#define PPS_OP_MIGRATE      0x07
+#define PPS_OP_MIGRATE_ACK  0x08
+#define PPS_OP_MIGRATE_DONE 0x09
+#define PPS_OP_MIGRATE_GET  0x0A
+
+/**
+ * @brief opcodes of the hinted handoff (see hints.h): a client hands a write for an unreachable
+ *        replica to another server, which replays it to the replica once it is back
+ */
+#define PPS_OP_HINT            0x0B
+#define PPS_OP_HINT_REPLAY     0x0C
+#define PPS_OP_HINT_REPLAY_ACK 0x0D
+
+/**
+ * @brief opcode of a get whose reply also reports the load of the server (see selection.h)
+ */
+#define PPS_OP_GET_FEEDBACK 0x0E
+
+/**
+ * @brief opcodes of the leased reads of caching clients and of the invalidations
+ *        servers send them (see lease.h and cache.h)
+ */
+#define PPS_OP_GET_LEASE  0x0F
+#define PPS_OP_INVALIDATE 0x10
+
+/**
+ * @brief opcode of the request (and reply) of the most requested keys of a server (see hotkeys.h)
+ */
+#define PPS_OP_HOT_KEYS 0x11
+
+/**
+ * @brief opcodes of the copies of hot keys pushed to extra servers, and of the gets whose
+ *        reply advertises the number of replicas of the key, as does the reply to a plain get
+ *        of a hot key (see hotcopies.h and spread.h)
+ */
+#define PPS_OP_HOT_COPY 0x12
+#define PPS_OP_GET_WIDE 0x13
+
+/**
+ * @brief opcodes of the server-side append and concatenation. Their requests are
+ *        [APPEND][key '\0' suffix] and [CONCAT][dest '\0' src1 '\0' ... srcK], sent to the
+ *        replicas of the key written. Their replies are the opcode and one of the PPS_STATUS_* bytes.
+ */
+#define PPS_OP_APPEND 0x14
+#define PPS_OP_CONCAT 0x15
+
+/**
+ * @brief opcode of the server-side substring search: [FIND][key '\0' pattern_key], sent to the
+ *        replicas of the key searched. The reply is the opcode, a PPS_STATUS_* byte and the offset
+ *        of the value of pattern_key in the value of key (4 bytes, 0xFFFFFFFF if it does not occur).
+ */
+#define PPS_OP_FIND 0x16
+
+/**
+ * @brief opcode of the scans of the table of a server for the keys matching a pattern (see scan.h)
+ */
+#define PPS_OP_SCAN 0x17
+
+/**
+ * @brief opcode of the queries of the keys of a server under a prefix, in key order (see scan.h)
+ */
+#define PPS_OP_RANGE 0x18
+
+/**
+ * @brief opcode of the paged dumps of the table of a server (see dump.h)
+ */
+#define PPS_OP_DUMP_PAGE 0x19
+
+/**
+ * @brief opcode of the writes of several pairs at once: [PUT_BATCH][seq (4 bytes)][count (2 bytes)]
+ *        [key1 '\0' value1 '\0' ... keyK '\0' valueK '\0'], sent to a replica of all the keys.
+ *        The reply is the opcode, the sequence number and a PPS_STATUS_* byte (see bulk.h).
+ */
+#define PPS_OP_PUT_BATCH 0x1A
+
+/**
+ * @brief opcode of the gets of pipelined clients, which have several requests out on one socket:
+ *        [GET_SEQ][seq (4 bytes)][key]. The reply echoes the sequence number, then holds whether
+ *        the key was found and the value (see pipeline.h).
+ */
+#define PPS_OP_GET_SEQ 0x1B
+
+/**
+ * @brief opcodes of the requests of a server for the values of the keys it needs to answer a
+ *        concatenation or a search, and of their replies (see pull.h)
+ */
+#define PPS_OP_PULL       0x1C
+#define PPS_OP_PULL_REPLY 0x1D
+
+#define PPS_STATUS_OK 0
+#define PPS_STATUS_NOT_FOUND 1
+#define PPS_STATUS_TOO_LONG 2
+#define PPS_STATUS_AGAIN 3      // the key is on its way to the server (see migration.h): send again later
@@ -1,33 +1,34 @@
 /**
  * @file pps-dump-node.c
- * @brief list the content of a node
+ * @brief list the content of a node, page by page: several pages are in flight at once and the
+ *        lost ones are asked again. Usage: pps-dump-node ip port [token], the token resuming
+ *        an interrupted dump
  *
  */
 
 #include <stdlib.h>
 #include <stdio.h>
-#include "config.h"
 
-#include <sys/socket.h>
 #include <netinet/in.h>
-#include <arpa/inet.h>
 
-#include "config.h" // for MAX_MSG_SIZE
 #include "system.h" // for get_socket, get_server_addr & bind_server
 #include "error.h"
+#include "dump.h"
 
 #define MAX_PORT 65535
 #define MAX_IP_SIZE 15
 
+static void print_pair(const char *key, const char *value, void *arg) {
+    (void) arg;
+    printf("%s = %s\n", key, value);
+}
+
 int main(int argc, char **argv) {
     if (argc < 3) {
         fprintf(stderr, "Not enough arguments.\n");
         return ERR_BAD_PARAMETER;
     }
 
-    // Set up socket (with timeout of 1).
-    int s = get_socket(1);
-
     char *ip_addr = argv[1];
     int  port = 0;
     M_EXIT_IF(sscanf(argv[2], "%d", &port) != 1, ERR_BAD_PARAMETER, "port", "%s", "wrong program input");
@@ -38,48 +39,32 @@ int main(int argc, char **argv) {
         return ERR_BAD_PARAMETER;
     }
 
+    //Large: not on the stack
+    static dump_cursor_t cursor;
+    dump_cursor_start(&cursor);
+    M_EXIT_IF(argc > 3 && !dump_cursor_parse(argv[3], &cursor), ERR_BAD_PARAMETER, "token", "%s", "wrong program input");
+
     struct sockaddr_in srv_addr;
     M_EXIT_IF_ERR(get_server_addr(ip_addr, (uint16_t) port, &srv_addr), "failed to get server address");
-    socklen_t addr_len = sizeof(srv_addr);
-
-    //Send a message containing only the nul character '\0'
-    const char *message = "\0";
-    M_EXIT_IF((sendto(s, message, 1, 0, (struct sockaddr *) &srv_addr, addr_len) == -1),
-              ERR_NETWORK, "pps-list-nodes", "%s", "error on send");
-
-    //Check confirmation received
-    char response[MAX_MSG_SIZE + 1];
-    (void) memset(response, '\0', MAX_MSG_SIZE + 1);
-    struct sockaddr_in srv_addr_recv = srv_addr;
-    socklen_t          addr_len_recv = addr_len;
-
-    size_t total_kv = 0;
-    size_t nb_kv    = 0;
-    size_t index    = 0;
 
-    while (recvfrom(s, response, MAX_MSG_SIZE, 0, (struct sockaddr *) &srv_addr_recv, &addr_len_recv) != -1
-           && memcmp(&srv_addr, &srv_addr_recv, sizeof(struct sockaddr_in)) == 0) {
-        index = 0;
+    int s = get_socket(0);
+    M_EXIT_IF(s == -1, ERR_NETWORK, "get socket", "%s", "problem with socket");
 
-        if ((nb_kv == 0) && (sscanf(response, "%lu", &total_kv) == 1)) {
-            index = strlen(response) + 1;
-        }
+    const error_code error = dump_fetch(s, &srv_addr, &cursor, print_pair, NULL);
+    fflush(stdout);
 
-        while (nb_kv < total_kv && strlen(&response[index]) != 0) {
-            printf("%s = ", response + index);
-            index += strlen(response + index) + 1;
-
-            printf("%s\n", response + index);
-            index += strlen(response + index) + 1;
-
-            nb_kv += 1;
-        }
-
-        fflush(stdout);
-        (void) memset(response, '\0', MAX_MSG_SIZE);
+    if (error == ERR_NETWORK) {
+        fprintf(stderr, "dump interrupted, resume with: %s %s %s ", argv[0], argv[1], argv[2]);
+        dump_cursor_print(stderr, &cursor);
+        fprintf(stderr, "\n");
+        return error;
+    }
+    if (error != ERR_NONE) {
+        fprintf(stderr, "dump stopped at a pair too large for a page, after: %s %s %s ", argv[0], argv[1], argv[2]);
+        dump_cursor_print(stderr, &cursor);
+        fprintf(stderr, "\n");
+        return error;
     }
-
 
     return 0;
 }
-
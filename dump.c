@@ -0,0 +1,387 @@
+/**
+ * @file dump.c
+ * @brief Implementation of dump.h
+ *
+ * A request is PPS_OP_PREFIX, PPS_OP_DUMP_PAGE, its identifier (4 bytes), the number of pages and
+ * the key of the cursor. A page is PPS_OP_PREFIX, PPS_OP_DUMP_PAGE, the identifier of its request
+ * (4 bytes), its index in the request, a PPS_STATUS_* byte, whether it is the last page of the
+ * table, the number of pairs (2 bytes) and the pairs.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "dump.h"
+#include "config.h"
+#include "error.h"
+#include "system.h"
+
+//Pages a client keeps when they come before the next one to use
+#define NB_SLOTS (2 * DUMP_DEFAULT_PAGES)
+
+/**
+ * @brief a page received out of order
+ */
+typedef struct {
+    int used;
+    uint32_t request;
+    uint8_t index;
+    size_t len;
+    char msg[MAX_MSG_SIZE];
+} slot_t;
+
+/**
+ * @brief a page being filled
+ */
+typedef struct {
+    size_t count;
+    size_t size;
+    int too_long;             // the first pair does not fit
+    unsigned char msg[MAX_MSG_SIZE];
+} page_buffer_t;
+
+static void write_u32(unsigned char *out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = (unsigned char) (value >> (24 - 8 * i));
+    }
+}
+
+static uint32_t read_u32(const unsigned char *in) {
+    return (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16 | (uint32_t) in[2] << 8 | (uint32_t) in[3];
+}
+
+//Add a pair if it fits in the page, decline it otherwise
+static int add_pair(const kv_pair_t *pair, void *arg) {
+
+    page_buffer_t *page = arg;
+    const size_t key_len   = strlen(pair->key);
+    const size_t value_len = strlen(pair->value);
+    const size_t len = key_len + value_len + 2;
+
+    if (page->size + len > sizeof(page->msg)) {
+        //Too large for any page: the dump stops there and tells the client
+        page->too_long = page->count == 0;
+        return 0;
+    }
+    memcpy(page->msg + page->size, pair->key, key_len + 1);
+    memcpy(page->msg + page->size + key_len + 1, pair->value, value_len + 1);
+    page->size  += len;
+    page->count += 1;
+    return 1;
+}
+
+void dump_cursor_start(dump_cursor_t *cursor) {
+    if (cursor != NULL) {
+        cursor->done     = 0;
+        cursor->after[0] = '\0';
+    }
+}
+
+int dump_cursor_parse(const char *text, dump_cursor_t *cursor) {
+
+    if (text == NULL || cursor == NULL || *text == '\0') {
+        return 0;
+    }
+    cursor->done = 0;
+
+    size_t len = 0;
+    if (strcmp(text, "-") != 0) {
+        for (const char *hex = text; *hex != '\0'; hex += 2) {
+            unsigned int byte = 0;
+            if (len == MAX_MSG_ELEM_SIZE || sscanf(hex, "%2x", &byte) != 1 || hex[1] == '\0' || byte == 0) {
+                return 0;
+            }
+            cursor->after[len++] = (char) byte;
+        }
+    }
+    cursor->after[len] = '\0';
+    return 1;
+}
+
+void dump_cursor_print(FILE *out, const dump_cursor_t *cursor) {
+    if (cursor->after[0] == '\0') {
+        fputc('-', out);
+    }
+    for (const char *c = cursor->after; *c != '\0'; ++c) {
+        fprintf(out, "%02x", (unsigned char) *c);
+    }
+}
+
+size_t dump_request(char *out, uint32_t request, const dump_cursor_t *cursor, uint8_t nb_pages) {
+    unsigned char *msg = (unsigned char *) out;
+    const size_t key_len = strnlen(cursor->after, MAX_MSG_ELEM_SIZE);
+    msg[0] = PPS_OP_PREFIX;
+    msg[1] = PPS_OP_DUMP_PAGE;
+    write_u32(msg + 2, request);
+    msg[6] = nb_pages;
+    memcpy(msg + DUMP_REQUEST_HEADER_SIZE, cursor->after, key_len);
+    return DUMP_REQUEST_HEADER_SIZE + key_len;
+}
+
+int dump_parse_page(const char *msg, size_t len, dump_page_t *page) {
+
+    if (msg == NULL || page == NULL || len < DUMP_PAGE_HEADER_SIZE || msg[0] != PPS_OP_PREFIX
+        || msg[1] != PPS_OP_DUMP_PAGE) {
+        return 0;
+    }
+    const unsigned char *in = (const unsigned char *) msg;
+    page->request     = read_u32(in + 2);
+    page->index       = in[6];
+    page->status      = (char) in[7];
+    page->last        = in[8] != 0;
+    page->count       = (size_t) (in[9] << 8 | in[10]);
+    page->pairs       = msg + DUMP_PAGE_HEADER_SIZE;
+    page->pairs_len   = len - DUMP_PAGE_HEADER_SIZE;
+    return 1;
+}
+
+int dump_next_pair(dump_page_t *page, const char **key, const char **value) {
+
+    if (page == NULL || key == NULL || value == NULL || page->count == 0) {
+        return 0;
+    }
+    const char *key_end = memchr(page->pairs, '\0', page->pairs_len);
+    if (key_end == NULL) {
+        return 0;
+    }
+    const size_t rest = page->pairs_len - (size_t) (key_end + 1 - page->pairs);
+    const char *value_end = memchr(key_end + 1, '\0', rest);
+    if (value_end == NULL) {
+        return 0;
+    }
+    *key   = page->pairs;
+    *value = key_end + 1;
+
+    page->pairs_len -= (size_t) (value_end + 1 - page->pairs);
+    page->pairs      = value_end + 1;
+    page->count     -= 1;
+    return 1;
+}
+
+void dump_page_end(const dump_page_t *page, dump_cursor_t *cursor) {
+
+    dump_page_t rest = *page;
+    const char *key   = NULL;
+    const char *last  = NULL;
+    const char *value = NULL;
+    while (dump_next_pair(&rest, &key, &value)) {
+        last = key;
+    }
+    cursor->done = page->last;
+    if (last != NULL) {
+        strncpy(cursor->after, last, MAX_MSG_ELEM_SIZE);
+        cursor->after[MAX_MSG_ELEM_SIZE] = '\0';
+    }
+}
+
+static void ask_pages(int socket, uint32_t request, const dump_cursor_t *cursor, const struct sockaddr_in *server) {
+    static char msg[DUMP_REQUEST_HEADER_SIZE + MAX_MSG_ELEM_SIZE];
+    const size_t len = dump_request(msg, request, cursor, DUMP_DEFAULT_PAGES);
+    sendto(socket, msg, len, 0, (const struct sockaddr *) server, sizeof(*server));
+}
+
+//Hand the pairs of a page over and move the cursor past them, unless the page stops at a pair too large
+static int use_page(dump_page_t *page, dump_cursor_t *cursor,
+                    void (*pair)(const char *key, const char *value, void *arg), void *arg) {
+    if (page->status != PPS_STATUS_OK) {
+        return 0;
+    }
+    dump_page_end(page, cursor);
+    const char *key   = NULL;
+    const char *value = NULL;
+    while (dump_next_pair(page, &key, &value)) {
+        pair(key, value, arg);
+    }
+    return 1;
+}
+
+//The last page of a request: the next one is in the next request, if any
+static int last_of_request(const dump_page_t *page) {
+    return page->index == DUMP_DEFAULT_PAGES - 1 || page->last;
+}
+
+//Identifier of the last request, distinct from those of the previous dumps whose pages may still come
+static uint32_t last_request = 0;
+
+//Ask the pages after the last one of a request, if it is and some are left
+static uint32_t ask_next(int socket, const dump_page_t *page, const struct sockaddr_in *server) {
+    static dump_cursor_t next_cursor;
+    if (page->index != DUMP_DEFAULT_PAGES - 1 || page->last || page->status != PPS_STATUS_OK) {
+        return 0;
+    }
+    //A page that is neither the last nor stopped at a pair too large has pairs: they set the cursor
+    dump_cursor_start(&next_cursor);
+    dump_page_end(page, &next_cursor);
+    ask_pages(socket, ++last_request, &next_cursor, server);
+    return last_request;
+}
+
+error_code dump_fetch(int socket, const struct sockaddr_in *server, dump_cursor_t *cursor,
+                      void (*pair)(const char *key, const char *value, void *arg), void *arg) {
+
+    M_REQUIRE_NON_NULL(server);
+    M_REQUIRE_NON_NULL(cursor);
+    M_REQUIRE_NON_NULL(pair);
+    M_REQUIRE(set_receive_timeout_ms(socket, DUMP_TIMEOUT_MS) == ERR_NONE, ERR_NETWORK, "%s", "cannot set the timeout");
+
+    //Room for the pages in flight (the system may give less: the pages dropped are asked again)
+    int buffer_size = NB_SLOTS * MAX_MSG_SIZE;
+    setsockopt(socket, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+    slot_t *slots = calloc(NB_SLOTS, sizeof(slot_t));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(slots, ERR_NOMEM);
+
+    static char response[MAX_MSG_SIZE];
+
+    uint32_t   current  = ++last_request;   // request of the next page to use
+    uint8_t    expected = 0;                // index of that page
+    uint32_t   next     = 0;                // request asked from the end of the current one, 0 if none yet
+    int        retries  = 0;
+    error_code error    = ERR_NONE;
+    ask_pages(socket, current, cursor, server);
+
+    while (!cursor->done && error == ERR_NONE) {
+        struct sockaddr_in from;
+        socklen_t          from_len = sizeof(from);
+        ssize_t len = recvfrom(socket, response, sizeof(response), 0, (struct sockaddr *) &from, &from_len);
+
+        dump_page_t page;
+        const int valid = len != -1 && from.sin_addr.s_addr == server->sin_addr.s_addr
+                          && from.sin_port == server->sin_port && dump_parse_page(response, (size_t) len, &page)
+                          && (page.request == current || (page.request == next && next != 0));
+
+        //Nothing for a while, or the end of a request came but not the next page to use (lost):
+        //ask again from where we stopped
+        const int lost = valid && page.request == current && page.index > expected && last_of_request(&page);
+        if (len == -1 || lost) {
+            if (len == -1 && ++retries > DUMP_MAX_RETRIES) {
+                error = ERR_NETWORK;
+                break;
+            }
+            current  = ++last_request;
+            expected = 0;
+            next     = 0;
+            memset(slots, 0, NB_SLOTS * sizeof(slot_t));
+            ask_pages(socket, current, cursor, server);
+            continue;
+        }
+        if (!valid || (page.request == current && page.index < expected)) {
+            continue;
+        }
+        retries = 0;
+
+        //The last page of a request tells where the next request starts: ask it before using the page
+        if (page.request == current && next == 0) {
+            next = ask_next(socket, &page, server);
+        }
+
+        if (page.request != current || page.index != expected) {
+            //Ahead of the next page to use: kept if there is room and it is not there yet
+            size_t free_slot = NB_SLOTS;
+            int    known     = 0;
+            for (size_t i = 0; i < NB_SLOTS; ++i) {
+                if (slots[i].used && slots[i].request == page.request && slots[i].index == page.index) {
+                    known = 1;
+                } else if (!slots[i].used && free_slot == NB_SLOTS) {
+                    free_slot = i;
+                }
+            }
+            if (!known && free_slot < NB_SLOTS) {
+                slots[free_slot].used    = 1;
+                slots[free_slot].request = page.request;
+                slots[free_slot].index   = page.index;
+                slots[free_slot].len     = (size_t) len;
+                memcpy(slots[free_slot].msg, response, (size_t) len);
+            }
+            continue;
+        }
+
+        //The page to use, then the pages received ahead that follow it
+        int found = 1;
+        while (found && !cursor->done) {
+            if (!use_page(&page, cursor, pair, arg)) {
+                error = ERR_BAD_PARAMETER;
+                break;
+            }
+            if (page.index == DUMP_DEFAULT_PAGES - 1) {
+                current  = next;
+                expected = 0;
+                next     = 0;
+                //The last page of the next request may be here already
+                for (size_t i = 0; i < NB_SLOTS && next == 0; ++i) {
+                    dump_page_t last;
+                    if (slots[i].used && slots[i].request == current
+                        && dump_parse_page(slots[i].msg, slots[i].len, &last)) {
+                        next = ask_next(socket, &last, server);
+                    }
+                }
+            } else {
+                ++expected;
+            }
+
+            found = 0;
+            for (size_t i = 0; i < NB_SLOTS && !found; ++i) {
+                if (slots[i].used && slots[i].request == current && slots[i].index == expected) {
+                    memcpy(response, slots[i].msg, slots[i].len);
+                    dump_parse_page(response, slots[i].len, &page);
+                    slots[i].used = 0;
+                    found = 1;
+                }
+            }
+        }
+    }
+
+    free(slots);
+
+    return error;
+}
+
+int dump_handle(Htable_t table, int socket, const char *msg, size_t len, const struct sockaddr_in *from) {
+
+    if (msg == NULL || len < DUMP_REQUEST_HEADER_SIZE || msg[0] != PPS_OP_PREFIX || msg[1] != PPS_OP_DUMP_PAGE) {
+        return 0;
+    }
+    if (table == NULL || from == NULL) {
+        return 1;
+    }
+
+    //Large, and the server handles one request at a time
+    static page_buffer_t page;
+    static char request_key[MAX_MSG_ELEM_SIZE + 1];
+    const unsigned char *in = (const unsigned char *) msg;
+    const size_t wanted   = in[6];
+    const size_t nb_pages = wanted == 0 ? DUMP_DEFAULT_PAGES : wanted < DUMP_MAX_PAGES ? wanted : DUMP_MAX_PAGES;
+
+    //Each page goes on after the last key of the previous one
+    const size_t key_len = len - DUMP_REQUEST_HEADER_SIZE < MAX_MSG_ELEM_SIZE ? len - DUMP_REQUEST_HEADER_SIZE
+                                                                            : MAX_MSG_ELEM_SIZE;
+    memcpy(request_key, msg + DUMP_REQUEST_HEADER_SIZE, key_len);
+    request_key[key_len] = '\0';
+    pps_key_t after = request_key;
+    for (size_t i = 0; i < nb_pages; ++i) {
+        page.count    = 0;
+        page.size     = DUMP_PAGE_HEADER_SIZE;
+        page.too_long = 0;
+
+        if (visit_Htable_from(table, &after, add_pair, &page) != ERR_NONE) {
+            break;
+        }
+
+        memcpy(page.msg, msg, 6);
+        page.msg[6] = (unsigned char) i;
+        page.msg[7] = page.too_long ? PPS_STATUS_TOO_LONG : PPS_STATUS_OK;
+        page.msg[8] = after == NULL;
+        page.msg[9] = (unsigned char) (page.count >> 8);
+        page.msg[10] = (unsigned char) page.count;
+        sendto(socket, page.msg, page.size, 0, (const struct sockaddr *) from, sizeof(*from));
+
+        if (after == NULL || page.too_long) {
+            break;
+        }
+    }
+
+    return 1;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+/**
+ * @file dump.h
+ * @brief Paged dump of the table of a server. A page is one datagram of pairs, taken in key order
+ *        from the ordered index of the table (see visit_Htable_from). A cursor is where a dump goes
+ *        on: the last key dumped, so that the pairs written or deleted meanwhile do not make the
+ *        dump miss or repeat the others, and each page costs O(pairs × key length) to the server
+ *        wherever it starts. A request asks for several pages in a row
+ *        from a cursor, and every page tells where the next one starts: a client asks for the next
+ *        pages as soon as it gets the last one of a request, so that pages are always in flight, and
+ *        asks again from where it stopped when one is lost. The server reads the pages straight from
+ *        the table, without copying it.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <netinet/in.h>
+
+#include "hashtable.h"
+#include "config.h"
+
+/**
+ * @brief pages per request when the request does not say, and at most
+ */
+#define DUMP_DEFAULT_PAGES 16
+#define DUMP_MAX_PAGES     64
+
+/**
+ * @brief sizes of the headers of a request (opcode, request identifier, number of pages, followed
+ *        by the key of the cursor) and of a page (opcode, request identifier, index in the request,
+ *        status, whether it is the last page of the table, number of pairs)
+ */
+#define DUMP_REQUEST_HEADER_SIZE 7
+#define DUMP_PAGE_HEADER_SIZE 11
+
+/**
+ * @brief a client asks again from where it stopped after this long without a page,
+ *        and gives up after this many times in a row
+ */
+#define DUMP_TIMEOUT_MS 200
+#define DUMP_MAX_RETRIES 10
+
+/**
+ * @brief where a dump goes on
+ */
+typedef struct {
+    int done;                           // once every page is fetched
+    char after[MAX_MSG_ELEM_SIZE + 1];  // the pairs up to this key are dumped ("" for none)
+} dump_cursor_t;
+
+/**
+ * @brief a page, as received by a client
+ */
+typedef struct {
+    uint32_t request;         // identifier of the request
+    uint8_t index;            // in the pages sent for the request
+    char status;              // PPS_STATUS_OK, or PPS_STATUS_TOO_LONG if the next pair does not fit in a page
+    int last;                 // whether it is the last page of the table
+    size_t count;             // number of pairs
+    const char *pairs;        // each one is the key, a nul byte, the value and a nul byte
+    size_t pairs_len;
+} dump_page_t;
+
+/**
+ * @brief set a cursor to the start of the table
+ */
+void dump_cursor_start(dump_cursor_t *cursor);
+
+/**
+ * @brief read a cursor printed by dump_cursor_print
+ * @return 1 if the text is a cursor, 0 otherwise
+ */
+int dump_cursor_parse(const char *text, dump_cursor_t *cursor);
+
+/**
+ * @brief print a cursor: its key in hexadecimal, or "-" if it has none
+ */
+void dump_cursor_print(FILE *out, const dump_cursor_t *cursor);
+
+/**
+ * @brief write a request of pages
+ * @param out where to write, of DUMP_REQUEST_HEADER_SIZE + MAX_MSG_ELEM_SIZE bytes
+ * @param request identifier of the request, echoed by its pages
+ * @param cursor where the first page starts
+ * @param nb_pages number of pages in a row (0 for DUMP_DEFAULT_PAGES)
+ * @return the length of the request
+ */
+size_t dump_request(char *out, uint32_t request, const dump_cursor_t *cursor, uint8_t nb_pages);
+
+/**
+ * @brief read a page
+ * @param msg the message received
+ * @param len its length
+ * @param page (OUT) the page
+ * @return 1 if the message is a well-formed page, 0 otherwise
+ */
+int dump_parse_page(const char *msg, size_t len, dump_page_t *page);
+
+/**
+ * @brief read the next pair of a page
+ * @param page the page, advanced past the pair
+ * @param key (OUT) the key, pointing in the page
+ * @param value (OUT) the value, pointing in the page
+ * @return 1 if a pair was read, 0 at the end of the page
+ */
+int dump_next_pair(dump_page_t *page, const char **key, const char **value);
+
+/**
+ * @brief where the page after a page starts
+ * @param page the page (not advanced)
+ * @param cursor (IN/OUT) the cursor the page started from, then the cursor of the next page:
+ *        after the last key of the page, if it has one
+ */
+void dump_page_end(const dump_page_t *page, dump_cursor_t *cursor);
+
+/**
+ * @brief fetch the pages of a server from a cursor, a request of pages being always in flight, and
+ *        ask again from where it stopped when pages are lost
+ * @param socket the socket to use (its receive timeout and buffer are changed)
+ * @param server the server to dump
+ * @param cursor (IN/OUT) where the dump starts, then done once every page is fetched, or where to
+ *        resume from if it stopped
+ * @param pair function called on each pair, in the order of the dump
+ * @param arg passed to pair
+ * @return ERR_NONE once every page is fetched, ERR_NETWORK if the server stopped answering,
+ *         ERR_BAD_PARAMETER if the next pair is too large for a page
+ */
+error_code dump_fetch(int socket, const struct sockaddr_in *server, dump_cursor_t *cursor,
+                      void (*pair)(const char *key, const char *value, void *arg), void *arg);
+
+/**
+ * @brief handle a message if it is a request of pages: they are sent to the sender
+ * @return 1 if the message was a request of pages, 0 otherwise
+ */
+int dump_handle(Htable_t table, int socket, const char *msg, size_t len, const struct sockaddr_in *from);
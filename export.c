@@ -0,0 +1,134 @@
+/**
+ * @file pps-export.c
+ * @brief write the pairs of the cluster to a bulk file (see bulk.h), read by pps-import: every
+ *        alive server of the servers file is dumped page by page, and a pair is written by the
+ *        first alive replica of its key only. Usage: pps-export [-n N] file
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "config.h"
+#include "system.h"
+#include "error.h"
+#include "args.h"
+#include "ring.h"
+#include "dump.h"
+#include "bulk.h"
+
+#define USAGE "usage: pps-export [-n N] file"
+
+/**
+ * @brief what the pairs of a server are written with
+ */
+typedef struct {
+    FILE *file;
+    const ring_t *ring;
+    size_t n;
+    size_t server;            // index in ring->servers of the server dumped
+    uint64_t count;           // pairs written
+    error_code error;
+} export_t;
+
+//Write a pair if the server dumped is the first alive replica of its key, or none of them
+//(a stray copy, e.g. left by a handoff, is better written twice than lost)
+static void export_pair(const char *key, const char *value, void *arg) {
+
+    export_t *export = arg;
+    if (export->error != ERR_NONE) {
+        return;
+    }
+
+    node_t replicas_row[RING_MAX_PREFERENCE_SIZE];
+    node_list_t replicas = ring_get_nodes_for_key(export->ring, export->n, key, replicas_row);
+    int keep = 1;
+    for (size_t i = 0; i < replicas.size; ++i) {
+        if (ring_server_index(export->ring, &replicas.nodes[i]) == export->server) {
+            keep = i == 0;
+            break;
+        }
+    }
+    if (keep) {
+        export->error = bulk_write_pair(export->file, key, strlen(key), value, strlen(value));
+        export->count += export->error == ERR_NONE;
+    }
+}
+
+int main(int argc, char **argv) {
+
+    char **rem_argv = argv + 1;
+    args_t *args = parse_opt_args(TOTAL_SERVERS, &rem_argv);
+    M_EXIT_IF(args == NULL || rem_argv[0] == NULL || rem_argv[1] != NULL, ERR_BAD_PARAMETER, "pps-export", "%s", USAGE);
+    const size_t n = args->N;
+    free(args);
+
+    ring_t *ring = ring_alloc();
+    M_REQUIRE_NON_NULL(ring);
+    error_code error = ring_init(ring);
+    int s = error == ERR_NONE ? get_socket(0) : -1;
+    if (error == ERR_NONE && s == -1) {
+        error = ERR_NETWORK;
+    }
+    if (error == ERR_NONE) {
+        error = bulk_update_membership(s, ring);
+    }
+    if (error != ERR_NONE) {
+        ring_free(ring);
+    }
+    M_EXIT_IF_ERR(error, "cannot reach the servers");
+
+    FILE *file = fopen(rem_argv[0], "wb");
+    if (file == NULL) {
+        ring_free(ring);
+        fprintf(stderr, "cannot open %s\n", rem_argv[0]);
+        return ERR_IO;
+    }
+
+    export_t export = {file, ring, n, 0, 0, bulk_write_header(file)};
+    size_t nb_failed = 0;
+    for (size_t i = 0; i < ring->nb_servers && export.error == ERR_NONE; ++i) {
+        const struct sockaddr_in *addr = (const struct sockaddr_in *) &ring->servers[i].addr;
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr->sin_addr, ip, INET_ADDRSTRLEN);
+        if (!ring->alive[i]) {
+            fprintf(stderr, "server %s:%d down, its keys may be missing\n", ip, ntohs(addr->sin_port));
+            ++nb_failed;
+            continue;
+        }
+
+        export.server = i;
+        static dump_cursor_t cursor;
+        dump_cursor_start(&cursor);
+        const error_code error = dump_fetch(s, addr, &cursor, export_pair, &export);
+        if (error == ERR_NETWORK) {
+            fprintf(stderr, "server %s:%d stopped answering, its keys may be missing\n", ip, ntohs(addr->sin_port));
+            ++nb_failed;
+        } else if (error != ERR_NONE) {
+            fprintf(stderr, "server %s:%d has a pair too large to export, its next keys are missing\n", ip,
+                    ntohs(addr->sin_port));
+            ++nb_failed;
+        }
+    }
+
+    if (export.error == ERR_NONE) {
+        export.error = bulk_write_end(file, export.count);
+    }
+    if (fclose(file) != 0 && export.error == ERR_NONE) {
+        export.error = ERR_IO;
+    }
+    ring_free(ring);
+
+    if (export.error != ERR_NONE) {
+        fprintf(stderr, "cannot write %s\n", rem_argv[0]);
+        return export.error;
+    }
+    printf("%" PRIu64 " pairs exported\n", export.count);
+
+    return nb_failed == 0 ? ERR_NONE : ERR_NETWORK;
+}
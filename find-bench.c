@@ -0,0 +1,112 @@
+/**
+ * @file pps-find-bench.c
+ * @brief measure the substring search kernels of the servers against strstr and memmem,
+ *        on values of the sizes the DHT stores (up to MAX_MSG_ELEM_SIZE)
+ *
+ */
+
+#define _GNU_SOURCE // for memmem
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+#include "error.h"
+#include "strsearch.h"
+
+#define DEFAULT_NB_BYTES 200000000
+#define NB_SIZES 4
+#define NB_PATTERNS 3
+
+typedef const char *(*search_t)(const char *haystack, size_t n, const char *needle, size_t m);
+
+static const char *search_strstr(const char *haystack, size_t n, const char *needle, size_t m) {
+    (void) n;
+    (void) m;
+    return strstr(haystack, needle);
+}
+
+static const char *search_memmem(const char *haystack, size_t n, const char *needle, size_t m) {
+    return memmem(haystack, n, needle, m);
+}
+
+static const struct {
+    const char *name;
+    search_t search;
+} KERNELS[] = {
+    {"strstr", search_strstr},
+    {"memmem", search_memmem},
+    {"scalar", str_search_scalar},
+    {"sse2",   str_search_sse2},
+    {"avx2",   str_search_avx2},
+};
+
+//Current time in seconds
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+
+    size_t nb_bytes = DEFAULT_NB_BYTES;
+    if (argc > 1 && (sscanf(argv[1], "%zu", &nb_bytes) != 1 || nb_bytes == 0)) {
+        fprintf(stderr, "usage: %s [bytes_searched_per_measure]\n", argv[0]);
+        return ERR_BAD_PARAMETER;
+    }
+
+    const size_t sizes[NB_SIZES]       = {64, 1024, 8192, MAX_MSG_ELEM_SIZE};
+    const size_t patterns[NB_PATTERNS] = {4, 16, 64};
+
+    //Text over 'a'..'y': the first and last bytes of the patterns often match, their 'z' never does
+    static char haystack[MAX_MSG_ELEM_SIZE + 1];
+    srand(42);
+    for (size_t i = 0; i < MAX_MSG_ELEM_SIZE; ++i) {
+        haystack[i] = (char) ('a' + rand() % 25);
+    }
+
+    printf("%s\n", str_search_has_avx2() ? "avx2 available" : "avx2 not available, falls back to sse2");
+    printf("%-7s %8s %8s %12s %10s\n", "kernel", "value", "pattern", "ns/search", "GB/s");
+
+    for (size_t s = 0; s < NB_SIZES; ++s) {
+        for (size_t p = 0; p < NB_PATTERNS; ++p) {
+
+            const size_t n = sizes[s];
+            const size_t m = patterns[p];
+            char needle[64 + 1];
+            for (size_t i = 0; i < m; ++i) {
+                needle[i] = (char) ('a' + rand() % 25);
+            }
+            needle[m / 2] = 'z';
+            needle[m]     = '\0';
+
+            //strstr needs the value nul-terminated, as the server has it
+            const char saved = haystack[n];
+            haystack[n] = '\0';
+
+            const size_t nb_searches = nb_bytes / n + 1;
+            for (size_t k = 0; k < sizeof(KERNELS) / sizeof(KERNELS[0]); ++k) {
+
+                //Through a volatile pointer and counting the matches, so that the searches are not optimized out
+                search_t volatile search = KERNELS[k].search;
+                size_t found = 0;
+                const double start = now();
+                for (size_t i = 0; i < nb_searches; ++i) {
+                    found += search(haystack, n, needle, m) != NULL;
+                }
+                const double elapsed = now() - start;
+
+                printf("%-7s %8zu %8zu %12.1f %10.2f\n", KERNELS[k].name, n, m,
+                       1e9 * elapsed / (double) nb_searches, (double) (n * nb_searches) / elapsed * 1e-9);
+                debug_print("found %zu", found);
+            }
+
+            haystack[n] = saved;
+        }
+    }
+
+    return 0;
+}
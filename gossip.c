@@ -0,0 +1,599 @@
+/**
+ * @file gossip.c
+ * @brief Implementation of gossip.h
+ *
+ * Protocol messages: PPS_OP_PREFIX, opcode, sequence number (4 bytes), incarnation of the
+ * sender (4 bytes), for PING_REQ the address of the target (IPv4 4 bytes, port 2 bytes),
+ * then the number of piggybacked updates (1 byte) and the updates (GOSSIP_UPDATE_SIZE bytes each).
+ * All integers are in network byte order.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "gossip.h"
+#include "config.h"
+#include "system.h"
+
+#define HEADER_SIZE 10
+#define TARGET_SIZE 6
+#define NO_TARGET SIZE_MAX
+#define EULER 2.718281828459045
+
+static void put_u32(unsigned char *out, uint32_t value) {
+    out[0] = (unsigned char) (value >> 24);
+    out[1] = (unsigned char) (value >> 16);
+    out[2] = (unsigned char) (value >> 8);
+    out[3] = (unsigned char) value;
+}
+
+static uint32_t get_u32(const unsigned char *in) {
+    return (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16 | (uint32_t) in[2] << 8 | (uint32_t) in[3];
+}
+
+//Address fields are already in network byte order
+static void put_addr(unsigned char *out, const struct sockaddr_in *addr) {
+    memcpy(out, &addr->sin_addr.s_addr, 4);
+    memcpy(out + 4, &addr->sin_port, 2);
+}
+
+static void get_addr(const unsigned char *in, struct sockaddr_in *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    memcpy(&addr->sin_addr.s_addr, in, 4);
+    memcpy(&addr->sin_port, in + 4, 2);
+}
+
+static size_t find_member(const member_t *members, size_t nb_members, const struct sockaddr_in *addr) {
+    for (size_t i = 0; i < nb_members; ++i) {
+        if (members[i].addr.sin_addr.s_addr == addr->sin_addr.s_addr
+            && members[i].addr.sin_port == addr->sin_port) {
+            return i;
+        }
+    }
+    return NO_TARGET;
+}
+
+//Number of piggybacked transmissions of an update: lambda * log2(n)
+static size_t retransmit_limit(const gossip_t *gossip) {
+    return GOSSIP_RETRANSMIT_MULT * (size_t) ceil(log2((double) gossip->nb_members + 1.0));
+}
+
+static void set_state(gossip_t *gossip, size_t index, member_state_t state, uint32_t incarnation, double now) {
+    member_t *member = &gossip->members[index];
+    if (member->state != state) {
+        member->state_since = now;
+        if (state == MEMBER_SUSPECT) {
+            ++gossip->nb_suspicions;
+        } else if (state == MEMBER_DEAD) {
+            ++gossip->nb_deaths;
+        }
+    }
+    member->state       = state;
+    member->incarnation = incarnation;
+    member->retransmits = retransmit_limit(gossip);
+}
+
+/**
+ * @brief merge an update into the local view (SWIM rules: a higher incarnation wins,
+ *        then dead over suspect over alive). Updates suspecting the local server are refuted
+ *        by incrementing its incarnation.
+ */
+static void apply_update(gossip_t *gossip, const struct sockaddr_in *addr, member_state_t state,
+                         uint32_t incarnation, double now) {
+
+    size_t index = find_member(gossip->members, gossip->nb_members, addr);
+    if (index == NO_TARGET) {
+        return;
+    }
+    member_t *member = &gossip->members[index];
+
+    if (index == gossip->self) {
+        if (state != MEMBER_ALIVE && incarnation >= member->incarnation) {
+            set_state(gossip, index, MEMBER_ALIVE, incarnation + 1, now);
+        }
+        return;
+    }
+
+    int newer = 0;
+    switch (state) {
+    case MEMBER_ALIVE:
+        newer = incarnation > member->incarnation;
+        break;
+    case MEMBER_SUSPECT:
+        newer = incarnation > member->incarnation
+                || (incarnation == member->incarnation && member->state == MEMBER_ALIVE);
+        break;
+    case MEMBER_DEAD:
+        newer = incarnation > member->incarnation
+                || (incarnation == member->incarnation && member->state != MEMBER_DEAD);
+        break;
+    }
+
+    if (newer) {
+        set_state(gossip, index, state, incarnation, now);
+    }
+}
+
+static void write_update(unsigned char *out, const member_t *member) {
+    put_addr(out, &member->addr);
+    out[6] = (unsigned char) member->state;
+    put_u32(out + 7, member->incarnation);
+}
+
+/**
+ * @brief append the updates to piggyback (most recent first) to a message. An update about
+ *        the destination itself goes first when the local view is not alive, so that it can refute it.
+ * @return number of bytes written
+ */
+static size_t write_updates(gossip_t *gossip, unsigned char *out, size_t room, size_t destination) {
+
+    size_t max = gossip->config.max_piggyback;
+    if (max > (room - 1) / GOSSIP_UPDATE_SIZE) {
+        max = (room - 1) / GOSSIP_UPDATE_SIZE;
+    }
+    if (max > UINT8_MAX) {
+        max = UINT8_MAX;
+    }
+
+    size_t count = 0;
+    const int refute = destination != NO_TARGET && max > 0 && gossip->members[destination].state != MEMBER_ALIVE;
+    if (refute) {
+        write_update(out + 1, &gossip->members[destination]);
+        count = 1;
+    }
+
+    //Most retransmissions left first, i.e. the most recent updates
+    size_t chosen[UINT8_MAX];
+    size_t nb_chosen = 0;
+    while (count < max) {
+        size_t best = NO_TARGET;
+        for (size_t i = 0; i < gossip->nb_members; ++i) {
+            int taken = refute && i == destination;
+            for (size_t c = 0; c < nb_chosen; ++c) {
+                taken |= chosen[c] == i;
+            }
+            if (!taken && gossip->members[i].retransmits > 0
+                && (best == NO_TARGET || gossip->members[i].retransmits > gossip->members[best].retransmits)) {
+                best = i;
+            }
+        }
+        if (best == NO_TARGET) {
+            break;
+        }
+        write_update(out + 1 + count * GOSSIP_UPDATE_SIZE, &gossip->members[best]);
+        chosen[nb_chosen++] = best;
+        ++count;
+    }
+    for (size_t c = 0; c < nb_chosen; ++c) {
+        gossip->members[chosen[c]].retransmits -= 1;
+    }
+
+    out[0] = (unsigned char) count;
+    return 1 + count * GOSSIP_UPDATE_SIZE;
+}
+
+static void send_message(gossip_t *gossip, int socket, uint8_t op, uint32_t seq,
+                         const struct sockaddr_in *to, const struct sockaddr_in *target) {
+
+    unsigned char msg[GOSSIP_MAX_MESSAGE_SIZE];
+    msg[0] = PPS_OP_PREFIX;
+    msg[1] = op;
+    put_u32(msg + 2, seq);
+    put_u32(msg + 6, gossip->members[gossip->self].incarnation);
+    size_t len = HEADER_SIZE;
+
+    if (target != NULL) {
+        put_addr(msg + len, target);
+        len += TARGET_SIZE;
+    }
+
+    len += write_updates(gossip, msg + len, sizeof(msg) - len, find_member(gossip->members, gossip->nb_members, to));
+
+    if (sendto(socket, msg, len, 0, (const struct sockaddr *) to, sizeof(*to)) != -1) {
+        gossip->bytes_sent    += len;
+        gossip->messages_sent += 1;
+    }
+}
+
+static uint32_t new_seq(gossip_t *gossip) {
+    gossip->next_seq += 1;
+    if (gossip->next_seq == 0) {
+        gossip->next_seq = 1;
+    }
+    return gossip->next_seq;
+}
+
+static void shuffle(size_t *order, size_t size) {
+    for (size_t i = size; i > 1; --i) {
+        size_t j = (size_t) rand() % i;
+        size_t tmp   = order[i - 1];
+        order[i - 1] = order[j];
+        order[j]     = tmp;
+    }
+}
+
+void gossip_default_config(gossip_config_t *config) {
+    if (config != NULL) {
+        config->period_ms         = GOSSIP_DEFAULT_PERIOD_MS;
+        config->ack_timeout_ms    = GOSSIP_DEFAULT_ACK_TIMEOUT_MS;
+        config->indirect_probes   = GOSSIP_DEFAULT_INDIRECT_PROBES;
+        config->suspicion_periods = GOSSIP_DEFAULT_SUSPICION_PERIODS;
+        config->max_piggyback     = GOSSIP_DEFAULT_MAX_PIGGYBACK;
+    }
+}
+
+error_code gossip_init(gossip_t *gossip, const gossip_config_t *config, const ring_t *ring,
+                       const struct sockaddr_in *self, double now) {
+
+    M_REQUIRE_NON_NULL(gossip);
+    M_REQUIRE_NON_NULL(config);
+    M_REQUIRE_NON_NULL(ring);
+    M_REQUIRE_NON_NULL(self);
+    M_REQUIRE(config->period_ms > 0 && config->ack_timeout_ms > 0 && config->ack_timeout_ms < config->period_ms,
+              ERR_BAD_PARAMETER, "%s", "the ack timeout must be shorter than the period");
+
+    memset(gossip, 0, sizeof(*gossip));
+    gossip->config = *config;
+
+    gossip->members = calloc(ring->nb_servers, sizeof(member_t));
+    gossip->order   = calloc(ring->nb_servers, sizeof(size_t));
+    if (gossip->members == NULL || gossip->order == NULL) {
+        gossip_end(gossip);
+        return ERR_NOMEM;
+    }
+    gossip->nb_members = ring->nb_servers;
+
+    //Members are in the order of ring->servers, so that the view maps to ring_update_membership
+    for (size_t i = 0; i < ring->nb_servers; ++i) {
+        memcpy(&gossip->members[i].addr, &ring->servers[i].addr, sizeof(struct sockaddr_in));
+        gossip->members[i].state       = MEMBER_ALIVE;
+        gossip->members[i].state_since = now;
+        gossip->order[i]               = i;
+    }
+
+    gossip->self = find_member(gossip->members, gossip->nb_members, self);
+    if (gossip->self == NO_TARGET) {
+        gossip_end(gossip);
+        debug_print("%s", "the server is not in the servers file");
+        return ERR_BAD_PARAMETER;
+    }
+
+    shuffle(gossip->order, gossip->nb_members);
+    gossip->target      = NO_TARGET;
+    gossip->next_probe  = now;
+    gossip->stats_start = now;
+
+    return ERR_NONE;
+}
+
+void gossip_end(gossip_t *gossip) {
+    if (gossip != NULL) {
+        free(gossip->members);
+        free(gossip->order);
+        gossip->members    = NULL;
+        gossip->order      = NULL;
+        gossip->nb_members = 0;
+    }
+}
+
+double gossip_next_timeout_ms(const gossip_t *gossip, double now) {
+
+    double next = gossip->next_probe;
+    if (gossip->target != NO_TARGET) {
+        next = gossip->probe_start + (gossip->indirect ? gossip->config.period_ms : gossip->config.ack_timeout_ms);
+    }
+    //Suspicion timeouts are checked at least every ack timeout
+    if (next > now + gossip->config.ack_timeout_ms) {
+        next = now + gossip->config.ack_timeout_ms;
+    }
+
+    return next > now ? next - now : 0;
+}
+
+//Pick the next member to probe, round robin over a random order (reshuffled at each round)
+static size_t next_target(gossip_t *gossip) {
+    for (size_t tries = 0; tries < gossip->nb_members; ++tries) {
+        if (gossip->order_pos >= gossip->nb_members) {
+            gossip->order_pos = 0;
+            shuffle(gossip->order, gossip->nb_members);
+        }
+        size_t candidate = gossip->order[gossip->order_pos++];
+        if (candidate != gossip->self && gossip->members[candidate].state != MEMBER_DEAD) {
+            return candidate;
+        }
+    }
+    return NO_TARGET;
+}
+
+static void send_indirect_probes(gossip_t *gossip, int socket) {
+
+    //Ask up to k random alive members, other than the target, to probe it
+    size_t sent = 0;
+    size_t start = gossip->nb_members > 0 ? (size_t) rand() % gossip->nb_members : 0;
+    for (size_t i = 0; i < gossip->nb_members && sent < gossip->config.indirect_probes; ++i) {
+        size_t m = (start + i) % gossip->nb_members;
+        if (m != gossip->self && m != gossip->target && gossip->members[m].state == MEMBER_ALIVE) {
+            send_message(gossip, socket, PPS_OP_GOSSIP_PING_REQ, gossip->probe_seq,
+                         &gossip->members[m].addr, &gossip->members[gossip->target].addr);
+            ++sent;
+        }
+    }
+    gossip->nb_indirect += sent;
+    gossip->indirect = 1;
+}
+
+void gossip_tick(gossip_t *gossip, int socket, double now) {
+
+    if (gossip == NULL || gossip->members == NULL) {
+        return;
+    }
+
+    const double period = gossip->config.period_ms;
+
+    for (size_t r = 0; r < GOSSIP_MAX_RELAYS; ++r) {
+        if (gossip->relays[r].seq != 0 && gossip->relays[r].expires <= now) {
+            gossip->relays[r].seq = 0;
+        }
+    }
+
+    for (size_t i = 0; i < gossip->nb_members; ++i) {
+        const member_t *member = &gossip->members[i];
+        if (member->state == MEMBER_SUSPECT
+            && now - member->state_since >= (double) gossip->config.suspicion_periods * period) {
+            set_state(gossip, i, MEMBER_DEAD, member->incarnation, now);
+        }
+    }
+
+    if (gossip->target != NO_TARGET) {
+        if (!gossip->indirect && now - gossip->probe_start >= gossip->config.ack_timeout_ms) {
+            send_indirect_probes(gossip, socket);
+        }
+        if (now - gossip->probe_start >= period) {
+            //No direct nor indirect ack within the period
+            const member_t *target = &gossip->members[gossip->target];
+            if (target->state == MEMBER_ALIVE) {
+                set_state(gossip, gossip->target, MEMBER_SUSPECT, target->incarnation, now);
+            }
+            gossip->target = NO_TARGET;
+        }
+    }
+
+    if (gossip->target == NO_TARGET && now >= gossip->next_probe) {
+        gossip->next_probe = now + period;
+        gossip->target     = next_target(gossip);
+        if (gossip->target != NO_TARGET) {
+            gossip->probe_seq   = new_seq(gossip);
+            gossip->probe_start = now;
+            gossip->indirect    = 0;
+            ++gossip->nb_probes;
+            send_message(gossip, socket, PPS_OP_GOSSIP_PING, gossip->probe_seq, &gossip->members[gossip->target].addr, NULL);
+        }
+    }
+}
+
+//Reply to a client with the full view: PPS_OP_PREFIX, MEMBERSHIP_REPLY, then one update per member
+static void send_membership(const gossip_t *gossip, int socket, const struct sockaddr_in *to) {
+
+    unsigned char msg[MAX_MSG_SIZE];
+    msg[0] = PPS_OP_PREFIX;
+    msg[1] = PPS_OP_MEMBERSHIP_REPLY;
+    size_t len = 2;
+    for (size_t i = 0; i < gossip->nb_members && len + GOSSIP_UPDATE_SIZE <= sizeof(msg); ++i) {
+        write_update(msg + len, &gossip->members[i]);
+        len += GOSSIP_UPDATE_SIZE;
+    }
+    sendto(socket, msg, len, 0, (const struct sockaddr *) to, sizeof(*to));
+}
+
+static void send_stats(const gossip_t *gossip, int socket, const struct sockaddr_in *to, double now) {
+
+    size_t counts[MEMBER_DEAD + 1] = {0, 0, 0};
+    for (size_t i = 0; i < gossip->nb_members; ++i) {
+        counts[gossip->members[i].state] += 1;
+    }
+
+    const double period  = gossip->config.period_ms;
+    const double elapsed = (now - gossip->stats_start) / 1e3;
+    //A failed member is probed by someone after e/(e-1) periods on average (SWIM), then suspected
+    const double detection = period * EULER / (EULER - 1.0) + (double) gossip->config.suspicion_periods * period;
+
+    char msg[GOSSIP_MAX_MESSAGE_SIZE];
+    msg[0] = PPS_OP_PREFIX;
+    msg[1] = PPS_OP_GOSSIP_STATS;
+    int len = snprintf(msg + 2, sizeof(msg) - 2,
+                       "members %zu alive %zu suspect %zu dead %zu incarnation %u\n"
+                       "period_ms %.0f ack_timeout_ms %.0f indirect_probes %zu suspicion_ms %.0f max_piggyback %zu\n"
+                       "expected_detection_ms %.0f worst_first_probe_ms %.0f\n"
+                       "probes %zu indirect %zu suspicions %zu deaths %zu\n"
+                       "sent_bytes_per_s %.1f sent_msgs_per_s %.2f\n",
+                       gossip->nb_members, counts[MEMBER_ALIVE], counts[MEMBER_SUSPECT], counts[MEMBER_DEAD],
+                       gossip->members[gossip->self].incarnation,
+                       period, gossip->config.ack_timeout_ms, gossip->config.indirect_probes,
+                       (double) gossip->config.suspicion_periods * period, gossip->config.max_piggyback,
+                       detection, (2.0 * (double) gossip->nb_members - 1.0) * period,
+                       gossip->nb_probes, gossip->nb_indirect, gossip->nb_suspicions, gossip->nb_deaths,
+                       elapsed > 0 ? (double) gossip->bytes_sent / elapsed : 0.0,
+                       elapsed > 0 ? (double) gossip->messages_sent / elapsed : 0.0);
+    if (len > 0) {
+        size_t size = 2 + ((size_t) len < sizeof(msg) - 2 ? (size_t) len : sizeof(msg) - 3);
+        sendto(socket, msg, size, 0, (const struct sockaddr *) to, sizeof(*to));
+    }
+}
+
+int gossip_handle(gossip_t *gossip, int socket, const char *msg, size_t len,
+                  const struct sockaddr_in *from, double now) {
+
+    if (gossip == NULL || msg == NULL || from == NULL || len < 2 || msg[0] != PPS_OP_PREFIX) {
+        return 0;
+    }
+    const unsigned char *in = (const unsigned char *) msg;
+    const uint8_t op = in[1];
+
+    if (op == PPS_OP_MEMBERSHIP) {
+        send_membership(gossip, socket, from);
+        return 1;
+    }
+    if (op == PPS_OP_GOSSIP_STATS) {
+        send_stats(gossip, socket, from, now);
+        return 1;
+    }
+    if (op != PPS_OP_GOSSIP_PING && op != PPS_OP_GOSSIP_ACK && op != PPS_OP_GOSSIP_PING_REQ) {
+        return 0;
+    }
+
+    size_t offset = HEADER_SIZE + (op == PPS_OP_GOSSIP_PING_REQ ? TARGET_SIZE : 0);
+    if (len < offset + 1 || len < offset + 1 + in[offset] * GOSSIP_UPDATE_SIZE) {
+        debug_print("%s", "truncated gossip message");
+        return 1;
+    }
+    const uint32_t seq         = get_u32(in + 2);
+    const uint32_t incarnation = get_u32(in + 6);
+
+    //Any message from a member tells it is alive at its incarnation
+    size_t sender = find_member(gossip->members, gossip->nb_members, from);
+    if (sender != NO_TARGET && sender != gossip->self) {
+        member_t *member = &gossip->members[sender];
+        if (incarnation > member->incarnation) {
+            set_state(gossip, sender, MEMBER_ALIVE, incarnation, now);
+        } else if (member->state != MEMBER_ALIVE && member->retransmits == 0) {
+            //It does not know yet: make sure our reply carries the news so that it refutes it
+            member->retransmits = 1;
+        }
+    }
+
+    const size_t nb_updates = in[offset];
+    for (size_t u = 0; u < nb_updates; ++u) {
+        const unsigned char *update = in + offset + 1 + u * GOSSIP_UPDATE_SIZE;
+        struct sockaddr_in addr;
+        get_addr(update, &addr);
+        if (update[6] <= MEMBER_DEAD) {
+            apply_update(gossip, &addr, (member_state_t) update[6], get_u32(update + 7), now);
+        }
+    }
+
+    switch (op) {
+    case PPS_OP_GOSSIP_PING:
+        send_message(gossip, socket, PPS_OP_GOSSIP_ACK, seq, from, NULL);
+        break;
+
+    case PPS_OP_GOSSIP_PING_REQ: {
+        struct sockaddr_in target;
+        get_addr(in + HEADER_SIZE, &target);
+        for (size_t r = 0; r < GOSSIP_MAX_RELAYS; ++r) {
+            if (gossip->relays[r].seq == 0) {
+                gossip->relays[r].seq           = new_seq(gossip);
+                gossip->relays[r].requester     = *from;
+                gossip->relays[r].requester_seq = seq;
+                gossip->relays[r].expires       = now + gossip->config.period_ms;
+                send_message(gossip, socket, PPS_OP_GOSSIP_PING, gossip->relays[r].seq, &target, NULL);
+                break;
+            }
+        }
+        break;
+    }
+
+    case PPS_OP_GOSSIP_ACK:
+        if (gossip->target != NO_TARGET && seq == gossip->probe_seq) {
+            gossip->target = NO_TARGET;
+        } else {
+            for (size_t r = 0; r < GOSSIP_MAX_RELAYS; ++r) {
+                if (gossip->relays[r].seq == seq) {
+                    send_message(gossip, socket, PPS_OP_GOSSIP_ACK, gossip->relays[r].requester_seq,
+                                 &gossip->relays[r].requester, NULL);
+                    gossip->relays[r].seq = 0;
+                    break;
+                }
+            }
+        }
+        break;
+    }
+
+    return 1;
+}
+
+int gossip_is_alive(const gossip_t *gossip, const struct sockaddr_in *addr) {
+    if (gossip == NULL || addr == NULL) {
+        return 1;
+    }
+    size_t index = find_member(gossip->members, gossip->nb_members, addr);
+    return index == NO_TARGET || gossip->members[index].state == MEMBER_ALIVE;
+}
+
+error_code gossip_fetch_membership(ring_t *ring) {
+
+    M_REQUIRE_NON_NULL(ring);
+    M_REQUIRE_NON_NULL(ring->alive);
+
+    int socket = get_socket(0);
+    M_REQUIRE(socket != -1, ERR_NETWORK, "%s", "cannot get a socket");
+    error_code error = ERR_NONE;
+
+    int *alive = calloc(ring->nb_servers, sizeof(int));
+    if (alive == NULL) {
+        close(socket);
+        return ERR_NOMEM;
+    }
+
+    const char request[2] = {PPS_OP_PREFIX, PPS_OP_MEMBERSHIP};
+    unsigned char reply[MAX_MSG_SIZE];
+
+    //Waves of requests until the first answer: a dead server costs a wave, not the whole timeout
+    const double deadline  = get_time_ms() + GOSSIP_FETCH_TIMEOUT_MS;
+    double       next_wave = 0;
+    size_t       asked     = 0;
+    int answered = 0;
+    while (error == ERR_NONE && !answered) {
+
+        const double now = get_time_ms();
+        if (now >= deadline) {
+            break;
+        }
+        if (now >= next_wave && asked < ring->nb_servers) {
+            for (size_t sent = 0; sent < GOSSIP_FETCH_FANOUT && asked < ring->nb_servers; ++asked) {
+                const struct sockaddr *addr = &ring->servers[asked].addr;
+                sent += sendto(socket, request, sizeof(request), 0, addr, sizeof(struct sockaddr_in)) != -1;
+            }
+            next_wave = now + GOSSIP_FETCH_WAVE_MS;
+        }
+
+        //Until the next wave, or the deadline once every server is asked
+        const double until = asked < ring->nb_servers && next_wave < deadline ? next_wave : deadline;
+        error = set_receive_timeout_ms(socket, until - now < 1 ? 1 : (long) (until - now));
+
+        struct sockaddr_in from;
+        socklen_t          from_len = sizeof(from);
+        ssize_t len = recvfrom(socket, reply, sizeof(reply), 0, (struct sockaddr *) &from, &from_len);
+        if (len < 2 || reply[0] != PPS_OP_PREFIX || reply[1] != PPS_OP_MEMBERSHIP_REPLY) {
+            continue;
+        }
+
+        //Members unknown to the server are kept alive
+        for (size_t i = 0; i < ring->nb_servers; ++i) {
+            alive[i] = 1;
+        }
+        for (size_t offset = 2; offset + GOSSIP_UPDATE_SIZE <= (size_t) len; offset += GOSSIP_UPDATE_SIZE) {
+            node_t node;
+            memset(&node, 0, sizeof(node));
+            get_addr(reply + offset, (struct sockaddr_in *) &node.addr);
+            size_t index = ring_server_index(ring, &node);
+            if (index != SIZE_MAX) {
+                alive[index] = reply[offset + 6] != MEMBER_DEAD;
+            }
+        }
+        answered = 1;
+    }
+
+    if (error == ERR_NONE) {
+        error = answered ? ring_update_membership(ring, alive) : ERR_NETWORK;
+    }
+
+    free(alive);
+    close(socket);
+
+    return error;
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+/**
+ * @file gossip.h
+ * @brief SWIM-style membership between servers: each protocol period, a server probes
+ *        one member (directly, then through other members), suspects it when it does not
+ *        answer and declares it dead after a suspicion timeout. Membership updates are
+ *        piggybacked on the protocol messages. Clients can ask any server for its view.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "error.h"
+#include "ring.h"
+
+/**
+ * @brief default configuration (see gossip_config_t)
+ */
+#define GOSSIP_DEFAULT_PERIOD_MS 1000
+#define GOSSIP_DEFAULT_ACK_TIMEOUT_MS 200
+#define GOSSIP_DEFAULT_INDIRECT_PROBES 3
+#define GOSSIP_DEFAULT_SUSPICION_PERIODS 5
+#define GOSSIP_DEFAULT_MAX_PIGGYBACK 8
+
+/**
+ * @brief an update is piggybacked GOSSIP_RETRANSMIT_MULT * log2(number of members) times
+ */
+#define GOSSIP_RETRANSMIT_MULT 3
+
+/**
+ * @brief maximum number of indirect probes a server relays at the same time
+ */
+#define GOSSIP_MAX_RELAYS 64
+
+/**
+ * @brief maximum size of a gossip message, to stay within one Ethernet frame
+ */
+#define GOSSIP_MAX_MESSAGE_SIZE 1400
+
+/**
+ * @brief size of a membership update: IPv4 address, port, state, incarnation
+ */
+#define GOSSIP_UPDATE_SIZE 11
+
+/**
+ * @brief a client asks GOSSIP_FETCH_FANOUT servers at once for the membership, a few more each
+ *        GOSSIP_FETCH_WAVE_MS without an answer, and gives up after GOSSIP_FETCH_TIMEOUT_MS in all
+ */
+#define GOSSIP_FETCH_FANOUT 3
+#define GOSSIP_FETCH_WAVE_MS 50
+#define GOSSIP_FETCH_TIMEOUT_MS 200
+
+/**
+ * @brief state of a member
+ */
+typedef enum {
+    MEMBER_ALIVE = 0,
+    MEMBER_SUSPECT,
+    MEMBER_DEAD
+} member_state_t;
+
+/**
+ * @brief failure detection time and gossip bandwidth settings
+ */
+typedef struct {
+    double period_ms;         // protocol period: one probe (and its answer) per period
+    double ack_timeout_ms;    // time before probing indirectly
+    size_t indirect_probes;   // number of members asked to probe indirectly
+    size_t suspicion_periods; // periods a member stays suspect before being declared dead
+    size_t max_piggyback;     // maximum number of membership updates per message
+} gossip_config_t;
+
+/**
+ * @brief a member, as seen by the local server
+ */
+typedef struct {
+    struct sockaddr_in addr;
+    member_state_t state;
+    uint32_t incarnation;
+    double state_since;       // time of the last state change
+    size_t retransmits;       // remaining piggybacked transmissions of its latest update
+} member_t;
+
+/**
+ * @brief an indirect probe relayed on behalf of another member
+ */
+typedef struct {
+    uint32_t seq;             // sequence number of the relayed ping, 0 if the slot is free
+    struct sockaddr_in requester;
+    uint32_t requester_seq;
+    double expires;
+} gossip_relay_t;
+
+/**
+ * @brief state of the gossip protocol on a server
+ */
+typedef struct {
+    gossip_config_t config;
+    member_t *members;        // sorted by address
+    size_t nb_members;
+    size_t self;              // index of the local server in members
+    size_t *order;            // random probing order (a permutation of the members)
+    size_t order_pos;
+    size_t target;            // member being probed, SIZE_MAX if none
+    uint32_t probe_seq;
+    double probe_start;
+    int indirect;             // whether the indirect probes of the current probe were sent
+    double next_probe;
+    uint32_t next_seq;
+    gossip_relay_t relays[GOSSIP_MAX_RELAYS];
+    // statistics
+    double stats_start;
+    size_t bytes_sent;
+    size_t messages_sent;
+    size_t nb_probes;
+    size_t nb_indirect;
+    size_t nb_suspicions;
+    size_t nb_deaths;
+} gossip_t;
+
+/**
+ * @brief set the default configuration
+ * @param config the configuration to set
+ */
+void gossip_default_config(gossip_config_t *config);
+
+/**
+ * @brief initialize the gossip state of a server; the members are the servers of the ring
+ * @param gossip the state to initialize
+ * @param config the configuration
+ * @param ring the (initialized) ring of the cluster
+ * @param self address of the local server, which must be in the ring
+ * @param now current time (get_time_ms)
+ * @return some error code
+ */
+error_code gossip_init(gossip_t *gossip, const gossip_config_t *config, const ring_t *ring,
+                       const struct sockaddr_in *self, double now);
+
+/**
+ * @brief free the gossip state
+ * @param gossip the state to free
+ */
+void gossip_end(gossip_t *gossip);
+
+/**
+ * @brief time before gossip_tick has something to do
+ * @param gossip the gossip state
+ * @param now current time
+ * @return the delay in milliseconds
+ */
+double gossip_next_timeout_ms(const gossip_t *gossip, double now);
+
+/**
+ * @brief run the timers of the protocol: start probes, send indirect probes,
+ *        suspect members and declare them dead
+ * @param gossip the gossip state
+ * @param socket the server socket
+ * @param now current time
+ */
+void gossip_tick(gossip_t *gossip, int socket, double now);
+
+/**
+ * @brief handle a message if it belongs to the gossip or membership protocol
+ * @param gossip the gossip state
+ * @param socket the server socket
+ * @param msg the message
+ * @param len length of the message
+ * @param from sender of the message
+ * @param now current time
+ * @return 1 if the message was handled, 0 if it is not a gossip message
+ */
+int gossip_handle(gossip_t *gossip, int socket, const char *msg, size_t len,
+                  const struct sockaddr_in *from, double now);
+
+/**
+ * @brief whether a member is alive in the local view
+ * @param gossip the gossip state, NULL if the server runs without it
+ * @param addr address of the member
+ * @return 0 if the member is suspect or dead, 1 otherwise (also for unknown members or without gossip)
+ */
+int gossip_is_alive(const gossip_t *gossip, const struct sockaddr_in *addr);
+
+/**
+ * @brief ask the servers of the ring for their view of the membership, a few at a time (see
+ *        GOSSIP_FETCH_FANOUT), and update the ring with the first answer. The ring is left as is
+ *        if none answers within GOSSIP_FETCH_TIMEOUT_MS.
+ * @param ring the (initialized) ring
+ * @return ERR_NONE if a server answered, some error code otherwise
+ */
+error_code gossip_fetch_membership(ring_t *ring);
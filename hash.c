@@ -0,0 +1,48 @@
+/**
+ * @file hash.c
+ * @brief Implementation of hash.h
+ *
+ */
+
+#include "hash.h"
+
+#define PRIME1 0x9e3779b97f4a7c15ULL
+#define PRIME2 0xbf58476d1ce4e5b9ULL
+#define PRIME3 0x94d049bb133111ebULL
+
+//Read 8 bytes as a little endian integer (compiled to a single load on x86)
+static uint64_t read64(const unsigned char *p) {
+    return  (uint64_t) p[0]        | ((uint64_t) p[1] << 8)  | ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24)
+         | ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40) | ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+//Final avalanche of the state
+static uint64_t finalize(uint64_t h) {
+    h ^= h >> 30;
+    h *= PRIME2;
+    h ^= h >> 27;
+    h *= PRIME3;
+    h ^= h >> 31;
+    return h;
+}
+
+uint64_t fast_hash64(const void *data, size_t len) {
+
+    const unsigned char *p = data;
+    uint64_t h = PRIME1 ^ ((uint64_t) len * PRIME3);
+
+    //8 bytes at a time
+    for (; len >= 8; len -= 8, p += 8) {
+        h ^= read64(p) * PRIME2;
+        h  = (h << 31 | h >> 33) * PRIME1;
+    }
+
+    //Remaining bytes
+    uint64_t last = 0;
+    for (size_t i = 0; i < len; ++i) {
+        last |= (uint64_t) p[i] << (8 * i);
+    }
+    h ^= last * PRIME3;
+
+    return finalize(h);
+}
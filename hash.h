@@ -0,0 +1,19 @@
+#pragma once
+
+/**
+ * @file hash.h
+ * @brief Fast non-cryptographic 64 bits hash, used for ring positions and key
+ *        placement when the ring does not use its (default, compatible) SHA-1 mode
+ */
+
+#include <stddef.h> // for size_t
+#include <stdint.h> // for uint64_t
+
+/**
+ * @brief 64 bits hash of a binary string. The result does not depend on the endianness
+ *        nor on the alignment of the data, so that every client and server agree on it.
+ * @param data bytes to hash
+ * @param len number of bytes
+ * @return the hash
+ */
+uint64_t fast_hash64(const void *data, size_t len);
@@ -6,6 +6,8 @@
 
 #include "hashtable.h"
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <stdio.h>
 #include "util.h"
 
@@ -25,6 +27,204 @@ struct bucket_t {
 //Create a new node given a key and a value
 node_t *create_node(pps_key_t key, pps_value_t value);
 
+/*
+ * Ordered index: a crit-bit tree (D. J. Bernstein) whose leaves are the nodes of the buckets.
+ * An inner node splits its keys on one bit, the first one where they differ: the keys with this
+ * bit at 0 are all before the ones with it at 1. Pointers to inner nodes are tagged with their
+ * lowest bit, the leaves being the nodes of the buckets.
+ */
+typedef struct index_node index_node_t;
+
+struct index_node {
+    void    *child[2];
+    size_t  byte;       // the bit is in this byte of the keys
+    uint8_t otherbits;  // every bit but this one
+};
+
+struct Htable_index_t {
+    void *root;         // NULL if the table is empty
+};
+
+static int is_inner(const void *p) {
+    return ((uintptr_t) p & 1) != 0;
+}
+
+static index_node_t *inner(const void *p) {
+    return (index_node_t *) ((uintptr_t) p - 1);
+}
+
+static pps_key_t leaf_key(const void *p) {
+    return ((const node_t *) p)->elem.key;
+}
+
+//0 or 1: the side of the key at this inner node
+static int direction(const index_node_t *q, pps_key_t key, size_t key_len) {
+    const uint8_t c = q->byte < key_len ? (uint8_t) key[q->byte] : 0;
+    return (1 + (q->otherbits | c)) >> 8;
+}
+
+static const void *leftmost(const void *p) {
+    while (is_inner(p)) {
+        p = inner(p)->child[0];
+    }
+    return p;
+}
+
+//The leaf the key would be found at
+static const void *best_leaf(const Htable_index_t *index, pps_key_t key, size_t key_len) {
+    const void *p = index->root;
+    while (is_inner(p)) {
+        const index_node_t *q = inner(p);
+        p = q->child[direction(q, key, key_len)];
+    }
+    return p;
+}
+
+static error_code index_insert(Htable_index_t *index, node_t *leaf) {
+
+    pps_key_t key = leaf->elem.key;
+    const size_t key_len = strlen(key);
+    if (index->root == NULL) {
+        index->root = leaf;
+        return ERR_NONE;
+    }
+
+    //First bit where the key differs from its closest key in the tree
+    const uint8_t *best = (const uint8_t *) leaf_key(best_leaf(index, key, key_len));
+    size_t  new_byte = 0;
+    uint32_t new_otherbits = 0;
+    while (new_byte <= key_len) {
+        new_otherbits = best[new_byte] ^ (uint8_t) key[new_byte];
+        if (new_otherbits != 0) {
+            break;
+        }
+        if (best[new_byte] == '\0') {
+            return ERR_NONE; //already in
+        }
+        ++new_byte;
+    }
+    while (new_otherbits & (new_otherbits - 1)) {
+        new_otherbits &= new_otherbits - 1;
+    }
+    new_otherbits ^= 255;
+    const int new_direction = (1 + (new_otherbits | best[new_byte])) >> 8;
+
+    index_node_t *node = malloc(sizeof(index_node_t));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(node, ERR_NOMEM);
+    node->byte      = new_byte;
+    node->otherbits = (uint8_t) new_otherbits;
+    node->child[1 - new_direction] = leaf;
+
+    //The inner nodes are ordered by the position of their bit from the root
+    void **where = &index->root;
+    while (is_inner(*where)) {
+        index_node_t *q = inner(*where);
+        if (q->byte > new_byte || (q->byte == new_byte && q->otherbits > new_otherbits)) {
+            break;
+        }
+        where = &q->child[direction(q, key, key_len)];
+    }
+    node->child[new_direction] = *where;
+    *where = (void *) ((uintptr_t) node + 1);
+
+    return ERR_NONE;
+}
+
+static void index_remove(Htable_index_t *index, pps_key_t key) {
+
+    const size_t key_len = strlen(key);
+    void **where  = &index->root;
+    void **parent = NULL;
+    index_node_t *q = NULL;
+    int d = 0;
+    if (*where == NULL) {
+        return;
+    }
+    while (is_inner(*where)) {
+        parent = where;
+        q = inner(*where);
+        d = direction(q, key, key_len);
+        where = &q->child[d];
+    }
+    if (strcmp(leaf_key(*where), key) != 0) {
+        return;
+    }
+    if (parent == NULL) {
+        index->root = NULL;
+        return;
+    }
+    *parent = q->child[1 - d];
+    free(q);
+}
+
+//First leaf whose key is after a key (which may not be in the tree), NULL if there is none
+static const void *index_successor(const Htable_index_t *index, pps_key_t key) {
+
+    if (index->root == NULL) {
+        return NULL;
+    }
+    const size_t key_len = strlen(key);
+    const uint8_t *best = (const uint8_t *) leaf_key(best_leaf(index, key, key_len));
+
+    //Where the key would be inserted: its bit splits the subtree under it from the key
+    size_t   new_byte = 0;
+    uint32_t new_otherbits = 0;
+    int      in_tree = 0;
+    while (1) {
+        new_otherbits = best[new_byte] ^ (uint8_t) key[new_byte];
+        if (new_otherbits != 0) {
+            break;
+        }
+        if (best[new_byte] == '\0') {
+            in_tree = 1;
+            break;
+        }
+        ++new_byte;
+    }
+    while (new_otherbits & (new_otherbits - 1)) {
+        new_otherbits &= new_otherbits - 1;
+    }
+    new_otherbits ^= 255;
+
+    const void *p = index->root;
+    const index_node_t *last_left = NULL;
+    while (is_inner(p)) {
+        const index_node_t *q = inner(p);
+        if (!in_tree && (q->byte > new_byte || (q->byte == new_byte && q->otherbits > new_otherbits))) {
+            break;
+        }
+        const int d = direction(q, key, key_len);
+        if (d == 0) {
+            last_left = q;
+        }
+        p = q->child[d];
+    }
+
+    //Before the whole subtree: its first key, after it: the first key of the next one
+    if (!in_tree && ((1 + (new_otherbits | (uint8_t) key[new_byte])) >> 8) == 0) {
+        return leftmost(p);
+    }
+    return last_left != NULL ? leftmost(last_left->child[1]) : NULL;
+}
+
+//Free the inner nodes without recursion: rotate the left inner children up until there is none
+static void index_free(Htable_index_t *index) {
+    void *p = index->root;
+    while (is_inner(p)) {
+        index_node_t *q = inner(p);
+        if (is_inner(q->child[0])) {
+            index_node_t *r = inner(q->child[0]);
+            q->child[0] = r->child[1];
+            r->child[1] = p;
+            p = (void *) ((uintptr_t) r + 1);
+        } else {
+            p = q->child[1];
+            free(q);
+        }
+    }
+    free(index);
+}
+
 //Delete the current node and all its successors in the list
 void delete_node(node_t *current);
 
@@ -42,6 +242,17 @@ Htable_t construct_Htable(size_t size) {
     return table;
 }
 
+Htable_t construct_ordered_Htable(size_t size) {
+    Htable_t table = construct_Htable(size);
+    if (table != NULL) {
+        table->index = calloc(1, sizeof(Htable_index_t));
+        if (table->index == NULL) {
+            delete_Htable_and_content(&table);
+        }
+    }
+    return table;
+}
+
 void kv_pair_free(kv_pair_t *kv) {
     //Free the memory of the pair key/value
     free_const_ptr(kv->key);
@@ -59,6 +270,11 @@ void delete_Htable_and_content(Htable_t *table) {
         delete_node((*table)->elements[i].head);
     }
 
+    if ((*table)->index != NULL) {
+        index_free((*table)->index);
+        (*table)->index = NULL;
+    }
+
     free((*table)->elements);
     (*table)->elements = NULL;
 
@@ -70,7 +286,7 @@ void delete_Htable_and_content(Htable_t *table) {
 }
 
 node_t *create_node(pps_key_t key, pps_value_t value) {
-    node_t *node = calloc(1, sizeof(node));
+    node_t *node = calloc(1, sizeof(node_t));
 
     if (node != NULL) {
         node->elem.key = strdup(key);
@@ -96,10 +312,26 @@ void delete_node(node_t *current) {
         //Delete the nodes recursively
         delete_node(current->next);
         current->next = NULL;
+        free(current);
     }
 }
 
 
+//Index the node just put at the head of a bucket, or take it back if the index cannot grow
+static error_code index_added(Htable_t table, bucket_t *bucket) {
+    if (table->index == NULL) {
+        return ERR_NONE;
+    }
+    node_t *node = bucket->head;
+    error_code error = index_insert(table->index, node);
+    if (error != ERR_NONE) {
+        bucket->head = node->next;
+        node->next   = NULL;
+        delete_node(node);
+    }
+    return error;
+}
+
 error_code add_Htable_value(Htable_t table, pps_key_t key, pps_value_t value) {
 
     M_REQUIRE_NON_NULL(table);
@@ -118,12 +350,12 @@ error_code add_Htable_value(Htable_t table, pps_key_t key, pps_value_t value) {
         M_REQUIRE_NON_NULL_CUSTOM_ERR(node, ERR_NOMEM);
 
         bucket->head = node;
-        return ERR_NONE;
+        return index_added(table, bucket);
     }
 
     //If key already present, just update its value
     for (node_t *current = bucket->head; current != NULL; current = current->next) {
-        if (strncmp(current->elem.key, key, strlen(key)) == 0) {
+        if (strcmp(current->elem.key, key) == 0) {
 
             pps_value_t newValue = strdup(value);
             M_REQUIRE_NON_NULL_CUSTOM_ERR(newValue, ERR_NOMEM);
@@ -142,7 +374,7 @@ error_code add_Htable_value(Htable_t table, pps_key_t key, pps_value_t value) {
     node->next   = bucket->head;
     bucket->head = node;
 
-    return ERR_NONE;
+    return index_added(table, bucket);
 }
 
 
@@ -156,7 +388,7 @@ pps_value_t get_Htable_value(Htable_t table, pps_key_t key) {
 
     //Try to find the key in the table
     for (node_t *current = table->elements[index].head; current != NULL; current = current->next) {
-        if (strncmp(current->elem.key, key, strlen(key)) == 0) {
+        if (strcmp(current->elem.key, key) == 0) {
             return strdup(current->elem.value);
         }
     }
@@ -269,6 +501,73 @@ kv_list_t *get_Htable_content(Htable_t table) {
 
 }
 
+error_code visit_Htable_bucket(Htable_t table, size_t bucket, void (*visit)(const kv_pair_t *pair, void *arg), void *arg) {
+
+    M_REQUIRE_NON_NULL(table);
+    M_REQUIRE_NON_NULL(table->elements);
+    M_REQUIRE_NON_NULL(visit);
+    M_REQUIRE(bucket < table->size, ERR_BAD_PARAMETER, "bucket %zu out of the table", bucket);
+
+    for (node_t *current = table->elements[bucket].head; current != NULL; current = current->next) {
+        visit(&current->elem, arg);
+    }
+
+    return ERR_NONE;
+}
+
+error_code visit_Htable_from(Htable_t table, pps_key_t *after,
+                             int (*visit)(const kv_pair_t *pair, void *arg), void *arg) {
+
+    M_REQUIRE_NON_NULL(table);
+    M_REQUIRE_NON_NULL(after);
+    M_REQUIRE_NON_NULL(*after);
+    M_REQUIRE_NON_NULL(visit);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(table->index, ERR_BAD_PARAMETER);
+
+    //Each pair is the one after the last key visited, which other pairs coming or going do not change
+    for (const void *p = index_successor(table->index, *after); p != NULL;
+         p = index_successor(table->index, leaf_key(p))) {
+        const kv_pair_t *pair = &((const node_t *) p)->elem;
+        if (!visit(pair, arg)) {
+            return ERR_NONE;
+        }
+        *after = pair->key;
+    }
+    *after = NULL;
+
+    return ERR_NONE;
+}
+
+error_code range_Htable(Htable_t table, pps_key_t prefix, pps_key_t after, size_t limit,
+                        void (*visit)(const kv_pair_t *pair, void *arg), void *arg) {
+
+    M_REQUIRE_NON_NULL(table);
+    M_REQUIRE_NON_NULL(prefix);
+    M_REQUIRE_NON_NULL(visit);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(table->index, ERR_BAD_PARAMETER);
+
+    const size_t prefix_len = strlen(prefix);
+
+    //The first key with the prefix is the prefix itself or the one after it
+    const void *p = NULL;
+    if (after != NULL && strcmp(after, prefix) >= 0) {
+        p = index_successor(table->index, after);
+    } else if (table->index->root != NULL) {
+        p = best_leaf(table->index, prefix, prefix_len);
+        if (strcmp(leaf_key(p), prefix) != 0) {
+            p = index_successor(table->index, prefix);
+        }
+    }
+
+    //The keys with the prefix follow each other
+    for (size_t n = 0; n < limit && p != NULL && strncmp(leaf_key(p), prefix, prefix_len) == 0; ++n) {
+        visit(&((const node_t *) p)->elem, arg);
+        p = index_successor(table->index, leaf_key(p));
+    }
+
+    return ERR_NONE;
+}
+
 error_code del_Htable_key(Htable_t table, pps_key_t key) {
 
     M_REQUIRE_NON_NULL(table->elements);
@@ -281,8 +580,15 @@ error_code del_Htable_key(Htable_t table, pps_key_t key) {
     node_t *last = NULL;
     for (node_t *current = table->elements[index].head; current != NULL;
          last = current, current = current->next) {
-        if (strncmp(current->elem.key, key, strlen(key)) == 0) {
-            last->next    = current->next;
+        if (strcmp(current->elem.key, key) == 0) {
+            if (last == NULL) {
+                table->elements[index].head = current->next;
+            } else {
+                last->next = current->next;
+            }
+            if (table->index != NULL) {
+                index_remove(table->index, key);
+            }
             current->next = NULL;
             delete_node(current);
             return ERR_NONE;
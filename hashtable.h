@@ -40,13 +40,20 @@
 
 
 /*
- * Definition of local hash-table type
+ * Definition of local hash-table type: the default number of buckets, which a table keeps
+ * (servers take another one with pps-launch-server -b)
  */
 #define HTABLE_SIZE 256
 
+/*
+ * Definition of the (optional) ordered index of the keys of a hash-table
+ */
+ typedef struct Htable_index_t Htable_index_t;
+
 struct Htable_t{
     bucket_t* elements;
     size_t size;
+    Htable_index_t* index; // NULL if the table has no ordered index
 };
 
 typedef struct Htable_t* Htable_t;
@@ -83,6 +90,15 @@ error_code get_kv_pair(kv_list_t* list, Htable_t table);
  */
 Htable_t construct_Htable(size_t size);
 
+/**
+ * @brief construct a hash-table of the given size that also keeps its keys in order, for
+ *        range_Htable: a crit-bit tree over the entries of the table, so that a write costs
+ *        O(key length) more and the keys and values are not stored twice
+ * @param size number of buckets in the new hash-table
+ * @return the newly allocated hash-table
+ */
+Htable_t construct_ordered_Htable(size_t size);
+
 /**
  * @brief delete the given hash-table
  *    Note: does NOTHING until week 07.
@@ -125,6 +141,48 @@ size_t hash_function(pps_key_t key, size_t table_size);
  */
 kv_list_t *get_Htable_content(Htable_t table);
 
+/**
+ * @brief call a function on every pair of a bucket, without copying them
+ * @param table the table to read from
+ * @param bucket index of the bucket, below table->size
+ * @param visit function to call on each pair (must not modify the table)
+ * @param arg passed to visit
+ * @return 0 on success; error code on errror (see error.h)
+ */
+error_code visit_Htable_bucket(Htable_t table, size_t bucket, void (*visit)(const kv_pair_t *pair, void *arg), void *arg);
+
+/**
+ * @brief call a function on the pairs of the table after a key, in the order of the keys (bytewise,
+ *        as strcmp), until it declines one: a walk over the whole table without copying it, which
+ *        resumes from the last key visited, so that it neither misses nor repeats the pairs present
+ *        all along if the table changes between two walks. Each pair found costs O(key length).
+ * @param table the table to read from, constructed by construct_ordered_Htable
+ * @param after (IN/OUT) only the pairs with a greater key are visited ("" for all of them); then
+ *        the last key visited (pointing in the table, valid until it changes), the initial one if
+ *        none was, or NULL once every pair after it is visited
+ * @param visit function to call on each pair (must not modify the table), returning 0 to decline
+ *        it and stop there
+ * @param arg passed to visit
+ * @return 0 on success; error code on errror (see error.h), ERR_BAD_PARAMETER if the table has no index
+ */
+error_code visit_Htable_from(Htable_t table, pps_key_t *after,
+                             int (*visit)(const kv_pair_t *pair, void *arg), void *arg);
+
+/**
+ * @brief call a function on the pairs whose key starts with a prefix, in the order of the keys
+ *        (bytewise, as strcmp)
+ * @param table the table to read from, constructed by construct_ordered_Htable
+ * @param prefix prefix of the keys ("" for all of them)
+ * @param after only the keys after this one, to go on from the last key of a previous call
+ *        (NULL to start with the first key with the prefix)
+ * @param limit maximum number of pairs to visit
+ * @param visit function to call on each pair (must not modify the table)
+ * @param arg passed to visit
+ * @return 0 on success; error code on errror (see error.h), ERR_BAD_PARAMETER if the table has no index
+ */
+error_code range_Htable(Htable_t table, pps_key_t prefix, pps_key_t after, size_t limit,
+                        void (*visit)(const kv_pair_t *pair, void *arg), void *arg);
+
 /**
  * @brief delete a key:value pair from the hash-table
  *    Note: does NOTHING until week 10.
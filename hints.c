@@ -0,0 +1,359 @@
+/**
+ * @file hints.c
+ * @brief Implementation of hints.h
+ *
+ * Hint messages: PPS_OP_PREFIX, opcode, then
+ *  - HINT (from a client): the replica (IPv4 4 bytes, port 2 bytes) and key\0value,
+ *    acknowledged by an empty datagram like a put;
+ *  - HINT_REPLAY: sequence number (4 bytes), then the age of each hint in milliseconds (4 bytes)
+ *    followed by its key\0value\0, acknowledged by HINT_REPLAY_ACK with the same sequence number.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "hints.h"
+#include "config.h"
+#include "util.h" // for free_const_ptr
+
+#define TARGET_SIZE 6
+#define SEQ_SIZE 4
+#define AGE_SIZE 4
+
+static void put_u32(unsigned char *out, uint32_t value) {
+    out[0] = (unsigned char) (value >> 24);
+    out[1] = (unsigned char) (value >> 16);
+    out[2] = (unsigned char) (value >> 8);
+    out[3] = (unsigned char) value;
+}
+
+static uint32_t get_u32(const unsigned char *in) {
+    return (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16 | (uint32_t) in[2] << 8 | (uint32_t) in[3];
+}
+
+static int same_addr(const struct sockaddr_in *first, const struct sockaddr_in *second) {
+    return first->sin_addr.s_addr == second->sin_addr.s_addr && first->sin_port == second->sin_port;
+}
+
+error_code hints_init(hint_table_t *hints, const struct sockaddr_in *self) {
+
+    M_REQUIRE_NON_NULL(hints);
+    M_REQUIRE_NON_NULL(self);
+
+    memset(hints, 0, sizeof(*hints));
+    hints->self  = *self;
+    hints->hints = calloc(HINTS_MAX, sizeof(hint_t));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(hints->hints, ERR_NOMEM);
+
+    //The table starts empty: every write since is recorded
+    hints->writes = construct_Htable(HINTS_MAX_WRITES / 4);
+    if (hints->writes == NULL) {
+        free(hints->hints);
+        hints->hints = NULL;
+        return ERR_NOMEM;
+    }
+
+    return ERR_NONE;
+}
+
+static void remove_hint(hint_table_t *hints, size_t index) {
+    hint_t *hint = &hints->hints[index];
+    hints->bytes -= strlen(hint->key) + strlen(hint->value);
+    free(hint->key);
+    free(hint->value);
+    hints->hints[index] = hints->hints[--hints->size];
+}
+
+void hints_end(hint_table_t *hints) {
+    if (hints != NULL && hints->hints != NULL) {
+        while (hints->size > 0) {
+            remove_hint(hints, hints->size - 1);
+        }
+        free(hints->hints);
+        hints->hints = NULL;
+        delete_Htable_and_content(&hints->writes);
+    }
+}
+
+void hints_written(hint_table_t *hints, pps_key_t key, double written) {
+
+    if (hints == NULL || hints->writes == NULL || key == NULL) {
+        return;
+    }
+
+    pps_value_t previous = get_Htable_value(hints->writes, key);
+    const int   known    = previous != NULL;
+    free_const_ptr(previous);
+    if (!known && hints->nb_writes >= HINTS_MAX_WRITES) {
+        //Start over: the writes forgotten are older than the last one
+        delete_Htable_and_content(&hints->writes);
+        hints->writes       = construct_Htable(HINTS_MAX_WRITES / 4);
+        hints->nb_writes    = 0;
+        hints->writes_since = hints->last_write;
+        if (hints->writes == NULL) {
+            return;
+        }
+    }
+
+    char time[32];
+    snprintf(time, sizeof(time), "%.0f", written);
+    if (add_Htable_value(hints->writes, key, time) == ERR_NONE) {
+        hints->nb_writes += !known;
+        hints->last_write = written > hints->last_write ? written : hints->last_write;
+    }
+}
+
+//Whether the local server holds a newer write of a key than a hint: one recorded after the hint was
+//created, or any value if the record does not go back that far
+static int superseded(const hint_table_t *hints, Htable_t table, pps_key_t key, double created) {
+    pps_value_t written = hints->writes != NULL ? get_Htable_value(hints->writes, key) : NULL;
+    if (written != NULL) {
+        const double time = strtod(written, NULL);
+        free_const_ptr(written);
+        return time > created;
+    }
+    if (created >= hints->writes_since) {
+        return 0;
+    }
+    pps_value_t value = get_Htable_value(table, key);
+    free_const_ptr(value);
+    return value != NULL;
+}
+
+/**
+ * @brief keep a hint; a newer hint for the same replica and key replaces the older one
+ * @return ERR_NONE, or ERR_NOMEM if the table is full
+ */
+static error_code add_hint(hint_table_t *hints, const struct sockaddr_in *target, const char *key,
+                           const char *value, size_t value_len, double now) {
+
+    size_t index = hints->size;
+    for (size_t i = 0; i < hints->size; ++i) {
+        if (same_addr(&hints->hints[i].target, target) && strcmp(hints->hints[i].key, key) == 0) {
+            index = i;
+            break;
+        }
+    }
+
+    const size_t key_len  = strlen(key);
+    const size_t old_size = index < hints->size ? key_len + strlen(hints->hints[index].value) : 0;
+    if (hints->bytes - old_size + key_len + value_len > HINTS_MAX_BYTES
+        || (index == hints->size && hints->size >= HINTS_MAX)) {
+        return ERR_NOMEM;
+    }
+
+    char *copy = strndup(value, value_len);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(copy, ERR_NOMEM);
+
+    hint_t *hint = &hints->hints[index];
+    if (index == hints->size) {
+        hint->key = strdup(key);
+        if (hint->key == NULL) {
+            free(copy);
+            return ERR_NOMEM;
+        }
+        hint->target = *target;
+        hints->size += 1;
+    } else {
+        free(hint->value);
+    }
+    hint->value   = copy;
+    hint->created = now;
+    hint->batch   = 0;
+    hints->bytes  = hints->bytes - old_size + key_len + value_len;
+
+    return ERR_NONE;
+}
+
+//Store a hint from a client; it is acknowledged like a put, only if kept
+static void serve_hint(hint_table_t *hints, hint_store_t store, void *arg, int socket, const char *msg, size_t len,
+                       const struct sockaddr_in *from, double now) {
+
+    if (len < 2 + TARGET_SIZE + 2) {
+        return;
+    }
+
+    struct sockaddr_in target;
+    memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    memcpy(&target.sin_addr.s_addr, msg + 2, 4);
+    memcpy(&target.sin_port, msg + 6, 2);
+
+    const char  *key     = msg + 2 + TARGET_SIZE;
+    const size_t key_len = strnlen(key, len - 2 - TARGET_SIZE);
+    if (key_len == 0 || 2 + TARGET_SIZE + key_len >= len) {
+        return;
+    }
+    const char  *value     = key + key_len + 1;
+    const size_t value_len = len - 2 - TARGET_SIZE - key_len - 1;
+
+    error_code error;
+    if (same_addr(&target, &hints->self)) {
+        //The hint is for us after all
+        char *copy = strndup(value, value_len);
+        error = copy == NULL ? ERR_NOMEM : store(arg, key, copy);
+        free(copy);
+    } else {
+        error = add_hint(hints, &target, key, value, value_len, now);
+    }
+
+    if (error == ERR_NONE) {
+        sendto(socket, NULL, 0, 0, (const struct sockaddr *) from, sizeof(*from));
+    }
+}
+
+//Write the replayed hints (they are writes the local server missed), unless it holds newer writes,
+//and acknowledge them
+static void serve_replay(hint_table_t *hints, Htable_t table, hint_store_t store, void *arg, int socket,
+                         const char *msg, size_t len, const struct sockaddr_in *from, double now) {
+
+    if (len < 2 + SEQ_SIZE) {
+        return;
+    }
+
+    size_t offset = 2 + SEQ_SIZE;
+    while (offset + AGE_SIZE < len) {
+        const double created = now - get_u32((const unsigned char *) msg + offset);
+        offset += AGE_SIZE;
+
+        const char  *key     = msg + offset;
+        const size_t key_len = strnlen(key, len - offset);
+        if (offset + key_len + 1 >= len) {
+            break;
+        }
+        const char  *value     = key + key_len + 1;
+        const size_t value_len = strnlen(value, len - offset - key_len - 1);
+        if (offset + key_len + 1 + value_len >= len) {
+            break;
+        }
+        if (!superseded(hints, table, key, created) && store(arg, key, value) == ERR_NONE) {
+            //The write dates from the hint, not from its replay
+            hints_written(hints, key, created);
+        }
+        offset += key_len + value_len + 2;
+    }
+
+    unsigned char ack[2 + SEQ_SIZE] = {PPS_OP_PREFIX, PPS_OP_HINT_REPLAY_ACK};
+    memcpy(ack + 2, msg + 2, SEQ_SIZE);
+    sendto(socket, ack, sizeof(ack), 0, (const struct sockaddr *) from, sizeof(*from));
+}
+
+int hints_handle(hint_table_t *hints, Htable_t table, hint_store_t store, void *arg, int socket, const char *msg,
+                 size_t len, const struct sockaddr_in *from, double now) {
+
+    if (hints == NULL || store == NULL || msg == NULL || from == NULL || len < 2 || msg[0] != PPS_OP_PREFIX) {
+        return 0;
+    }
+
+    switch ((unsigned char) msg[1]) {
+    case PPS_OP_HINT:
+        serve_hint(hints, store, arg, socket, msg, len, from, now);
+        return 1;
+
+    case PPS_OP_HINT_REPLAY:
+        serve_replay(hints, table, store, arg, socket, msg, len, from, now);
+        return 1;
+
+    case PPS_OP_HINT_REPLAY_ACK:
+        if (len >= 2 + SEQ_SIZE && hints->inflight != 0
+            && get_u32((const unsigned char *) msg + 2) == hints->inflight) {
+            for (size_t i = hints->size; i > 0; --i) {
+                if (hints->hints[i - 1].batch == hints->inflight) {
+                    remove_hint(hints, i - 1);
+                }
+            }
+            //Go on with the next batch right away
+            hints->inflight    = 0;
+            hints->next_replay = now;
+        }
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+//Send the hints of one replica that is alive (as many as fit in a batch)
+static void replay_batch(hint_table_t *hints, const gossip_t *gossip, int socket, double now) {
+
+    //Start from a different hint each time, so that a replica that does not answer does not block the others
+    const hint_t *first = NULL;
+    for (size_t i = 0; i < hints->size && first == NULL; ++i) {
+        const hint_t *hint = &hints->hints[(i + hints->next_seq) % hints->size];
+        if (gossip_is_alive(gossip, &hint->target)) {
+            first = hint;
+        }
+    }
+    if (first == NULL) {
+        hints->next_replay = now + HINTS_REPLAY_MS;
+        return;
+    }
+    const struct sockaddr_in target = first->target;
+
+    hints->next_seq = hints->next_seq + 1 == 0 ? 1 : hints->next_seq + 1;
+    const uint32_t seq = hints->next_seq;
+
+    unsigned char msg[MAX_MSG_SIZE];
+    msg[0] = PPS_OP_PREFIX;
+    msg[1] = PPS_OP_HINT_REPLAY;
+    put_u32(msg + 2, seq);
+    size_t len = 2 + SEQ_SIZE;
+
+    for (size_t i = 0; i < hints->size && len < HINTS_BATCH_SIZE; ++i) {
+        hint_t *hint = &hints->hints[i];
+        if (!same_addr(&hint->target, &target)) {
+            continue;
+        }
+        const size_t key_len   = strlen(hint->key) + 1;
+        const size_t value_len = strlen(hint->value) + 1;
+        if (len + AGE_SIZE + key_len + value_len > MAX_MSG_SIZE) {
+            break;
+        }
+        put_u32(msg + len, (uint32_t) (now - hint->created));
+        memcpy(msg + len + AGE_SIZE, hint->key, key_len);
+        memcpy(msg + len + AGE_SIZE + key_len, hint->value, value_len);
+        len += AGE_SIZE + key_len + value_len;
+        hint->batch = seq;
+    }
+
+    sendto(socket, msg, len, 0, (const struct sockaddr *) &target, sizeof(target));
+    hints->inflight      = seq;
+    hints->inflight_sent = now;
+}
+
+void hints_tick(hint_table_t *hints, const gossip_t *gossip, int socket, double now) {
+
+    if (hints == NULL || hints->hints == NULL) {
+        return;
+    }
+
+    if (hints->inflight != 0) {
+        if (now - hints->inflight_sent < HINTS_RETRY_MS) {
+            return;
+        }
+        //Lost batch, or the replica is still down: try again later
+        for (size_t i = 0; i < hints->size; ++i) {
+            if (hints->hints[i].batch == hints->inflight) {
+                hints->hints[i].batch = 0;
+            }
+        }
+        hints->inflight    = 0;
+        hints->next_replay = now + HINTS_REPLAY_MS;
+    }
+
+    if (now < hints->next_replay) {
+        return;
+    }
+
+    for (size_t i = hints->size; i > 0; --i) {
+        if (now - hints->hints[i - 1].created > HINTS_TTL_MS) {
+            remove_hint(hints, i - 1);
+        }
+    }
+
+    replay_batch(hints, gossip, socket, now);
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+/**
+ * @file hints.h
+ * @brief Hinted handoff: a server accepts writes meant for an unreachable replica as hints,
+ *        keeps them in a bounded table and replays them in batches once the replica is alive again.
+ *        The replica writes a replayed hint like a put, unless it holds a newer write of the key.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "error.h"
+#include "hashtable.h"
+#include "gossip.h"
+
+/**
+ * @brief bounds of the hint table: new hints are refused when it is full
+ */
+#define HINTS_MAX 4096
+#define HINTS_MAX_BYTES (4 << 20)
+
+/**
+ * @brief hints older than this are dropped
+ */
+#define HINTS_TTL_MS (10 * 60 * 1000)
+
+/**
+ * @brief time between replay attempts while the replicas are not reachable
+ */
+#define HINTS_REPLAY_MS 1000
+
+/**
+ * @brief maximum size of a replay batch, and time before it is considered lost
+ */
+#define HINTS_BATCH_SIZE 8192
+#define HINTS_RETRY_MS 500
+
+/**
+ * @brief bound of the record of the recent local writes (see hint_table_t): it starts over when full
+ */
+#define HINTS_MAX_WRITES 16384
+
+/**
+ * @brief how the server writes a value, the same way for the puts and for the hints it gets
+ * @param arg the argument given to hints_handle
+ * @param key the key
+ * @param value the value
+ * @return some error code
+ */
+typedef error_code (*hint_store_t)(void *arg, pps_key_t key, pps_value_t value);
+
+/**
+ * @brief a write for another server
+ */
+typedef struct {
+    struct sockaddr_in target;
+    char *key;
+    char *value;
+    double created;
+    uint32_t batch;           // sequence number of the batch replaying it, 0 if none
+} hint_t;
+
+/**
+ * @brief the hints kept by a server
+ */
+typedef struct {
+    struct sockaddr_in self;
+    hint_t *hints;
+    size_t size;
+    size_t bytes;             // total size of the keys and values
+    uint32_t next_seq;
+    uint32_t inflight;        // sequence number of the batch being replayed, 0 if none
+    double inflight_sent;
+    double next_replay;
+    Htable_t writes;          // time of the last local write of the keys, to skip the hints they supersede
+    size_t nb_writes;
+    double writes_since;      // the writes before are not in writes any more
+    double last_write;
+} hint_table_t;
+
+/**
+ * @brief initialize an empty hint table
+ * @param hints the table to initialize
+ * @param self address of the local server
+ * @return some error code
+ */
+error_code hints_init(hint_table_t *hints, const struct sockaddr_in *self);
+
+/**
+ * @brief free the hint table
+ * @param hints the table to free
+ */
+void hints_end(hint_table_t *hints);
+
+/**
+ * @brief record a local write, to skip the hints created before it
+ * @param hints the hint table
+ * @param key the key written
+ * @param written time of the write (get_time_ms)
+ */
+void hints_written(hint_table_t *hints, pps_key_t key, double written);
+
+/**
+ * @brief handle a message if it belongs to the hinted handoff: hints from clients (acknowledged
+ *        like a put, unless the table is full), replayed hints (written unless the local server
+ *        holds a newer write of the key, see hints_written) and their acks
+ * @param hints the hint table
+ * @param table the local content
+ * @param store how to write a hint for the local server
+ * @param arg passed to store
+ * @param socket the server socket
+ * @param msg the message
+ * @param len length of the message
+ * @param from sender of the message
+ * @param now current time (get_time_ms)
+ * @return 1 if the message was handled, 0 otherwise
+ */
+int hints_handle(hint_table_t *hints, Htable_t table, hint_store_t store, void *arg, int socket, const char *msg,
+                 size_t len, const struct sockaddr_in *from, double now);
+
+/**
+ * @brief drop expired hints and replay a batch of hints to a replica that is alive again
+ * @param hints the hint table
+ * @param gossip the membership view of the server, NULL to try every replica
+ * @param socket the server socket
+ * @param now current time
+ */
+void hints_tick(hint_table_t *hints, const gossip_t *gossip, int socket, double now);
@@ -0,0 +1,87 @@
+/**
+ * @file histogram.c
+ * @brief Implementation of histogram.h
+ *
+ */
+
+#include <string.h>
+
+#include "histogram.h"
+
+//A value v >= 2 * HISTOGRAM_SUB_BUCKETS with its highest bit at m keeps its HISTOGRAM_SUB_BITS + 1
+//highest bits: v >> (m - HISTOGRAM_SUB_BITS) is in [HISTOGRAM_SUB_BUCKETS, 2 * HISTOGRAM_SUB_BUCKETS)
+static size_t bucket_of(uint64_t value) {
+    if (value < 2 * HISTOGRAM_SUB_BUCKETS) {
+        return (size_t) value;
+    }
+    const int highest = 63 - __builtin_clzll(value);
+    const int shift   = highest - HISTOGRAM_SUB_BITS;
+    return (size_t) (2 * HISTOGRAM_SUB_BUCKETS + (shift - 1) * HISTOGRAM_SUB_BUCKETS
+                     + (int) ((value >> shift) - HISTOGRAM_SUB_BUCKETS));
+}
+
+//Largest value counted in a bucket
+static uint64_t bucket_top(size_t bucket) {
+    if (bucket < 2 * HISTOGRAM_SUB_BUCKETS) {
+        return bucket;
+    }
+    const size_t   above = bucket - 2 * HISTOGRAM_SUB_BUCKETS;
+    const int      shift = (int) (above / HISTOGRAM_SUB_BUCKETS) + 1;
+    const uint64_t top   = HISTOGRAM_SUB_BUCKETS + above % HISTOGRAM_SUB_BUCKETS;
+    return ((top + 1) << shift) - 1;
+}
+
+void histogram_init(histogram_t *histogram) {
+    if (histogram != NULL) {
+        memset(histogram, 0, sizeof(*histogram));
+        histogram->min = UINT64_MAX;
+    }
+}
+
+void histogram_record(histogram_t *histogram, uint64_t value) {
+    if (histogram == NULL) {
+        return;
+    }
+    histogram->counts[bucket_of(value)] += 1;
+    histogram->total += 1;
+    histogram->sum   += (double) value;
+    histogram->min    = value < histogram->min ? value : histogram->min;
+    histogram->max    = value > histogram->max ? value : histogram->max;
+}
+
+void histogram_merge(histogram_t *into, const histogram_t *from) {
+    if (into == NULL || from == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        into->counts[i] += from->counts[i];
+    }
+    into->total += from->total;
+    into->sum   += from->sum;
+    into->min    = from->min < into->min ? from->min : into->min;
+    into->max    = from->max > into->max ? from->max : into->max;
+}
+
+uint64_t histogram_percentile(const histogram_t *histogram, double percentile) {
+
+    if (histogram == NULL || histogram->total == 0) {
+        return 0;
+    }
+    //Rank of the value, from 1
+    uint64_t rank = (uint64_t) (percentile / 100 * (double) histogram->total + 0.5);
+    rank = rank < 1 ? 1 : rank > histogram->total ? histogram->total : rank;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            const uint64_t top = bucket_top(i);
+            return top < histogram->max ? top : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+double histogram_mean(const histogram_t *histogram) {
+    return histogram == NULL || histogram->total == 0 ? 0 : histogram->sum / (double) histogram->total;
+}
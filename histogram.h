@@ -0,0 +1,57 @@
+#pragma once
+
+/**
+ * @file histogram.h
+ * @brief Latency histograms with a bounded relative error, as HdrHistogram: the values below
+ *        2 * HISTOGRAM_SUB_BUCKETS are counted exactly, and each power of two above is split in
+ *        HISTOGRAM_SUB_BUCKETS buckets, so that a percentile is within 1 / HISTOGRAM_SUB_BUCKETS of
+ *        the true value whatever its magnitude. Recording a value takes a few instructions.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTOGRAM_SUB_BITS 6
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+
+/**
+ * @brief buckets of the values below 2 * HISTOGRAM_SUB_BUCKETS, then of each power of two above
+ */
+#define HISTOGRAM_BUCKETS (2 * HISTOGRAM_SUB_BUCKETS + (63 - HISTOGRAM_SUB_BITS) * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+} histogram_t;
+
+/**
+ * @brief empty a histogram
+ */
+void histogram_init(histogram_t *histogram);
+
+/**
+ * @brief count a value
+ */
+void histogram_record(histogram_t *histogram, uint64_t value);
+
+/**
+ * @brief add the counts of a histogram to another one
+ */
+void histogram_merge(histogram_t *into, const histogram_t *from);
+
+/**
+ * @brief value below which a share of the values fall
+ * @param histogram the histogram
+ * @param percentile the share, in percents (100 for the maximum)
+ * @return the largest value of the bucket reaching the share (the maximum if it is smaller), 0 if
+ *         the histogram is empty
+ */
+uint64_t histogram_percentile(const histogram_t *histogram, double percentile);
+
+/**
+ * @brief mean of the values, 0 if the histogram is empty
+ */
+double histogram_mean(const histogram_t *histogram);
@@ -0,0 +1,152 @@
+/**
+ * @file pps-hot-keys.c
+ * @brief print the most requested keys of the cluster: the top keys of every server of the
+ *        servers file, summed by key. Usage: pps-hot-keys [k]
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "config.h"
+#include "system.h"
+#include "error.h"
+#include "ring.h"
+#include "hotkeys.h"
+
+#define DEFAULT_TOP 10
+
+/**
+ * @brief a key of the cluster: its counts summed over the servers that report it
+ */
+typedef struct {
+    char key[HOTKEYS_KEY_SIZE + 1];
+    uint64_t count;
+    uint64_t error;
+    size_t nb_servers;
+} cluster_key_t;
+
+static uint64_t read_u64(const unsigned char *in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value = value << 8 | in[i];
+    }
+    return value;
+}
+
+static int compare_count(const void *a, const void *b) {
+    const uint64_t ca = ((const cluster_key_t *) a)->count;
+    const uint64_t cb = ((const cluster_key_t *) b)->count;
+    return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+//Add the keys of a reply to the cluster keys
+static void merge_reply(const unsigned char *reply, size_t len, cluster_key_t *keys, size_t *nb_keys) {
+
+    const size_t n = reply[10];
+    size_t offset = 11;
+    for (size_t i = 0; i < n && offset + HOTKEYS_ENTRY_HEADER_SIZE <= len; ++i) {
+        const size_t key_len = reply[offset + 16];
+        if (key_len > HOTKEYS_KEY_SIZE || offset + HOTKEYS_ENTRY_HEADER_SIZE + key_len > len) {
+            return;
+        }
+        char key[HOTKEYS_KEY_SIZE + 1];
+        memcpy(key, reply + offset + HOTKEYS_ENTRY_HEADER_SIZE, key_len);
+        key[key_len] = '\0';
+
+        size_t k = 0;
+        while (k < *nb_keys && strcmp(keys[k].key, key) != 0) {
+            ++k;
+        }
+        if (k == *nb_keys) {
+            memset(&keys[k], 0, sizeof(keys[k]));
+            strcpy(keys[k].key, key);
+            *nb_keys += 1;
+        }
+        keys[k].count      += read_u64(reply + offset);
+        keys[k].error      += read_u64(reply + offset + 8);
+        keys[k].nb_servers += 1;
+
+        offset += HOTKEYS_ENTRY_HEADER_SIZE + key_len;
+    }
+}
+
+int main(int argc, char **argv) {
+
+    int top = DEFAULT_TOP;
+    M_EXIT_IF(argc > 2 || (argc == 2 && (sscanf(argv[1], "%d", &top) != 1 || top <= 0)),
+              ERR_BAD_PARAMETER, "pps-hot-keys", "%s", "usage: pps-hot-keys [k]");
+
+    ring_t *ring = ring_alloc();
+    M_REQUIRE_NON_NULL(ring);
+    error_code error = ring_init(ring);
+    if (error != ERR_NONE) {
+        ring_free(ring);
+    }
+    M_EXIT_IF_ERR(error, "cannot read the servers file");
+
+    int s = get_socket(1);
+    if (s == -1) {
+        ring_free(ring);
+    }
+    M_EXIT_IF(s == -1, ERR_NETWORK, "get socket", "%s", "problem with socket");
+
+    //Ask each server its whole sketch: a key may be hot on a few servers only
+    const char request[3] = {PPS_OP_PREFIX, PPS_OP_HOT_KEYS, (char) HOTKEYS_CAPACITY};
+    for (size_t i = 0; i < ring->nb_servers; ++i) {
+        sendto(s, request, sizeof(request), 0, &ring->servers[i].addr, sizeof(ring->servers[i].addr));
+    }
+
+    cluster_key_t *keys = calloc(ring->nb_servers * HOTKEYS_CAPACITY, sizeof(cluster_key_t));
+    int *answered = calloc(ring->nb_servers, sizeof(int));
+    if (keys == NULL || answered == NULL) {
+        free(keys);
+        free(answered);
+        ring_free(ring);
+        return ERR_NOMEM;
+    }
+
+    unsigned char reply[11 + HOTKEYS_CAPACITY * (HOTKEYS_ENTRY_HEADER_SIZE + HOTKEYS_KEY_SIZE)];
+    size_t   nb_keys     = 0;
+    size_t   nb_answered = 0;
+    uint64_t total       = 0;
+    while (nb_answered < ring->nb_servers) {
+        struct sockaddr from;
+        socklen_t       from_len = sizeof(from);
+        ssize_t len = recvfrom(s, reply, sizeof(reply), 0, &from, &from_len);
+        if (len == -1) {
+            break;
+        }
+        if (len < 11 || reply[0] != PPS_OP_PREFIX || reply[1] != PPS_OP_HOT_KEYS) {
+            continue;
+        }
+        for (size_t i = 0; i < ring->nb_servers; ++i) {
+            if (!answered[i] && memcmp(&from, &ring->servers[i].addr, from_len) == 0) {
+                answered[i] = 1;
+                ++nb_answered;
+                total += read_u64(reply + 2);
+                merge_reply(reply, (size_t) len, keys, &nb_keys);
+                break;
+            }
+        }
+    }
+
+    qsort(keys, nb_keys, sizeof(cluster_key_t), compare_count);
+
+    printf("%llu requests on %zu/%zu servers\n", (unsigned long long) total, nb_answered, ring->nb_servers);
+    printf("%12s %12s %7s %s\n", "count", "error", "servers", "key");
+    for (size_t i = 0; i < nb_keys && i < (size_t) top; ++i) {
+        printf("%12llu %12llu %7zu %s\n", (unsigned long long) keys[i].count, (unsigned long long) keys[i].error,
+               keys[i].nb_servers, keys[i].key);
+    }
+
+    free(keys);
+    free(answered);
+    ring_free(ring);
+
+    return nb_answered > 0 ? ERR_NONE : ERR_NETWORK;
+}
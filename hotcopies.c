@@ -0,0 +1,297 @@
+/**
+ * @file hotcopies.c
+ * @brief Implementation of hotcopies.h
+ *
+ * A copy is PPS_OP_PREFIX, PPS_OP_HOT_COPY, its time to live in milliseconds (4 bytes),
+ * the width of the key (1 byte), the key, a nul byte and the value.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/socket.h>
+
+#include "hotcopies.h"
+#include "config.h"
+#include "util.h"
+
+#define COPY_HEADER_SIZE 7
+
+static int is_self(const hotcopies_t *hot, const node_t *node) {
+    const struct sockaddr_in *addr = (const struct sockaddr_in *) &node->addr;
+    return addr->sin_addr.s_addr == hot->self.sin_addr.s_addr && addr->sin_port == hot->self.sin_port;
+}
+
+static size_t replicas(const hotcopies_t *hot, const ring_t *ring) {
+    return hot->replication < ring->pref_size ? hot->replication : ring->pref_size;
+}
+
+static hot_entry_t *find_hot(hotcopies_t *hot, pps_key_t key) {
+    for (size_t i = 0; i < HOTCOPIES_MAX_HOT; ++i) {
+        if (hot->hot[i].width > 0 && strcmp(hot->hot[i].key, key) == 0) {
+            return &hot->hot[i];
+        }
+    }
+    return NULL;
+}
+
+static hot_copy_t *find_copy(const hotcopies_t *hot, pps_key_t key, double now) {
+    const size_t base = hash_function(key, HOTCOPIES_MAX_COPIES);
+    for (size_t p = 0; p < HOTCOPIES_PROBES; ++p) {
+        const hot_copy_t *copy = &hot->copies[(base + p) % HOTCOPIES_MAX_COPIES];
+        if (copy->key != NULL && copy->expires > now && strcmp(copy->key, key) == 0) {
+            return (hot_copy_t *) copy;
+        }
+    }
+    return NULL;
+}
+
+static void free_copy(hot_copy_t *copy) {
+    free(copy->key);
+    free(copy->value);
+    copy->key   = NULL;
+    copy->value = NULL;
+}
+
+//Send the value of a hot key to the servers after its N replicas
+static void push_copies(const hotcopies_t *hot, const ring_t *ring, const hot_entry_t *entry,
+                        pps_value_t value, int socket) {
+
+    const size_t key_len   = strlen(entry->key);
+    const size_t value_len = strnlen(value, MAX_MSG_ELEM_SIZE);
+    const uint32_t ttl     = (uint32_t) (hot->config.period_ms * HOTCOPIES_COPY_PERIODS);
+
+    char msg[COPY_HEADER_SIZE + HOTKEYS_KEY_SIZE + 1 + MAX_MSG_ELEM_SIZE];
+    msg[0] = PPS_OP_PREFIX;
+    msg[1] = PPS_OP_HOT_COPY;
+    for (int i = 0; i < 4; ++i) {
+        msg[2 + i] = (char) (ttl >> (24 - 8 * i));
+    }
+    msg[6] = (char) entry->width;
+    memcpy(msg + COPY_HEADER_SIZE, entry->key, key_len + 1);
+    memcpy(msg + COPY_HEADER_SIZE + key_len + 1, value, value_len);
+
+    node_t list_row[RING_MAX_PREFERENCE_SIZE];
+    node_list_t list = ring_get_nodes_for_key(ring, entry->width, entry->key, list_row);
+    for (size_t i = replicas(hot, ring); i < list.size; ++i) {
+        sendto(socket, msg, COPY_HEADER_SIZE + key_len + 1 + value_len, 0, &list.nodes[i].addr, sizeof(list.nodes[i].addr));
+    }
+}
+
+//Widen, keep or narrow a key from its rate over the last period
+static void update_width(hotcopies_t *hot, const ring_t *ring, pps_key_t key, double rate, int *seen) {
+
+    const size_t n = replicas(hot, ring);
+    node_t owners_row[RING_MAX_PREFERENCE_SIZE];
+    node_list_t owners = ring_get_nodes_for_key(ring, n, key, owners_row);
+    hot_entry_t *entry = find_hot(hot, key);
+
+    //Only the first replica decides: it sees every read that is not spread yet
+    if (owners.size == 0 || !is_self(hot, &owners.nodes[0])) {
+        if (entry != NULL) {
+            entry->width = 0;
+        }
+        return;
+    }
+
+    //Rate per replica if the reads spread over the extra servers went back to the N replicas
+    const size_t width = entry != NULL ? entry->width : n;
+    const double load  = rate * (double) width / (double) n;
+    size_t max = n * hot->config.max_width;
+    max = max < ring->pref_size ? max : ring->pref_size;
+
+    size_t new_width = n;
+    if (load >= hot->config.threshold) {
+        new_width = n * (size_t) ceil(load / hot->config.threshold);
+    } else if (load >= hot->config.threshold / 2) {
+        //Between half the threshold and the threshold: keep the width, so that it does not flap
+        new_width = width;
+    }
+    new_width = new_width < max ? new_width : max;
+
+    if (new_width <= n) {
+        if (entry != NULL) {
+            entry->width = 0;
+        }
+        return;
+    }
+
+    if (entry == NULL) {
+        for (size_t i = 0; entry == NULL && i < HOTCOPIES_MAX_HOT; ++i) {
+            if (hot->hot[i].width == 0) {
+                entry = &hot->hot[i];
+            }
+        }
+        if (entry == NULL) {
+            return;
+        }
+        strcpy(entry->key, key);
+    }
+    entry->width = new_width;
+    seen[entry - hot->hot] = 1;
+}
+
+void hotcopies_default_config(hotcopies_config_t *config) {
+    if (config != NULL) {
+        config->threshold = HOTCOPIES_DEFAULT_THRESHOLD;
+        config->period_ms = HOTCOPIES_DEFAULT_PERIOD_MS;
+        config->max_width = HOTCOPIES_DEFAULT_MAX_WIDTH;
+    }
+}
+
+void hotcopies_init(hotcopies_t *hot, const hotcopies_config_t *config, const struct sockaddr_in *self,
+                    size_t replication, double now) {
+    if (hot != NULL && config != NULL && self != NULL) {
+        memset(hot, 0, sizeof(*hot));
+        hot->config      = *config;
+        hot->self        = *self;
+        hot->replication = replication;
+        hot->next_period = now + config->period_ms;
+    }
+}
+
+void hotcopies_end(hotcopies_t *hot) {
+    if (hot != NULL) {
+        for (size_t i = 0; i < HOTCOPIES_MAX_COPIES; ++i) {
+            free_copy(&hot->copies[i]);
+        }
+    }
+}
+
+double hotcopies_next_timeout_ms(const hotcopies_t *hot, double now) {
+    return hot->next_period > now ? hot->next_period - now : 0;
+}
+
+void hotcopies_tick(hotcopies_t *hot, const hotkeys_t *sketch, const ring_t *ring, Htable_t table,
+                    int socket, double now) {
+
+    if (hot == NULL || sketch == NULL || now < hot->next_period) {
+        return;
+    }
+    const double elapsed = now - hot->next_period + hot->config.period_ms;
+    hot->next_period = now + hot->config.period_ms;
+
+    for (size_t i = 0; i < HOTCOPIES_MAX_COPIES; ++i) {
+        if (hot->copies[i].key != NULL && hot->copies[i].expires <= now) {
+            free_copy(&hot->copies[i]);
+        }
+    }
+
+    int seen[HOTCOPIES_MAX_HOT] = {0};
+    for (size_t i = 0; i < sketch->size; ++i) {
+        const hot_key_t *key = &sketch->keys[i];
+
+        //A key new in the sketch was requested at least count - error times since it came in
+        const uint64_t requests = hot->last_hash[i] == key->hash ? key->count - hot->last_count[i] : key->count - key->error;
+        hot->last_hash[i]  = key->hash;
+        hot->last_count[i] = key->count;
+
+        //Keys longer than what the sketch keeps cannot be copied
+        if (ring != NULL && hot->config.threshold > 0 && strlen(key->key) < HOTKEYS_KEY_SIZE) {
+            update_width(hot, ring, key->key, (double) requests * 1000.0 / elapsed, seen);
+        }
+    }
+
+    for (size_t i = 0; i < HOTCOPIES_MAX_HOT; ++i) {
+        hot_entry_t *entry = &hot->hot[i];
+        if (entry->width == 0) {
+            continue;
+        }
+        //Out of the sketch: not hot anymore
+        if (!seen[i]) {
+            entry->width = 0;
+            continue;
+        }
+        pps_value_t value = get_Htable_value(table, entry->key);
+        if (value != NULL) {
+            push_copies(hot, ring, entry, value, socket);
+            free_const_ptr(value);
+        }
+    }
+}
+
+void hotcopies_written(hotcopies_t *hot, const ring_t *ring, pps_key_t key, pps_value_t value, int socket) {
+    if (hot != NULL && ring != NULL && key != NULL && value != NULL) {
+        const hot_entry_t *entry = find_hot(hot, key);
+        if (entry != NULL) {
+            push_copies(hot, ring, entry, value, socket);
+        }
+    }
+}
+
+size_t hotcopies_width(const hotcopies_t *hot, pps_key_t key, double now) {
+
+    if (hot == NULL || key == NULL) {
+        return 0;
+    }
+    const hot_entry_t *entry = find_hot((hotcopies_t *) hot, key);
+    if (entry != NULL) {
+        return entry->width;
+    }
+    const hot_copy_t *copy = find_copy(hot, key, now);
+    return copy != NULL ? copy->width : 0;
+}
+
+pps_value_t hotcopies_get(const hotcopies_t *hot, pps_key_t key, double now) {
+    if (hot == NULL || key == NULL) {
+        return NULL;
+    }
+    const hot_copy_t *copy = find_copy(hot, key, now);
+    return copy != NULL ? strdup(copy->value) : NULL;
+}
+
+int hotcopies_handle(hotcopies_t *hot, const char *msg, size_t len, double now) {
+
+    if (msg == NULL || len < COPY_HEADER_SIZE + 2 || msg[0] != PPS_OP_PREFIX || msg[1] != PPS_OP_HOT_COPY) {
+        return 0;
+    }
+    const char *key = msg + COPY_HEADER_SIZE;
+    const char *nul = memchr(key, '\0', len - COPY_HEADER_SIZE);
+    if (hot == NULL || nul == NULL || nul == key) {
+        return 1;
+    }
+    const unsigned char *in = (const unsigned char *) msg;
+    const uint32_t ttl = (uint32_t) in[2] << 24 | (uint32_t) in[3] << 16 | (uint32_t) in[4] << 8 | (uint32_t) in[5];
+    const size_t value_len = len - (size_t) (nul + 1 - msg);
+
+    //The slot of the key if it is there, the first free one otherwise
+    const size_t base = hash_function(key, HOTCOPIES_MAX_COPIES);
+    hot_copy_t *slot = NULL;
+    for (size_t p = 0; p < HOTCOPIES_PROBES; ++p) {
+        hot_copy_t *copy = &hot->copies[(base + p) % HOTCOPIES_MAX_COPIES];
+        if (copy->key != NULL && strcmp(copy->key, key) == 0) {
+            slot = copy;
+            break;
+        }
+        if (slot == NULL && (copy->key == NULL || copy->expires <= now)) {
+            slot = copy;
+        }
+    }
+    if (slot == NULL) {
+        return 1;
+    }
+
+    char *value = malloc(value_len + 1);
+    if (value == NULL) {
+        return 1;
+    }
+    memcpy(value, nul + 1, value_len);
+    value[value_len] = '\0';
+
+    if (slot->key == NULL || strcmp(slot->key, key) != 0) {
+        free_copy(slot);
+        slot->key = strdup(key);
+        if (slot->key == NULL) {
+            free(value);
+            return 1;
+        }
+    }
+    free(slot->value);
+    slot->value   = value;
+    slot->width   = in[6];
+    slot->expires = now + ttl;
+
+    return 1;
+}
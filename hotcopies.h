@@ -0,0 +1,154 @@
+#pragma once
+
+/**
+ * @file hotcopies.h
+ * @brief Adaptive extra replication of hot keys: each period, a server estimates the request
+ *        rate of the keys of its sketch (see hotkeys.h). When the rate of a key it owns goes over
+ *        a threshold, the key is widened to more replicas, the next servers of its preference list,
+ *        and the replies to the gets of the key advertise this width so that clients spread their reads.
+ *        The first replica pushes copies to the extra servers every period while the key stays
+ *        hot: the copies expire by themselves once the key cools down.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "ring.h"
+#include "hashtable.h"
+#include "hotkeys.h"
+
+/**
+ * @brief default configuration (see hotcopies_config_t)
+ */
+#define HOTCOPIES_DEFAULT_THRESHOLD 1000
+#define HOTCOPIES_DEFAULT_PERIOD_MS 1000
+#define HOTCOPIES_DEFAULT_MAX_WIDTH 2
+
+/**
+ * @brief a copy lives this many periods without a refresh
+ */
+#define HOTCOPIES_COPY_PERIODS 3
+
+/**
+ * @brief maximum number of hot keys a server replicates, and of copies it holds for others
+ */
+#define HOTCOPIES_MAX_HOT 32
+#define HOTCOPIES_MAX_COPIES 256
+
+/**
+ * @brief a copy goes in one of the HOTCOPIES_PROBES slots after the hash of its key
+ */
+#define HOTCOPIES_PROBES 8
+
+/**
+ * @brief hot replication settings
+ */
+typedef struct {
+    double threshold;         // requests per second and per replica over which a key is widened, 0 to never
+    double period_ms;         // how often rates are measured and copies refreshed
+    size_t max_width;         // maximum number of replicas of a hot key, as a multiple of N
+} hotcopies_config_t;
+
+/**
+ * @brief a key this server replicates to more servers
+ */
+typedef struct {
+    char key[HOTKEYS_KEY_SIZE + 1];
+    size_t width;             // number of replicas, 0 if the slot is free
+} hot_entry_t;
+
+/**
+ * @brief a copy held for the first replica of a hot key
+ */
+typedef struct {
+    char *key;                // NULL if the slot is free
+    char *value;
+    size_t width;
+    double expires;           // the slot is free once expired
+} hot_copy_t;
+
+/**
+ * @brief hot replication state of a server
+ */
+typedef struct {
+    hotcopies_config_t config;
+    struct sockaddr_in self;
+    size_t replication;       // N of the clients
+    double next_period;
+    uint64_t last_hash[HOTKEYS_CAPACITY]; // sketch counts at the start of the period
+    uint64_t last_count[HOTKEYS_CAPACITY];
+    hot_entry_t hot[HOTCOPIES_MAX_HOT];
+    hot_copy_t copies[HOTCOPIES_MAX_COPIES];
+} hotcopies_t;
+
+/**
+ * @brief fill a configuration with the default values
+ * @param config the configuration to fill
+ */
+void hotcopies_default_config(hotcopies_config_t *config);
+
+/**
+ * @brief initialize the hot replication state
+ * @param hot the state
+ * @param config the settings
+ * @param self address of this server
+ * @param replication number of replicas of a key (N of the clients)
+ * @param now current time (get_time_ms)
+ */
+void hotcopies_init(hotcopies_t *hot, const hotcopies_config_t *config, const struct sockaddr_in *self,
+                    size_t replication, double now);
+
+/**
+ * @brief free the hot replication state
+ * @param hot the state
+ */
+void hotcopies_end(hotcopies_t *hot);
+
+/**
+ * @brief time before the next period
+ * @return the time in milliseconds (0 if it is due)
+ */
+double hotcopies_next_timeout_ms(const hotcopies_t *hot, double now);
+
+/**
+ * @brief measure the rates of the period if it is over, widen or narrow the hot keys, push
+ *        fresh copies of the keys this server is the first replica of, and drop the expired copies
+ * @param hot the state
+ * @param sketch the request sketch of the server
+ * @param ring the ring (NULL if the server is not in a ring)
+ * @param table the keys of the server
+ * @param socket the server socket
+ * @param now current time
+ */
+void hotcopies_tick(hotcopies_t *hot, const hotkeys_t *sketch, const ring_t *ring, Htable_t table,
+                    int socket, double now);
+
+/**
+ * @brief push the new value of a hot key to its extra servers, if this server is its first replica
+ * @param hot the state
+ * @param ring the ring
+ * @param key the key written
+ * @param value its new value
+ * @param socket the server socket
+ */
+void hotcopies_written(hotcopies_t *hot, const ring_t *ring, pps_key_t key, pps_value_t value, int socket);
+
+/**
+ * @brief number of replicas to advertise for a key: only its first replica and the servers
+ *        holding copies know it is hot
+ * @return the width of the key, 0 if it is not hot
+ */
+size_t hotcopies_width(const hotcopies_t *hot, pps_key_t key, double now);
+
+/**
+ * @brief value of a copy held for another server
+ * @return the value (to be freed by the caller), NULL if there is no copy of the key
+ */
+pps_value_t hotcopies_get(const hotcopies_t *hot, pps_key_t key, double now);
+
+/**
+ * @brief handle a message if it is a copy of a hot key
+ * @return 1 if the message was a copy, 0 otherwise
+ */
+int hotcopies_handle(hotcopies_t *hot, const char *msg, size_t len, double now);
@@ -0,0 +1,186 @@
+/**
+ * @file hotkeys.c
+ * @brief Implementation of hotkeys.h
+ *
+ * A request of the top keys is PPS_OP_PREFIX, PPS_OP_HOT_KEYS and the number of keys wanted.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "hotkeys.h"
+#include "hash.h"
+#include "config.h"
+
+#define INDEX_MASK (HOTKEYS_INDEX_SIZE - 1)
+
+static void write_u64(unsigned char *out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out[i] = (unsigned char) (value >> (56 - 8 * i));
+    }
+}
+
+static void swap(hotkeys_t *hot, size_t a, size_t b) {
+    const uint16_t key = hot->heap[a];
+    hot->heap[a] = hot->heap[b];
+    hot->heap[b] = key;
+    hot->position[hot->heap[a]] = (uint16_t) a;
+    hot->position[hot->heap[b]] = (uint16_t) b;
+}
+
+//Counts only grow: a key only ever moves down the heap
+static void sift_down(hotkeys_t *hot, size_t i) {
+    while (1) {
+        size_t smallest = i;
+        const size_t left  = 2 * i + 1;
+        const size_t right = left + 1;
+        if (left < hot->size && hot->keys[hot->heap[left]].count < hot->keys[hot->heap[smallest]].count) {
+            smallest = left;
+        }
+        if (right < hot->size && hot->keys[hot->heap[right]].count < hot->keys[hot->heap[smallest]].count) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        swap(hot, i, smallest);
+        i = smallest;
+    }
+}
+
+//Slot of the index holding the key, or the free slot where it would go
+static size_t find_slot(const hotkeys_t *hot, uint64_t hash, const char *key, size_t len) {
+    const size_t kept = len < HOTKEYS_KEY_SIZE ? len : HOTKEYS_KEY_SIZE;
+    size_t slot = hash & INDEX_MASK;
+    while (hot->index[slot] != 0) {
+        const hot_key_t *entry = &hot->keys[hot->index[slot] - 1];
+        if (entry->hash == hash && strncmp(entry->key, key, kept) == 0 && entry->key[kept] == '\0') {
+            return slot;
+        }
+        slot = (slot + 1) & INDEX_MASK;
+    }
+    return slot;
+}
+
+//Free a slot of the index, moving back the keys probed past it (no tombstones)
+static void remove_slot(hotkeys_t *hot, size_t slot) {
+    size_t next = slot;
+    while (1) {
+        next = (next + 1) & INDEX_MASK;
+        if (hot->index[next] == 0) {
+            break;
+        }
+        const size_t home = hot->keys[hot->index[next] - 1].hash & INDEX_MASK;
+        //The key at next may move to slot if its home is not cyclically in (slot, next]
+        const int between = slot <= next ? (slot < home && home <= next) : (slot < home || home <= next);
+        if (!between) {
+            hot->index[slot] = hot->index[next];
+            hot->keys[hot->index[slot] - 1].slot = (uint16_t) slot;
+            slot = next;
+        }
+    }
+    hot->index[slot] = 0;
+}
+
+void hotkeys_init(hotkeys_t *hot) {
+    if (hot != NULL) {
+        memset(hot, 0, sizeof(*hot));
+    }
+}
+
+void hotkeys_record(hotkeys_t *hot, const char *key, size_t len) {
+
+    if (hot == NULL || key == NULL) {
+        return;
+    }
+    hot->total += 1;
+
+    const uint64_t hash = fast_hash64(key, len);
+    size_t slot = find_slot(hot, hash, key, len);
+
+    size_t i;
+    uint64_t min = 0;
+    if (hot->index[slot] != 0) {
+        i = hot->index[slot] - 1;
+        hot->keys[i].count += 1;
+        sift_down(hot, hot->position[i]);
+        return;
+    } else if (hot->size < HOTKEYS_CAPACITY) {
+        i = hot->size;
+        hot->heap[i]     = (uint16_t) i;
+        hot->position[i] = (uint16_t) i;
+        hot->size += 1;
+    } else {
+        //Space-Saving: the new key takes the place of the least counted one, and its count
+        i   = hot->heap[0];
+        min = hot->keys[i].count;
+        remove_slot(hot, hot->keys[i].slot);
+        slot = find_slot(hot, hash, key, len);
+    }
+
+    hot_key_t *entry = &hot->keys[i];
+    const size_t kept = len < HOTKEYS_KEY_SIZE ? len : HOTKEYS_KEY_SIZE;
+    memcpy(entry->key, key, kept);
+    entry->key[kept] = '\0';
+    entry->hash  = hash;
+    entry->count = min + 1;
+    entry->error = min;
+    entry->slot  = (uint16_t) slot;
+    hot->index[slot] = (uint16_t) (i + 1);
+    sift_down(hot, hot->position[i]);
+}
+
+static int compare_count(const void *a, const void *b) {
+    const uint64_t ca = ((const hot_key_t *) a)->count;
+    const uint64_t cb = ((const hot_key_t *) b)->count;
+    return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+size_t hotkeys_top(const hotkeys_t *hot, hot_key_t *top, size_t k) {
+
+    if (hot == NULL || top == NULL) {
+        return 0;
+    }
+
+    hot_key_t all[HOTKEYS_CAPACITY];
+    memcpy(all, hot->keys, hot->size * sizeof(hot_key_t));
+    qsort(all, hot->size, sizeof(hot_key_t), compare_count);
+
+    const size_t n = k < hot->size ? k : hot->size;
+    memcpy(top, all, n * sizeof(hot_key_t));
+    return n;
+}
+
+int hotkeys_handle(const hotkeys_t *hot, int socket, const char *msg, size_t len, const struct sockaddr_in *from) {
+
+    if (msg == NULL || len < 2 || msg[0] != PPS_OP_PREFIX || msg[1] != PPS_OP_HOT_KEYS) {
+        return 0;
+    }
+    if (hot == NULL) {
+        return 1;
+    }
+
+    hot_key_t top[HOTKEYS_CAPACITY];
+    const size_t wanted = len >= 3 && (unsigned char) msg[2] > 0 ? (unsigned char) msg[2] : HOTKEYS_CAPACITY;
+    const size_t n = hotkeys_top(hot, top, wanted);
+
+    unsigned char reply[11 + HOTKEYS_CAPACITY * (HOTKEYS_ENTRY_HEADER_SIZE + HOTKEYS_KEY_SIZE)];
+    reply[0] = PPS_OP_PREFIX;
+    reply[1] = PPS_OP_HOT_KEYS;
+    write_u64(reply + 2, hot->total);
+    reply[10] = (unsigned char) n;
+
+    size_t size = 11;
+    for (size_t i = 0; i < n; ++i) {
+        const size_t key_len = strlen(top[i].key);
+        write_u64(reply + size, top[i].count);
+        write_u64(reply + size + 8, top[i].error);
+        reply[size + 16] = (unsigned char) key_len;
+        memcpy(reply + size + HOTKEYS_ENTRY_HEADER_SIZE, top[i].key, key_len);
+        size += HOTKEYS_ENTRY_HEADER_SIZE + key_len;
+    }
+
+    sendto(socket, reply, size, 0, (const struct sockaddr *) from, sizeof(*from));
+    return 1;
+}
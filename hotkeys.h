@@ -0,0 +1,92 @@
+#pragma once
+
+/**
+ * @file hotkeys.h
+ * @brief Heavy hitters of the requests of a server (Space-Saving sketch): the HOTKEYS_CAPACITY
+ *        most frequent keys are tracked in constant memory, each with a count that overestimates
+ *        its number of requests by at most its error. Recording a request costs a hash, a probe
+ *        of the key index and a few heap moves.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+/**
+ * @brief number of keys tracked: any key requested more than total / HOTKEYS_CAPACITY
+ *        times is among them
+ */
+#define HOTKEYS_CAPACITY 128
+
+/**
+ * @brief number of bytes of a key kept for reporting (keys are told apart by their full hash)
+ */
+#define HOTKEYS_KEY_SIZE 64
+
+/**
+ * @brief size of the key index (a power of 2, twice the capacity)
+ */
+#define HOTKEYS_INDEX_SIZE (2 * HOTKEYS_CAPACITY)
+
+/**
+ * @brief size of a key in a reply to PPS_OP_HOT_KEYS: count, error, key length, key
+ */
+#define HOTKEYS_ENTRY_HEADER_SIZE 17
+
+/**
+ * @brief a tracked key
+ */
+typedef struct {
+    uint64_t hash;
+    uint64_t count;           // requests counted for the key, at most error more than the real number
+    uint64_t error;
+    uint16_t slot;            // slot of the key in the index
+    char key[HOTKEYS_KEY_SIZE + 1];
+} hot_key_t;
+
+/**
+ * @brief the sketch
+ */
+typedef struct {
+    hot_key_t keys[HOTKEYS_CAPACITY];
+    uint16_t heap[HOTKEYS_CAPACITY];     // indices of the keys, the least counted first
+    uint16_t position[HOTKEYS_CAPACITY]; // position of each key in the heap
+    uint16_t index[HOTKEYS_INDEX_SIZE];  // 1 + index of the key by hash (linear probing), 0 if free
+    size_t size;
+    uint64_t total;           // requests recorded
+} hotkeys_t;
+
+/**
+ * @brief initialize an empty sketch
+ * @param hot the sketch
+ */
+void hotkeys_init(hotkeys_t *hot);
+
+/**
+ * @brief record a request for a key
+ * @param hot the sketch
+ * @param key the key (not necessarily nul-terminated)
+ * @param len length of the key
+ */
+void hotkeys_record(hotkeys_t *hot, const char *key, size_t len);
+
+/**
+ * @brief the most requested keys
+ * @param hot the sketch
+ * @param top where to write them, the most counted first
+ * @param k maximum number of keys to write
+ * @return the number of keys written
+ */
+size_t hotkeys_top(const hotkeys_t *hot, hot_key_t *top, size_t k);
+
+/**
+ * @brief answer a PPS_OP_HOT_KEYS request: the reply holds the number of requests recorded,
+ *        the number of keys, then for each key its count, error, length and first bytes
+ * @param hot the sketch
+ * @param socket the server socket
+ * @param msg the message received
+ * @param len its length
+ * @param from its sender
+ * @return 1 if the message was a PPS_OP_HOT_KEYS request, 0 otherwise
+ */
+int hotkeys_handle(const hotkeys_t *hot, int socket, const char *msg, size_t len, const struct sockaddr_in *from);
@@ -0,0 +1,332 @@
+/**
+ * @file pps-import.c
+ * @brief load a bulk file (see bulk.h) written by pps-export into the cluster: the pairs are
+ *        grouped by replica into batches of writes of a datagram each, a few batches per server in
+ *        flight and the lost ones sent again. Usage: pps-import [-r pairs_per_s] [-n N] file
+ *        The table of a server does not grow: for a large load, start the servers with about as
+ *        many buckets as pairs each is to hold (pps-launch-server -b), or inserts walk long chains.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+
+#include "config.h"
+#include "system.h"
+#include "error.h"
+#include "args.h"
+#include "ring.h"
+#include "bulk.h"
+
+#define USAGE "usage: pps-import [-r pairs_per_s] [-n N] file"
+
+/**
+ * @brief batches in flight per server, and when a batch not acknowledged is sent again: after
+ *        twice the usual time of an acknowledgement (at least IMPORT_TIMEOUT_MS), doubled at each
+ *        retry, so that a server slowed down is not flooded with copies of the batches it is on
+ */
+#define IMPORT_WINDOW 4
+#define IMPORT_TIMEOUT_MS 200
+#define IMPORT_MAX_RETRIES 6
+#define IMPORT_RTT_WEIGHT 0.875
+
+/**
+ * @brief a batch sent, waiting for its acknowledgement
+ */
+typedef struct {
+    int used;
+    uint32_t seq;
+    size_t count;
+    size_t len;
+    double sent_at;
+    int retries;
+    char msg[MAX_MSG_SIZE];
+} flight_t;
+
+/**
+ * @brief the batches of a server: the one being filled and the ones in flight
+ */
+typedef struct {
+    size_t count;
+    size_t len;
+    char msg[MAX_MSG_SIZE];
+    flight_t flights[IMPORT_WINDOW];
+    size_t nb_flights;
+    double rtt_ms;            // moving average of the time of an acknowledgement
+    int failed;               // stopped answering: its batches are dropped
+    uint64_t acked;           // pairs acknowledged
+    uint64_t lost;            // pairs dropped
+} server_batches_t;
+
+/**
+ * @brief state of the import
+ */
+typedef struct {
+    int socket;
+    const ring_t *ring;
+    server_batches_t *servers;
+    uint32_t next_seq;
+} import_t;
+
+static void write_u32(char *out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = (char) (value >> (24 - 8 * i));
+    }
+}
+
+static uint32_t read_u32(const char *msg) {
+    const unsigned char *in = (const unsigned char *) msg;
+    return (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16 | (uint32_t) in[2] << 8 | in[3];
+}
+
+static void send_flight(import_t *import, size_t k, flight_t *flight) {
+    flight->sent_at = get_time_ms();
+    sendto(import->socket, flight->msg, flight->len, 0, &import->ring->servers[k].addr,
+           sizeof(import->ring->servers[k].addr));
+}
+
+//Drop the batches of a server that stopped answering
+static void fail_server(import_t *import, size_t k) {
+    server_batches_t *server = &import->servers[k];
+    const struct sockaddr_in *addr = (const struct sockaddr_in *) &import->ring->servers[k].addr;
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr->sin_addr, ip, INET_ADDRSTRLEN);
+    fprintf(stderr, "server %s:%d stopped answering, its pairs are dropped\n", ip, ntohs(addr->sin_port));
+
+    for (size_t i = 0; i < IMPORT_WINDOW; ++i) {
+        server->lost += server->flights[i].used ? server->flights[i].count : 0;
+        server->flights[i].used = 0;
+    }
+    server->lost      += server->count;
+    server->nb_flights = 0;
+    server->count      = 0;
+    server->len        = BULK_BATCH_HEADER_SIZE;
+    server->failed     = 1;
+}
+
+//Wait at most timeout_ms for an acknowledgement, then send again the batches waiting for too long
+static void pump(import_t *import, double timeout_ms) {
+
+    struct pollfd fd = {import->socket, POLLIN, 0};
+    if (poll(&fd, 1, timeout_ms > 0 ? 1 + (int) timeout_ms : 0) > 0) {
+        char reply[BULK_BATCH_REPLY_SIZE + 1];
+        struct sockaddr from;
+        socklen_t from_len = sizeof(from);
+        ssize_t len = recvfrom(import->socket, reply, sizeof(reply), 0, &from, &from_len);
+        if (len == BULK_BATCH_REPLY_SIZE && reply[0] == PPS_OP_PREFIX && reply[1] == PPS_OP_PUT_BATCH
+            && reply[6] == PPS_STATUS_OK) {
+            const uint32_t seq = read_u32(reply + 2);
+            for (size_t k = 0; k < import->ring->nb_servers; ++k) {
+                server_batches_t *server = &import->servers[k];
+                for (size_t i = 0; i < IMPORT_WINDOW; ++i) {
+                    flight_t *flight = &server->flights[i];
+                    if (flight->used && flight->seq == seq && memcmp(&from, &import->ring->servers[k].addr, from_len) == 0) {
+                        //Only a batch sent once tells how long an acknowledgement takes
+                        if (flight->retries == 0) {
+                            server->rtt_ms = IMPORT_RTT_WEIGHT * server->rtt_ms
+                                             + (1 - IMPORT_RTT_WEIGHT) * (get_time_ms() - flight->sent_at);
+                        }
+                        flight->used = 0;
+                        server->nb_flights -= 1;
+                        server->acked += flight->count;
+                    }
+                }
+            }
+        }
+    }
+
+    const double now = get_time_ms();
+    for (size_t k = 0; k < import->ring->nb_servers; ++k) {
+        const double rtt_ms  = 2 * import->servers[k].rtt_ms;
+        const double timeout = rtt_ms > IMPORT_TIMEOUT_MS ? rtt_ms : IMPORT_TIMEOUT_MS;
+        for (size_t i = 0; i < IMPORT_WINDOW && !import->servers[k].failed; ++i) {
+            flight_t *flight = &import->servers[k].flights[i];
+            if (flight->used && now - flight->sent_at >= timeout * (1 << flight->retries)) {
+                if (++flight->retries > IMPORT_MAX_RETRIES) {
+                    fail_server(import, k);
+                } else {
+                    send_flight(import, k, flight);
+                }
+            }
+        }
+    }
+}
+
+//Send the batch being filled for a server, once it has room in its window
+static void flush_batch(import_t *import, size_t k) {
+
+    server_batches_t *server = &import->servers[k];
+    while (!server->failed && server->nb_flights == IMPORT_WINDOW) {
+        pump(import, IMPORT_TIMEOUT_MS);
+    }
+    if (server->failed || server->count == 0) {
+        return;
+    }
+
+    flight_t *flight = server->flights;
+    while (flight->used) {
+        ++flight;
+    }
+    server->msg[0] = PPS_OP_PREFIX;
+    server->msg[1] = PPS_OP_PUT_BATCH;
+    write_u32(server->msg + 2, import->next_seq);
+    server->msg[6] = (char) (server->count >> 8);
+    server->msg[7] = (char) server->count;
+
+    flight->used    = 1;
+    flight->seq     = import->next_seq++;
+    flight->count   = server->count;
+    flight->len     = server->len;
+    flight->retries = 0;
+    memcpy(flight->msg, server->msg, server->len);
+    server->nb_flights += 1;
+    server->count = 0;
+    server->len   = BULK_BATCH_HEADER_SIZE;
+
+    send_flight(import, k, flight);
+}
+
+//Add a pair to the batch of a server, sending the batch first if the pair does not fit
+static void add_pair(import_t *import, size_t k, const char *key, size_t key_len, const char *value, size_t value_len) {
+
+    server_batches_t *server = &import->servers[k];
+    const size_t len = key_len + value_len + 2;
+    if (server->len + len > MAX_MSG_SIZE || server->count == UINT16_MAX) {
+        flush_batch(import, k);
+    }
+    if (server->failed) {
+        server->lost += 1;
+        return;
+    }
+    memcpy(server->msg + server->len, key, key_len + 1);
+    memcpy(server->msg + server->len + key_len + 1, value, value_len + 1);
+    server->len   += len;
+    server->count += 1;
+}
+
+int main(int argc, char **argv) {
+
+    double rate = 0;
+    char **rem_argv = argv + 1;
+    if (argc > 2 && strcmp(argv[1], "-r") == 0) {
+        M_EXIT_IF(sscanf(argv[2], "%lf", &rate) != 1 || rate < 0, ERR_BAD_PARAMETER, "pps-import", "%s", USAGE);
+        rem_argv += 2;
+    }
+    args_t *args = parse_opt_args(TOTAL_SERVERS, &rem_argv);
+    M_EXIT_IF(args == NULL || rem_argv[0] == NULL || rem_argv[1] != NULL, ERR_BAD_PARAMETER, "pps-import", "%s", USAGE);
+    const size_t n = args->N;
+    free(args);
+
+    FILE *file = fopen(rem_argv[0], "rb");
+    M_EXIT_IF(file == NULL, ERR_IO, "pps-import", "cannot open %s", rem_argv[0]);
+    if (bulk_read_header(file) != ERR_NONE) {
+        fclose(file);
+        fprintf(stderr, "%s is not a file of pps-export\n", rem_argv[0]);
+        return ERR_IO;
+    }
+
+    ring_t *ring = ring_alloc();
+    M_REQUIRE_NON_NULL(ring);
+    error_code error = ring_init(ring);
+    int s = error == ERR_NONE ? get_socket(0) : -1;
+    if (error == ERR_NONE && s == -1) {
+        error = ERR_NETWORK;
+    }
+    if (error == ERR_NONE) {
+        error = bulk_update_membership(s, ring);
+    }
+    server_batches_t *servers = error == ERR_NONE ? calloc(ring->nb_servers, sizeof(server_batches_t)) : NULL;
+    if (error == ERR_NONE && servers == NULL) {
+        error = ERR_NOMEM;
+    }
+    if (error != ERR_NONE) {
+        ring_free(ring);
+        fclose(file);
+    }
+    M_EXIT_IF_ERR(error, "cannot reach the servers");
+
+    for (size_t k = 0; k < ring->nb_servers; ++k) {
+        servers[k].len = BULK_BATCH_HEADER_SIZE;
+    }
+    import_t import = {s, ring, servers, 1};
+
+    static char key[MAX_MSG_ELEM_SIZE + 1];
+    static char value[MAX_MSG_ELEM_SIZE + 1];
+    size_t   key_len   = 0;
+    size_t   value_len = 0;
+    uint64_t count     = 0;
+    uint64_t nb_read   = 0;
+    uint64_t too_large = 0;
+    const double start = get_time_ms();
+
+    while ((error = bulk_read_pair(file, key, &key_len, value, &value_len, &count)) == ERR_NONE && key_len > 0) {
+        ++nb_read;
+        if (BULK_BATCH_HEADER_SIZE + key_len + value_len + 2 > MAX_MSG_SIZE) {
+            ++too_large;
+            continue;
+        }
+
+        //At most rate pairs per second: acknowledgements are handled while waiting
+        while (rate > 0 && get_time_ms() < start + 1000.0 * (double) nb_read / rate) {
+            pump(&import, start + 1000.0 * (double) nb_read / rate - get_time_ms());
+        }
+
+        //The replicas among the servers that answered: a full window waits for acknowledgements
+        node_t replicas_row[RING_MAX_PREFERENCE_SIZE];
+        node_list_t replicas = ring_get_nodes_for_key(ring, n, key, replicas_row);
+        for (size_t i = 0; i < replicas.size; ++i) {
+            const size_t k = ring_server_index(ring, &replicas.nodes[i]);
+            if (k < ring->nb_servers) {
+                add_pair(&import, k, key, key_len, value, value_len);
+            }
+        }
+    }
+    fclose(file);
+
+    //The last batches, then their acknowledgements
+    for (size_t k = 0; k < ring->nb_servers; ++k) {
+        flush_batch(&import, k);
+    }
+    size_t in_flight = 1;
+    while (in_flight > 0) {
+        in_flight = 0;
+        for (size_t k = 0; k < ring->nb_servers; ++k) {
+            in_flight += servers[k].nb_flights;
+        }
+        if (in_flight > 0) {
+            pump(&import, IMPORT_TIMEOUT_MS);
+        }
+    }
+
+    uint64_t acked = 0;
+    uint64_t lost  = 0;
+    for (size_t k = 0; k < ring->nb_servers; ++k) {
+        acked += servers[k].acked;
+        lost  += servers[k].lost;
+    }
+    const double elapsed_s = (get_time_ms() - start) / 1000;
+    printf("%" PRIu64 " pairs read, %" PRIu64 " replica writes acknowledged, %" PRIu64 " lost in %.1f s\n",
+           nb_read, acked, lost, elapsed_s);
+
+    if (error != ERR_NONE) {
+        fprintf(stderr, "%s is truncated or corrupted after %" PRIu64 " pairs\n", rem_argv[0], nb_read);
+    } else if (count != nb_read) {
+        fprintf(stderr, "%s holds %" PRIu64 " pairs, %" PRIu64 " expected\n", rem_argv[0], nb_read, count);
+        error = ERR_IO;
+    }
+    if (too_large > 0) {
+        fprintf(stderr, "%" PRIu64 " pairs too large for a batch skipped\n", too_large);
+    }
+
+    free(servers);
+    ring_free(ring);
+
+    return error != ERR_NONE ? error : lost > 0 || too_large > 0 ? ERR_NETWORK : ERR_NONE;
+}
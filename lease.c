@@ -0,0 +1,121 @@
+/**
+ * @file lease.c
+ * @brief Implementation of lease.h
+ *
+ * An invalidation is PPS_OP_PREFIX, PPS_OP_INVALIDATE and the key.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/socket.h>
+
+#include "lease.h"
+#include "config.h"
+
+static void free_lease(lease_table_t *leases, lease_t *lease) {
+    free(lease->key);
+    free(lease);
+    leases->size -= 1;
+}
+
+//Drop the expired leases of a bucket
+static void purge(lease_table_t *leases, lease_t **bucket, double now) {
+    while (*bucket != NULL) {
+        lease_t *lease = *bucket;
+        if (lease->expires <= now) {
+            *bucket = lease->next;
+            free_lease(leases, lease);
+        } else {
+            bucket = &lease->next;
+        }
+    }
+}
+
+void lease_init(lease_table_t *leases, double duration_ms) {
+    if (leases != NULL) {
+        memset(leases, 0, sizeof(*leases));
+        leases->duration_ms = duration_ms;
+    }
+}
+
+void lease_end(lease_table_t *leases) {
+    if (leases != NULL) {
+        for (size_t b = 0; b < LEASE_BUCKETS; ++b) {
+            purge(leases, &leases->buckets[b], INFINITY);
+        }
+    }
+}
+
+double lease_grant(lease_table_t *leases, pps_key_t key, const struct sockaddr_in *holder, double now) {
+
+    if (leases == NULL || key == NULL || holder == NULL || leases->duration_ms <= 0) {
+        return 0;
+    }
+
+    lease_t **bucket = &leases->buckets[hash_function(key, LEASE_BUCKETS)];
+    purge(leases, bucket, now);
+
+    for (lease_t *lease = *bucket; lease != NULL; lease = lease->next) {
+        if (lease->holder.sin_addr.s_addr == holder->sin_addr.s_addr && lease->holder.sin_port == holder->sin_port
+            && strcmp(lease->key, key) == 0) {
+            lease->expires = now + leases->duration_ms;
+            return leases->duration_ms;
+        }
+    }
+
+    if (leases->size >= LEASE_MAX) {
+        for (size_t b = 0; b < LEASE_BUCKETS; ++b) {
+            purge(leases, &leases->buckets[b], now);
+        }
+        if (leases->size >= LEASE_MAX) {
+            return 0;
+        }
+    }
+
+    lease_t *lease = calloc(1, sizeof(lease_t));
+    if (lease == NULL || (lease->key = strdup(key)) == NULL) {
+        free(lease);
+        return 0;
+    }
+    lease->holder  = *holder;
+    lease->expires = now + leases->duration_ms;
+    lease->next    = *bucket;
+    *bucket        = lease;
+    leases->size  += 1;
+
+    return leases->duration_ms;
+}
+
+size_t lease_revoke(lease_table_t *leases, pps_key_t key, int socket, double now) {
+
+    if (leases == NULL || key == NULL || leases->size == 0) {
+        return 0;
+    }
+
+    char msg[2 + MAX_MSG_ELEM_SIZE];
+    const size_t key_len = strnlen(key, MAX_MSG_ELEM_SIZE);
+    msg[0] = PPS_OP_PREFIX;
+    msg[1] = PPS_OP_INVALIDATE;
+    memcpy(msg + 2, key, key_len);
+
+    size_t sent = 0;
+    lease_t **bucket = &leases->buckets[hash_function(key, LEASE_BUCKETS)];
+    while (*bucket != NULL) {
+        lease_t *lease = *bucket;
+        if (strcmp(lease->key, key) == 0) {
+            if (lease->expires > now) {
+                sendto(socket, msg, 2 + key_len, 0, (const struct sockaddr *) &lease->holder, sizeof(lease->holder));
+                ++sent;
+            }
+            *bucket = lease->next;
+            free_lease(leases, lease);
+        } else {
+            bucket = &lease->next;
+        }
+    }
+
+    return sent;
+}
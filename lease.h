@@ -0,0 +1,78 @@
+#pragma once
+
+/**
+ * @file lease.h
+ * @brief Read leases granted by a server to caching clients (see cache.h): a write to a key
+ *        revokes its leases by sending an invalidation to their holders.
+ */
+
+#include <stddef.h>
+#include <netinet/in.h>
+
+#include "hashtable.h"
+
+/**
+ * @brief default lease duration, which bounds the staleness of a cached value
+ *        when an invalidation is lost
+ */
+#define LEASE_DEFAULT_MS 1000
+
+/**
+ * @brief maximum number of leases a server keeps track of: no lease is granted beyond
+ */
+#define LEASE_MAX 4096
+#define LEASE_BUCKETS 1024
+
+typedef struct lease lease_t;
+
+/**
+ * @brief a lease on a key held by a client
+ */
+struct lease {
+    struct sockaddr_in holder;
+    char *key;
+    double expires;
+    lease_t *next;
+};
+
+/**
+ * @brief the leases granted by a server, by key hash
+ */
+typedef struct {
+    double duration_ms;       // 0 to grant no lease
+    lease_t *buckets[LEASE_BUCKETS];
+    size_t size;
+} lease_table_t;
+
+/**
+ * @brief initialize an empty lease table
+ * @param leases the table to initialize
+ * @param duration_ms duration of the leases, 0 to grant none
+ */
+void lease_init(lease_table_t *leases, double duration_ms);
+
+/**
+ * @brief free the lease table
+ * @param leases the table to free
+ */
+void lease_end(lease_table_t *leases);
+
+/**
+ * @brief grant (or extend) a lease on a key
+ * @param leases the lease table
+ * @param key the key
+ * @param holder the client asking for it
+ * @param now current time (get_time_ms)
+ * @return the duration of the lease in milliseconds, 0 if none is granted
+ */
+double lease_grant(lease_table_t *leases, pps_key_t key, const struct sockaddr_in *holder, double now);
+
+/**
+ * @brief revoke the leases on a key, sending an invalidation to each holder
+ * @param leases the lease table
+ * @param key the key being written
+ * @param socket the server socket
+ * @param now current time
+ * @return the number of invalidations sent
+ */
+size_t lease_revoke(lease_table_t *leases, pps_key_t key, int socket, double now);
@@ -0,0 +1,92 @@
+/**
+ * @file pps-list-members.c
+ * @brief print the membership view of a node (state and incarnation of every server)
+ *        and its gossip statistics (failure detection time and gossip bandwidth)
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "config.h"
+#include "system.h"
+#include "error.h"
+#include "gossip.h"
+
+#define MAX_PORT 65535
+
+static const char *const STATE_NAMES[] = {"alive", "suspect", "dead"};
+
+/**
+ * @brief send a control request to the node and wait for its reply
+ * @return the length of the reply, -1 on timeout or if the reply is not the expected one
+ */
+static ssize_t request(int s, const struct sockaddr_in *srv_addr, char op, char reply_op,
+                       unsigned char *reply, size_t size) {
+
+    const char message[2] = {PPS_OP_PREFIX, op};
+    if (sendto(s, message, sizeof(message), 0, (const struct sockaddr *) srv_addr, sizeof(*srv_addr)) == -1) {
+        return -1;
+    }
+
+    struct sockaddr_in from;
+    socklen_t          from_len = sizeof(from);
+    ssize_t len = recvfrom(s, reply, size, 0, (struct sockaddr *) &from, &from_len);
+    if (len < 2 || reply[0] != PPS_OP_PREFIX || reply[1] != (unsigned char) reply_op) {
+        return -1;
+    }
+
+    return len;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s IP port\n", argv[0]);
+        return ERR_BAD_PARAMETER;
+    }
+
+    int s = get_socket(1);
+    M_EXIT_IF(s == -1, ERR_NETWORK, "get socket", "%s", "problem with socket");
+
+    int port = 0;
+    M_EXIT_IF(sscanf(argv[2], "%d", &port) != 1 || port < 0 || port > MAX_PORT,
+              ERR_BAD_PARAMETER, "port", "%s", "wrong program input");
+
+    struct sockaddr_in srv_addr;
+    M_EXIT_IF_ERR(get_server_addr(argv[1], (uint16_t) port, &srv_addr), "failed to get server address");
+
+    unsigned char reply[MAX_MSG_SIZE + 1];
+
+    ssize_t len = request(s, &srv_addr, PPS_OP_MEMBERSHIP, PPS_OP_MEMBERSHIP_REPLY, reply, MAX_MSG_SIZE);
+    M_EXIT_IF(len == -1, ERR_NETWORK, "pps-list-members", "%s", "no membership reply (is the node in the servers file?)");
+
+    printf("%-15s %5s %-8s %s\n", "server", "port", "state", "incarnation");
+    for (size_t offset = 2; offset + GOSSIP_UPDATE_SIZE <= (size_t) len; offset += GOSSIP_UPDATE_SIZE) {
+        const unsigned char *update = reply + offset;
+
+        struct in_addr ip;
+        uint16_t       member_port;
+        memcpy(&ip.s_addr, update, 4);
+        memcpy(&member_port, update + 4, 2);
+        const uint32_t incarnation = (uint32_t) update[7] << 24 | (uint32_t) update[8] << 16
+                                     | (uint32_t) update[9] << 8 | (uint32_t) update[10];
+
+        char ip_str[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &ip, ip_str, INET_ADDRSTRLEN);
+        printf("%-15s %5d %-8s %u\n", ip_str, ntohs(member_port),
+               update[6] <= MEMBER_DEAD ? STATE_NAMES[update[6]] : "?", incarnation);
+    }
+
+    len = request(s, &srv_addr, PPS_OP_GOSSIP_STATS, PPS_OP_GOSSIP_STATS, reply, MAX_MSG_SIZE);
+    if (len != -1) {
+        reply[len] = '\0';
+        printf("\n%s", (const char *) reply + 2);
+    }
+
+    return 0;
+}
@@ -6,6 +6,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <inttypes.h> // for PRIx64
 
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -73,7 +74,12 @@ int main(void) {
 		inet_ntop(AF_INET, &(ipv4->sin_addr), ipAddress, INET_ADDRSTRLEN);
 
 		printf("%s %d (", ipAddress, ntohs(port));
-		print_sha(nodes_to_print->nodes[i].sha);
+		//The node id hash of the ring: only this one is computed
+		if (nodes_to_print->hash == RING_HASH_FAST) {
+			printf("%016" PRIx64, nodes_to_print->nodes[i].position);
+		} else {
+			print_sha(nodes_to_print->nodes[i].sha);
+		}
 
 		if (nodes_to_print->nodes[i].responsive == 1) {
 			printf(") OK\n");		
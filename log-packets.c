@@ -2,35 +2,128 @@
 #include <arpa/inet.h>
 #include <assert.h>
 #include <dlfcn.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 
+#include "trace_format.h"
+
 #define LOG_FILE "packets.log"
 
-#define PASS_THROUGH(fn, ...)                                                  \
-  (((__typeof__(fn) *)dlsym(RTLD_NEXT, #fn))(__VA_ARGS__))
+/*
+ * Binary traces (see trace_format.h), when PPS_TRACE_DIR is set: each thread maps its own ring
+ * of records, opened at its first datagram (again in a child after a fork).
+ */
+static __thread trace_header_t *ring = NULL;
+static __thread int ring_failed = 0;
 
-ssize_t sendto(int socket, const void *message, size_t length, int flags,
-               const struct sockaddr *dest_addr, socklen_t dest_len)
+//Whether PPS_TRACE_DIR is set, -1 until looked up
+static int tracing = -1;
+
+static int is_tracing(void)
 {
-    const char *delay_str = getenv("SEND_DELAY");
-    if (delay_str) {
-        usleep(atoi(delay_str) * 1000);
+    if (tracing < 0) {
+        tracing = getenv(PPS_TRACE_DIR_ENV) != NULL;
+    }
+    return tracing;
+}
+
+static trace_header_t *open_ring(const char *dir)
+{
+    const char *records = getenv(PPS_TRACE_RECORDS_ENV);
+    const long capacity = records != NULL && atol(records) > 0 ? atol(records) : TRACE_DEFAULT_RECORDS;
+    const pid_t tid = (pid_t) syscall(SYS_gettid);
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/trace-%d-%d.bin", dir, (int) getpid(), (int) tid);
+    const size_t size = sizeof(trace_header_t) + (size_t) capacity * sizeof(trace_record_t);
+    const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return NULL;
+    }
+    void *map = ftruncate(fd, (off_t) size) == 0
+                ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
     }
 
+    trace_header_t *header = map;
+    memcpy(header->magic, TRACE_MAGIC, TRACE_MAGIC_SIZE);
+    header->record_size = sizeof(trace_record_t);
+    header->capacity    = (uint32_t) capacity;
+    header->pid         = (int32_t) getpid();
+    header->tid         = (int32_t) tid;
+    return header;
+}
+
+static void trace(trace_direction_t direction, int socket, const void *message, size_t length,
+                  const struct sockaddr *peer)
+{
+    if (ring != NULL && ring->pid != getpid()) {
+        //Forked: the ring is the parent's
+        ring = NULL;
+        ring_failed = 0;
+    }
+    if (ring == NULL && !ring_failed) {
+        ring = open_ring(getenv(PPS_TRACE_DIR_ENV));
+        ring_failed = ring == NULL;
+    }
+    if (ring == NULL) {
+        return;
+    }
+
+    trace_record_t *records = (trace_record_t *) (ring + 1);
+    trace_record_t *record  = &records[ring->head % ring->capacity];
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    record->t_ns = (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+
+    struct sockaddr_in local;
+    socklen_t local_len = sizeof(local);
+    memset(&local, 0, sizeof(local));
+    getsockname(socket, (struct sockaddr *) &local, &local_len);
+    struct sockaddr_in remote;
+    memset(&remote, 0, sizeof(remote));
+    if (peer != NULL && peer->sa_family == AF_INET) {
+        memcpy(&remote, peer, sizeof(remote));
+    }
+    const struct sockaddr_in *src = direction == TRACE_SENT ? &local : &remote;
+    const struct sockaddr_in *dst = direction == TRACE_SENT ? &remote : &local;
+    record->src_ip   = src->sin_addr.s_addr;
+    record->src_port = src->sin_port;
+    record->dst_ip   = dst->sin_addr.s_addr;
+    record->dst_port = dst->sin_port;
+
+    const uint8_t *bytes = message;
+    record->length    = (uint32_t) length;
+    record->captured  = (uint16_t) (length < TRACE_PAYLOAD_SIZE ? length : TRACE_PAYLOAD_SIZE);
+    record->direction = (uint8_t) direction;
+    record->kind      = length == 0 ? TRACE_EMPTY : length >= 2 && bytes[0] == '\0' ? TRACE_CONTROL : TRACE_DATA;
+    record->opcode    = record->kind == TRACE_CONTROL ? bytes[1] : 0;
+    memcpy(record->payload, bytes, record->captured);
+
+    //Published once written, for a reader of the file while the process runs
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+static void log_text(int socket, const void *message, size_t length,
+                     const struct sockaddr *dest_addr)
+{
     FILE *log = fopen(LOG_FILE, "a");
     assert(log && "Unable to open packet log file.");
 
     assert(flock(fileno(log), LOCK_EX) == 0 && "Unable to lock log file.");
 
-    ssize_t result =
-        PASS_THROUGH(sendto, socket, message, length, flags, dest_addr, dest_len);
-
     struct sockaddr_in bind_addr;
     socklen_t bind_len = sizeof(bind_addr);
     assert(getsockname(socket, &bind_addr, &bind_len) == 0);
@@ -52,6 +145,53 @@ ssize_t sendto(int socket, const void *message, size_t length, int flags,
     assert(flock(fileno(log), LOCK_UN) == 0 && "Unable to unlock log file.");
 
     fclose(log);
+}
+
+ssize_t sendto(int socket, const void *message, size_t length, int flags,
+               const struct sockaddr *dest_addr, socklen_t dest_len)
+{
+    static __typeof__(sendto) *real_sendto = NULL;
+    if (real_sendto == NULL) {
+        real_sendto = (__typeof__(sendto) *) dlsym(RTLD_NEXT, "sendto");
+    }
+
+    const char *delay_str = getenv("SEND_DELAY");
+    if (delay_str) {
+        usleep(atoi(delay_str) * 1000);
+    }
+
+    ssize_t result = real_sendto(socket, message, length, flags, dest_addr, dest_len);
+
+    if (is_tracing()) {
+        if (result >= 0) {
+            trace(TRACE_SENT, socket, message, length, dest_addr);
+        }
+    } else {
+        log_text(socket, message, length, dest_addr);
+    }
+
+    return result;
+}
+
+ssize_t recvfrom(int socket, void *buffer, size_t length, int flags,
+                 struct sockaddr *src_addr, socklen_t *src_len)
+{
+    static __typeof__(recvfrom) *real_recvfrom = NULL;
+    if (real_recvfrom == NULL) {
+        real_recvfrom = (__typeof__(recvfrom) *) dlsym(RTLD_NEXT, "recvfrom");
+    }
+
+    //The sender is needed even if the caller does not ask for it
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    ssize_t result = real_recvfrom(socket, buffer, length, flags,
+                                   src_addr != NULL ? src_addr : (struct sockaddr *) &from,
+                                   src_addr != NULL ? src_len : &from_len);
+
+    if (result >= 0 && is_tracing()) {
+        trace(TRACE_RECEIVED, socket, buffer, (size_t) result,
+              src_addr != NULL ? src_addr : (struct sockaddr *) &from);
+    }
 
     return result;
 }
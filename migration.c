@@ -0,0 +1,600 @@
+/**
+ * @file migration.c
+ * @brief Implementation of migration.h
+ *
+ * Migration messages: PPS_OP_PREFIX, opcode, then
+ *  - MIGRATE: sequence number (4 bytes) and key\0value\0 pairs, acknowledged by MIGRATE_ACK
+ *    with the same sequence number. Sequence number 0 is not acknowledged: it is used for the
+ *    notice sent when a migration starts (no pairs) and for the answers to MIGRATE_GET;
+ *  - MIGRATE_DONE: nothing, when the sender has no more keys for the receiver;
+ *  - MIGRATE_GET: a key, answered by a MIGRATE with sequence number 0 and the pair if the
+ *    sender has it, by a MIGRATE_GET with an empty key followed by the key otherwise.
+ * Migrated keys never overwrite a local value: it was written by a client with the new ring.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h> // for INFINITY
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "migration.h"
+#include "config.h"
+#include "system.h"
+#include "util.h"
+
+#define SEQ_SIZE 4
+#define MIGRATE_HEADER_SIZE (2 + SEQ_SIZE)
+
+static void put_u32(unsigned char *out, uint32_t value) {
+    out[0] = (unsigned char) (value >> 24);
+    out[1] = (unsigned char) (value >> 16);
+    out[2] = (unsigned char) (value >> 8);
+    out[3] = (unsigned char) value;
+}
+
+static uint32_t get_u32(const unsigned char *in) {
+    return (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16 | (uint32_t) in[2] << 8 | (uint32_t) in[3];
+}
+
+static int same_addr(const struct sockaddr_in *first, const struct sockaddr_in *second) {
+    return first->sin_addr.s_addr == second->sin_addr.s_addr && first->sin_port == second->sin_port;
+}
+
+static const struct sockaddr_in *server_addr(const ring_t *ring, size_t server) {
+    return (const struct sockaddr_in *) &ring->servers[server].addr;
+}
+
+static int is_self(const migration_t *migration, const node_t *node) {
+    return same_addr(&migration->self, (const struct sockaddr_in *) &node->addr);
+}
+
+static size_t replicas(const migration_t *migration, const ring_t *ring) {
+    return migration->config.replication < ring->pref_size ? migration->config.replication : ring->pref_size;
+}
+
+static void send_control(int socket, uint8_t op, uint32_t seq, int with_seq, const struct sockaddr_in *to) {
+    unsigned char msg[MIGRATE_HEADER_SIZE] = {PPS_OP_PREFIX, op};
+    put_u32(msg + 2, seq);
+    sendto(socket, msg, with_seq ? MIGRATE_HEADER_SIZE : 2, 0, (const struct sockaddr *) to, sizeof(*to));
+}
+
+void migration_default_config(migration_config_t *config) {
+    if (config != NULL) {
+        config->replication = MIGRATION_DEFAULT_REPLICATION;
+        config->rate        = MIGRATION_DEFAULT_RATE;
+        config->batch_size  = MIGRATION_DEFAULT_BATCH_SIZE;
+        config->retry_ms    = MIGRATION_DEFAULT_RETRY_MS;
+        config->max_tries   = MIGRATION_DEFAULT_MAX_TRIES;
+    }
+}
+
+void migration_init(migration_t *migration, const migration_config_t *config, const struct sockaddr_in *self) {
+    if (migration != NULL && config != NULL && self != NULL) {
+        memset(migration, 0, sizeof(*migration));
+        migration->config = *config;
+        migration->self   = *self;
+    }
+}
+
+//Count a transfer of a key as done: the last one drops the key, unless one failed (or table is NULL)
+static void drop_done(migration_t *migration, migration_drop_t *drop, int acked, Htable_t table) {
+    drop->failed |= !acked;
+    if (--drop->pending == 0) {
+        if (!drop->failed && table != NULL && del_Htable_key(table, drop->key) == ERR_NONE) {
+            ++migration->keys_dropped;
+        }
+        free(drop->key);
+        free(drop);
+    }
+}
+
+//Free a batch, acknowledged or not
+static void batch_free(migration_t *migration, migration_batch_t *batch, int acked, Htable_t table) {
+    for (size_t i = 0; i < batch->count; ++i) {
+        if (batch->drops[i] != NULL) {
+            drop_done(migration, batch->drops[i], acked, table);
+        }
+    }
+    free(batch->msg);
+    free(batch->drops);
+    memset(batch, 0, sizeof(*batch));
+}
+
+//Free the outgoing state, keeping the keys not acknowledged yet
+static void stop(migration_t *migration) {
+    for (size_t i = 0; i < migration->queue_size; ++i) {
+        batch_free(migration, &migration->queue[i], 0, NULL);
+    }
+    for (size_t i = 0; migration->open != NULL && i < migration->new_ring->nb_servers; ++i) {
+        batch_free(migration, &migration->open[i], 0, NULL);
+    }
+    ring_free(migration->old_ring);
+    free(migration->open);
+    free(migration->queue);
+    migration->old_ring        = NULL;
+    migration->open            = NULL;
+    migration->queue           = NULL;
+    migration->queue_size      = 0;
+    migration->queue_allocated = 0;
+    migration->active          = 0;
+}
+
+void migration_end(migration_t *migration) {
+    if (migration != NULL) {
+        stop(migration);
+        for (size_t i = 0; i < MIGRATION_MAX_WAITS; ++i) {
+            migration_wait_free(&migration->waits[i]);
+        }
+    }
+}
+
+//Send a message to every server of the new ring but the local one
+static void send_all(const migration_t *migration, int socket, uint8_t op, int with_seq) {
+    for (size_t i = 0; i < migration->new_ring->nb_servers; ++i) {
+        if (!is_self(migration, &migration->new_ring->servers[i])) {
+            send_control(socket, op, 0, with_seq, server_addr(migration->new_ring, i));
+        }
+    }
+}
+
+error_code migration_start(migration_t *migration, ring_t *old_ring, const ring_t *new_ring,
+                           Htable_t table, int socket, double now) {
+
+    //The old ring is ours from here on, even if we cannot start
+    if (migration == NULL || new_ring == NULL || table == NULL) {
+        ring_free(old_ring);
+        return ERR_BAD_PARAMETER;
+    }
+    M_REQUIRE_NON_NULL(old_ring);
+
+    if (migration->active) {
+        fprintf(stderr, "migration: abandoned at bucket %zu of %zu, starting a new one\n",
+                migration->next_bucket, table->size);
+    }
+    stop(migration);
+
+    migration->old_ring = old_ring;
+    migration->new_ring = new_ring;
+    migration->open     = calloc(new_ring->nb_servers + 1, sizeof(migration_batch_t));
+    if (migration->open == NULL) {
+        stop(migration);
+        return ERR_NOMEM;
+    }
+
+    migration->active       = 1;
+    migration->next_bucket  = 0;
+    migration->tokens       = 0;
+    migration->last_refill  = now;
+    migration->started      = now;
+    migration->bytes_sent   = 0;
+    migration->keys_acked   = 0;
+    migration->keys_failed  = 0;
+    migration->keys_dropped = 0;
+
+    //Tell the other servers to ask us for the keys they miss until we are done
+    send_all(migration, socket, PPS_OP_MIGRATE, 1);
+
+    return ERR_NONE;
+}
+
+//Move the open batch of a server to the queue
+static error_code enqueue(migration_t *migration, size_t server) {
+    if (migration->queue_size == migration->queue_allocated) {
+        const size_t allocated = 2 * migration->queue_allocated + MIGRATION_MAX_INFLIGHT;
+        migration_batch_t *queue = realloc(migration->queue, allocated * sizeof(migration_batch_t));
+        M_REQUIRE_NON_NULL_CUSTOM_ERR(queue, ERR_NOMEM);
+        migration->queue           = queue;
+        migration->queue_allocated = allocated;
+    }
+    migration->next_seq = migration->next_seq + 1 == 0 ? 1 : migration->next_seq + 1;
+    migration_batch_t *batch = &migration->open[server];
+    batch->seq = migration->next_seq;
+    put_u32((unsigned char *) batch->msg + 2, batch->seq);
+    migration->queue[migration->queue_size++] = *batch;
+    memset(batch, 0, sizeof(*batch));
+    return ERR_NONE;
+}
+
+//Add a pair to the open batch of a server, moving it to the queue first if the pair does not fit
+static error_code add_to_batch(migration_t *migration, size_t server, const kv_pair_t *pair, size_t pair_len,
+                               migration_drop_t *drop) {
+    const size_t limit = migration->config.batch_size < MAX_MSG_SIZE ? migration->config.batch_size : MAX_MSG_SIZE;
+    migration_batch_t *batch = &migration->open[server];
+    if (batch->count > 0 && batch->len + pair_len > limit) {
+        error_code error = enqueue(migration, server);
+        if (error != ERR_NONE) {
+            return error;
+        }
+    }
+    if (batch->msg == NULL) {
+        batch->msg = malloc(MIGRATE_HEADER_SIZE + pair_len > limit ? MIGRATE_HEADER_SIZE + pair_len : limit);
+        M_REQUIRE_NON_NULL_CUSTOM_ERR(batch->msg, ERR_NOMEM);
+        batch->msg[0] = PPS_OP_PREFIX;
+        batch->msg[1] = PPS_OP_MIGRATE;
+        batch->len    = MIGRATE_HEADER_SIZE;
+        batch->server = server;
+    }
+    if (batch->count == batch->allocated) {
+        const size_t allocated = 2 * batch->allocated + 16;
+        migration_drop_t **drops = realloc(batch->drops, allocated * sizeof(migration_drop_t *));
+        M_REQUIRE_NON_NULL_CUSTOM_ERR(drops, ERR_NOMEM);
+        batch->drops     = drops;
+        batch->allocated = allocated;
+    }
+
+    const size_t key_len = strlen(pair->key) + 1;
+    memcpy(batch->msg + batch->len, pair->key, key_len);
+    memcpy(batch->msg + batch->len + key_len, pair->value, pair_len - key_len);
+    batch->len += pair_len;
+    batch->drops[batch->count++] = drop;
+    if (drop != NULL) {
+        ++drop->pending;
+    }
+    return ERR_NONE;
+}
+
+/**
+ * @brief add a pair of the table to the batches of its destinations: a key is sent by the first of
+ *        its old replicas that is still in the new ring (or its old primary if none is), to each of
+ *        its new replicas that did not have it
+ */
+static void add_pair(const kv_pair_t *pair, void *arg) {
+    migration_t  *migration = arg;
+    const ring_t *old_ring  = migration->old_ring;
+    const ring_t *new_ring  = migration->new_ring;
+
+    node_t      before_row[RING_MAX_PREFERENCE_SIZE];
+    node_t      after_row[RING_MAX_PREFERENCE_SIZE];
+    node_list_t before = ring_get_nodes_for_key(old_ring, replicas(migration, old_ring), pair->key, before_row);
+    node_list_t after  = ring_get_nodes_for_key(new_ring, replicas(migration, new_ring), pair->key, after_row);
+    if (before.size == 0) {
+        return;
+    }
+
+    const node_t *sender = &before.nodes[0];
+    for (size_t i = 0; i < before.size; ++i) {
+        if (ring_server_index(new_ring, &before.nodes[i]) != SIZE_MAX) {
+            sender = &before.nodes[i];
+            break;
+        }
+    }
+    if (!is_self(migration, sender)) {
+        return;
+    }
+
+    const size_t pair_len = strlen(pair->key) + strlen(pair->value) + 2;
+    int owner = 0;
+    size_t nb_destinations = 0;
+    for (size_t i = 0; i < after.size; ++i) {
+        owner |= is_self(migration, &after.nodes[i]);
+        nb_destinations += server_different(&before, &after.nodes[i]) && !is_self(migration, &after.nodes[i]);
+    }
+    if (nb_destinations == 0) {
+        return;
+    }
+    if (MIGRATE_HEADER_SIZE + pair_len > MAX_MSG_SIZE) {
+        migration->keys_failed += nb_destinations;
+        return;
+    }
+
+    //The key goes once it reached all its new replicas, if we are not one of them
+    migration_drop_t *drop = NULL;
+    if (!owner) {
+        drop = calloc(1, sizeof(migration_drop_t));
+        if (drop != NULL && (drop->key = strdup(pair->key)) == NULL) {
+            free(drop);
+            drop = NULL;
+        }
+        if (drop == NULL) {
+            ++migration->keys_failed;
+            return;
+        }
+        //Held until every batch holds the key, in case one fails
+        drop->pending = 1;
+    }
+
+    for (size_t i = 0; i < after.size; ++i) {
+        if (server_different(&before, &after.nodes[i]) && !is_self(migration, &after.nodes[i])
+            && add_to_batch(migration, ring_server_index(new_ring, &after.nodes[i]), pair, pair_len, drop)
+               != ERR_NONE) {
+            ++migration->keys_failed;
+            if (drop != NULL) {
+                drop->failed = 1;
+            }
+        }
+    }
+    //Release the hold: a key no batch holds stays
+    if (drop != NULL && --drop->pending == 0) {
+        free(drop->key);
+        free(drop);
+    }
+}
+//Send (or send again) a batch, within the rate limit
+static void send_batch(migration_t *migration, migration_batch_t *batch, int socket, double now) {
+    const struct sockaddr_in *to = server_addr(migration->new_ring, batch->server);
+    sendto(socket, batch->msg, batch->len, 0, (const struct sockaddr *) to, sizeof(*to));
+
+    batch->sent_at = now;
+    batch->tries  += 1;
+    migration->tokens     -= (double) batch->len;
+    migration->bytes_sent += batch->len;
+}
+
+//Every batch acknowledged or failed: tell the other servers we are done
+static void finish(migration_t *migration, int socket, double now) {
+
+    send_all(migration, socket, PPS_OP_MIGRATE_DONE, 0);
+
+    fprintf(stderr, "migration: done in %.0f ms, %zu keys sent (%zu bytes), %zu failed, %zu dropped\n",
+            now - migration->started, migration->keys_acked, migration->bytes_sent, migration->keys_failed,
+            migration->keys_dropped);
+
+    stop(migration);
+}
+
+void migration_tick(migration_t *migration, Htable_t table, int socket, double now) {
+
+    if (migration == NULL || !migration->active) {
+        return;
+    }
+
+    //Walk on while few batches wait, then send what is left in the open batches
+    while (migration->next_bucket < table->size && migration->queue_size < MIGRATION_MAX_INFLIGHT) {
+        visit_Htable_bucket(table, migration->next_bucket++, add_pair, migration);
+    }
+    for (size_t i = 0; migration->next_bucket >= table->size && i < migration->new_ring->nb_servers; ++i) {
+        if (migration->open[i].count > 0 && enqueue(migration, i) != ERR_NONE) {
+            migration->keys_failed += migration->open[i].count;
+            batch_free(migration, &migration->open[i], 0, table);
+        }
+    }
+
+    //Token bucket: at most one batch of burst
+    migration->tokens += migration->config.rate * (now - migration->last_refill) / 1e3;
+    if (migration->tokens > (double) migration->config.batch_size) {
+        migration->tokens = (double) migration->config.batch_size;
+    }
+    migration->last_refill = now;
+
+    size_t inflight = 0;
+    for (size_t b = 0; b < migration->queue_size; ) {
+        migration_batch_t *batch = &migration->queue[b];
+        if (batch->tries > 0 && now - batch->sent_at >= migration->config.retry_ms) {
+            if (batch->tries >= migration->config.max_tries) {
+                migration->keys_failed += batch->count;
+                batch_free(migration, batch, 0, table);
+                migration->queue[b] = migration->queue[--migration->queue_size];
+                continue;
+            }
+            if (migration->tokens > 0) {
+                send_batch(migration, batch, socket, now);
+            }
+        }
+        inflight += batch->tries > 0;
+        ++b;
+    }
+
+    for (size_t b = 0; b < migration->queue_size && inflight < MIGRATION_MAX_INFLIGHT && migration->tokens > 0; ++b) {
+        if (migration->queue[b].tries == 0) {
+            send_batch(migration, &migration->queue[b], socket, now);
+            ++inflight;
+        }
+    }
+
+    if (migration->next_bucket >= table->size && migration->queue_size == 0) {
+        finish(migration, socket, now);
+    }
+}
+
+//Remember (or refresh) a server streaming to us
+static void add_source(migration_t *migration, const struct sockaddr_in *from, double now) {
+    migration_source_t *free_slot = NULL;
+    for (size_t i = 0; i < MIGRATION_MAX_SOURCES; ++i) {
+        migration_source_t *source = &migration->sources[i];
+        if (source->expires > now && same_addr(&source->addr, from)) {
+            source->expires = now + MIGRATION_SOURCE_TIMEOUT_MS;
+            return;
+        }
+        if (free_slot == NULL && source->expires <= now) {
+            free_slot = source;
+        }
+    }
+    if (free_slot != NULL) {
+        free_slot->addr    = *from;
+        free_slot->expires = now + MIGRATION_SOURCE_TIMEOUT_MS;
+    }
+}
+
+//A key a request waits for arrived, or a source answered that it does not have it
+static void key_answered(migration_t *migration, pps_key_t key, int found) {
+    for (size_t i = 0; i < MIGRATION_MAX_WAITS; ++i) {
+        migration_wait_t *wait = &migration->waits[i];
+        if (wait->request != NULL && wait->waiting > 0 && strcmp(wait->key, key) == 0) {
+            wait->waiting = found ? 0 : wait->waiting - 1;
+        }
+    }
+}
+
+//Store the pairs of a batch, unless a (newer) value is already there
+static void store_batch(migration_t *migration, Htable_t table, const char *msg, size_t len) {
+    size_t offset = MIGRATE_HEADER_SIZE;
+    while (offset < len) {
+        const char  *key       = msg + offset;
+        const size_t key_len   = strnlen(key, len - offset);
+        if (offset + key_len + 1 >= len) {
+            break;
+        }
+        const char  *value     = key + key_len + 1;
+        const size_t value_len = strnlen(value, len - offset - key_len - 1);
+        if (offset + key_len + 1 + value_len >= len) {
+            break;
+        }
+
+        pps_value_t current = get_Htable_value(table, key);
+        if (current == NULL) {
+            add_Htable_value(table, key, value);
+        } else {
+            free_const_ptr(current);
+        }
+        key_answered(migration, key, 1);
+        offset += key_len + value_len + 2;
+    }
+}
+
+int migration_handle(migration_t *migration, Htable_t table, int socket, const char *msg, size_t len,
+                     const struct sockaddr_in *from, double now) {
+
+    if (migration == NULL || msg == NULL || from == NULL || len < 2 || msg[0] != PPS_OP_PREFIX) {
+        return 0;
+    }
+    const unsigned char *in = (const unsigned char *) msg;
+
+    switch (in[1]) {
+    case PPS_OP_MIGRATE:
+        if (len >= MIGRATE_HEADER_SIZE) {
+            const uint32_t seq = get_u32(in + 2);
+            store_batch(migration, table, msg, len);
+            if (seq != 0) {
+                add_source(migration, from, now);
+                send_control(socket, PPS_OP_MIGRATE_ACK, seq, 1, from);
+            } else if (len == MIGRATE_HEADER_SIZE) {
+                add_source(migration, from, now);
+            }
+        }
+        return 1;
+
+    case PPS_OP_MIGRATE_ACK:
+        if (len >= MIGRATE_HEADER_SIZE && migration->active) {
+            const uint32_t seq = get_u32(in + 2);
+            for (size_t b = 0; b < migration->queue_size; ++b) {
+                migration_batch_t *batch = &migration->queue[b];
+                if (batch->seq == seq && batch->tries > 0) {
+                    migration->keys_acked += batch->count;
+                    batch_free(migration, batch, 1, table);
+                    migration->queue[b] = migration->queue[--migration->queue_size];
+                    break;
+                }
+            }
+        }
+        return 1;
+
+    case PPS_OP_MIGRATE_DONE:
+        for (size_t i = 0; i < MIGRATION_MAX_SOURCES; ++i) {
+            if (same_addr(&migration->sources[i].addr, from)) {
+                migration->sources[i].expires = 0;
+            }
+        }
+        return 1;
+
+    case PPS_OP_MIGRATE_GET: {
+        //The key is nul-terminated: the server clears its buffer before each message
+        if (len > 3 && msg[2] == '\0') {
+            key_answered(migration, msg + 3, 0);
+            return 1;
+        }
+        const char *key = msg + 2;
+        const size_t key_len = strlen(key);
+        pps_value_t value = get_Htable_value(table, key);
+        char reply[MAX_MSG_SIZE];
+        if (value != NULL && MIGRATE_HEADER_SIZE + key_len + strlen(value) + 2 <= MAX_MSG_SIZE) {
+            const size_t value_len = strlen(value);
+            memset(reply, 0, MIGRATE_HEADER_SIZE);
+            reply[1] = PPS_OP_MIGRATE;
+            memcpy(reply + MIGRATE_HEADER_SIZE, key, key_len + 1);
+            memcpy(reply + MIGRATE_HEADER_SIZE + key_len + 1, value, value_len + 1);
+            sendto(socket, reply, MIGRATE_HEADER_SIZE + key_len + value_len + 2, 0,
+                   (const struct sockaddr *) from, sizeof(*from));
+        } else if (key_len > 0 && 3 + key_len <= MAX_MSG_SIZE) {
+            reply[0] = PPS_OP_PREFIX;
+            reply[1] = PPS_OP_MIGRATE_GET;
+            reply[2] = '\0';
+            memcpy(reply + 3, key, key_len);
+            sendto(socket, reply, 3 + key_len, 0, (const struct sockaddr *) from, sizeof(*from));
+        }
+        free_const_ptr(value);
+        return 1;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+int migration_receiving(const migration_t *migration, double now) {
+    for (size_t i = 0; migration != NULL && i < MIGRATION_MAX_SOURCES; ++i) {
+        if (migration->sources[i].expires > now) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int migration_defer(migration_t *migration, int socket, const char *request, size_t len, size_t key,
+                    const struct sockaddr_in *cli_addr, socklen_t addr_len, double now) {
+
+    if (migration == NULL || request == NULL || cli_addr == NULL || key >= len
+        || !migration_receiving(migration, now)) {
+        return 0;
+    }
+    migration_wait_t *wait = NULL;
+    for (size_t i = 0; i < MIGRATION_MAX_WAITS && wait == NULL; ++i) {
+        wait = migration->waits[i].request == NULL ? &migration->waits[i] : NULL;
+    }
+    if (wait == NULL || (wait->request = calloc(len + 1, 1)) == NULL) {
+        return 0;
+    }
+    memcpy(wait->request, request, len);
+    wait->len      = len;
+    wait->key      = wait->request + key;
+    wait->cli_addr = *cli_addr;
+    wait->addr_len = addr_len;
+    wait->waiting  = 0;
+    wait->deadline = now + MIGRATION_WAIT_MS;
+
+    const size_t key_len = strlen(wait->key);
+    char message[MAX_MSG_SIZE];
+    message[0] = PPS_OP_PREFIX;
+    message[1] = PPS_OP_MIGRATE_GET;
+    memcpy(message + 2, wait->key, key_len < MAX_MSG_SIZE - 2 ? key_len : MAX_MSG_SIZE - 2);
+
+    for (size_t i = 0; i < MIGRATION_MAX_SOURCES; ++i) {
+        if (migration->sources[i].expires > now
+            && sendto(socket, message, 2 + (key_len < MAX_MSG_SIZE - 2 ? key_len : MAX_MSG_SIZE - 2), 0,
+                      (const struct sockaddr *) &migration->sources[i].addr, sizeof(struct sockaddr_in)) != -1) {
+            ++wait->waiting;
+        }
+    }
+
+    return 1;
+}
+
+migration_wait_t *migration_next_ready(migration_t *migration, double now) {
+    for (size_t i = 0; migration != NULL && i < MIGRATION_MAX_WAITS; ++i) {
+        migration_wait_t *wait = &migration->waits[i];
+        if (wait->request != NULL && (wait->waiting == 0 || now >= wait->deadline)) {
+            return wait;
+        }
+    }
+    return NULL;
+}
+
+void migration_wait_free(migration_wait_t *wait) {
+    if (wait != NULL) {
+        free(wait->request);
+        memset(wait, 0, sizeof(*wait));
+    }
+}
+
+double migration_next_timeout_ms(const migration_t *migration, double now) {
+    double wait = migration != NULL && migration->active ? migration->config.retry_ms / 4 : INFINITY;
+    for (size_t i = 0; migration != NULL && i < MIGRATION_MAX_WAITS; ++i) {
+        if (migration->waits[i].request != NULL && migration->waits[i].deadline - now < wait) {
+            wait = migration->waits[i].deadline - now;
+        }
+    }
+    return wait;
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+/**
+ * @file migration.h
+ * @brief Online data migration when servers join or leave the ring: when the servers file
+ *        changes, each server walks its table bucket by bucket and streams the keys it held
+ *        (as the first replica still present) to their new owners in rate-limited,
+ *        acknowledged batches, dropping each key it sent and no longer owns once all its
+ *        transfers are acknowledged. During the handoff, a request for a key a new owner
+ *        misses waits until the servers streaming to it sent the key or answered that they
+ *        do not have it.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "error.h"
+#include "ring.h"
+#include "hashtable.h"
+
+/**
+ * @brief default configuration (see migration_config_t)
+ */
+#define MIGRATION_DEFAULT_REPLICATION 3
+#define MIGRATION_DEFAULT_RATE 1000000
+#define MIGRATION_DEFAULT_BATCH_SIZE 8192
+#define MIGRATION_DEFAULT_RETRY_MS 200
+#define MIGRATION_DEFAULT_MAX_TRIES 5
+
+/**
+ * @brief maximum number of unacknowledged batches
+ */
+#define MIGRATION_MAX_INFLIGHT 8
+
+/**
+ * @brief maximum number of servers streaming to a server at the same time
+ */
+#define MIGRATION_MAX_SOURCES 16
+
+/**
+ * @brief a source is forgotten after this long without a batch (e.g. if its end is lost)
+ */
+#define MIGRATION_SOURCE_TIMEOUT_MS 10000
+
+/**
+ * @brief maximum number of requests waiting for a key during a handoff
+ */
+#define MIGRATION_MAX_WAITS 64
+
+/**
+ * @brief time a request waits for a key during a handoff
+ */
+#define MIGRATION_WAIT_MS 100
+
+/**
+ * @brief how often servers check whether the servers file changed
+ */
+#define MIGRATION_RELOAD_CHECK_MS 1000
+
+/**
+ * @brief migration settings
+ */
+typedef struct {
+    size_t replication;       // number of replicas of a key (N of the clients)
+    double rate;              // maximum migration bandwidth, in bytes per second
+    size_t batch_size;        // maximum size of a batch message, in bytes
+    double retry_ms;          // time before sending an unacknowledged batch again
+    size_t max_tries;         // number of sends of a batch before giving up
+} migration_config_t;
+
+/**
+ * @brief a key the server sends and no longer owns: it is dropped once all its transfers are
+ *        acknowledged, kept if one fails
+ */
+typedef struct {
+    char *key;
+    size_t pending;           // transfers not acknowledged yet
+    int failed;
+} migration_drop_t;
+
+/**
+ * @brief a batch of pairs for one server: being filled, waiting to be sent, or not acknowledged yet
+ */
+typedef struct {
+    uint32_t seq;
+    size_t server;            // index of the destination in the new ring
+    char *msg;                // the MIGRATE message (batch_size bytes, more for a larger pair), NULL while empty
+    size_t len;
+    migration_drop_t **drops; // drop of each pair, NULL for the keys the server keeps
+    size_t count;             // number of pairs
+    size_t allocated;         // of drops
+    double sent_at;
+    size_t tries;             // 0 until sent
+} migration_batch_t;
+
+/**
+ * @brief a server streaming keys to the local server
+ */
+typedef struct {
+    struct sockaddr_in addr;
+    double expires;           // 0 if the slot is free
+} migration_source_t;
+
+/**
+ * @brief a request for a key that is not here yet during a handoff (see migration_defer)
+ */
+typedef struct {
+    char *request;            // copy of the request, followed by a nul byte; NULL if the slot is free
+    size_t len;
+    pps_key_t key;            // in request
+    struct sockaddr_in cli_addr;
+    socklen_t addr_len;
+    size_t waiting;           // number of sources that did not answer yet
+    double deadline;
+} migration_wait_t;
+
+/**
+ * @brief migration state of a server: the outgoing stream and the incoming handoffs
+ */
+typedef struct {
+    migration_config_t config;
+    struct sockaddr_in self;
+    // outgoing
+    int active;
+    ring_t *old_ring;         // owned by the migration while active
+    const ring_t *new_ring;   // borrowed from the server
+    size_t next_bucket;       // next bucket of the table to walk
+    migration_batch_t *open;  // batch being filled for each server of the new ring
+    migration_batch_t *queue; // full batches, sent (at most MIGRATION_MAX_INFLIGHT) or not
+    size_t queue_size;
+    size_t queue_allocated;
+    uint32_t next_seq;
+    double tokens;            // token bucket of the rate limit, in bytes
+    double last_refill;
+    double started;
+    size_t bytes_sent;
+    size_t keys_acked;
+    size_t keys_failed;
+    size_t keys_dropped;
+    // incoming
+    migration_source_t sources[MIGRATION_MAX_SOURCES];
+    migration_wait_t waits[MIGRATION_MAX_WAITS];
+} migration_t;
+
+/**
+ * @brief set the default configuration
+ * @param config the configuration to set
+ */
+void migration_default_config(migration_config_t *config);
+
+/**
+ * @brief initialize an idle migration state
+ * @param migration the state to initialize
+ * @param config the configuration
+ * @param self address of the local server
+ */
+void migration_init(migration_t *migration, const migration_config_t *config, const struct sockaddr_in *self);
+
+/**
+ * @brief start migrating from an old to a new ring (a running migration is abandoned,
+ *        keeping all its keys)
+ * @param migration the migration state
+ * @param old_ring the previous ring; the migration always takes it over, even on error, and
+ *        frees it when done or abandoned (the caller must not free it after this call)
+ * @param new_ring the current ring, which must outlive the migration
+ * @param table the local content
+ * @param socket the server socket
+ * @param now current time (get_time_ms)
+ * @return some error code
+ */
+error_code migration_start(migration_t *migration, ring_t *old_ring, const ring_t *new_ring,
+                           Htable_t table, int socket, double now);
+
+/**
+ * @brief free the migration state
+ * @param migration the state to free
+ */
+void migration_end(migration_t *migration);
+
+/**
+ * @brief walk the table on and send batches (within the rate limit), retransmit lost ones and drop
+ *        the keys whose transfers are all acknowledged; end the migration once the walk is over and
+ *        every batch acknowledged or failed
+ * @param migration the migration state
+ * @param table the local content
+ * @param socket the server socket
+ * @param now current time
+ */
+void migration_tick(migration_t *migration, Htable_t table, int socket, double now);
+
+/**
+ * @brief handle a message if it belongs to the migration protocol
+ * @param migration the migration state
+ * @param table the local content
+ * @param socket the server socket
+ * @param msg the message
+ * @param len length of the message
+ * @param from sender of the message
+ * @param now current time
+ * @return 1 if the message was handled, 0 otherwise
+ */
+int migration_handle(migration_t *migration, Htable_t table, int socket, const char *msg, size_t len,
+                     const struct sockaddr_in *from, double now);
+
+/**
+ * @brief whether servers are streaming keys to the local server
+ * @param migration the migration state
+ * @param now current time
+ * @return 1 during a handoff, 0 otherwise
+ */
+int migration_receiving(const migration_t *migration, double now);
+
+/**
+ * @brief keep a request for a key the local server misses during a handoff, and ask the servers
+ *        streaming to it for the key: the request is ready (see migration_next_ready) once one of
+ *        them sent it, all answered that they do not have it, or MIGRATION_WAIT_MS has passed
+ * @param migration the migration state
+ * @param socket the server socket
+ * @param request the request
+ * @param len its length
+ * @param key offset of the key in the request, nul-terminated or up to its end
+ * @param cli_addr where the request comes from
+ * @param addr_len length of cli_addr
+ * @param now current time
+ * @return 1 if the request waits, 0 if it must be served now (no handoff, or too many waiting)
+ */
+int migration_defer(migration_t *migration, int socket, const char *request, size_t len, size_t key,
+                    const struct sockaddr_in *cli_addr, socklen_t addr_len, double now);
+
+/**
+ * @brief a request that waited for a key and can be served again
+ * @param migration the migration state
+ * @param now current time
+ * @return the request, to be freed with migration_wait_free once served, NULL if none is ready
+ */
+migration_wait_t *migration_next_ready(migration_t *migration, double now);
+
+/**
+ * @brief free the slot of a request served again
+ * @param wait the request
+ */
+void migration_wait_free(migration_wait_t *wait);
+
+/**
+ * @brief time before the next migration timer: a retransmission or the deadline of a request
+ * @param migration the migration state
+ * @param now current time
+ * @return the time in milliseconds, INFINITY if there is none
+ */
+double migration_next_timeout_ms(const migration_t *migration, double now);
@@ -0,0 +1,534 @@
+/*
+ * Network faults for tests, preloaded in the servers and clients:
+ *     LD_PRELOAD=./net-faults.so PPS_FAULTS_FILE=faults.conf ./pps-launch-server
+ * Each line of the file (faults.conf by default) is a rule for the datagrams sent to an address,
+ * "ip:port", "ip:*", "*:port" or "*", then some of these settings:
+ *     delay=ms         latency added to each datagram
+ *     jitter=ms        scale of a random latency added to delay, drawn from
+ *     dist=D           uniform (in [0, jitter], the default), normal (standard deviation jitter,
+ *                      never below -delay), exp (mean jitter) or pareto (scale jitter, heavy tail)
+ *     shape=a          of the pareto distribution (1.5 by default: the lower, the heavier the tail)
+ *     loss=p           share of the datagrams dropped
+ *     dup=p            share of the datagrams sent twice (the copy with its own latency)
+ *     reorder=p        share of the datagrams held reorder_ms longer, so that later ones pass them
+ *     reorder_ms=ms    (10 by default)
+ *     rate=bytes_per_s bandwidth to the address: datagrams queue behind the ones before them
+ *     in=1             the rule is for the datagrams received from the address instead (only loss
+ *                      and dup apply: a datagram received cannot be delayed without blocking)
+ * The first rule matching an address applies; '#' starts a comment. The file is read again when
+ * it changes (looked at every FAULTS_CHECK_MS), so that faults can be turned on and off during a
+ * run. The datagrams delayed are sent by a thread of the process, when they are due: sendto does
+ * not block, and a dropped or delayed datagram is reported as sent. PPS_FAULTS_SEED makes the
+ * draws repeatable.
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <dlfcn.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define FAULTS_FILE_ENV "PPS_FAULTS_FILE"
+#define FAULTS_SEED_ENV "PPS_FAULTS_SEED"
+#define FAULTS_DEFAULT_FILE "faults.conf"
+#define FAULTS_CHECK_MS 100
+#define FAULTS_MAX_RULES 64
+#define FAULTS_DEFAULT_SHAPE 1.5
+#define FAULTS_DEFAULT_REORDER_MS 10
+
+typedef enum {
+    DIST_UNIFORM,
+    DIST_NORMAL,
+    DIST_EXP,
+    DIST_PARETO
+} dist_t;
+
+typedef struct {
+    uint32_t ip;              // network order, 0 for any
+    uint16_t port;            // network order, 0 for any
+    int in;
+    double delay_ms;
+    double jitter_ms;
+    dist_t dist;
+    double shape;
+    double loss;
+    double dup;
+    double reorder;
+    double reorder_ms;
+    double rate;              // bytes per second, 0 for no cap
+    double next_free_ns;      // when the link to the address is free again (with rate)
+} rule_t;
+
+//A datagram waiting for its time
+typedef struct {
+    double due_ns;
+    int socket;
+    int flags;
+    struct sockaddr_storage dest;
+    socklen_t dest_len;
+    size_t length;
+    char *data;
+} delayed_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  wake;
+static int             started = 0;
+
+static rule_t rules[FAULTS_MAX_RULES];
+static size_t nb_rules = 0;
+static double next_check_ns = 0;
+static struct timespec file_mtime = {0, 0};
+static off_t  file_size = -1;
+
+static uint64_t state = 0;
+
+//Min-heap of the datagrams delayed, by due time
+static delayed_t *heap = NULL;
+static size_t heap_size = 0;
+static size_t heap_allocated = 0;
+
+static __typeof__(sendto) *real_sendto = NULL;
+static __typeof__(recvfrom) *real_recvfrom = NULL;
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec * 1e9 + (double) t.tv_nsec;
+}
+
+//Uniform in (0, 1)
+static double uniform(void)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return ((double) ((state * 0x2545F4914F6CDD1DULL) >> 11) + 0.5) * 0x1.0p-53;
+}
+
+static double sample_ms(const rule_t *rule)
+{
+    double extra = 0;
+    switch (rule->dist) {
+    case DIST_UNIFORM:
+        extra = uniform() * rule->jitter_ms;
+        break;
+    case DIST_NORMAL:
+        extra = sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform()) * rule->jitter_ms;
+        break;
+    case DIST_EXP:
+        extra = -log(uniform()) * rule->jitter_ms;
+        break;
+    case DIST_PARETO:
+        extra = (pow(uniform(), -1 / rule->shape) - 1) * rule->jitter_ms;
+        break;
+    }
+    const double latency = rule->delay_ms + extra;
+    return latency > 0 ? latency : 0;
+}
+
+static int parse_address(const char *text, rule_t *rule)
+{
+    char ip[64];
+    const char *colon = strrchr(text, ':');
+    const size_t ip_len = colon != NULL ? (size_t) (colon - text) : strlen(text);
+    if (ip_len >= sizeof(ip)) {
+        return 0;
+    }
+    memcpy(ip, text, ip_len);
+    ip[ip_len] = '\0';
+
+    struct in_addr addr = {0};
+    if (strcmp(ip, "*") != 0 && inet_pton(AF_INET, ip, &addr) != 1) {
+        return 0;
+    }
+    rule->ip = addr.s_addr;
+    rule->port = 0;
+    if (colon != NULL && strcmp(colon + 1, "*") != 0) {
+        const int port = atoi(colon + 1);
+        if (port <= 0 || port > 65535) {
+            return 0;
+        }
+        rule->port = htons((uint16_t) port);
+    }
+    return 1;
+}
+
+static int parse_setting(rule_t *rule, const char *name, const char *value)
+{
+    char *end = NULL;
+    const double number = strtod(value, &end);
+    const int is_number = end != value && *end == '\0' && number >= 0;
+    if (strcmp(name, "dist") == 0) {
+        rule->dist = strcmp(value, "normal") == 0 ? DIST_NORMAL : strcmp(value, "exp") == 0 ? DIST_EXP
+                     : strcmp(value, "pareto") == 0 ? DIST_PARETO : DIST_UNIFORM;
+        return strcmp(value, "uniform") == 0 || rule->dist != DIST_UNIFORM;
+    }
+    if (!is_number) {
+        return 0;
+    }
+    if (strcmp(name, "delay") == 0) {
+        rule->delay_ms = number;
+    } else if (strcmp(name, "jitter") == 0) {
+        rule->jitter_ms = number;
+    } else if (strcmp(name, "shape") == 0 && number > 0) {
+        rule->shape = number;
+    } else if (strcmp(name, "loss") == 0 && number <= 1) {
+        rule->loss = number;
+    } else if (strcmp(name, "dup") == 0 && number <= 1) {
+        rule->dup = number;
+    } else if (strcmp(name, "reorder") == 0 && number <= 1) {
+        rule->reorder = number;
+    } else if (strcmp(name, "reorder_ms") == 0) {
+        rule->reorder_ms = number;
+    } else if (strcmp(name, "rate") == 0) {
+        rule->rate = number;
+    } else if (strcmp(name, "in") == 0) {
+        rule->in = number != 0;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+//Read the rules again if the file changed (called with the lock held)
+static void reload(const char *path)
+{
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        nb_rules = 0;
+        file_size = -1;
+        return;
+    }
+    if (info.st_mtim.tv_sec == file_mtime.tv_sec && info.st_mtim.tv_nsec == file_mtime.tv_nsec
+        && info.st_size == file_size) {
+        return;
+    }
+    file_mtime = info.st_mtim;
+    file_size  = info.st_size;
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return;
+    }
+    nb_rules = 0;
+    char line[1024];
+    size_t nb_line = 0;
+    while (fgets(line, sizeof(line), file) != NULL && nb_rules < FAULTS_MAX_RULES) {
+        ++nb_line;
+        line[strcspn(line, "#\n")] = '\0';
+        char *save = NULL;
+        const char *address = strtok_r(line, " \t", &save);
+        if (address == NULL) {
+            continue;
+        }
+        rule_t rule;
+        memset(&rule, 0, sizeof(rule));
+        rule.shape      = FAULTS_DEFAULT_SHAPE;
+        rule.reorder_ms = FAULTS_DEFAULT_REORDER_MS;
+        int valid = parse_address(address, &rule);
+        for (char *setting = strtok_r(NULL, " \t", &save); setting != NULL && valid;
+             setting = strtok_r(NULL, " \t", &save)) {
+            char *equal = strchr(setting, '=');
+            if (equal == NULL) {
+                valid = 0;
+                break;
+            }
+            *equal = '\0';
+            valid = parse_setting(&rule, setting, equal + 1);
+        }
+        if (valid) {
+            rules[nb_rules++] = rule;
+        } else {
+            fprintf(stderr, "net-faults: %s:%zu: rule ignored\n", path, nb_line);
+        }
+    }
+    fclose(file);
+}
+
+//Rule for the datagrams to (or from) an address, NULL if none (called with the lock held)
+static rule_t *find_rule(const struct sockaddr *addr, int in)
+{
+    const double now = now_ns();
+    if (now >= next_check_ns) {
+        const char *path = getenv(FAULTS_FILE_ENV);
+        reload(path != NULL ? path : FAULTS_DEFAULT_FILE);
+        next_check_ns = now + FAULTS_CHECK_MS * 1e6;
+    }
+    if (addr == NULL || addr->sa_family != AF_INET) {
+        return NULL;
+    }
+    const struct sockaddr_in *in4 = (const struct sockaddr_in *) addr;
+    for (size_t i = 0; i < nb_rules; ++i) {
+        rule_t *rule = &rules[i];
+        if (rule->in == in && (rule->ip == 0 || rule->ip == in4->sin_addr.s_addr)
+            && (rule->port == 0 || rule->port == in4->sin_port)) {
+            return rule;
+        }
+    }
+    return NULL;
+}
+
+static void heap_swap(size_t a, size_t b)
+{
+    const delayed_t tmp = heap[a];
+    heap[a] = heap[b];
+    heap[b] = tmp;
+}
+
+static void heap_pop(void)
+{
+    heap[0] = heap[--heap_size];
+    size_t i = 0;
+    while (1) {
+        size_t smallest = i;
+        const size_t left = 2 * i + 1;
+        const size_t right = left + 1;
+        if (left < heap_size && heap[left].due_ns < heap[smallest].due_ns) {
+            smallest = left;
+        }
+        if (right < heap_size && heap[right].due_ns < heap[smallest].due_ns) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        heap_swap(i, smallest);
+        i = smallest;
+    }
+}
+
+//Send the datagrams delayed when they are due
+static void *sender(void *arg)
+{
+    (void) arg;
+    pthread_mutex_lock(&lock);
+    while (1) {
+        if (heap_size == 0) {
+            pthread_cond_wait(&wake, &lock);
+            continue;
+        }
+        const double due = heap[0].due_ns;
+        if (due > now_ns()) {
+            struct timespec until = {(time_t) (due / 1e9), (long) fmod(due, 1e9)};
+            pthread_cond_timedwait(&wake, &lock, &until);
+            continue;
+        }
+        const delayed_t d = heap[0];
+        heap_pop();
+        pthread_mutex_unlock(&lock);
+        real_sendto(d.socket, d.data, d.length, d.flags, (const struct sockaddr *) &d.dest, d.dest_len);
+        free(d.data);
+        pthread_mutex_lock(&lock);
+    }
+    return NULL;
+}
+
+//A child forked does not have the sender: its datagrams are the parent's to send
+static void before_fork(void)
+{
+    pthread_mutex_lock(&lock);
+}
+
+static void after_fork_parent(void)
+{
+    pthread_mutex_unlock(&lock);
+}
+
+static void after_fork_child(void)
+{
+    for (size_t i = 0; i < heap_size; ++i) {
+        free(heap[i].data);
+    }
+    heap_size = 0;
+    started = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+//Start the sender at the first datagram delayed (called with the lock held)
+static int start_sender(void)
+{
+    static int registered = 0;
+    if (started) {
+        return 1;
+    }
+    if (!registered) {
+        pthread_atfork(before_fork, after_fork_parent, after_fork_child);
+        registered = 1;
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wake, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, sender, NULL) != 0) {
+        return 0;
+    }
+    pthread_detach(thread);
+    started = 1;
+    return 1;
+}
+
+//Queue a copy of a datagram (called with the lock held), 0 if it cannot be
+static int delay(double due_ns, int socket, const void *message, size_t length, int flags,
+                 const struct sockaddr *dest_addr, socklen_t dest_len)
+{
+    if (!start_sender() || dest_len > sizeof(struct sockaddr_storage)) {
+        return 0;
+    }
+    if (heap_size == heap_allocated) {
+        const size_t allocated = heap_allocated == 0 ? 256 : 2 * heap_allocated;
+        delayed_t *grown = realloc(heap, allocated * sizeof(delayed_t));
+        if (grown == NULL) {
+            return 0;
+        }
+        heap = grown;
+        heap_allocated = allocated;
+    }
+    delayed_t d = {due_ns, socket, flags, {0}, dest_len, length, malloc(length + 1)};
+    if (d.data == NULL) {
+        return 0;
+    }
+    memcpy(d.data, message, length);
+    memcpy(&d.dest, dest_addr, dest_len);
+
+    size_t i = heap_size++;
+    heap[i] = d;
+    while (i > 0 && heap[(i - 1) / 2].due_ns > heap[i].due_ns) {
+        heap_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    pthread_cond_signal(&wake);
+    return 1;
+}
+
+static void init(void)
+{
+    if (real_sendto == NULL) {
+        real_sendto   = (__typeof__(sendto) *) dlsym(RTLD_NEXT, "sendto");
+        real_recvfrom = (__typeof__(recvfrom) *) dlsym(RTLD_NEXT, "recvfrom");
+    }
+    if (state == 0) {
+        const char *seed = getenv(FAULTS_SEED_ENV);
+        state = seed != NULL ? strtoull(seed, NULL, 10) : (uint64_t) now_ns() ^ (uint64_t) getpid();
+        state = (state + 1) * 0x9E3779B97F4A7C15ULL;
+        state = state == 0 ? 1 : state;
+    }
+}
+
+ssize_t sendto(int socket, const void *message, size_t length, int flags,
+               const struct sockaddr *dest_addr, socklen_t dest_len)
+{
+    pthread_mutex_lock(&lock);
+    init();
+    rule_t *rule = find_rule(dest_addr, 0);
+    if (rule == NULL) {
+        pthread_mutex_unlock(&lock);
+        return real_sendto(socket, message, length, flags, dest_addr, dest_len);
+    }
+    if (uniform() < rule->loss) {
+        pthread_mutex_unlock(&lock);
+        return (ssize_t) length;
+    }
+
+    //Behind the datagrams already on the link, then its latency
+    const double now = now_ns();
+    double due = now;
+    if (rule->rate > 0) {
+        due = (rule->next_free_ns > now ? rule->next_free_ns : now) + (double) length / rule->rate * 1e9;
+        rule->next_free_ns = due;
+    }
+    const int copies = 1 + (uniform() < rule->dup);
+    int delayed = 1;
+    for (int c = 0; c < copies && delayed; ++c) {
+        double at = due + sample_ms(rule) * 1e6;
+        if (uniform() < rule->reorder) {
+            at += rule->reorder_ms * 1e6;
+        }
+        delayed = at > now && delay(at, socket, message, length, flags, dest_addr, dest_len);
+        if (!delayed) {
+            //Not delayed: sent now, with the other copy if any
+            pthread_mutex_unlock(&lock);
+            ssize_t result = 0;
+            for (; c < copies; ++c) {
+                result = real_sendto(socket, message, length, flags, dest_addr, dest_len);
+            }
+            return result;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return (ssize_t) length;
+}
+
+//A datagram received twice, to be returned by the next call on its socket
+static __thread int dup_socket = -1;
+static __thread char *dup_data = NULL;
+static __thread size_t dup_length = 0;
+static __thread struct sockaddr_storage dup_from;
+static __thread socklen_t dup_from_len = 0;
+
+ssize_t recvfrom(int socket, void *buffer, size_t length, int flags,
+                 struct sockaddr *src_addr, socklen_t *src_len)
+{
+    pthread_mutex_lock(&lock);
+    init();
+    pthread_mutex_unlock(&lock);
+
+    if (dup_socket == socket && dup_data != NULL) {
+        const size_t n = dup_length < length ? dup_length : length;
+        memcpy(buffer, dup_data, n);
+        if (src_addr != NULL && src_len != NULL) {
+            const socklen_t from_len = dup_from_len < *src_len ? dup_from_len : *src_len;
+            memcpy(src_addr, &dup_from, from_len);
+            *src_len = dup_from_len;
+        }
+        free(dup_data);
+        dup_data = NULL;
+        dup_socket = -1;
+        return (ssize_t) n;
+    }
+
+    while (1) {
+        struct sockaddr_storage from;
+        socklen_t from_len = sizeof(from);
+        const ssize_t result = real_recvfrom(socket, buffer, length, flags, (struct sockaddr *) &from, &from_len);
+        if (result < 0) {
+            return result;
+        }
+
+        pthread_mutex_lock(&lock);
+        const rule_t *rule = find_rule((const struct sockaddr *) &from, 1);
+        const int lost = rule != NULL && uniform() < rule->loss;
+        const int twice = rule != NULL && !lost && uniform() < rule->dup;
+        pthread_mutex_unlock(&lock);
+        if (lost) {
+            //As if it never came: wait for the next one (with the timeout of the socket again)
+            continue;
+        }
+
+        if (twice && (flags & MSG_PEEK) == 0 && (dup_data = malloc((size_t) result + 1)) != NULL) {
+            memcpy(dup_data, buffer, (size_t) result);
+            dup_length = (size_t) result;
+            dup_socket = socket;
+            memcpy(&dup_from, &from, from_len);
+            dup_from_len = from_len;
+        }
+        if (src_addr != NULL && src_len != NULL) {
+            memcpy(src_addr, &from, from_len < *src_len ? from_len : *src_len);
+            *src_len = from_len;
+        }
+        return result;
+    }
+}
@@ -18,10 +18,38 @@
 #include <sys/socket.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h> //for close
+#include <math.h> //for INFINITY
 
 
 #define TIMEOUT 1
 
+/**
+ * @brief with a sloppy quorum, time a put waits for W acks of the replicas before handing the
+ *        writes of the late ones to other servers (hinted handoff), then for W acks in all
+ */
+#define HANDOFF_TIMEOUT_MS 200
+
+/**
+ * @brief time a get of a hot key waits for its answers before asking other servers
+ */
+#define SPREAD_TIMEOUT_MS 200
+
+/**
+ * @brief size of the header of the replies to gets with load feedback, before the value (see PPS_OP_GET_FEEDBACK)
+ */
+#define FEEDBACK_HEADER_SIZE 11
+
+/**
+ * @brief size of the header of the replies to leased gets, before the value (see PPS_OP_GET_LEASE)
+ */
+#define LEASE_HEADER_SIZE 11
+
+/**
+ * @brief size of the header of the replies to wide gets, before the value (see PPS_OP_GET_WIDE)
+ */
+#define WIDE_HEADER_SIZE 4
+
 
 error_code
 send_messages(const void *message, size_t size_message, int socket, node_list_t *servers_to_contact) {
@@ -42,13 +70,14 @@ send_messages(const void *message, size_t size_message, int socket, node_list_t
     return ERR_NONE;
 }
 
-error_code receive_message(int socket, char *response, ssize_t *len_receive, node_list_t *servers_to_contact) {
+error_code receive_message(int socket, char *response, size_t size, ssize_t *len_receive,
+                           node_list_t *servers_to_contact) {
 
     //Check confirmation received
     socklen_t       addr_len_received = sizeof(struct sockaddr);
     struct sockaddr addr_sender;
 
-    *len_receive = recvfrom(socket, response, MAX_MSG_ELEM_SIZE, 0, &(addr_sender), &addr_len_received);
+    *len_receive = recvfrom(socket, response, size, 0, &(addr_sender), &addr_len_received);
 
     M_EXIT_IF(*len_receive == -1, ERR_NETWORK, "send_message", " %s", "timeout");
 
@@ -62,6 +91,62 @@ error_code receive_message(int socket, char *response, ssize_t *len_receive, nod
 
 }
 
+/**
+ * @brief wait for a reply from one of the servers of a list
+ * @param socket the socket to receive on
+ * @param response where to write the reply
+ * @param size the size of response
+ * @param len_receive where to write the length of the reply
+ * @param servers the servers expected to reply
+ * @return the index of the server that replied, servers->size for a stray reply, SIZE_MAX on timeout
+ */
+static size_t receive_from(int socket, char *response, size_t size, ssize_t *len_receive, const node_list_t *servers) {
+
+    struct sockaddr addr_sender;
+    socklen_t       addr_len = sizeof(struct sockaddr);
+
+    *len_receive = recvfrom(socket, response, size, 0, &addr_sender, &addr_len);
+    if (*len_receive == -1) {
+        return SIZE_MAX;
+    }
+
+    for (size_t i = 0; i < servers->size; ++i) {
+        if (memcmp(&addr_sender, &servers->nodes[i].addr, addr_len) == 0) {
+            return i;
+        }
+    }
+
+    return servers->size;
+}
+
+/**
+ * @brief copy a list of nodes, those of the given zone first (both parts keep their order)
+ * @param list the nodes to copy
+ * @param zone the zone to put first, NULL or "" for none
+ * @param ordered where to copy the list->size nodes
+ * @return the number of nodes of the given zone
+ */
+size_t order_by_zone(const node_list_t *list, const char *zone, node_t *ordered) {
+
+    size_t nb_local = 0;
+    if (zone != NULL && zone[0] != '\0') {
+        for (size_t i = 0; i < list->size; ++i) {
+            if (strcmp(list->nodes[i].zone, zone) == 0) {
+                ordered[nb_local++] = list->nodes[i];
+            }
+        }
+    }
+
+    size_t index = nb_local;
+    for (size_t i = 0; i < list->size; ++i) {
+        if (nb_local == 0 || strcmp(list->nodes[i].zone, zone) != 0) {
+            ordered[index++] = list->nodes[i];
+        }
+    }
+
+    return nb_local;
+}
+
 int increment_and_test(Htable_t table, pps_key_t key, size_t R) {
     //get_value is the current number of reads we have for the given key
     pps_value_t get_value = get_Htable_value(table, key);
@@ -86,16 +171,437 @@ int increment_and_test(Htable_t table, pps_key_t key, size_t R) {
     }
 }
 
+/**
+ * @brief parse the reply to a get with load feedback (see PPS_OP_GET_FEEDBACK)
+ * @return 1 if the reply is well formed, 0 otherwise
+ */
+static int parse_feedback(const char *reply, ssize_t len, double *queue, double *service_ms, int *found) {
+    if (len < FEEDBACK_HEADER_SIZE || reply[0] != PPS_OP_PREFIX || reply[1] != PPS_OP_GET_FEEDBACK) {
+        return 0;
+    }
+    const unsigned char *in = (const unsigned char *) reply;
+    uint32_t q = 0;
+    uint32_t t = 0;
+    for (int i = 0; i < 4; ++i) {
+        q = q << 8 | in[2 + i];
+        t = t << 8 | in[6 + i];
+    }
+    *queue      = q / 1e3;
+    *service_ms = t / 1e3;
+    *found      = in[10] != 0;
+    return 1;
+}
+
+/**
+ * @brief latency-aware get (C3): send to the R replicas with the best scores, and to the next
+ *        one each time an answer is late, missing or does not make R matching values
+ * @param client the client, with its replica statistics
+ * @param key the key
+ * @param replicas the N replicas of the key
+ * @param value where to write the value
+ * @return some error code
+ */
+static error_code network_get_selective(client_t client, pps_key_t key, const node_list_t *replicas, pps_value_t *value) {
+
+    const ring_t *ring = client.server;
+    const size_t  R    = client.args->R;
+
+    //Replicas of the client's zone first if there are enough of them, then by score
+    node_t ordered[RING_MAX_PREFERENCE_SIZE];
+    size_t nb_local = order_by_zone(replicas, client.zone, ordered);
+    if (nb_local >= R) {
+        selection_sort(client.selection, ring, ordered, nb_local);
+        selection_sort(client.selection, ring, ordered + nb_local, replicas->size - nb_local);
+    } else {
+        selection_sort(client.selection, ring, ordered, replicas->size);
+    }
+
+    const size_t key_len = strlen(key);
+    char request[2 + MAX_MSG_ELEM_SIZE];
+    request[0] = PPS_OP_PREFIX;
+    request[1] = PPS_OP_GET_FEEDBACK;
+    memcpy(request + 2, key, key_len);
+
+    int socket = get_socket(0);
+    M_EXIT_IF(socket == -1, ERR_NETWORK, "network", "%s", "no socket");
+
+    char *response = calloc(FEEDBACK_HEADER_SIZE + MAX_MSG_ELEM_SIZE + 1, sizeof(char)); //freed by the caller if we get no errors
+    Htable_t table = construct_Htable(client.args->N);
+    if (response == NULL || table == NULL) {
+        free(response);
+        delete_Htable_and_content(&table);
+        close(socket);
+        return ERR_NOMEM;
+    }
+
+    size_t server[RING_MAX_PREFERENCE_SIZE];
+    double sent_at[RING_MAX_PREFERENCE_SIZE];
+    int    answered[RING_MAX_PREFERENCE_SIZE] = {0};
+    size_t nb_sent     = 0;
+    size_t nb_answered = 0;
+    size_t nb_found    = 0;
+
+    error_code error = ERR_NETWORK;
+    while (error == ERR_NETWORK) {
+
+        //Keep enough requests out to possibly make R matching values (at least one while the
+        //values differ), sending to the best replicas not tried yet
+        const size_t wanted = nb_found < R ? R - nb_found : 1;
+        while (nb_sent < replicas->size && nb_sent - nb_answered < wanted) {
+            server[nb_sent]  = ring_server_index(ring, &ordered[nb_sent]);
+            sent_at[nb_sent] = get_time_ms();
+            sendto(socket, request, 2 + key_len, 0, &ordered[nb_sent].addr, sizeof(ordered[nb_sent].addr));
+            selection_sent(client.selection, server[nb_sent]);
+            ++nb_sent;
+        }
+        if (nb_answered == nb_sent) {
+            break;
+        }
+
+        //Wait as long as the slowest expected answer among those out
+        double timeout = SELECTION_MIN_TIMEOUT_MS;
+        for (size_t i = 0; i < nb_sent; ++i) {
+            const double t = selection_timeout_ms(client.selection, server[i]);
+            timeout = !answered[i] && t > timeout ? t : timeout;
+        }
+        if (set_receive_timeout_ms(socket, (long) timeout) != ERR_NONE) {
+            break;
+        }
+
+        node_list_t sent = {nb_sent, ordered};
+        ssize_t     len  = 0;
+        size_t      i    = receive_from(socket, response, FEEDBACK_HEADER_SIZE + MAX_MSG_ELEM_SIZE, &len, &sent);
+        const double now = get_time_ms();
+
+        if (i == SIZE_MAX) {
+            //Late: give up on the requests out, ask the next replica (or stop if none is left)
+            for (size_t j = 0; j < nb_sent; ++j) {
+                if (!answered[j]) {
+                    selection_timed_out(client.selection, server[j], timeout);
+                    answered[j] = 1;
+                    ++nb_answered;
+                }
+            }
+            continue;
+        }
+
+        double queue      = 0;
+        double service_ms = 0;
+        int    found      = 0;
+        if (i >= nb_sent || answered[i] || !parse_feedback(response, len, &queue, &service_ms, &found)) {
+            continue;
+        }
+        answered[i] = 1;
+        ++nb_answered;
+        selection_answered(client.selection, server[i], now - sent_at[i], service_ms, queue);
+
+        if (found) {
+            ++nb_found;
+            memmove(response, response + FEEDBACK_HEADER_SIZE, (size_t) len - FEEDBACK_HEADER_SIZE);
+            response[len - FEEDBACK_HEADER_SIZE] = '\0';
+            if (increment_and_test(table, response, R)) {
+                error = ERR_NONE;
+            }
+        }
+    }
+
+    delete_Htable_and_content(&table);
+    close(socket);
+
+    if (error == ERR_NONE) {
+        *value = response;
+    } else {
+        free(response);
+    }
+
+    return error;
+}
+
+/**
+ * @brief parse the reply to a leased get (see PPS_OP_GET_LEASE)
+ * @return 1 if the reply is well formed and answers the request of sequence number seq, 0 otherwise
+ */
+static int parse_lease(const char *reply, ssize_t len, uint32_t seq, double *lease_ms, int *found) {
+    if (len < LEASE_HEADER_SIZE || reply[0] != PPS_OP_PREFIX || reply[1] != PPS_OP_GET_LEASE) {
+        return 0;
+    }
+    const unsigned char *in = (const unsigned char *) reply;
+    uint32_t s = 0;
+    uint32_t l = 0;
+    for (int i = 0; i < 4; ++i) {
+        s = s << 8 | in[2 + i];
+        l = l << 8 | in[6 + i];
+    }
+    *lease_ms = l;
+    *found    = in[10] != 0;
+    return s == seq;
+}
+
+/**
+ * @brief cached get: serve the key from the cache of the client, or read it with leases from the
+ *        replicas (as network_get does) and cache it until the shortest lease of the R matching
+ *        values expires. Invalidations received meanwhile are applied to the cache.
+ * @param client the client, with its cache
+ * @param key the key
+ * @param replicas the N replicas of the key
+ * @param value where to write the value
+ * @return some error code
+ */
+static error_code network_get_cached(client_t client, pps_key_t key, const node_list_t *replicas, pps_value_t *value) {
+
+    client_cache_t *cache = client.cache;
+    const size_t    R     = client.args->R;
+
+    cache_poll(cache);
+    pps_value_t cached = cache_get(cache, key, get_time_ms());
+    if (cached != NULL) {
+        *value = cached;
+        return ERR_NONE;
+    }
+
+    const uint32_t seq     = cache->next_seq++;
+    const size_t   key_len = strlen(key);
+    char request[6 + MAX_MSG_ELEM_SIZE];
+    request[0] = PPS_OP_PREFIX;
+    request[1] = PPS_OP_GET_LEASE;
+    for (int i = 0; i < 4; ++i) {
+        request[2 + i] = (char) (seq >> (24 - 8 * i));
+    }
+    memcpy(request + 6, key, key_len);
+
+    char *response = calloc(LEASE_HEADER_SIZE + MAX_MSG_ELEM_SIZE + 1, sizeof(char)); //freed by the caller if we get no errors
+    Htable_t table = construct_Htable(client.args->N);
+    if (response == NULL || table == NULL) {
+        free(response);
+        delete_Htable_and_content(&table);
+        return ERR_NOMEM;
+    }
+
+    //Replicas of the client's zone first, as for uncached reads
+    node_t      ordered[RING_MAX_PREFERENCE_SIZE];
+    node_list_t servers_to_contact = {replicas->size, ordered};
+    size_t      nb_local = order_by_zone(replicas, client.zone, ordered);
+    size_t      nb_sent  = nb_local >= R ? nb_local : replicas->size;
+
+    node_list_t first_servers = {nb_sent, ordered};
+    error_code  error = send_messages(request, 6 + key_len, cache->socket, &first_servers);
+
+    int    answered[RING_MAX_PREFERENCE_SIZE] = {0};
+    size_t nb_answered = 0;
+    double lease_ms    = INFINITY;
+    const double start = get_time_ms();
+
+    if (error == ERR_NONE) {
+        error = ERR_NETWORK;
+    }
+    while (error == ERR_NETWORK && nb_answered < nb_sent) {
+
+        ssize_t len = 0;
+        size_t  i   = receive_from(cache->socket, response, LEASE_HEADER_SIZE + MAX_MSG_ELEM_SIZE, &len,
+                                   &servers_to_contact);
+
+        if (i == SIZE_MAX) {
+            //Timeout: fall back to the replicas of the other zones, or give up
+            if (nb_sent == replicas->size) {
+                break;
+            }
+            node_list_t other_servers = {replicas->size - nb_sent, ordered + nb_sent};
+            if (send_messages(request, 6 + key_len, cache->socket, &other_servers) != ERR_NONE) {
+                break;
+            }
+            nb_sent = replicas->size;
+            continue;
+        }
+
+        double granted = 0;
+        int    found   = 0;
+        if (i < servers_to_contact.size && !answered[i] && parse_lease(response, len, seq, &granted, &found)) {
+            answered[i] = 1;
+            ++nb_answered;
+            //The value may change once the first lease expires
+            lease_ms = granted < lease_ms ? granted : lease_ms;
+            if (found) {
+                memmove(response, response + LEASE_HEADER_SIZE, (size_t) len - LEASE_HEADER_SIZE);
+                response[len - LEASE_HEADER_SIZE] = '\0';
+                if (increment_and_test(table, response, R)) {
+                    error = ERR_NONE;
+                }
+            }
+        } else if (len >= 0) {
+            cache_handle(cache, response, (size_t) len);
+        }
+    }
+
+    delete_Htable_and_content(&table);
+
+    if (error != ERR_NONE) {
+        free(response);
+        return error;
+    }
+
+    //Leases run from the replies: counting from the request keeps on the safe side
+    if (lease_ms > 0 && lease_ms < INFINITY) {
+        cache_put(cache, key, response, start + lease_ms);
+    }
+    *value = response;
+
+    return ERR_NONE;
+}
+
+/**
+ * @brief parse the reply to a wide get (see PPS_OP_GET_WIDE), and move its value to the start
+ * @return 1 if the reply is well formed, 0 otherwise
+ */
+static int parse_wide(char *reply, ssize_t len, size_t *width, int *found) {
+    if (len < WIDE_HEADER_SIZE || reply[0] != PPS_OP_PREFIX || reply[1] != PPS_OP_GET_WIDE) {
+        return 0;
+    }
+    *width = (unsigned char) reply[2];
+    *found = reply[3] != 0;
+    memmove(reply, reply + WIDE_HEADER_SIZE, (size_t) len - WIDE_HEADER_SIZE);
+    reply[len - WIDE_HEADER_SIZE] = '\0';
+    return 1;
+}
+
+/**
+ * @brief get of a hot key: send to R of its widened replicas, chosen at random (those of the
+ *        client's zone first if there are enough of them), and to another one each time an answer
+ *        is late, missing (a copy that expired) or does not make R matching values
+ * @param client the client
+ * @param key the key
+ * @param wide the replicas of the key, then the servers holding copies
+ * @param value where to write the value
+ * @return some error code
+ */
+static error_code network_get_spread(client_t client, pps_key_t key, const node_list_t *wide, pps_value_t *value) {
+
+    const size_t R = client.args->R;
+
+    node_t shuffled[RING_MAX_PREFERENCE_SIZE];
+    memcpy(shuffled, wide->nodes, wide->size * sizeof(node_t));
+    for (size_t i = wide->size; i > 1; --i) {
+        const size_t j = (size_t) rand() % i;
+        node_t tmp      = shuffled[i - 1];
+        shuffled[i - 1] = shuffled[j];
+        shuffled[j]     = tmp;
+    }
+    node_list_t shuffled_list = {wide->size, shuffled};
+    node_t      ordered[RING_MAX_PREFERENCE_SIZE];
+    order_by_zone(&shuffled_list, client.zone, ordered);
+
+    const size_t key_len = strlen(key);
+    char request[2 + MAX_MSG_ELEM_SIZE];
+    request[0] = PPS_OP_PREFIX;
+    request[1] = PPS_OP_GET_WIDE;
+    memcpy(request + 2, key, key_len);
+
+    int socket = get_socket(0);
+    M_EXIT_IF(socket == -1, ERR_NETWORK, "network", "%s", "no socket");
+
+    char *response = calloc(WIDE_HEADER_SIZE + MAX_MSG_ELEM_SIZE + 1, sizeof(char)); //freed by the caller if we get no errors
+    Htable_t table = construct_Htable(client.args->N);
+    if (response == NULL || table == NULL || set_receive_timeout_ms(socket, SPREAD_TIMEOUT_MS) != ERR_NONE) {
+        free(response);
+        delete_Htable_and_content(&table);
+        close(socket);
+        return ERR_NOMEM;
+    }
+
+    int    answered[RING_MAX_PREFERENCE_SIZE] = {0};
+    size_t nb_sent     = 0;
+    size_t nb_answered = 0;
+    size_t nb_found    = 0;
+
+    error_code error = ERR_NETWORK;
+    while (error == ERR_NETWORK) {
+
+        //Keep enough requests out to possibly make R matching values (at least one while the values differ)
+        const size_t wanted = nb_found < R ? R - nb_found : 1;
+        while (nb_sent < wide->size && nb_sent - nb_answered < wanted) {
+            sendto(socket, request, 2 + key_len, 0, &ordered[nb_sent].addr, sizeof(ordered[nb_sent].addr));
+            ++nb_sent;
+        }
+        if (nb_answered == nb_sent) {
+            break;
+        }
+
+        node_list_t sent = {nb_sent, ordered};
+        ssize_t     len  = 0;
+        size_t      i    = receive_from(socket, response, WIDE_HEADER_SIZE + MAX_MSG_ELEM_SIZE, &len, &sent);
+
+        if (i == SIZE_MAX) {
+            //Late: give up on the requests out, ask the next servers
+            for (size_t j = 0; j < nb_sent; ++j) {
+                if (!answered[j]) {
+                    answered[j] = 1;
+                    ++nb_answered;
+                }
+            }
+            continue;
+        }
+
+        size_t width = 0;
+        int    found = 0;
+        if (i >= nb_sent || answered[i] || !parse_wide(response, len, &width, &found)) {
+            continue;
+        }
+        answered[i] = 1;
+        ++nb_answered;
+        spread_learn(client.spread, key, width, get_time_ms());
+
+        if (found) {
+            ++nb_found;
+            if (increment_and_test(table, response, R)) {
+                error = ERR_NONE;
+            }
+        }
+    }
+
+    delete_Htable_and_content(&table);
+    close(socket);
+
+    if (error == ERR_NONE) {
+        *value = response;
+    } else {
+        free(response);
+    }
+
+    return error;
+}
+
 error_code network_get(client_t client, pps_key_t key, pps_value_t *value) {
 
     M_REQUIRE_NON_NULL(value);
     M_REQUIRE_NON_NULL(key);
     M_EXIT_IF_TOO_LONG(key, MAX_MSG_ELEM_SIZE, "key too long");
 
+    //Written in a buffer of ours, must not be freed
+    node_t replicas_row[RING_MAX_PREFERENCE_SIZE];
+    node_list_t replicas = ring_get_nodes_for_key(client.server, client.args->N, key, replicas_row);
+    M_EXIT_IF(replicas.size < client.args->R, ERR_BAD_PARAMETER, "network_get", " %s", "not enough servers");
+
+    //Served locally while the leases on the value last
+    if (client.cache != NULL) {
+        return network_get_cached(client, key, &replicas, value);
+    }
+
+    //Only the best R replicas when reads are latency-aware
+    if (client.selection != NULL && client.args->R < replicas.size) {
+        return network_get_selective(client, key, &replicas, value);
+    }
+
+    //R of the widened replicas of a hot key
+    const size_t width = spread_width(client.spread, key, replicas.size, get_time_ms());
+    if (width > replicas.size) {
+        node_t wide_row[RING_MAX_PREFERENCE_SIZE];
+        node_list_t wide = ring_get_nodes_for_key(client.server, width, key, wide_row);
+        return network_get_spread(client, key, &wide, value);
+    }
+
     int socket = get_socket(TIMEOUT);
     M_EXIT_IF(socket == -1, ERR_NETWORK, "network", "%s", "no socket");
 
-    char *response = calloc(MAX_MSG_ELEM_SIZE + 1, sizeof(char)); //response is freed by the caller if we get no errors
+    char *response = calloc(WIDE_HEADER_SIZE + MAX_MSG_ELEM_SIZE + 1, sizeof(char)); //response is freed by the caller if we get no errors
     M_REQUIRE_NON_NULL_CUSTOM_ERR(response, ERR_NOMEM);
 
     //Create a local Htable in order to store the number of counts associated to each value received
@@ -105,46 +611,113 @@ error_code network_get(client_t client, pps_key_t key, pps_value_t *value) {
         return ERR_NOMEM;
     }
 
-    node_list_t *servers_to_contact = ring_get_nodes_for_key(client.server, client.args->N, key);
-    M_EXIT_IF(servers_to_contact->size < client.args->R, ERR_BAD_PARAMETER, "network_get", " %s", "not enough servers");
 
-    error_code error_on_send = send_messages(key, strlen(key), socket, servers_to_contact);
+    //Replicas of the client's zone first: if there are enough of them, the others
+    //are only contacted if the local ones do not answer in time
+    node_t      ordered[RING_MAX_PREFERENCE_SIZE];
+    node_list_t servers_to_contact = {replicas.size, ordered};
+    size_t      nb_local = order_by_zone(&replicas, client.zone, ordered);
+    size_t      nb_sent  = nb_local >= client.args->R ? nb_local : replicas.size;
+
+    //Plain gets: the replicas of a hot key answer like a wide get, to tell its width (see spread.h)
+    const size_t key_len = strlen(key);
+    node_list_t first_servers = {nb_sent, ordered};
+    error_code error_on_send = send_messages(key, key_len, socket, &first_servers);
     M_EXIT_IF_ERR(error_on_send, "send all messages");
 
 
-    //If no errors and the response is not the nul char, we have a valid response
-    for (size_t i = 0; i < servers_to_contact->size; ++i) {
+    //If no errors and the key was found, we have a valid response
+    for (size_t i = 0; i < nb_sent; ++i) {
 
         memset(response, '\0', sizeof(*response));
         ssize_t len_receive = 0;
-
-        error_code error_on_receive = receive_message(socket, response, &len_receive, servers_to_contact);
-
-        if (error_on_receive == ERR_NONE && (len_receive != 1 || response[0] != '\0')) {
-            response[len_receive] = '\0';
-            if (increment_and_test(table, response, client.args->R)) {
+        size_t  width       = 0;
+        int     found       = 0;
+
+        error_code error_on_receive = receive_message(socket, response, WIDE_HEADER_SIZE + MAX_MSG_ELEM_SIZE,
+                                                      &len_receive, &servers_to_contact);
+
+        if (error_on_receive == ERR_NONE) {
+            if (parse_wide(response, len_receive, &width, &found)) {
+                spread_learn(client.spread, key, width, get_time_ms());
+            } else {
+                found = len_receive != 1 || response[0] != '\0';
+                response[len_receive] = '\0';
+            }
+            if (found && increment_and_test(table, response, client.args->R)) {
                 *value = response;
                 delete_Htable_and_content(&table);
+                close(socket);
 
                 return ERR_NONE;
             }
+        } else if (len_receive == -1 && nb_sent < replicas.size) {
+            //Timeout: fall back to the replicas of the other zones
+            node_list_t other_servers = {replicas.size - nb_sent, ordered + nb_sent};
+            error_on_send = send_messages(key, key_len, socket, &other_servers);
+            M_EXIT_IF_ERR(error_on_send, "send all messages");
+            nb_sent = replicas.size;
         }
     }
 
     delete_Htable_and_content(&table);
     free(response);
+    close(socket);
 
     return ERR_NETWORK;
 }
 
 
+/**
+ * @brief hand the write of each replica that did not acknowledge it to the next server
+ *        of the preference list after the N replicas (one hint per server)
+ * @return the number of hints sent; the nodes that got them follow the replicas in candidates
+ */
+static size_t send_hints(int socket, const node_list_t *candidates, size_t n, const int *acked,
+                         pps_key_t key, pps_value_t value) {
+
+    const size_t key_len   = strlen(key);
+    const size_t value_len = strlen(value);
+    char message[2 + 6 + MAX_MSG_SIZE];
+    message[0] = PPS_OP_PREFIX;
+    message[1] = PPS_OP_HINT;
+    memcpy(message + 8, key, key_len + 1);
+    memcpy(message + 8 + key_len + 1, value, value_len);
+
+    size_t nb_hints = 0;
+    for (size_t i = 0; i < n && n + nb_hints < candidates->size; ++i) {
+        if (acked[i]) {
+            continue;
+        }
+        const struct sockaddr_in *replica = (const struct sockaddr_in *) &candidates->nodes[i].addr;
+        memcpy(message + 2, &replica->sin_addr.s_addr, 4);
+        memcpy(message + 6, &replica->sin_port, 2);
+
+        const node_t *holder = &candidates->nodes[n + nb_hints];
+        if (sendto(socket, message, 8 + key_len + 1 + value_len, 0, &holder->addr, sizeof(holder->addr)) != -1) {
+            ++nb_hints;
+        }
+    }
+
+    return nb_hints;
+}
+
 error_code network_put(client_t client, pps_key_t key, pps_value_t value) {
     M_REQUIRE_NON_NULL(key);
     M_REQUIRE_NON_NULL(value);
     M_EXIT_IF_TOO_LONG(key, MAX_MSG_ELEM_SIZE, "too long key");
     M_EXIT_IF_TOO_LONG(value, MAX_MSG_ELEM_SIZE, "too long value");
+    //A message starting with a nul byte is a control message (see PPS_OP_PREFIX)
+    M_REQUIRE(key[0] != '\0', ERR_BAD_PARAMETER, "%s", "empty key");
 
-    int socket = get_socket(TIMEOUT);
+    //Written in a buffer of ours, must not be freed: the N replicas, then the servers that take hints
+    node_t candidates_row[RING_MAX_PREFERENCE_SIZE];
+    node_list_t candidates = ring_get_nodes_for_key(client.server, client.server->pref_size, key, candidates_row);
+    const size_t n = client.args->N < candidates.size ? client.args->N : candidates.size;
+    M_EXIT_IF(n < client.args->W, ERR_BAD_PARAMETER, "network_put", " %s", "not enough servers");
+    node_list_t servers_to_contact = {n, candidates.nodes};
+
+    int socket = get_socket(client.sloppy_quorum ? 0 : TIMEOUT);
     M_EXIT_IF(socket == -1, ERR_NETWORK, "network", "%s", "no socket");
 
     //Send pair key/value to put
@@ -158,35 +731,229 @@ error_code network_put(client_t client, pps_key_t key, pps_value_t value) {
     strncpy(message, key, key_len);
     strncpy(message + key_len + 1, value, value_len);
 
-    size_t nb_writes = 0;
-
     char response[MAX_MSG_ELEM_SIZE];
     (void) memset(response, '\0', MAX_MSG_ELEM_SIZE);
 
-    node_list_t *servers_to_contact = ring_get_nodes_for_key(client.server, client.args->N, key);
-    M_EXIT_IF(servers_to_contact->size < client.args->W, ERR_BAD_PARAMETER, "network_put", " %s", "not enough servers");
+    error_code error = client.sloppy_quorum ? set_receive_timeout_ms(socket, HANDOFF_TIMEOUT_MS) : ERR_NONE;
+    if (error == ERR_NONE) {
+        error = send_messages(message, size_message, socket, &servers_to_contact);
+    }
+    if (error != ERR_NONE) {
+        close(socket);
+    }
+    M_EXIT_IF_ERR(error, "sending all messages failed");
+
+    //Done as soon as W servers kept the write. With a sloppy quorum, the writes of the replicas
+    //still missing after HANDOFF_TIMEOUT_MS go to the next servers as hints, which count for W
+    //once kept (late acks of the replicas themselves still count).
+    int         acked[RING_MAX_PREFERENCE_SIZE] = {0};
+    node_list_t from        = servers_to_contact;
+    int         hinted      = 0;
+    size_t      nb_writes   = 0;
+    ssize_t     len_receive = 0;
+    while (nb_writes < client.args->W) {
+        size_t index = receive_from(socket, response, sizeof(response), &len_receive, &from);
+        if (index == SIZE_MAX) {
+            if (!client.sloppy_quorum || hinted) {
+                break;
+            }
+            hinted    = 1;
+            from.size = n + send_hints(socket, &candidates, n, acked, key, value);
+            continue;
+        }
+        if (index < from.size && len_receive == 0 && !acked[index]) {
+            acked[index] = 1;
+            ++nb_writes;
+        }
+    }
+
+    close(socket);
+
+    //Our own write makes the cached value stale, whatever the servers tell us
+    cache_drop(client.cache, key);
+
+    return nb_writes >= client.args->W ? ERR_NONE : ERR_NETWORK;
+}
 
-    error_code error_on_send = send_messages(message, size_message, socket, servers_to_contact);
-    M_EXIT_IF_ERR(error_on_send, "sending all messages failed");
+/**
+ * @brief send an update (append or concatenation) to the replicas of a key and wait for W of them
+ *        to apply it
+ * @param client client to use
+ * @param key the key updated
+ * @param message the request
+ * @param len its length
+ * @param op opcode of the request, and of the replies
+ * @return ERR_NONE if W replicas applied it, otherwise the error of the first replica that could not
+ */
+static error_code send_update(client_t client, pps_key_t key, const char *message, size_t len, char op) {
 
-    for (size_t i = 0; i < servers_to_contact->size; i++) {
+    //Written in a buffer of ours, must not be freed
+    node_t replicas_row[RING_MAX_PREFERENCE_SIZE];
+    node_list_t replicas = ring_get_nodes_for_key(client.server, client.args->N, key, replicas_row);
+    M_EXIT_IF(replicas.size < client.args->W, ERR_BAD_PARAMETER, "network_update", " %s", "not enough servers");
 
-        ssize_t    len_receive      = 0;
-        error_code error_on_receive = receive_message(socket, response, &len_receive, servers_to_contact);
+    int socket = get_socket(TIMEOUT);
+    M_EXIT_IF(socket == -1, ERR_NETWORK, "network", "%s", "no socket");
 
-        if (error_on_receive == ERR_NONE && len_receive == 0) {
+    error_code error = send_messages(message, len, socket, &replicas);
+    if (error != ERR_NONE) {
+        close(socket);
+    }
+    M_EXIT_IF_ERR(error, "sending all messages failed");
 
-            nb_writes += 1;
-            //Check if enough writes have been performed
-            if (nb_writes >= client.args->W) {
-                return ERR_NONE;
-            }
+    //Not applied anywhere unless some replica says otherwise
+    error = ERR_NETWORK;
+
+    int    answered[RING_MAX_PREFERENCE_SIZE] = {0};
+    size_t nb_answered = 0;
+    size_t nb_applied  = 0;
+    char   response[MAX_MSG_ELEM_SIZE];
+    while (nb_answered < replicas.size && nb_applied < client.args->W) {
+        ssize_t len_receive = 0;
+        size_t  index = receive_from(socket, response, sizeof(response), &len_receive, &replicas);
+        if (index == SIZE_MAX) {
+            break;
         }
+        if (index >= replicas.size || answered[index] || len_receive != 3
+            || response[0] != PPS_OP_PREFIX || response[1] != op) {
+            continue;
+        }
+        answered[index] = 1;
+        ++nb_answered;
 
+        if (response[2] == PPS_STATUS_OK) {
+            ++nb_applied;
+        } else if (error == ERR_NETWORK && response[2] != PPS_STATUS_AGAIN) {
+            error = response[2] == PPS_STATUS_NOT_FOUND ? ERR_NOT_FOUND : ERR_BAD_PARAMETER;
+        }
     }
 
-    return ERR_NETWORK;
+    close(socket);
+
+    return nb_applied >= client.args->W ? ERR_NONE : error;
+}
 
+error_code network_append(client_t client, pps_key_t key, pps_value_t suffix) {
+    M_REQUIRE_NON_NULL(key);
+    M_REQUIRE_NON_NULL(suffix);
+    M_EXIT_IF_TOO_LONG(key, MAX_MSG_ELEM_SIZE, "too long key");
+    M_EXIT_IF_TOO_LONG(suffix, MAX_MSG_ELEM_SIZE, "too long suffix");
+    M_REQUIRE(key[0] != '\0', ERR_BAD_PARAMETER, "%s", "empty key");
+
+    const size_t key_len    = strlen(key);
+    const size_t suffix_len = strlen(suffix);
+    char message[2 + MAX_MSG_SIZE];
+    message[0] = PPS_OP_PREFIX;
+    message[1] = PPS_OP_APPEND;
+    memcpy(message + 2, key, key_len + 1);
+    memcpy(message + 2 + key_len + 1, suffix, suffix_len);
+
+    error_code error = send_update(client, key, message, 2 + key_len + 1 + suffix_len, PPS_OP_APPEND);
+
+    //Our own write makes the cached value stale
+    cache_drop(client.cache, key);
+
+    return error;
 }
 
+error_code network_concat(client_t client, pps_key_t dest, pps_key_t *sources, size_t nb_sources) {
+    M_REQUIRE_NON_NULL(dest);
+    M_REQUIRE_NON_NULL(sources);
+    M_EXIT_IF_TOO_LONG(dest, MAX_MSG_ELEM_SIZE, "too long key");
+    M_REQUIRE(dest[0] != '\0', ERR_BAD_PARAMETER, "%s", "empty key");
+
+    char message[MAX_MSG_SIZE];
+    message[0] = PPS_OP_PREFIX;
+    message[1] = PPS_OP_CONCAT;
+    size_t len = 2;
+
+    //The destination then each source, separated by nul bytes
+    for (size_t i = 0; i <= nb_sources; ++i) {
+        pps_key_t key = i == 0 ? dest : sources[i - 1];
+        M_REQUIRE_NON_NULL(key);
+        const size_t key_len = strlen(key);
+        M_REQUIRE(key_len > 0 && len + key_len + 1 <= sizeof(message), ERR_BAD_PARAMETER, "%s", "too many keys");
+        memcpy(message + len, key, key_len + 1);
+        len += key_len + 1;
+    }
+
+    error_code error = send_update(client, dest, message, len - 1, PPS_OP_CONCAT);
+
+    cache_drop(client.cache, dest);
+
+    return error;
+}
+
+error_code network_find(client_t client, pps_key_t key, pps_key_t pattern, long *offset) {
+    M_REQUIRE_NON_NULL(key);
+    M_REQUIRE_NON_NULL(pattern);
+    M_REQUIRE_NON_NULL(offset);
+    M_EXIT_IF_TOO_LONG(key, MAX_MSG_ELEM_SIZE, "too long key");
+    M_EXIT_IF_TOO_LONG(pattern, MAX_MSG_ELEM_SIZE, "too long key");
+    M_REQUIRE(key[0] != '\0' && pattern[0] != '\0', ERR_BAD_PARAMETER, "%s", "empty key");
+
+    const size_t key_len     = strlen(key);
+    const size_t pattern_len = strlen(pattern);
+    char message[2 + 2 * MAX_MSG_ELEM_SIZE + 1];
+    message[0] = PPS_OP_PREFIX;
+    message[1] = PPS_OP_FIND;
+    memcpy(message + 2, key, key_len + 1);
+    memcpy(message + 2 + key_len + 1, pattern, pattern_len);
+
+    //Written in a buffer of ours, must not be freed
+    node_t replicas_row[RING_MAX_PREFERENCE_SIZE];
+    node_list_t replicas = ring_get_nodes_for_key(client.server, client.args->N, key, replicas_row);
+    M_EXIT_IF(replicas.size < client.args->R, ERR_BAD_PARAMETER, "network_find", " %s", "not enough servers");
+
+    int socket = get_socket(TIMEOUT);
+    M_EXIT_IF(socket == -1, ERR_NETWORK, "network", "%s", "no socket");
 
+    error_code error = send_messages(message, 2 + key_len + 1 + pattern_len, socket, &replicas);
+    if (error != ERR_NONE) {
+        close(socket);
+    }
+    M_EXIT_IF_ERR(error, "sending all messages failed");
+
+    //Answers as status << 32 | offset: done once R replicas gave the same one
+    int      answered[RING_MAX_PREFERENCE_SIZE] = {0};
+    uint64_t answers[RING_MAX_PREFERENCE_SIZE];
+    size_t   nb_answered = 0;
+    int      agreed = 0;
+    uint64_t result = 0;
+    char     response[MAX_MSG_ELEM_SIZE];
+    while (nb_answered < replicas.size && !agreed) {
+        ssize_t len_receive = 0;
+        size_t  index = receive_from(socket, response, sizeof(response), &len_receive, &replicas);
+        if (index == SIZE_MAX) {
+            break;
+        }
+        if (index >= replicas.size || answered[index] || len_receive != 7
+            || response[0] != PPS_OP_PREFIX || response[1] != PPS_OP_FIND) {
+            continue;
+        }
+        const unsigned char *in = (const unsigned char *) response;
+        const uint64_t answer = (uint64_t) in[2] << 32 | (uint64_t) in[3] << 24 | (uint64_t) in[4] << 16
+                                | (uint64_t) in[5] << 8 | (uint64_t) in[6];
+        answered[index] = 1;
+        answers[nb_answered++] = answer;
+
+        size_t same = 0;
+        for (size_t i = 0; i < nb_answered; ++i) {
+            same += answers[i] == answer;
+        }
+        if (same >= client.args->R) {
+            agreed = 1;
+            result = answer;
+        }
+    }
+
+    close(socket);
+
+    M_REQUIRE(agreed, ERR_NETWORK, "%s", "replicas did not agree");
+    M_REQUIRE((result >> 32) == PPS_STATUS_OK, ERR_NOT_FOUND, "%s", "missing key");
+
+    const uint32_t position = (uint32_t) result;
+    *offset = position == UINT32_MAX ? -1 : (long) position;
+
+    return ERR_NONE;
+}
@@ -28,6 +28,38 @@ error_code network_get(client_t client, pps_key_t key, pps_value_t* value);
  */
 error_code network_put(client_t client, pps_key_t key, pps_value_t value);
 
+/**
+ * @brief append a suffix to the value of a key, in place on its replicas (a missing key is created)
+ * @param client client to use
+ * @param key key to append to
+ * @param suffix what to append
+ * @return an error code (ERR_BAD_PARAMETER if the value would get too long)
+ */
+error_code network_append(client_t client, pps_key_t key, pps_value_t suffix);
+
+/**
+ * @brief write the concatenation of the values of some keys to another key: the replicas of the
+ *        destination pull the sources from their replicas, the values do not go through the client
+ * @param client client to use
+ * @param dest key to write
+ * @param sources keys to concatenate
+ * @param nb_sources number of keys to concatenate
+ * @return an error code (ERR_NOT_FOUND if a source is missing, ERR_BAD_PARAMETER if the
+ *         concatenation is too long)
+ */
+error_code network_concat(client_t client, pps_key_t dest, pps_key_t *sources, size_t nb_sources);
+
+/**
+ * @brief find the value of a key in the value of another one: the replicas of the searched key
+ *        run the search, only the offset comes back (R of them must agree)
+ * @param client client to use
+ * @param key key whose value is searched
+ * @param pattern key whose value is looked for
+ * @param offset (OUT) position of the first occurrence, -1 if there is none
+ * @return an error code (ERR_NOT_FOUND if one of the keys is missing)
+ */
+error_code network_find(client_t client, pps_key_t key, pps_key_t pattern, long *offset);
+
 /**
  * @brief delete a key in the network
  * @param client client to use
@@ -10,12 +10,13 @@
 #include <stdio.h>
 #include "system.h" //for get_server_addr
 #include "node.h"
+#include "hash.h"
 
 #define SIZE 54 //15 + 5 + 2 + 32
 
 
 /** problem here: doesn't give the right sha for the string input? (missmatch?) */
-error_code node_init(node_t *node, const char *ip, uint16_t port, size_t _unused node_id) {
+error_code node_init(node_t *node, const char *ip, uint16_t port, size_t _unused node_id, ring_hash_t hash) {
 
     error_code error = get_server_addr(ip, port, (struct sockaddr_in *) &node->addr);
     M_EXIT_IF_ERR(error, "node init");
@@ -25,9 +26,17 @@ error_code node_init(node_t *node, const char *ip, uint16_t port, size_t _unused
     
     snprintf(input, SIZE, "%s %d %lu", ip, port, node_id);
     
-    SHA1((unsigned char*) input, strlen(input), node->sha);
+    //SHA-1 is the costly part of building a ring: only the hash of the ring is computed
+    memset(node->sha, 0, SHA_DIGEST_LENGTH);
+    node->position = 0;
+    if (hash == RING_HASH_FAST) {
+        node->position = fast_hash64(input, strlen(input));
+    } else {
+        SHA1((unsigned char*) input, strlen(input), node->sha);
+    }
     
     node->responsive = 0;
+    memset(node->zone, '\0', sizeof(node->zone));
 
     return ERR_NONE;
 }
@@ -38,15 +47,16 @@ void node_end(node_t *node) {
 
 
 int node_cmp_sha(const node_t *first, const node_t *second) {
-    
-    char* sha1 = (char *) first->sha;
-    char* sha2 = (char *) second->sha;
+    //SHAs are binary: they may contain '\0' bytes
+    return memcmp(first->sha, second->sha, SHA_DIGEST_LENGTH);
+}
 
-    return strncmp(sha1, sha2, SHA_DIGEST_LENGTH);
+int node_cmp_position(const node_t *first, const node_t *second) {
+    return (first->position > second->position) - (first->position < second->position);
 }
 
 int node_cmp_server_addr(const node_t *first, const node_t *second) {
-    return strncmp(first->addr.sa_data, second->addr.sa_data, 14);
+    return memcmp(first->addr.sa_data, second->addr.sa_data, sizeof(first->addr.sa_data));
 }
 
 int compare_port(const node_t *first, const node_t *second) {
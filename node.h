@@ -7,6 +7,7 @@
  * @author Valérian Rousset
  */
 
+#include <stdint.h>
 #include <netinet/in.h>
 #include <openssl/sha.h>
 #include <sys/socket.h>
@@ -14,13 +15,34 @@
 #include "error.h"
 #include "util.h" // for _unused macro
 
+/**
+ * @brief maximum number of characters of a zone (failure domain) label
+ */
+#define MAX_ZONE_SIZE 31
+
+/**
+ * @brief position on a ring using the fast 64 bits hash (see hash.h)
+ */
+typedef uint64_t ring_position_t;
+
+/**
+ * @brief hash functions giving the positions of the nodes and keys on a ring (see ring.h)
+ */
+typedef enum {
+    RING_HASH_SHA1 = 0,     // SHA-1 (default, compatible with every existing cluster)
+    RING_HASH_FAST,         // fast 64 bits hash of hash.h: much cheaper on the client
+    RING_HASH_LAST          // not an actual hash but to have the total number of them
+} ring_hash_t;
+
 /**
  * @brief node data structure
  */
 typedef struct {
-    unsigned char sha[SHA_DIGEST_LENGTH];
+    unsigned char sha[SHA_DIGEST_LENGTH]; // SHA-1 of the node id, with RING_HASH_SHA1 only
+    ring_position_t position; // fast hash of the same node id, with RING_HASH_FAST only
     struct sockaddr addr;
     int responsive;
+    char zone[MAX_ZONE_SIZE + 1]; // zone (e.g. rack) of the server, "" if none
 } node_t;
 
 
@@ -30,9 +52,10 @@ typedef struct {
  * @param ip server IP address
  * @param port server port
  * @param node_id after week 11 (included), specify the server node id in a key ring. Unused before week 11.
+ * @param hash hash of the ring the node is for: only this one is computed (sha or position)
  * @return some error code
  */
-error_code node_init(node_t *node, const char *ip, uint16_t port, size_t _unused node_id);
+error_code node_init(node_t *node, const char *ip, uint16_t port, size_t _unused node_id, ring_hash_t hash);
 
 /**
  * @brief all what needs to be done when a node is removed.
@@ -48,6 +71,13 @@ void node_end(node_t *node);
  */
 int node_cmp_sha(const node_t *first, const node_t *second);
 
+/**
+ * @brief tool function to sort nodes according to their 64 bits position
+ * @param two nodes to be compared
+ * @return <0 if first node comes first, 0 if equal and >0 is second node comes first
+ */
+int node_cmp_position(const node_t *first, const node_t *second);
+
 /**
  * @brief tool function to sort node according to their SERVER address
  * @param two nodes to be compared
@@ -8,10 +8,48 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <ctype.h>
 #include "config.h"
 
 #define MAX_PORT 65535
 #define MAX_IP_SIZE 15
+#define MAX_LINE_SIZE 256
+#define WEIGHT_OPTION "weight="
+#define ZONE_OPTION "zone="
+
+/**
+ * @brief parse the optional "name=value" settings following the node count of a server line
+ * @param options rest of the line
+ * @param weight where to write the capacity weight of the server (1 if not given)
+ * @param zone where to write the zone of the server ("" if not given), of size MAX_ZONE_SIZE + 1
+ * @return some error code on unknown option or wrong value
+ */
+static error_code parse_server_options(const char *options, double *weight, char *zone) {
+
+    *weight = 1.0;
+    zone[0] = '\0';
+
+    char option[MAX_LINE_SIZE + 1];
+    int  read = 0;
+    while (sscanf(options, "%256s%n", option, &read) == 1) {
+        options += read;
+
+        if (strncmp(option, WEIGHT_OPTION, strlen(WEIGHT_OPTION)) == 0) {
+            char *end = NULL;
+            *weight = strtod(option + strlen(WEIGHT_OPTION), &end);
+            M_REQUIRE(end != NULL && *end == '\0' && *weight > 0, ERR_BAD_PARAMETER, "wrong weight %s", option);
+        } else if (strncmp(option, ZONE_OPTION, strlen(ZONE_OPTION)) == 0) {
+            const char *name = option + strlen(ZONE_OPTION);
+            M_REQUIRE(strlen(name) <= MAX_ZONE_SIZE, ERR_BAD_PARAMETER, "zone too long %s", option);
+            strcpy(zone, name);
+        } else {
+            M_EXIT(ERR_BAD_PARAMETER, "unknown server option %s", option);
+        }
+    }
+
+    return ERR_NONE;
+}
 
 node_list_t *node_list_new() {
     node_list_t *nodes = calloc(1, sizeof(node_list_t));
@@ -62,7 +100,7 @@ void node_list_sort(node_list_t *list, int (*comparator)(const node_t *, const n
     qsort(list->nodes, list->size, sizeof(node_t), (int (*)(void const *, void const *)) comparator);
 }
 
-node_list_t *get_nodes() {
+node_list_t *get_nodes(ring_hash_t hash) {
 
     node_list_t *node_list1 = node_list_new();
 
@@ -79,48 +117,54 @@ node_list_t *get_nodes() {
     }
 
 #define free_and_close(X, Y) node_list_free((X)); fclose((Y));
-    //Read the file
-    while (!feof(file) && !ferror(file)) {
+    //Read the file, line by line
+    char line[MAX_LINE_SIZE + 1];
+    while (fgets(line, sizeof(line), file) != NULL) {
+
+        //Blank lines, comments and cluster settings (e.g. "placement maglev") are not servers
+        size_t start = strspn(line, " \t\r\n");
+        if (line[start] == '\0' || line[start] == '#' || isalpha((unsigned char) line[start])) {
+            continue;
+        }
 
         char ip[MAX_IP_SIZE + 1];
         memset(ip, '\0', MAX_IP_SIZE + 1);
 
         int port = 0;
         size_t nb_nodes = 0;
+        int end = 0;
+        double weight = 1.0;
+        char zone[MAX_ZONE_SIZE + 1];
 
-        int i = fscanf(file, "%"xstr(MAX_IP_SIZE)"s %d %lu", ip, &port, &nb_nodes);
+        int i = sscanf(line, "%"xstr(MAX_IP_SIZE)"s %d %zu%n", ip, &port, &nb_nodes, &end);
 
-        //Add the node
-        if (i == 3) {
+        //File has wrong format or wrong port size
+        if (i != 3 || port < 0 || port > MAX_PORT || parse_server_options(line + end, &weight, zone) != ERR_NONE) {
+            free_and_close(node_list1, file);
+            return NULL;
+        }
 
-            //Wrong port size
-            if (port < 0 || port > MAX_PORT) {
+        //The server gets virtual nodes in proportion to its weight (at least one)
+        if (nb_nodes > 0) {
+            nb_nodes = (size_t) ((double) nb_nodes * weight + 0.5);
+            nb_nodes = nb_nodes == 0 ? 1 : nb_nodes;
+        }
+
+        //Initialize the nodes
+        for (size_t i = 1; i <= nb_nodes; i++) {
+            node_t node;
+            if (node_init(&node, ip, (uint16_t) port, i, hash) != ERR_NONE) {
                 free_and_close(node_list1, file);
                 return NULL;
             }
+            strcpy(node.zone, zone);
 
-            //Initialize the nodes
-            for (size_t i = 1; i <= nb_nodes; i++) {
-				node_t node;
-				if (node_init(&node, ip, (uint16_t) port, i) != ERR_NONE) {
-					free_and_close(node_list1, file);
-					return NULL;
-				}
-
-				//Add the node
-				if (node_list_add(node_list1, node) != ERR_NONE) {
-					free_and_close(node_list1, file);
-					return NULL;
-				}
-			}
-
-        }
-            //File has wrong format
-        else if (i != EOF) {
-            free_and_close(node_list1, file);
-            return NULL;
+            //Add the node
+            if (node_list_add(node_list1, node) != ERR_NONE) {
+                free_and_close(node_list1, file);
+                return NULL;
+            }
         }
-
     }
 
     fclose(file);
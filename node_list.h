@@ -29,10 +29,16 @@ typedef struct {
 node_list_t *node_list_new();
 
 /**
- * @brief parse the PPS_SERVERS_LIST_FILENAME file and return the corresponding list of nodes
+ * @brief parse the PPS_SERVERS_LIST_FILENAME file and return the corresponding list of nodes.
+ *        Each server line is "IP port nb_nodes [weight=W] [zone=Z]": the server gets round(nb_nodes * W)
+ *        virtual nodes (at least one if nb_nodes > 0), W being its capacity weight (1 by default),
+ *        and belongs to the failure domain (e.g. rack) Z, if any.
+ *        Blank lines, lines starting with '#' and cluster settings (lines starting with
+ *        a letter, see ring.h) are skipped.
+ * @param hash hash of the ring the nodes are for (see node_init)
  * @return the list of nodes initialized from the server file (PPS_SERVERS_LIST_FILENAME)
  */
-node_list_t *get_nodes();
+node_list_t *get_nodes(ring_hash_t hash);
 
 /**
  * @brief add a node to a list of nodes
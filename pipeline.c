@@ -0,0 +1,274 @@
+/**
+ * @file pipeline.c
+ * @brief Implementation of pipeline.h
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "pipeline.h"
+#include "config.h"
+#include "system.h"
+#include "bulk.h" // for the sizes of the batches of writes
+
+static void write_u32(char *out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = (char) (value >> (24 - 8 * i));
+    }
+}
+
+static uint32_t read_u32(const char *msg) {
+    const unsigned char *in = (const unsigned char *) msg;
+    return (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16 | (uint32_t) in[2] << 8 | in[3];
+}
+
+static void finish(pipeline_entry_t *entry, error_code error, char *value) {
+    entry->done    = 1;
+    entry->done_at = get_time_ms();
+    entry->error   = error;
+    entry->value = value;
+}
+
+static void clear_entry(pipeline_entry_t *entry) {
+    for (size_t i = 0; i < entry->nb_values; ++i) {
+        free(entry->values[i]);
+    }
+    free(entry->key);
+    free(entry->value);
+    memset(entry, 0, sizeof(*entry));
+}
+
+//Hand the results over in order, as far as the operations are done
+static void deliver(pipeline_t *pipeline) {
+    while (pipeline->oldest_seq != pipeline->next_seq) {
+        pipeline_entry_t *entry = &pipeline->entries[pipeline->oldest_seq % pipeline->depth];
+        if (!entry->done) {
+            return;
+        }
+        pipeline->done(entry->op, entry->key, entry->error, entry->value, entry->done_at, pipeline->arg);
+        clear_entry(entry);
+        ++pipeline->oldest_seq;
+    }
+}
+
+//A get is done once R replicas gave the same value, or once all answered without
+static void handle_get(const client_t *client, pipeline_entry_t *entry, const char *reply, size_t len) {
+
+    if (len >= 7 && reply[6] != 0) {
+        char *value = malloc(len - 7 + 1);
+        if (value == NULL) {
+            finish(entry, ERR_NOMEM, NULL);
+            return;
+        }
+        memcpy(value, reply + 7, len - 7);
+        value[len - 7] = '\0';
+        entry->values[entry->nb_values++] = value;
+
+        size_t same = 0;
+        for (size_t i = 0; i < entry->nb_values; ++i) {
+            same += strcmp(entry->values[i], value) == 0;
+        }
+        if (same >= client->args->R) {
+            //Handed over to the entry, not freed with the answers
+            entry->values[--entry->nb_values] = NULL;
+            finish(entry, ERR_NONE, value);
+            return;
+        }
+    }
+    if (entry->nb_answered == entry->nb_replicas) {
+        finish(entry, ERR_NETWORK, NULL);
+    }
+}
+
+static void handle_reply(pipeline_t *pipeline, const char *reply, size_t len, const struct sockaddr *from, socklen_t from_len) {
+
+    if (len < 6 || reply[0] != PPS_OP_PREFIX || (reply[1] != PPS_OP_GET_SEQ && reply[1] != PPS_OP_PUT_BATCH)) {
+        return;
+    }
+    const uint32_t seq = read_u32(reply + 2);
+    pipeline_entry_t *entry = &pipeline->entries[seq % pipeline->depth];
+    const pipeline_op_t op = reply[1] == PPS_OP_GET_SEQ ? PIPELINE_GET : PIPELINE_PUT;
+    if (!entry->used || entry->done || entry->seq != seq || entry->op != op) {
+        return;
+    }
+
+    size_t i = 0;
+    while (i < entry->nb_replicas && memcmp(from, &entry->replicas[i].addr, from_len) != 0) {
+        ++i;
+    }
+    if (i == entry->nb_replicas || entry->answered[i]) {
+        return;
+    }
+    entry->answered[i] = 1;
+    entry->nb_answered += 1;
+
+    if (op == PIPELINE_GET) {
+        handle_get(pipeline->client, entry, reply, len);
+        return;
+    }
+    if (len == BULK_BATCH_REPLY_SIZE && reply[6] == PPS_STATUS_OK) {
+        entry->nb_acked += 1;
+    }
+    if (entry->nb_acked >= pipeline->client->args->W) {
+        finish(entry, ERR_NONE, NULL);
+    } else if (entry->nb_answered == entry->nb_replicas) {
+        finish(entry, ERR_NETWORK, NULL);
+    }
+}
+
+//Wait at most timeout_ms for replies, handle all those arrived, then give up on the late operations
+static void pump(pipeline_t *pipeline, double timeout_ms) {
+
+    static char reply[MAX_MSG_SIZE];
+    struct pollfd fd = {pipeline->socket, POLLIN, 0};
+    if (poll(&fd, 1, timeout_ms > 0 ? 1 + (int) timeout_ms : 0) > 0) {
+        struct sockaddr from;
+        socklen_t from_len = sizeof(from);
+        ssize_t len = 0;
+        while ((len = recvfrom(pipeline->socket, reply, sizeof(reply), MSG_DONTWAIT, &from, &from_len)) >= 0) {
+            handle_reply(pipeline, reply, (size_t) len, &from, from_len);
+            from_len = sizeof(from);
+        }
+    }
+
+    const double now = get_time_ms();
+    for (uint32_t seq = pipeline->oldest_seq; seq != pipeline->next_seq; ++seq) {
+        pipeline_entry_t *entry = &pipeline->entries[seq % pipeline->depth];
+        if (!entry->done && now - entry->sent_at >= PIPELINE_TIMEOUT_MS) {
+            finish(entry, ERR_NETWORK, NULL);
+        }
+    }
+
+    deliver(pipeline);
+}
+
+//Time until the oldest operation out times out (the operations are sent in order)
+static double next_timeout_ms(const pipeline_t *pipeline) {
+    for (uint32_t seq = pipeline->oldest_seq; seq != pipeline->next_seq; ++seq) {
+        const pipeline_entry_t *entry = &pipeline->entries[seq % pipeline->depth];
+        if (!entry->done) {
+            return entry->sent_at + PIPELINE_TIMEOUT_MS - get_time_ms();
+        }
+    }
+    return 0;
+}
+
+error_code pipeline_init(pipeline_t *pipeline, const client_t *client, size_t depth, pipeline_done_t done, void *arg) {
+
+    M_REQUIRE_NON_NULL(pipeline);
+    M_REQUIRE_NON_NULL(client);
+    M_REQUIRE_NON_NULL(done);
+    M_REQUIRE(depth <= PIPELINE_MAX_DEPTH, ERR_BAD_PARAMETER, "depth %zu", depth);
+
+    memset(pipeline, 0, sizeof(*pipeline));
+    pipeline->client = client;
+    pipeline->depth  = depth == 0 ? PIPELINE_DEFAULT_DEPTH : depth;
+    pipeline->done   = done;
+    pipeline->arg    = arg;
+
+    pipeline->entries = calloc(pipeline->depth, sizeof(pipeline_entry_t));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(pipeline->entries, ERR_NOMEM);
+
+    pipeline->socket = get_socket(0);
+    if (pipeline->socket == -1) {
+        free(pipeline->entries);
+        return ERR_NETWORK;
+    }
+
+    //Room for the replies of all the operations out (the system may give less: those dropped time out)
+    int buffer_size = (int) (pipeline->depth * client->args->N) * MAX_MSG_ELEM_SIZE;
+    setsockopt(pipeline->socket, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+    return ERR_NONE;
+}
+
+error_code pipeline_submit(pipeline_t *pipeline, pipeline_op_t op, const char *key, const char *value) {
+
+    M_REQUIRE_NON_NULL(pipeline);
+    M_REQUIRE_NON_NULL(key);
+    M_REQUIRE(op == PIPELINE_GET || value != NULL, ERR_BAD_PARAMETER, "%s", "put without a value");
+
+    const size_t key_len   = strlen(key);
+    const size_t value_len = op == PIPELINE_PUT ? strlen(value) : 0;
+    const size_t len = op == PIPELINE_GET ? 6 + key_len : BULK_BATCH_HEADER_SIZE + key_len + value_len + 2;
+    M_REQUIRE(key_len > 0 && key_len <= MAX_MSG_ELEM_SIZE && value_len <= MAX_MSG_ELEM_SIZE && len <= MAX_MSG_SIZE,
+              ERR_BAD_PARAMETER, "%s", "empty or too long key or value");
+
+    //Room for the operation
+    while (pipeline->next_seq - pipeline->oldest_seq == pipeline->depth) {
+        pump(pipeline, next_timeout_ms(pipeline));
+    }
+
+    const uint32_t seq = pipeline->next_seq;
+    pipeline_entry_t *entry = &pipeline->entries[seq % pipeline->depth];
+    entry->key = malloc(key_len + 1);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(entry->key, ERR_NOMEM);
+    memcpy(entry->key, key, key_len + 1);
+    entry->used = 1;
+    entry->op   = op;
+    entry->seq  = seq;
+    ++pipeline->next_seq;
+
+    static char request[MAX_MSG_SIZE];
+    request[0] = PPS_OP_PREFIX;
+    write_u32(request + 2, seq);
+    if (op == PIPELINE_GET) {
+        request[1] = PPS_OP_GET_SEQ;
+        memcpy(request + 6, key, key_len);
+    } else {
+        request[1] = PPS_OP_PUT_BATCH;
+        request[6] = 0;
+        request[7] = 1;
+        memcpy(request + BULK_BATCH_HEADER_SIZE, key, key_len + 1);
+        memcpy(request + BULK_BATCH_HEADER_SIZE + key_len + 1, value, value_len + 1);
+        cache_drop(pipeline->client->cache, key);
+    }
+
+    //Written in the entry, which keeps them until it is answered
+    const client_t *client = pipeline->client;
+    node_list_t replicas = ring_get_nodes_for_key(client->server, client->args->N, key, entry->replicas);
+    entry->nb_replicas = replicas.size;
+
+    entry->sent_at = get_time_ms();
+    if (replicas.size < (op == PIPELINE_GET ? client->args->R : client->args->W)) {
+        finish(entry, ERR_BAD_PARAMETER, NULL);
+    } else {
+        for (size_t i = 0; i < replicas.size; ++i) {
+            sendto(pipeline->socket, request, len, 0, &entry->replicas[i].addr, sizeof(entry->replicas[i].addr));
+        }
+    }
+
+    //Replies already there make room for the next operations
+    pump(pipeline, 0);
+
+    return ERR_NONE;
+}
+
+void pipeline_wait(pipeline_t *pipeline, double timeout_ms) {
+    if (pipeline != NULL) {
+        pump(pipeline, timeout_ms);
+    }
+}
+
+void pipeline_flush(pipeline_t *pipeline) {
+    if (pipeline == NULL) {
+        return;
+    }
+    while (pipeline->oldest_seq != pipeline->next_seq) {
+        pump(pipeline, next_timeout_ms(pipeline));
+    }
+}
+
+void pipeline_end(pipeline_t *pipeline) {
+    if (pipeline == NULL || pipeline->entries == NULL) {
+        return;
+    }
+    pipeline_flush(pipeline);
+    close(pipeline->socket);
+    free(pipeline->entries);
+    pipeline->entries = NULL;
+}
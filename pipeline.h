@@ -0,0 +1,123 @@
+#pragma once
+
+/**
+ * @file pipeline.h
+ * @brief Pipelined gets and puts: a client keeps several operations out at once on a single
+ *        socket, each request carrying a sequence number that its replies echo (PPS_OP_GET_SEQ for
+ *        gets, a batch of one pair for puts, see PPS_OP_PUT_BATCH). The results are handed over
+ *        in the order the operations were submitted.
+ *        A get needs R matching values from the N replicas and a put W acknowledgements, as with
+ *        network_get and network_put, but without their hinted handoff, latency-aware reads, cache
+ *        or hot key spreading.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "client.h"
+#include "error.h"
+
+/**
+ * @brief operations out at once by default, and at most
+ */
+#define PIPELINE_DEFAULT_DEPTH 32
+#define PIPELINE_MAX_DEPTH 1024
+
+/**
+ * @brief time an operation waits for its replies
+ */
+#define PIPELINE_TIMEOUT_MS 1000
+
+typedef enum {
+    PIPELINE_GET,
+    PIPELINE_PUT
+} pipeline_op_t;
+
+/**
+ * @brief function called with the result of each operation, in the order of submission
+ * @param op the operation
+ * @param key its key
+ * @param error ERR_NONE if it succeeded
+ * @param value the value read by a get that succeeded, NULL otherwise
+ * @param done_ms when the operation was done (see get_time_ms), which may be before its turn came
+ * @param arg argument given to pipeline_init
+ */
+typedef void (*pipeline_done_t)(pipeline_op_t op, const char *key, error_code error, const char *value,
+                                double done_ms, void *arg);
+
+/**
+ * @brief an operation out, or done and waiting for the ones submitted before it
+ */
+typedef struct {
+    int used;
+    int done;
+    pipeline_op_t op;
+    uint32_t seq;
+    char *key;
+    double sent_at;
+    double done_at;
+    node_t replicas[RING_MAX_PREFERENCE_SIZE];
+    size_t nb_replicas;
+    int answered[RING_MAX_PREFERENCE_SIZE];
+    char *values[RING_MAX_PREFERENCE_SIZE]; // values found by a get, in the order of the answers
+    size_t nb_values;
+    size_t nb_answered;
+    size_t nb_acked;
+    error_code error;
+    char *value;              // value agreed on by a get
+} pipeline_entry_t;
+
+/**
+ * @brief the operations of a client
+ */
+typedef struct {
+    const client_t *client;
+    int socket;
+    size_t depth;
+    pipeline_entry_t *entries; // the entry of sequence number seq is entries[seq % depth]
+    uint32_t next_seq;        // of the next operation submitted
+    uint32_t oldest_seq;      // of the oldest operation whose result is not handed over
+    pipeline_done_t done;
+    void *arg;
+} pipeline_t;
+
+/**
+ * @brief initialize a pipeline
+ * @param pipeline the pipeline
+ * @param client the (initialized) client, used until pipeline_end
+ * @param depth number of operations out at once (0 for PIPELINE_DEFAULT_DEPTH)
+ * @param done function called with the result of each operation
+ * @param arg passed to done
+ * @return some error code
+ */
+error_code pipeline_init(pipeline_t *pipeline, const client_t *client, size_t depth, pipeline_done_t done, void *arg);
+
+/**
+ * @brief submit an operation, once the oldest one is done if depth operations are out
+ * @param pipeline the pipeline
+ * @param op the operation
+ * @param key the key
+ * @param value the value to write (NULL for a get)
+ * @return ERR_BAD_PARAMETER if the key or value is empty or too long (the operation is not
+ *         submitted), ERR_NOMEM, or ERR_NONE
+ */
+error_code pipeline_submit(pipeline_t *pipeline, pipeline_op_t op, const char *key, const char *value);
+
+/**
+ * @brief wait for replies, handing over the results of the operations done meanwhile
+ * @param pipeline the pipeline
+ * @param timeout_ms how long to wait at most (0 to handle only the replies already there)
+ */
+void pipeline_wait(pipeline_t *pipeline, double timeout_ms);
+
+/**
+ * @brief wait for all the operations submitted to be done and handed over
+ * @param pipeline the pipeline
+ */
+void pipeline_flush(pipeline_t *pipeline);
+
+/**
+ * @brief flush and free a pipeline
+ * @param pipeline the pipeline
+ */
+void pipeline_end(pipeline_t *pipeline);
@@ -0,0 +1,89 @@
+/**
+ * @file pps-placement-check.c
+ * @brief check, over a sample of keys, that the replicas of each key are spread
+ *        over as many zones as possible
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "error.h"
+#include "args.h"
+#include "ring.h"
+
+#define DEFAULT_NB_KEYS 100000
+#define KEY_SIZE 32
+
+int main(int argc, char *argv[]) {
+
+    char **rem_argv = argv + 1;
+    args_t *args = parse_opt_args(TOTAL_SERVERS, &rem_argv);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(args, ERR_BAD_PARAMETER);
+
+    size_t nb_keys = DEFAULT_NB_KEYS;
+    if (*rem_argv != NULL && (sscanf(*rem_argv, "%zu", &nb_keys) != 1 || nb_keys == 0)) {
+        fprintf(stderr, "usage: %s [-n N] [nb_keys]\n", argv[0]);
+        free(args);
+        return ERR_BAD_PARAMETER;
+    }
+
+    ring_t *ring = ring_alloc();
+    error_code error = ring == NULL ? ERR_IO : ring_init(ring);
+    if (error != ERR_NONE) {
+        ring_free(ring);
+        free(args);
+    }
+    M_EXIT_IF_ERR(error, "cannot build the ring");
+
+    const size_t n        = args->N < ring->pref_size ? args->N : ring->pref_size;
+    const size_t expected = n < ring->nb_zones ? n : ring->nb_zones;
+
+    //histogram[z] is the number of keys whose replicas are in z distinct zones
+    size_t histogram[RING_MAX_PREFERENCE_SIZE + 1];
+    memset(histogram, 0, sizeof(histogram));
+
+    for (size_t k = 0; k < nb_keys; ++k) {
+        char key[KEY_SIZE];
+        snprintf(key, KEY_SIZE, "key-%zu", k);
+
+        node_t replicas_row[RING_MAX_PREFERENCE_SIZE];
+        node_list_t replicas = ring_get_nodes_for_key(ring, n, key, replicas_row);
+
+        size_t zones = 0;
+        for (size_t i = 0; i < replicas.size; ++i) {
+            int new_zone = 1;
+            for (size_t j = 0; j < i; ++j) {
+                if (strcmp(replicas.nodes[i].zone, replicas.nodes[j].zone) == 0) {
+                    new_zone = 0;
+                }
+            }
+            zones += new_zone;
+        }
+        histogram[zones] += 1;
+    }
+
+    printf("%s placement, %zu servers in %zu zones, N = %zu: replicas must span %zu zones\n",
+           PLACEMENT_NAMES[ring->placement], ring->nb_servers, ring->nb_zones, n, expected);
+
+    size_t violations = 0;
+    for (size_t z = 0; z <= n; ++z) {
+        if (histogram[z] > 0) {
+            printf("%3zu zones: %9zu keys (%6.2f%%)\n", z, histogram[z],
+                   100.0 * (double) histogram[z] / (double) nb_keys);
+        }
+        if (z < expected) {
+            violations += histogram[z];
+        }
+    }
+
+    printf("%s: %zu of %zu keys with replicas in too few zones\n", violations == 0 ? "OK" : "FAIL",
+           violations, nb_keys);
+
+    ring_free(ring);
+    free(args);
+
+    return violations == 0 ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+/**
+ * @file pps-placement-report.c
+ * @brief report, for each placement strategy, the load imbalance over the servers
+ *        of the servers file (primary keys relative to the share expected from their
+ *        number of virtual nodes) and the keys moved when its last server leaves,
+ *        then the expected key share of every server with the cluster's own placement
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "config.h"
+#include "error.h"
+#include "args.h"
+#include "node_list.h"
+#include "ring.h"
+
+#define DEFAULT_NB_KEYS 100000
+#define KEY_SIZE 32
+
+/**
+ * @brief build and initialize a ring from the servers file
+ * @param placement placement strategy of the ring
+ * @param drop_last whether to leave out the server of the last line of the file
+ * @return the initialized ring, NULL on error
+ */
+static ring_t *build_ring(placement_t placement, int drop_last) {
+
+    node_list_t *list = get_nodes(RING_HASH_SHA1);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(list, NULL);
+
+    if (drop_last && list->size > 0) {
+        const struct sockaddr last = list->nodes[list->size - 1].addr;
+        size_t kept = 0;
+        for (size_t i = 0; i < list->size; ++i) {
+            if (memcmp(&list->nodes[i].addr, &last, sizeof(struct sockaddr)) != 0) {
+                list->nodes[kept++] = list->nodes[i];
+            }
+        }
+        list->size = kept;
+    }
+
+    ring_t *ring = ring_alloc_from_nodes(list, placement, RING_HASH_SHA1);
+    if (ring != NULL && ring_init(ring) != ERR_NONE) {
+        ring_free(ring);
+        ring = NULL;
+    }
+
+    return ring;
+}
+
+//Whether both lists hold the same servers (in any order)
+static int same_servers(const node_list_t *first, const node_list_t *second) {
+    if (first->size != second->size) {
+        return 0;
+    }
+    for (size_t i = 0; i < first->size; ++i) {
+        if (server_different(second, &first->nodes[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief print the target (from the weights) and expected key share of each server
+ * @param ring the (initialized) ring of the cluster
+ * @return some error code
+ */
+static error_code print_shares(const ring_t *ring) {
+
+    double *shares = calloc(ring->nb_servers, sizeof(double));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(shares, ERR_NOMEM);
+
+    error_code error = ring_primary_shares(ring, shares);
+    if (error != ERR_NONE) {
+        free(shares);
+        return error;
+    }
+
+    printf("\n%s placement, expected share of primary keys:\n", PLACEMENT_NAMES[ring->placement]);
+    printf("%-21s %8s %8s %8s %8s\n", "server", "vnodes", "target", "share", "ratio");
+
+    for (size_t s = 0; s < ring->nb_servers; ++s) {
+        const struct sockaddr_in *addr = (const struct sockaddr_in *) &ring->servers[s].addr;
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr->sin_addr, ip, INET_ADDRSTRLEN);
+
+        const double target = (double) ring->weights[s] / (double) ring->size;
+        printf("%15s %5d %8zu %7.2f%% %7.2f%% %8.3f\n", ip, ntohs(addr->sin_port), ring->weights[s],
+               100.0 * target, 100.0 * shares[s], shares[s] / target);
+    }
+
+    free(shares);
+    return ERR_NONE;
+}
+
+int main(int argc, char *argv[]) {
+
+    char **rem_argv = argv + 1;
+    args_t *args = parse_opt_args(TOTAL_SERVERS, &rem_argv);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(args, ERR_BAD_PARAMETER);
+
+    size_t nb_keys = DEFAULT_NB_KEYS;
+    if (*rem_argv != NULL && (sscanf(*rem_argv, "%zu", &nb_keys) != 1 || nb_keys == 0)) {
+        fprintf(stderr, "usage: %s [-n N] [nb_keys]\n", argv[0]);
+        free(args);
+        return ERR_BAD_PARAMETER;
+    }
+
+    printf("%-11s %8s %8s %8s %10s %10s %8s\n",
+           "placement", "servers", "max/exp", "min/exp", "moved", "sets-moved", "ideal");
+
+    for (placement_t p = PLACEMENT_RING; p < PLACEMENT_LAST; ++p) {
+
+        ring_t *full    = build_ring(p, 0);
+        ring_t *reduced = build_ring(p, 1);
+        if (full == NULL || reduced == NULL || reduced->nb_servers == 0) {
+            fprintf(stderr, "%s: cannot build the rings from " PPS_SERVERS_LIST_FILENAME " (at least two servers are needed)\n", PLACEMENT_NAMES[p]);
+            ring_free(full);
+            ring_free(reduced);
+            free(args);
+            return ERR_BAD_PARAMETER;
+        }
+
+        const size_t n = args->N < full->pref_size ? args->N : full->pref_size;
+
+        size_t *loads = calloc(full->nb_servers, sizeof(size_t));
+        if (loads == NULL) {
+            ring_free(full);
+            ring_free(reduced);
+            free(args);
+            return ERR_NOMEM;
+        }
+
+        size_t moved      = 0;
+        size_t sets_moved = 0;
+        for (size_t k = 0; k < nb_keys; ++k) {
+            char key[KEY_SIZE];
+            snprintf(key, KEY_SIZE, "key-%zu", k);
+
+            node_t      before_row[RING_MAX_PREFERENCE_SIZE];
+            node_t      after_row[RING_MAX_PREFERENCE_SIZE];
+            node_list_t before = ring_get_nodes_for_key(full, n, key, before_row);
+            node_list_t after  = ring_get_nodes_for_key(reduced, n, key, after_row);
+
+            loads[ring_server_index(full, &before.nodes[0])] += 1;
+            if (memcmp(&before.nodes[0].addr, &after.nodes[0].addr, sizeof(struct sockaddr)) != 0) {
+                ++moved;
+            }
+            if (!same_servers(&before, &after)) {
+                ++sets_moved;
+            }
+        }
+
+        //Loads relative to the share expected from the number of virtual nodes of each server
+        double max = 0;
+        double min = -1;
+        for (size_t s = 0; s < full->nb_servers; ++s) {
+            const double expected = (double) nb_keys * (double) full->weights[s] / (double) full->size;
+            const double ratio    = (double) loads[s] / expected;
+            max = ratio > max ? ratio : max;
+            min = min < 0 || ratio < min ? ratio : min;
+        }
+
+        printf("%-11s %8zu %8.3f %8.3f %9.2f%% %9.2f%% %7.2f%%\n", PLACEMENT_NAMES[p], full->nb_servers,
+               max, min,
+               100.0 * (double) moved / (double) nb_keys, 100.0 * (double) sets_moved / (double) nb_keys,
+               100.0 * (double) (full->size - reduced->size) / (double) full->size);
+
+        free(loads);
+        ring_free(full);
+        ring_free(reduced);
+    }
+
+    ring_t *ring = ring_alloc();
+    error_code error = ring == NULL ? ERR_IO : ring_init(ring);
+    if (error == ERR_NONE) {
+        error = print_shares(ring);
+    }
+    ring_free(ring);
+    free(args);
+
+    M_EXIT_IF_ERR(error, "placement report");
+
+    return 0;
+}
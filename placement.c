@@ -0,0 +1,272 @@
+/**
+ * @file placement.c
+ * @brief Implementation of placement.h
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <openssl/sha.h>
+#include "placement.h"
+
+uint64_t placement_mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+uint64_t placement_hash64(const void *data, size_t len) {
+    unsigned char sha[SHA_DIGEST_LENGTH];
+    SHA1((const unsigned char *) data, len, sha);
+
+    uint64_t hash = 0;
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+        hash = (hash << 8) | sha[i];
+    }
+    return hash;
+}
+
+/**
+ * @brief fill every slot row by walking a table of server indices from the slot,
+ *        keeping the first ring->pref_size distinct alive servers: first the ones
+ *        of zones not in the row yet, then the others
+ * @param ring the ring (preferences already allocated for nb_slots rows)
+ * @param table server index of each of the nb_slots entries (every server appears)
+ * @param nb_slots number of entries of the table
+ * @param nodes node to copy for each entry, NULL to copy ring->servers
+ * @return some error code
+ */
+static error_code fill_rows(ring_t *ring, const size_t *table, size_t nb_slots, const node_t *nodes) {
+
+    //last_seen[s] (resp. zone_seen[z]) is the (slot index + 1) for which server s (resp. zone z) was last added
+    size_t *last_seen = calloc(ring->nb_servers, sizeof(size_t));
+    size_t *zone_seen = calloc(ring->nb_zones, sizeof(size_t));
+    if (last_seen == NULL || zone_seen == NULL) {
+        free(last_seen);
+        free(zone_seen);
+        return ERR_NOMEM;
+    }
+
+    //Zones with at least one alive server
+    size_t nb_zones = 0;
+    for (size_t s = 0; s < ring->nb_servers; ++s) {
+        if (ring->alive[s] && zone_seen[ring->server_zones[s]] == 0) {
+            zone_seen[ring->server_zones[s]] = SIZE_MAX;
+            ++nb_zones;
+        }
+    }
+    memset(zone_seen, 0, ring->nb_zones * sizeof(size_t));
+
+    for (size_t i = 0; i < nb_slots; ++i) {
+        node_t *row   = &ring->preferences[i * ring->pref_size];
+        size_t found  = 0;
+        size_t zones  = 0;
+
+        //First pass: one server per zone, second pass: complete with the other servers
+        for (int pass = 0; pass < 2 && found < ring->pref_size; ++pass) {
+            for (size_t step = 0, j = i; step < nb_slots && found < ring->pref_size
+                 && (pass == 1 || zones < nb_zones); ++step, j = (j + 1) % nb_slots) {
+                const size_t server = table[j];
+                const size_t zone   = ring->server_zones[server];
+                if (ring->alive[server] && last_seen[server] != i + 1 && (pass == 1 || zone_seen[zone] != i + 1)) {
+                    last_seen[server] = i + 1;
+                    zones += zone_seen[zone] != i + 1;
+                    zone_seen[zone]   = i + 1;
+                    row[found++] = nodes == NULL ? ring->servers[server] : nodes[j];
+                }
+            }
+        }
+    }
+
+    free(zone_seen);
+    free(last_seen);
+    return ERR_NONE;
+}
+
+//Allocate the preference lists of the ring
+static error_code alloc_rows(ring_t *ring, size_t nb_slots) {
+    free(ring->preferences);
+    ring->nb_slots    = nb_slots;
+    ring->preferences = calloc(nb_slots * ring->pref_size, sizeof(node_t));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(ring->preferences, ERR_NOMEM);
+    return ERR_NONE;
+}
+
+error_code placement_ring_build(ring_t *ring, const size_t *server_ids) {
+
+    error_code error = alloc_rows(ring, ring->size);
+    M_EXIT_IF_ERR(error, "ring placement");
+
+    return fill_rows(ring, server_ids, ring->size, ring->nodes);
+}
+
+//Smallest prime greater or equal to n
+static size_t next_prime(size_t n) {
+    for (;; ++n) {
+        int prime = n >= 2;
+        for (size_t d = 2; prime && d * d <= n; ++d) {
+            prime = n % d != 0;
+        }
+        if (prime) {
+            return n;
+        }
+    }
+}
+
+error_code placement_maglev_build(ring_t *ring) {
+
+    size_t table_size = MAGLEV_TABLE_SIZE;
+    if (MAGLEV_ENTRIES_PER_SERVER * ring->nb_servers > table_size) {
+        table_size = next_prime(MAGLEV_ENTRIES_PER_SERVER * ring->nb_servers);
+    }
+
+    size_t *table = calloc(table_size, sizeof(size_t));
+    size_t *next  = calloc(ring->nb_servers, sizeof(size_t));
+    if (table == NULL || next == NULL) {
+        free(table);
+        free(next);
+        return ERR_NOMEM;
+    }
+
+    for (size_t c = 0; c < table_size; ++c) {
+        table[c] = SIZE_MAX;
+    }
+
+    //Alive servers take turns filling the table following their own permutation,
+    //each of them taking as many entries per turn as it has virtual nodes
+    size_t filled = 0;
+    while (filled < table_size) {
+        for (size_t i = 0; i < ring->nb_servers && filled < table_size; ++i) {
+            if (!ring->alive[i]) {
+                continue;
+            }
+            const uint64_t offset = ring->server_hashes[i] % table_size;
+            const uint64_t skip   = placement_mix64(ring->server_hashes[i]) % (table_size - 1) + 1;
+
+            for (size_t w = 0; w < ring->weights[i] && filled < table_size; ++w) {
+                size_t c = (size_t) ((offset + next[i] * skip) % table_size);
+                while (table[c] != SIZE_MAX) {
+                    ++next[i];
+                    c = (size_t) ((offset + next[i] * skip) % table_size);
+                }
+                table[c] = i;
+                ++next[i];
+                ++filled;
+            }
+        }
+    }
+
+    error_code error = alloc_rows(ring, table_size);
+    if (error == ERR_NONE) {
+        error = fill_rows(ring, table, table_size, NULL);
+    }
+
+    free(next);
+    free(table);
+    return error;
+}
+
+error_code placement_jump_build(ring_t *ring) {
+
+    size_t *table = calloc(ring->nb_servers, sizeof(size_t));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(table, ERR_NOMEM);
+
+    //Bucket i is the i-th server to join: a server added at the end of the servers file only takes
+    //keys from the others, which keep their buckets
+    for (size_t i = 0; i < ring->nb_servers; ++i) {
+        table[i] = ring->joined[i];
+    }
+
+    error_code error = alloc_rows(ring, ring->nb_servers);
+    if (error == ERR_NONE) {
+        error = fill_rows(ring, table, ring->nb_servers, NULL);
+    }
+
+    free(table);
+    return error;
+}
+
+size_t placement_jump_bucket(uint64_t key, size_t nb_buckets) {
+    int64_t b = -1;
+    int64_t j = 0;
+    while (j < (int64_t) nb_buckets) {
+        b   = j;
+        key = key * 2862933555777941757ULL + 1;
+        j   = (int64_t) ((double) (b + 1) * ((double) (1LL << 31) / (double) ((key >> 33) + 1)));
+    }
+    return (size_t) b;
+}
+
+//A server and its score, in a list kept from the best score down
+typedef struct {
+    size_t server;
+    double score;
+} rendezvous_pick_t;
+
+//Put a server in a list of at most capacity ones kept from the best score down, after the ones
+//with the same score (the servers come by increasing index, the first one wins the ties)
+static void keep_best(rendezvous_pick_t *list, size_t *size, size_t capacity, size_t server, double score) {
+    if (*size == capacity && !(score > list[*size - 1].score)) {
+        return;
+    }
+    size_t i = *size < capacity ? (*size)++ : *size - 1;
+    for (; i > 0 && score > list[i - 1].score; --i) {
+        list[i] = list[i - 1];
+    }
+    list[i] = (rendezvous_pick_t) {server, score};
+}
+
+void placement_rendezvous_fill(const ring_t *ring, uint64_t key, node_t *row, size_t wanted_size) {
+
+    if (wanted_size == 0) {
+        return;
+    }
+
+    //In one pass, the best servers and the best server of each of the best zones: the row is
+    //the best zones from their best server down, then the best servers left
+    rendezvous_pick_t best[RING_MAX_PREFERENCE_SIZE];
+    rendezvous_pick_t zones[RING_MAX_PREFERENCE_SIZE];
+    size_t nb_best  = 0;
+    size_t nb_zones = 0;
+    for (size_t i = 0; i < ring->nb_servers; ++i) {
+        if (!ring->alive[i]) {
+            continue;
+        }
+        //Uniform in ]0, 1[, then weighted score w / -ln(u)
+        const uint64_t h     = placement_mix64(key ^ ring->server_hashes[i]);
+        const double   u     = ((double) (h >> 11) + 0.5) / 9007199254740992.0;
+        const double   score = (double) ring->weights[i] / -log(u);
+        keep_best(best, &nb_best, wanted_size, i, score);
+
+        size_t z = 0;
+        while (z < nb_zones && ring->server_zones[zones[z].server] != ring->server_zones[i]) {
+            ++z;
+        }
+        if (z == nb_zones) {
+            keep_best(zones, &nb_zones, wanted_size, i, score);
+        } else if (score > zones[z].score) {
+            for (; z > 0 && score > zones[z - 1].score; --z) {
+                zones[z] = zones[z - 1];
+            }
+            zones[z] = (rendezvous_pick_t) {i, score};
+        }
+    }
+
+    size_t found = 0;
+    for (; found < nb_zones; ++found) {
+        row[found] = ring->servers[zones[found].server];
+    }
+    for (size_t b = 0; b < nb_best && found < wanted_size; ++b) {
+        int taken = 0;
+        for (size_t z = 0; z < nb_zones && !taken; ++z) {
+            taken = zones[z].server == best[b].server;
+        }
+        if (!taken) {
+            row[found++] = ring->servers[best[b].server];
+        }
+    }
+}
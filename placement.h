@@ -0,0 +1,79 @@
+#pragma once
+
+/**
+ * @file placement.h
+ * @brief Placement strategies of the ring (see ring.h): each of them builds the
+ *        preference lists of the ring slots and maps a key hash to a slot.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "error.h"
+#include "ring.h"
+
+/**
+ * @brief size of the Maglev lookup table (a prime). It must not depend on the membership
+ *        to keep disruption minimal, so it only grows (to a prime above
+ *        MAGLEV_ENTRIES_PER_SERVER entries per server) for very large clusters
+ */
+#define MAGLEV_TABLE_SIZE 5003
+#define MAGLEV_ENTRIES_PER_SERVER 101
+
+/**
+ * @brief mix the bits of a 64 bits integer (splitmix64 finalizer)
+ * @param x value to mix
+ * @return the mixed value
+ */
+uint64_t placement_mix64(uint64_t x);
+
+/**
+ * @brief 64 bits hash of a binary string (the first 8 bytes of its SHA-1)
+ * @param data bytes to hash
+ * @param len number of bytes
+ * @return the hash
+ */
+uint64_t placement_hash64(const void *data, size_t len);
+
+/**
+ * @brief fill the preference lists of the consistent hashing ring: one slot per node,
+ *        walking the ring from it and keeping distinct servers
+ * @param ring the ring, with sorted nodes and known servers
+ * @param server_ids server index of every node
+ * @return some error code
+ */
+error_code placement_ring_build(ring_t *ring, const size_t *server_ids);
+
+/**
+ * @brief build the Maglev lookup table (weighted by the number of virtual nodes)
+ *        and fill the preference list of each of its entries
+ * @param ring the ring, with known servers
+ * @return some error code
+ */
+error_code placement_maglev_build(ring_t *ring);
+
+/**
+ * @brief fill the jump hash preference lists: one slot per server, in the order they join
+ *        (see ring_t). Jump hash ignores the weights of the servers
+ * @param ring the ring, with known servers and their join order
+ * @return some error code
+ */
+error_code placement_jump_build(ring_t *ring);
+
+/**
+ * @brief jump consistent hash (Lamping & Veach)
+ * @param key the key hash
+ * @param nb_buckets number of buckets, > 0
+ * @return the bucket of the key in [0..nb_buckets-1]
+ */
+size_t placement_jump_bucket(uint64_t key, size_t nb_buckets);
+
+/**
+ * @brief write the wanted_size servers with the highest weighted rendezvous scores for a key,
+ *        taking them from distinct zones first
+ * @param ring the ring, with known servers
+ * @param key the key hash
+ * @param row where to write the nodes (at least wanted_size of them)
+ * @param wanted_size number of nodes wanted, at most ring->pref_size
+ */
+void placement_rendezvous_fill(const ring_t *ring, uint64_t key, node_t *row, size_t wanted_size);
@@ -0,0 +1,225 @@
+/**
+ * @file pull.c
+ * @brief Implementation of pull.h
+ *
+ * Pull messages: PPS_OP_PREFIX, opcode, the identifier of the pending request (4 bytes) and the
+ * index of the key in it (2 bytes), then
+ *  - PULL: the key, answered by the replica like a get;
+ *  - PULL_REPLY: whether the key was found (1 byte) and its value.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h> // for INFINITY
+#include <sys/socket.h>
+
+#include "pull.h"
+#include "config.h"
+#include "util.h"
+
+static void put_u32(unsigned char *out, uint32_t value) {
+    out[0] = (unsigned char) (value >> 24);
+    out[1] = (unsigned char) (value >> 16);
+    out[2] = (unsigned char) (value >> 8);
+    out[3] = (unsigned char) value;
+}
+
+static uint32_t get_u32(const unsigned char *in) {
+    return (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16 | (uint32_t) in[2] << 8 | (uint32_t) in[3];
+}
+
+static int same_addr(const struct sockaddr_in *first, const struct sockaddr_in *second) {
+    return first->sin_addr.s_addr == second->sin_addr.s_addr && first->sin_port == second->sin_port;
+}
+
+void pull_init(pull_table_t *pulls) {
+    if (pulls != NULL) {
+        memset(pulls, 0, sizeof(*pulls));
+        pulls->next_id = 1;
+    }
+}
+
+void pull_free(pull_t *pull) {
+    if (pull == NULL) {
+        return;
+    }
+    for (size_t i = 0; pull->values != NULL && i < pull->nb_keys; ++i) {
+        free_const_ptr(pull->values[i]);
+    }
+    free(pull->request);
+    free(pull->keys);
+    free(pull->values);
+    free(pull->waiting);
+    memset(pull, 0, sizeof(*pull));
+}
+
+void pull_end(pull_table_t *pulls) {
+    if (pulls == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < PULL_MAX; ++i) {
+        pull_free(&pulls->pulls[i]);
+    }
+}
+
+//Read the value of a key here if we are one of its replicas and have it, or ask the other replicas
+static void pull_key(pull_t *pull, size_t index, Htable_t table, const ring_t *ring, size_t n,
+                     const struct sockaddr_in *self, int socket) {
+
+    pps_key_t key = pull->keys[index];
+    node_t owners_row[RING_MAX_PREFERENCE_SIZE];
+    node_list_t owners = ring_get_nodes_for_key(ring, n, key, owners_row);
+    for (size_t i = 0; i < owners.size; ++i) {
+        if (same_addr((const struct sockaddr_in *) &owners.nodes[i].addr, self)) {
+            pull->values[index] = get_Htable_value(table, key);
+            //Missing here (not written here, or on its way during a handoff): the others are asked
+            if (pull->values[index] != NULL) {
+                return;
+            }
+        }
+    }
+
+    const size_t key_len = strlen(key);
+    unsigned char message[PULL_HEADER_SIZE + MAX_MSG_ELEM_SIZE];
+    message[0] = PPS_OP_PREFIX;
+    message[1] = PPS_OP_PULL;
+    put_u32(message + 2, pull->id);
+    message[6] = (unsigned char) (index >> 8);
+    message[7] = (unsigned char) index;
+    memcpy(message + PULL_HEADER_SIZE, key, key_len);
+
+    for (size_t i = 0; i < owners.size; ++i) {
+        if (!same_addr((const struct sockaddr_in *) &owners.nodes[i].addr, self)
+            && sendto(socket, message, PULL_HEADER_SIZE + key_len, 0, &owners.nodes[i].addr,
+                      sizeof(owners.nodes[i].addr)) != -1) {
+            ++pull->waiting[index];
+        }
+    }
+}
+
+error_code pull_start(pull_table_t *pulls, Htable_t table, const ring_t *ring, size_t n,
+                      const struct sockaddr_in *self, int socket, const char *request, size_t request_len,
+                      size_t first_key, const struct sockaddr_in *cli_addr, socklen_t addr_len, double now) {
+
+    M_REQUIRE_NON_NULL(pulls);
+    M_REQUIRE_NON_NULL(ring);
+    M_REQUIRE_NON_NULL(self);
+    M_REQUIRE_NON_NULL(request);
+    M_REQUIRE_NON_NULL(cli_addr);
+
+    pull_t *pull = NULL;
+    for (size_t i = 0; i < PULL_MAX && pull == NULL; ++i) {
+        pull = pulls->pulls[i].id == 0 ? &pulls->pulls[i] : NULL;
+    }
+    if (pull == NULL) {
+        return ERR_NOMEM;
+    }
+
+    //The keys point into our copy of the request, nul-terminated even if the last one was not
+    size_t nb_keys = 0;
+    for (size_t offset = first_key; offset < request_len;
+         offset += strnlen(request + offset, request_len - offset) + 1) {
+        ++nb_keys;
+    }
+    if (nb_keys > UINT16_MAX + 1) {
+        return ERR_BAD_PARAMETER;
+    }
+    pull->request = calloc(request_len + 1, 1);
+    pull->keys    = calloc(nb_keys + 1, sizeof(pps_key_t));
+    pull->values  = calloc(nb_keys + 1, sizeof(pps_value_t));
+    pull->waiting = calloc(nb_keys + 1, sizeof(size_t));
+    if (pull->request == NULL || pull->keys == NULL || pull->values == NULL || pull->waiting == NULL) {
+        pull_free(pull);
+        return ERR_NOMEM;
+    }
+    memcpy(pull->request, request, request_len);
+    for (size_t offset = first_key; offset < request_len; offset += strlen(pull->request + offset) + 1) {
+        pull->keys[pull->nb_keys++] = pull->request + offset;
+    }
+
+    pull->id          = pulls->next_id++;
+    pulls->next_id   += pulls->next_id == 0;
+    pull->request_len = request_len;
+    pull->cli_addr    = *cli_addr;
+    pull->addr_len    = addr_len;
+    pull->deadline    = now + PULL_TIMEOUT_MS;
+
+    for (size_t i = 0; i < pull->nb_keys; ++i) {
+        pull_key(pull, i, table, ring, n, self, socket);
+    }
+
+    return ERR_NONE;
+}
+
+int pull_handle(pull_table_t *pulls, const char *msg, size_t len) {
+
+    if (pulls == NULL || msg == NULL || len < PULL_REPLY_HEADER_SIZE || msg[0] != PPS_OP_PREFIX
+        || msg[1] != PPS_OP_PULL_REPLY) {
+        return 0;
+    }
+    const unsigned char *in = (const unsigned char *) msg;
+    const uint32_t id    = get_u32(in + 2);
+    const size_t   index = (size_t) (in[6] << 8 | in[7]);
+
+    for (size_t i = 0; i < PULL_MAX; ++i) {
+        pull_t *pull = &pulls->pulls[i];
+        if (pull->id != id || id == 0 || index >= pull->nb_keys || pull->waiting[index] == 0) {
+            continue;
+        }
+        if (in[8]) {
+            //The first value found is kept
+            const size_t value_len = len - PULL_REPLY_HEADER_SIZE;
+            char *value = malloc(value_len + 1);
+            if (value != NULL) {
+                memcpy(value, msg + PULL_REPLY_HEADER_SIZE, value_len);
+                value[value_len] = '\0';
+                pull->values[index]  = value;
+                pull->waiting[index] = 0;
+            }
+        } else {
+            --pull->waiting[index];
+        }
+    }
+
+    return 1;
+}
+
+pull_t *pull_next_done(pull_table_t *pulls, double now) {
+
+    if (pulls == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < PULL_MAX; ++i) {
+        pull_t *pull = &pulls->pulls[i];
+        if (pull->id == 0) {
+            continue;
+        }
+        if (now >= pull->deadline) {
+            return pull;
+        }
+        size_t nb_pulled = 0;
+        for (size_t k = 0; k < pull->nb_keys; ++k) {
+            if (pull->values[k] == NULL && pull->waiting[k] == 0) {
+                return pull;
+            }
+            nb_pulled += pull->values[k] != NULL;
+        }
+        if (nb_pulled == pull->nb_keys) {
+            return pull;
+        }
+    }
+
+    return NULL;
+}
+
+double pull_next_timeout_ms(const pull_table_t *pulls, double now) {
+    double wait = INFINITY;
+    for (size_t i = 0; pulls != NULL && i < PULL_MAX; ++i) {
+        if (pulls->pulls[i].id != 0 && pulls->pulls[i].deadline - now < wait) {
+            wait = pulls->pulls[i].deadline - now;
+        }
+    }
+    return wait;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+/**
+ * @file pull.h
+ * @brief Values of other keys that a server needs to answer a request (the sources of a
+ *        concatenation, the pattern of a search): the server asks their replicas and keeps
+ *        the request pending, serving others meanwhile, until all the values are in, one of
+ *        them is missing everywhere, or PULL_TIMEOUT_MS has passed.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "error.h"
+#include "hashtable.h"
+#include "ring.h"
+
+/**
+ * @brief maximum number of pending requests: new ones are refused when all are taken
+ */
+#define PULL_MAX 64
+
+/**
+ * @brief time a request waits for the values of its keys
+ */
+#define PULL_TIMEOUT_MS 200
+
+/**
+ * @brief size of the headers of the requests ([PULL][id (4 bytes)][index (2 bytes)][key]) and
+ *        of their replies ([PULL_REPLY][id][index][found (1 byte)][value]), see PPS_OP_PULL
+ */
+#define PULL_HEADER_SIZE 8
+#define PULL_REPLY_HEADER_SIZE 9
+
+/**
+ * @brief a pending request
+ */
+typedef struct {
+    uint32_t id;              // 0 if the slot is free
+    char *request;            // copy of the request of the client, followed by a nul byte
+    size_t request_len;
+    struct sockaddr_in cli_addr;
+    socklen_t addr_len;
+    size_t nb_keys;
+    pps_key_t *keys;          // the keys pulled, in request
+    pps_value_t *values;      // their values, NULL until pulled
+    size_t *waiting;          // number of replicas each key still waits for (0 once pulled)
+    double deadline;
+} pull_t;
+
+/**
+ * @brief the pending requests of a server
+ */
+typedef struct {
+    pull_t pulls[PULL_MAX];
+    uint32_t next_id;
+} pull_table_t;
+
+/**
+ * @brief initialize an empty table
+ * @param pulls the table to initialize
+ */
+void pull_init(pull_table_t *pulls);
+
+/**
+ * @brief free the table and its pending requests
+ * @param pulls the table to free
+ */
+void pull_end(pull_table_t *pulls);
+
+/**
+ * @brief keep a request pending and ask the replicas of the keys it needs for their values
+ *        (keys the local server is a replica of are read from its table right away, and asked
+ *        to the other replicas if missing there)
+ * @param pulls the table
+ * @param table the local content
+ * @param ring the ring
+ * @param n number of replicas of a key
+ * @param self address of the local server
+ * @param socket the server socket
+ * @param request the request of the client, followed by zeros up to MAX_MSG_SIZE bytes
+ * @param request_len its length
+ * @param first_key offset of the first key to pull in the request: the keys are nul-separated
+ *        up to the end of the request (none if first_key >= request_len)
+ * @param cli_addr where the request comes from
+ * @param addr_len length of cli_addr
+ * @param now current time (get_time_ms)
+ * @return some error code (ERR_NOMEM if too many requests are pending)
+ */
+error_code pull_start(pull_table_t *pulls, Htable_t table, const ring_t *ring, size_t n,
+                      const struct sockaddr_in *self, int socket, const char *request, size_t request_len,
+                      size_t first_key, const struct sockaddr_in *cli_addr, socklen_t addr_len, double now);
+
+/**
+ * @brief handle a message if it is the reply of a replica to a pull
+ * @param pulls the table
+ * @param msg the message
+ * @param len length of the message
+ * @return 1 if the message was handled, 0 otherwise
+ */
+int pull_handle(pull_table_t *pulls, const char *msg, size_t len);
+
+/**
+ * @brief a request that can be answered: all its values are in, one of them is missing on all
+ *        its replicas, or its deadline has passed
+ * @param pulls the table
+ * @param now current time
+ * @return the request (its keys with a NULL value are missing), to be freed with pull_free once
+ *         answered, NULL if none is ready
+ */
+pull_t *pull_next_done(pull_table_t *pulls, double now);
+
+/**
+ * @brief free the slot of an answered request
+ * @param pull the request
+ */
+void pull_free(pull_t *pull);
+
+/**
+ * @brief time before the deadline of the first pending request
+ * @return the time in milliseconds (at most 0 if one is due), INFINITY if none is pending
+ */
+double pull_next_timeout_ms(const pull_table_t *pulls, double now);
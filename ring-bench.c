@@ -0,0 +1,84 @@
+/**
+ * @file pps-ring-bench.c
+ * @brief measure placement lookups per second for every hash and placement,
+ *        on the servers of the servers file
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+#include "error.h"
+#include "args.h"
+#include "ring.h"
+
+#define DEFAULT_NB_LOOKUPS 1000000
+#define NB_KEYS 4096
+#define KEY_SIZE 32
+
+//Current time in seconds
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+
+    char **rem_argv = argv + 1;
+    args_t *args = parse_opt_args(TOTAL_SERVERS, &rem_argv);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(args, ERR_BAD_PARAMETER);
+
+    size_t nb_lookups = DEFAULT_NB_LOOKUPS;
+    if (*rem_argv != NULL && (sscanf(*rem_argv, "%zu", &nb_lookups) != 1 || nb_lookups == 0)) {
+        fprintf(stderr, "usage: %s [-n N] [nb_lookups]\n", argv[0]);
+        free(args);
+        return ERR_BAD_PARAMETER;
+    }
+
+    //Keys are generated beforehand so that only the lookups are measured
+    static char keys[NB_KEYS][KEY_SIZE];
+    for (size_t k = 0; k < NB_KEYS; ++k) {
+        snprintf(keys[k], KEY_SIZE, "user:%zu:profile", k * 7919);
+    }
+
+    printf("%-6s %-11s %8s %14s %10s\n", "hash", "placement", "vnodes", "lookups/s", "ns/lookup");
+
+    for (ring_hash_t h = RING_HASH_SHA1; h < RING_HASH_LAST; ++h) {
+        for (placement_t p = PLACEMENT_RING; p < PLACEMENT_LAST; ++p) {
+
+            ring_t *ring = ring_alloc_from_nodes(get_nodes(h), p, h);
+            if (ring == NULL || ring_init(ring) != ERR_NONE) {
+                fprintf(stderr, "cannot build the ring from %s\n", PPS_SERVERS_LIST_FILENAME);
+                ring_free(ring);
+                free(args);
+                return ERR_IO;
+            }
+
+            //Sum of the ports of the first replicas, so that the lookups are not optimized out
+            unsigned long checksum = 0;
+            const double  start    = now();
+            for (size_t i = 0; i < nb_lookups; ++i) {
+                node_t list_row[RING_MAX_PREFERENCE_SIZE];
+                node_list_t list = ring_get_nodes_for_key(ring, args->N, keys[i % NB_KEYS], list_row);
+                checksum += ((const struct sockaddr_in *) &list.nodes[0].addr)->sin_port;
+            }
+            const double elapsed = now() - start;
+
+            printf("%-6s %-11s %8zu %14.0f %10.1f\n", RING_HASH_NAMES[h], PLACEMENT_NAMES[p], ring->size,
+                   (double) nb_lookups / elapsed, 1e9 * elapsed / (double) nb_lookups);
+            debug_print("checksum %lu", checksum);
+
+            ring_free(ring);
+        }
+    }
+
+    free(args);
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file pps-ring-migrate.c
+ * @brief read keys (one per line) on stdin and print those whose replicas differ
+ *        between the SHA-1 and the fast hash layouts of the cluster, with their
+ *        servers in both layouts
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "config.h"
+#include "error.h"
+#include "args.h"
+#include "ring.h"
+
+/**
+ * @brief build and initialize the ring of the servers file with the given hash
+ * @param hash the hash of the ring
+ * @return the initialized ring, NULL on error
+ */
+static ring_t *build_ring(ring_hash_t hash) {
+
+    placement_t placement = PLACEMENT_RING;
+    ring_hash_t unused    = RING_HASH_SHA1;
+    M_REQUIRE(get_ring_settings(&placement, &unused) == ERR_NONE, NULL, "%s", "wrong ring settings");
+
+    ring_t *ring = ring_alloc_from_nodes(get_nodes(hash), placement, hash);
+    if (ring != NULL && ring_init(ring) != ERR_NONE) {
+        ring_free(ring);
+        ring = NULL;
+    }
+
+    return ring;
+}
+
+//Print the servers of a list as ip:port,ip:port,...
+static void print_servers(const node_list_t *list) {
+    for (size_t i = 0; i < list->size; ++i) {
+        const struct sockaddr_in *addr = (const struct sockaddr_in *) &list->nodes[i].addr;
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr->sin_addr, ip, INET_ADDRSTRLEN);
+        printf("%s%s:%d", i == 0 ? "" : ",", ip, ntohs(addr->sin_port));
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    char **rem_argv = argv + 1;
+    args_t *args = parse_opt_args(TOTAL_SERVERS, &rem_argv);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(args, ERR_BAD_PARAMETER);
+
+    ring_t *old_ring = build_ring(RING_HASH_SHA1);
+    ring_t *new_ring = build_ring(RING_HASH_FAST);
+    if (old_ring == NULL || new_ring == NULL) {
+        ring_free(old_ring);
+        ring_free(new_ring);
+        free(args);
+        fprintf(stderr, "cannot build the rings from %s\n", PPS_SERVERS_LIST_FILENAME);
+        return ERR_IO;
+    }
+
+    static char key[MAX_MSG_ELEM_SIZE + 2];
+    size_t nb_keys  = 0;
+    size_t nb_moved = 0;
+
+    while (fgets(key, sizeof(key), stdin) != NULL) {
+        key[strcspn(key, "\n")] = '\0';
+        if (key[0] == '\0') {
+            continue;
+        }
+        ++nb_keys;
+
+        node_t      before_row[RING_MAX_PREFERENCE_SIZE];
+        node_t      after_row[RING_MAX_PREFERENCE_SIZE];
+        node_list_t before = ring_get_nodes_for_key(old_ring, args->N, key, before_row);
+        node_list_t after  = ring_get_nodes_for_key(new_ring, args->N, key, after_row);
+
+        int moved = before.size != after.size;
+        for (size_t i = 0; !moved && i < before.size; ++i) {
+            moved = server_different(&after, &before.nodes[i]);
+        }
+
+        if (moved) {
+            ++nb_moved;
+            printf("%s ", key);
+            print_servers(&before);
+            printf(" -> ");
+            print_servers(&after);
+            printf("\n");
+        }
+    }
+
+    fprintf(stderr, "%zu of %zu keys move from the %s to the %s layout\n", nb_moved, nb_keys,
+            RING_HASH_NAMES[RING_HASH_SHA1], RING_HASH_NAMES[RING_HASH_FAST]);
+
+    ring_free(old_ring);
+    ring_free(new_ring);
+    free(args);
+
+    return 0;
+}
@@ -6,77 +6,490 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 #include "ring.h"
 #include "node_list.h"
+#include "placement.h"
+#include "hash.h"
+#include "config.h"
+
+#define MAX_LINE_SIZE 256
+
+const char * const PLACEMENT_NAMES[] = {
+    "ring",
+    "maglev",
+    "rendezvous",
+    "jump",
+    "" // PLACEMENT_LAST
+};
+
+const char * const RING_HASH_NAMES[] = {
+    "sha1",
+    "fast",
+    "" // RING_HASH_LAST
+};
 
 ring_t *ring_alloc() {
 
-	ring_t *ring = calloc(1, sizeof(ring_t));
+    placement_t placement = PLACEMENT_RING;
+    ring_hash_t hash      = RING_HASH_SHA1;
+    if (get_ring_settings(&placement, &hash) != ERR_NONE) {
+        return NULL;
+    }
 
-	if (ring != NULL) {
-		ring = get_nodes();
-	}
+    return ring_alloc_from_nodes(get_nodes(hash), placement, hash);
+}
+
+ring_t *ring_alloc_from_nodes(node_list_t *list, placement_t placement, ring_hash_t hash) {
+
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(list, NULL);
+
+    ring_t *ring = calloc(1, sizeof(ring_t));
+    if (ring == NULL) {
+        node_list_free(list);
+        return NULL;
+    }
+
+    //The ring takes over the nodes of the list
+    ring->size      = list->size;
+    ring->nodes     = list->nodes;
+    ring->placement = placement;
+    ring->hash      = hash;
+    ring->references = 1;
+    free(list);
+
+    return ring;
+}
+
+/**
+ * @brief find a name in a list of names
+ * @param name the name to look for
+ * @param names the names, the last one being ""
+ * @param index where to write the index of the name
+ * @return ERR_BAD_PARAMETER if the name is not in the list
+ */
+static error_code find_name(const char *name, const char * const *names, int *index) {
+    for (int i = 0; names[i][0] != '\0'; ++i) {
+        if (strcmp(name, names[i]) == 0) {
+            *index = i;
+            return ERR_NONE;
+        }
+    }
+    M_EXIT(ERR_BAD_PARAMETER, "unknown setting value %s", name);
+}
+
+error_code get_ring_settings(placement_t *placement, ring_hash_t *hash) {
+
+    M_REQUIRE_NON_NULL(placement);
+    M_REQUIRE_NON_NULL(hash);
+    *placement = PLACEMENT_RING;
+    *hash      = RING_HASH_SHA1;
+
+    FILE *file = fopen(PPS_SERVERS_LIST_FILENAME, "r");
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(file, ERR_IO);
 
-	return ring;
+    error_code error = ERR_NONE;
+    char line[MAX_LINE_SIZE + 1];
+    while (error == ERR_NONE && fgets(line, sizeof(line), file) != NULL) {
+
+        char keyword[MAX_LINE_SIZE + 1];
+        char name[MAX_LINE_SIZE + 1];
+        if (sscanf(line, "%256s %256s", keyword, name) != 2) {
+            continue;
+        }
+
+        int index = 0;
+        if (strcmp(keyword, RING_PLACEMENT_KEYWORD) == 0) {
+            error = find_name(name, PLACEMENT_NAMES, &index);
+            *placement = error == ERR_NONE ? (placement_t) index : *placement;
+        } else if (strcmp(keyword, RING_HASH_KEYWORD) == 0) {
+            error = find_name(name, RING_HASH_NAMES, &index);
+            *hash = error == ERR_NONE ? (ring_hash_t) index : *hash;
+        }
+    }
+
+    fclose(file);
+    return error;
+}
+
+//Compare two node pointers according to their server address
+static int cmp_node_ptr_addr(const void *first, const void *second) {
+    const node_t *n1 = *(const node_t * const *) first;
+    const node_t *n2 = *(const node_t * const *) second;
+    return memcmp(&n1->addr, &n2->addr, sizeof(struct sockaddr));
 }
 
+/**
+ * @brief find the distinct servers of the ring (sorted by address), their weight,
+ *        and give each node the index of its server
+ * @param ring the ring, nodes already sorted
+ * @param server_ids where to write the server index of each node (ring->size entries)
+ * @return some error code
+ */
+static error_code compute_servers(ring_t *ring, size_t *server_ids) {
+
+    const node_t **by_addr = calloc(ring->size, sizeof(node_t *));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(by_addr, ERR_NOMEM);
+
+    for (size_t i = 0; i < ring->size; ++i) {
+        by_addr[i] = &ring->nodes[i];
+    }
+    qsort(by_addr, ring->size, sizeof(node_t *), cmp_node_ptr_addr);
+
+    size_t nb_servers = 0;
+    for (size_t i = 0; i < ring->size; ++i) {
+        if (i == 0 || cmp_node_ptr_addr(&by_addr[i - 1], &by_addr[i]) != 0) {
+            ++nb_servers;
+        }
+        server_ids[by_addr[i] - ring->nodes] = nb_servers - 1;
+    }
+
+    free(ring->servers);
+    free(ring->server_hashes);
+    free(ring->weights);
+    free(ring->server_zones);
+    ring->nb_servers    = nb_servers;
+    ring->servers       = calloc(nb_servers, sizeof(node_t));
+    ring->server_hashes = calloc(nb_servers, sizeof(uint64_t));
+    ring->weights       = calloc(nb_servers, sizeof(size_t));
+    ring->server_zones  = calloc(nb_servers, sizeof(size_t));
+    if (ring->servers == NULL || ring->server_hashes == NULL || ring->weights == NULL
+        || ring->server_zones == NULL) {
+        free(by_addr);
+        return ERR_NOMEM;
+    }
+
+    for (size_t i = 0; i < ring->size; ++i) {
+        const size_t server = server_ids[by_addr[i] - ring->nodes];
+        if (ring->weights[server] == 0) {
+            ring->servers[server]       = *by_addr[i];
+            ring->server_hashes[server] = placement_hash64(&by_addr[i]->addr, sizeof(struct sockaddr));
+        }
+        ring->weights[server] += 1;
+    }
+
+    //Zone index of each server, by order of appearance
+    ring->nb_zones = 0;
+    for (size_t s = 0; s < nb_servers; ++s) {
+        size_t zone = 0;
+        while (zone < s && strcmp(ring->servers[zone].zone, ring->servers[s].zone) != 0) {
+            ++zone;
+        }
+        ring->server_zones[s] = zone < s ? ring->server_zones[zone] : ring->nb_zones++;
+    }
+
+    free(by_addr);
+    return ERR_NONE;
+}
+
+/**
+ * @brief find the order in which the servers join: the order of their first node in the servers file
+ * @param ring the ring, with known servers
+ * @param file_addrs address of each node, in the order of the servers file (ring->size entries)
+ * @return some error code
+ */
+static error_code compute_joined(ring_t *ring, const struct sockaddr *file_addrs) {
+
+    int *seen = calloc(ring->nb_servers, sizeof(int));
+    free(ring->joined);
+    ring->joined = calloc(ring->nb_servers, sizeof(size_t));
+    if (seen == NULL || ring->joined == NULL) {
+        free(seen);
+        return ERR_NOMEM;
+    }
+
+    size_t nb_joined = 0;
+    for (size_t i = 0; i < ring->size; ++i) {
+        node_t node;
+        memset(&node, 0, sizeof(node));
+        node.addr = file_addrs[i];
+        const size_t server = ring_server_index(ring, &node);
+        if (server < ring->nb_servers && !seen[server]) {
+            seen[server] = 1;
+            ring->joined[nb_joined++] = server;
+        }
+    }
+
+    free(seen);
+    return ERR_NONE;
+}
+
+//First 8 bytes of a SHA as a position on the ring
+static uint64_t sha_position(const unsigned char *sha) {
+    uint64_t position = 0;
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+        position = (position << 8) | sha[i];
+    }
+    return position;
+}
+
+/**
+ * @brief precompute the preference lists of the placement strategy, over alive servers only
+ * @param ring the ring, with known servers
+ * @return some error code
+ */
+static error_code build_rows(ring_t *ring) {
+
+    ring->pref_size = ring->nb_alive < RING_MAX_PREFERENCE_SIZE ? ring->nb_alive : RING_MAX_PREFERENCE_SIZE;
+
+    error_code error = ERR_NONE;
+    switch (ring->placement) {
+    case PLACEMENT_MAGLEV:
+        error = placement_maglev_build(ring);
+        break;
+    case PLACEMENT_JUMP:
+        error = placement_jump_build(ring);
+        break;
+    case PLACEMENT_RENDEZVOUS:
+        //Computed at each lookup: no rows
+        free(ring->preferences);
+        ring->nb_slots    = 0;
+        ring->preferences = NULL;
+        break;
+    default:
+        error = placement_ring_build(ring, ring->node_servers);
+        break;
+    }
+
+    return error;
+}
 
 error_code ring_init(ring_t *ring) {
 
     M_REQUIRE_NON_NULL(ring);
-    
-    node_list_sort(ring, node_cmp_sha);
-	
-    return ERR_NONE;
+    M_REQUIRE(ring->size > 0, ERR_BAD_PARAMETER, "%s", "empty ring");
+    M_REQUIRE(ring->placement < PLACEMENT_LAST, ERR_BAD_PARAMETER, "unknown placement %d", ring->placement);
+    M_REQUIRE(ring->hash < RING_HASH_LAST, ERR_BAD_PARAMETER, "unknown hash %d", ring->hash);
+
+    //The order of the servers file is lost with the sort
+    struct sockaddr *file_addrs = calloc(ring->size, sizeof(struct sockaddr));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(file_addrs, ERR_NOMEM);
+    for (size_t i = 0; i < ring->size; ++i) {
+        file_addrs[i] = ring->nodes[i].addr;
+    }
+
+    qsort(ring->nodes, ring->size, sizeof(node_t), (int (*)(void const *, void const *))
+          (ring->hash == RING_HASH_FAST ? node_cmp_position : node_cmp_sha));
+
+    //Positions are kept apart from the nodes to make the search cache friendly
+    free(ring->positions);
+    ring->positions = calloc(ring->size, sizeof(ring_position_t));
+    if (ring->positions == NULL) {
+        free(file_addrs);
+        return ERR_NOMEM;
+    }
+    for (size_t i = 0; i < ring->size; ++i) {
+        ring->positions[i] = ring->hash == RING_HASH_FAST ? ring->nodes[i].position : sha_position(ring->nodes[i].sha);
+    }
+
+    free(ring->node_servers);
+    ring->node_servers = calloc(ring->size, sizeof(size_t));
+    if (ring->node_servers == NULL) {
+        free(file_addrs);
+        return ERR_NOMEM;
+    }
+
+    error_code error = compute_servers(ring, ring->node_servers);
+    if (error == ERR_NONE) {
+        error = compute_joined(ring, file_addrs);
+    }
+    free(file_addrs);
+    M_EXIT_IF_ERR(error, "ring servers");
+
+    //Every server is alive until told otherwise
+    free(ring->alive);
+    ring->alive = calloc(ring->nb_servers, sizeof(int));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(ring->alive, ERR_NOMEM);
+    for (size_t s = 0; s < ring->nb_servers; ++s) {
+        ring->alive[s] = 1;
+    }
+    ring->nb_alive = ring->nb_servers;
+
+    return build_rows(ring);
 }
 
-node_list_t *ring_get_nodes_for_key(const ring_t *ring, size_t wanted_list_size, pps_key_t key) {
-	
-	M_REQUIRE_NON_NULL_CUSTOM_ERR(ring, NULL);
-	
+error_code ring_update_membership(ring_t *ring, const int *alive) {
+
+    M_REQUIRE_NON_NULL(ring);
+    M_REQUIRE_NON_NULL(alive);
+    M_REQUIRE_NON_NULL(ring->alive);
+
+    size_t nb_alive = 0;
+    for (size_t s = 0; s < ring->nb_servers; ++s) {
+        nb_alive += alive[s] != 0;
+    }
+    M_REQUIRE(nb_alive > 0, ERR_BAD_PARAMETER, "%s", "no server alive");
+
+    int changed = 0;
+    for (size_t s = 0; s < ring->nb_servers; ++s) {
+        changed |= (alive[s] != 0) != ring->alive[s];
+        ring->alive[s] = alive[s] != 0;
+    }
+    ring->nb_alive = nb_alive;
+
+    return changed ? build_rows(ring) : ERR_NONE;
+}
+
+node_list_t ring_get_nodes_for_key(const ring_t *ring, size_t wanted_list_size, pps_key_t key, node_t *buffer) {
+
+    node_list_t result = {0, NULL};
+
+    if (ring == NULL || ring->alive == NULL || key == NULL || buffer == NULL
+        || (ring->preferences == NULL && ring->placement != PLACEMENT_RENDEZVOUS)) {
+        debug_print("%s", "ring not initialized or no key");
+        return result;
+    }
+
+    //Only the SHA-1 mode needs the whole digest, to break ties between 64 bits prefixes
     unsigned char hash[SHA_DIGEST_LENGTH];
-    (void)memset(hash, 0, SHA_DIGEST_LENGTH);
-    SHA1((const unsigned char *) key, strlen(key), hash);
-    
-    const node_t node_key = {.sha = {*hash}};
-	
-	node_list_t *result = node_list_new();
-	result->size = 0;
-	
-	size_t i = 0;
-	// find first node such that its sha is greater than the key's sha 
-	while (node_cmp_sha(&(node_key), &(ring->nodes[i])) > 0) {
-		i++;
-	}
+    ring_position_t position = 0;
+    if (ring->hash == RING_HASH_FAST) {
+        position = fast_hash64(key, strlen(key));
+    } else {
+        SHA1((const unsigned char *) key, strlen(key), hash);
+        position = sha_position(hash);
+    }
 
-	while (result->size < wanted_list_size) { 
-		
-		if (server_different(result, &(ring->nodes[i]))) {
-			if (node_list_add(result, ring->nodes[i]) != ERR_NONE) {
-				fprintf(stderr, "error while adding node to node_list");
-				node_list_free(result);
-				return NULL;
-			} 
-		}
-		i++;
-		i = i % ring->size;
-	}
-	
-	return result;
+    result.size = wanted_list_size < ring->pref_size ? wanted_list_size : ring->pref_size;
+
+    size_t slot = 0;
+    switch (ring->placement) {
+    case PLACEMENT_MAGLEV:
+        slot = (size_t) (position % ring->nb_slots);
+        break;
+    case PLACEMENT_JUMP:
+        slot = placement_jump_bucket(position, ring->nb_slots);
+        break;
+    case PLACEMENT_RENDEZVOUS:
+        placement_rendezvous_fill(ring, position, buffer, result.size);
+        result.nodes = buffer;
+        return result;
+    default: {
+        //Find first node such that its position is greater or equal to the key's one
+        size_t low  = 0;
+        size_t high = ring->size;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            int    cmp    = (ring->positions[middle] > position) - (ring->positions[middle] < position);
+            if (cmp == 0 && ring->hash == RING_HASH_SHA1) {
+                cmp = memcmp(ring->nodes[middle].sha, hash, SHA_DIGEST_LENGTH);
+            }
+            if (cmp < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+
+        //Keys after the last node belong to the first one
+        slot = low % ring->size;
+        break;
+    }
+    }
+
+    memcpy(buffer, &ring->preferences[slot * ring->pref_size], result.size * sizeof(node_t));
+    result.nodes = buffer;
+
+    return result;
 }
 
-int server_different(const ring_t *ring, node_t *node) {
-    for (size_t i = 0; i < ring->size; i++) {
-        if (memcmp(&(node->addr), &(ring->nodes[i].addr), sizeof(struct sockaddr)) == 0) {
+size_t ring_server_index(const ring_t *ring, const node_t *node) {
+
+    M_REQUIRE(ring != NULL && node != NULL, SIZE_MAX, "%s", "NULL ring or node");
+
+    //Servers are sorted by address
+    size_t low  = 0;
+    size_t high = ring->nb_servers;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        int    cmp    = memcmp(&ring->servers[middle].addr, &node->addr, sizeof(struct sockaddr));
+        if (cmp == 0) {
+            return middle;
+        } else if (cmp < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return SIZE_MAX;
+}
+
+error_code ring_primary_shares(const ring_t *ring, double *shares) {
+
+    M_REQUIRE_NON_NULL(ring);
+    M_REQUIRE_NON_NULL(shares);
+    M_REQUIRE(ring->preferences != NULL || ring->placement == PLACEMENT_RENDEZVOUS, ERR_BAD_PARAMETER,
+              "%s", "ring not initialized");
+
+    memset(shares, 0, ring->nb_servers * sizeof(double));
+
+    switch (ring->placement) {
+    case PLACEMENT_RENDEZVOUS:
+        //Weighted rendezvous is exactly proportional to the weights
+        for (size_t s = 0; s < ring->nb_servers; ++s) {
+            shares[s] = (double) ring->weights[s] / (double) ring->size;
+        }
+        break;
+    case PLACEMENT_RING:
+        //Slot i owns the keys between nodes i-1 (excluded) and i (included)
+        for (size_t i = 0; i < ring->size; ++i) {
+            const uint64_t previous = ring->positions[(i + ring->size - 1) % ring->size];
+            uint64_t arc = ring->positions[i] - previous;
+            if (ring->size == 1) {
+                arc = UINT64_MAX;
+            }
+            shares[ring_server_index(ring, &ring->preferences[i * ring->pref_size])] +=
+                (double) arc / 18446744073709551616.0;
+        }
+        break;
+    default:
+        //Every slot is equally likely
+        for (size_t i = 0; i < ring->nb_slots; ++i) {
+            shares[ring_server_index(ring, &ring->preferences[i * ring->pref_size])] +=
+                1.0 / (double) ring->nb_slots;
+        }
+        break;
+    }
+
+    return ERR_NONE;
+}
+
+int server_different(const node_list_t *list, const node_t *node) {
+    for (size_t i = 0; i < list->size; i++) {
+        if (memcmp(&(node->addr), &(list->nodes[i].addr), sizeof(struct sockaddr)) == 0) {
             return 0;
         }
     }
 
-	return 1;
+    return 1;
+}
+
+ring_t *ring_retain(ring_t *ring) {
+    if (ring != NULL) {
+        ++ring->references;
+    }
+    return ring;
 }
 
 void ring_free(ring_t *ring) {
-    node_list_free(ring);
+    if (ring != NULL && --ring->references == 0) {
+        for (size_t i = 0; i < ring->size; ++i) {
+            node_end(&ring->nodes[i]);
+        }
+        free(ring->nodes);
+        free(ring->positions);
+        free(ring->node_servers);
+        free(ring->alive);
+        free(ring->servers);
+        free(ring->server_hashes);
+        free(ring->weights);
+        free(ring->server_zones);
+        free(ring->joined);
+        free(ring->preferences);
+        free(ring);
+    }
 }
 
 // ======================================================================
@@ -86,9 +499,4 @@ void print_sha(unsigned char* hash) {
 			printf("%02x", hash[i]);
 		}
 	}
-}	
-	
-	
-	
-	
-		
+}
@@ -14,42 +14,156 @@
 #include "hashtable.h"
 #include "node_list.h"
 
+/**
+ * @brief maximum length of the precomputed preference list of a ring segment
+ *        (i.e. maximum number of distinct servers a key can be stored on)
+ */
+#define RING_MAX_PREFERENCE_SIZE 16
+
+/**
+ * @brief keyword of the (optional) servers file line selecting the placement, e.g. "placement maglev"
+ */
+#define RING_PLACEMENT_KEYWORD "placement"
+
+/**
+ * @brief keyword of the (optional) servers file line selecting the hash of the ring, e.g. "hash fast"
+ */
+#define RING_HASH_KEYWORD "hash"
+
+/**
+ * @brief names of the hashes, as written in the servers file
+ */
+extern const char * const RING_HASH_NAMES[];
+
+/**
+ * @brief placement strategies: how keys are mapped to their list of distinct servers
+ */
+typedef enum {
+    PLACEMENT_RING = 0,     // SHA-1 successor on the ring of virtual nodes (default)
+    PLACEMENT_MAGLEV,       // Maglev lookup table, weighted by the number of virtual nodes
+    PLACEMENT_RENDEZVOUS,   // weighted rendezvous (highest random weight) hashing
+    PLACEMENT_JUMP,         // jump consistent hash over the servers
+    PLACEMENT_LAST          // not an actual placement but to have the total number of them
+} placement_t;
+
+/**
+ * @brief names of the placements, as written in the servers file
+ */
+extern const char * const PLACEMENT_NAMES[];
+
 /*
  * Definition of type for a ring of nodes
  */
-typedef node_list_t ring_t;
+typedef struct {
+    size_t size;          // number of (virtual) nodes
+    node_t *nodes;        // nodes sorted by position once initialized
+    placement_t placement;
+    ring_hash_t hash;
+    ring_position_t *positions; // 64 bits position of each sorted node (SHA-1 prefix in SHA-1 mode)
+    size_t *node_servers; // server index of each sorted node
+    size_t nb_servers;    // number of distinct servers among the nodes
+    int *alive;           // whether each server is alive (see ring_update_membership)
+    size_t nb_alive;      // number of alive servers
+    node_t *servers;      // one node per distinct server, sorted by address
+    size_t *joined;       // index in servers of each server in the order they join (servers file order)
+    uint64_t *server_hashes; // hash of each server address
+    size_t *weights;      // number of virtual nodes of each server
+    size_t nb_zones;      // number of distinct zones among the servers
+    size_t *server_zones; // zone index of each server
+    size_t pref_size;     // length of each preference list, min(nb_alive, RING_MAX_PREFERENCE_SIZE)
+    size_t nb_slots;      // number of precomputed preference lists (none with rendezvous placement)
+    node_t *preferences;  // nb_slots * pref_size nodes: row i is the preference list of slot i
+    size_t references;    // owners of the ring (see ring_retain), freed with the last one
+} ring_t;
 
 /**
- * @brief creates a new ring of nodes
+ * @brief creates a new ring of nodes from the servers file, with the placement and hash it selects
  * @return a newly created ring
  */
 ring_t *ring_alloc();
 
 /**
- * @brief initializes a ring
+ * @brief creates a new ring from a list of nodes
+ * @param list the nodes; the ring takes them over and frees the list itself
+ * @param placement placement strategy of the ring
+ * @param hash hash function of the ring
+ * @return a newly created ring, NULL on error
+ */
+ring_t *ring_alloc_from_nodes(node_list_t *list, placement_t placement, ring_hash_t hash);
+
+/**
+ * @brief initializes a ring: sorts its nodes and precomputes the preference lists
+ *        of its placement strategy
  * @param ring the ring to be initialized (modified)
  * @return some error if something wrong during initialization
  */
 error_code ring_init(ring_t *ring);
 
 /**
- * @brief destroy a ring of nodes
+ * @brief mark the servers dead or alive and recompute the preference lists, which
+ *        only contain alive servers
+ * @param ring the (initialized) ring
+ * @param alive for each server of ring->servers, whether it is alive
+ * @return some error code, e.g. if no server is alive
+ */
+error_code ring_update_membership(ring_t *ring, const int *alive);
+
+/**
+ * @brief share a ring with one more owner, which frees it with ring_free like the others
+ * @param ring the ring
+ * @return the ring
+ */
+ring_t *ring_retain(ring_t *ring);
+
+/**
+ * @brief destroy a ring of nodes, once its last owner frees it
  * @param ring the ring to be destroyed
  */
 void ring_free(ring_t *ring);
 
 /**
- * @brief search nodes storing for a key
- * @param  ring the ring of nodes to search into
- * @param  wanted_list_size minimum of nodes wanted
+ * @brief search nodes storing for a key. Does not allocate anything, nor modify the ring:
+ *        lookups with their own buffers do not interfere.
+ *        Replicas are spread over as many zones as possible: the first nodes of the list
+ *        are the first ones (in the placement order) of distinct zones.
+ * @param  ring the (initialized) ring of nodes to search into
+ * @param  wanted_list_size number of distinct servers wanted
  * @param  key the key for which we are looking for
- * @return the list of all nodes storing the key
+ * @param  buffer where to write the list, of RING_MAX_PREFERENCE_SIZE nodes
+ * @return a list of at most wanted_list_size nodes, pointing in buffer (must NOT be freed).
+ *         An empty list on error
+ */
+node_list_t ring_get_nodes_for_key(const ring_t *ring, size_t wanted_list_size, pps_key_t key, node_t *buffer);
+
+/**
+ * @brief index of the server of a node in ring->servers
+ * @param ring the (initialized) ring
+ * @param node the node to look for
+ * @return the server index, SIZE_MAX if the server is not in the ring
+ */
+size_t ring_server_index(const ring_t *ring, const node_t *node);
+
+/**
+ * @brief compute the expected share of the keys for which each server comes first
+ *        (exact arc lengths for the ring placement)
+ * @param ring the (initialized) ring
+ * @param shares where to write the share of each server of ring->servers (ring->nb_servers entries)
+ * @return some error code
+ */
+error_code ring_primary_shares(const ring_t *ring, double *shares);
+
+/**
+ * @brief read the placement and hash selected in the servers file (PLACEMENT_RING
+ *        and RING_HASH_SHA1 if none)
+ * @param placement where to write the placement
+ * @param hash where to write the hash
+ * @return some error code if the file cannot be read or names an unknown placement or hash
  */
-node_list_t *ring_get_nodes_for_key(const ring_t *ring, size_t wanted_list_size, pps_key_t key);
+error_code get_ring_settings(placement_t *placement, ring_hash_t *hash);
 
 /**
  * @brief checks whether the server of the node is different from the servers of the nodes already added
- * @param  ring the ring of nodes already added
+ * @param  list the list of nodes already added
  * @param  node to check
  */
-int server_different(const ring_t *ring, node_t *node);
+int server_different(const node_list_t *list, const node_t *node);
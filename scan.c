@@ -0,0 +1,263 @@
+/**
+ * @file scan.c
+ * @brief Implementation of scan.h
+ *
+ * A request is PPS_OP_PREFIX, PPS_OP_SCAN, its id (4 bytes), the cursor (4 bytes), the limit
+ * (2 bytes), the flags and the pattern. A part is PPS_OP_PREFIX, PPS_OP_SCAN, the id of the
+ * request, its number (2 bytes), the next cursor (4 bytes), the last flag, the number of keys
+ * (2 bytes) and the keys.
+ *
+ * A range query is PPS_OP_PREFIX, PPS_OP_RANGE, its id (4 bytes), the limit (2 bytes), the prefix,
+ * a nul byte and the last key of the previous page. Its reply is a part.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <sys/socket.h>
+
+#include "scan.h"
+#include "config.h"
+#include "strsearch.h"
+
+/**
+ * @brief a page being scanned
+ */
+typedef struct {
+    const char *pattern;
+    size_t pattern_len;
+    uint8_t flags;
+    int socket;
+    const struct sockaddr_in *from;
+    uint32_t id;
+    uint16_t number;          // of the part being filled
+    size_t count;             // keys in the part being filled
+    size_t found;             // keys in the page
+    size_t size;              // bytes of the part being filled
+    unsigned char part[MAX_MSG_SIZE];
+} scan_page_t;
+
+static void write_u16(unsigned char *out, uint16_t value) {
+    out[0] = (unsigned char) (value >> 8);
+    out[1] = (unsigned char) value;
+}
+
+static void write_u32(unsigned char *out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = (unsigned char) (value >> (24 - 8 * i));
+    }
+}
+
+static uint16_t read_u16(const unsigned char *in) {
+    return (uint16_t) (in[0] << 8 | in[1]);
+}
+
+static uint32_t read_u32(const unsigned char *in) {
+    return (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16 | (uint32_t) in[2] << 8 | (uint32_t) in[3];
+}
+
+static int matches(const scan_page_t *page, const char *text) {
+    if (page->flags & SCAN_MATCH_PREFIX) {
+        return strncmp(text, page->pattern, page->pattern_len) == 0;
+    }
+    return str_search(text, strlen(text), page->pattern, page->pattern_len) != NULL;
+}
+
+static void send_part(scan_page_t *page, int last, uint32_t next) {
+    page->part[0] = PPS_OP_PREFIX;
+    page->part[1] = PPS_OP_SCAN;
+    write_u32(page->part + 2, page->id);
+    write_u16(page->part + 6, page->number);
+    write_u32(page->part + 8, next);
+    page->part[12] = (unsigned char) (last != 0);
+    write_u16(page->part + 13, (uint16_t) page->count);
+    sendto(page->socket, page->part, page->size, 0, (const struct sockaddr *) page->from, sizeof(*page->from));
+
+    page->number += 1;
+    page->count = 0;
+    page->size  = SCAN_PART_HEADER_SIZE;
+}
+
+static void visit(const kv_pair_t *pair, void *arg) {
+
+    scan_page_t *page = arg;
+    const int on_value = (page->flags & SCAN_MATCH_VALUE) != 0;
+    const int on_key   = (page->flags & SCAN_MATCH_KEY) != 0 || !on_value;
+    if (!(on_key && matches(page, pair->key)) && !(on_value && matches(page, pair->value))) {
+        return;
+    }
+
+    const size_t key_len = strnlen(pair->key, MAX_MSG_ELEM_SIZE);
+    //Stream the keys found so far if this one does not fit
+    if (page->size + 2 + key_len > sizeof(page->part)) {
+        send_part(page, 0, 0);
+    }
+    write_u16(page->part + page->size, (uint16_t) key_len);
+    memcpy(page->part + page->size + 2, pair->key, key_len);
+    page->size  += 2 + key_len;
+    page->count += 1;
+    page->found += 1;
+
+    if (page->size >= SCAN_PART_SIZE) {
+        send_part(page, 0, 0);
+    }
+}
+
+//Add the keys in order while they fit in the part: a page cut short is not the last one
+static void visit_range(const kv_pair_t *pair, void *arg) {
+    scan_page_t *page = arg;
+    const size_t key_len = strnlen(pair->key, MAX_MSG_ELEM_SIZE);
+    if (page->number > 0 || page->size + 2 + key_len > sizeof(page->part)) {
+        page->number = 1;
+        return;
+    }
+    write_u16(page->part + page->size, (uint16_t) key_len);
+    memcpy(page->part + page->size + 2, pair->key, key_len);
+    page->size  += 2 + key_len;
+    page->count += 1;
+}
+
+size_t scan_request(char *out, uint32_t id, uint32_t cursor, uint16_t limit, uint8_t flags, const char *pattern) {
+
+    const size_t pattern_len = pattern != NULL ? strnlen(pattern, MAX_MSG_ELEM_SIZE) : 0;
+    unsigned char *msg = (unsigned char *) out;
+    msg[0] = PPS_OP_PREFIX;
+    msg[1] = PPS_OP_SCAN;
+    write_u32(msg + 2, id);
+    write_u32(msg + 6, cursor);
+    write_u16(msg + 10, limit);
+    msg[12] = flags;
+    if (pattern_len > 0) {
+        memcpy(msg + SCAN_REQUEST_HEADER_SIZE, pattern, pattern_len);
+    }
+    return SCAN_REQUEST_HEADER_SIZE + pattern_len;
+}
+
+int scan_parse_part(const char *msg, size_t len, scan_part_t *part) {
+
+    if (msg == NULL || part == NULL || len < SCAN_PART_HEADER_SIZE || msg[0] != PPS_OP_PREFIX || msg[1] != PPS_OP_SCAN) {
+        return 0;
+    }
+    const unsigned char *in = (const unsigned char *) msg;
+    part->id       = read_u32(in + 2);
+    part->number   = read_u16(in + 6);
+    part->next     = read_u32(in + 8);
+    part->last     = in[12] != 0;
+    part->count    = read_u16(in + 13);
+    part->keys     = in + SCAN_PART_HEADER_SIZE;
+    part->keys_len = len - SCAN_PART_HEADER_SIZE;
+    return 1;
+}
+
+int scan_next_key(scan_part_t *part, char *key) {
+
+    if (part == NULL || key == NULL || part->count == 0 || part->keys_len < 2) {
+        return 0;
+    }
+    const size_t key_len = read_u16(part->keys);
+    if (key_len > MAX_MSG_ELEM_SIZE || 2 + key_len > part->keys_len) {
+        return 0;
+    }
+    memcpy(key, part->keys + 2, key_len);
+    key[key_len] = '\0';
+
+    part->keys     += 2 + key_len;
+    part->keys_len -= 2 + key_len;
+    part->count    -= 1;
+    return 1;
+}
+
+int scan_handle(Htable_t table, int socket, const char *msg, size_t len, const struct sockaddr_in *from) {
+
+    if (msg == NULL || len < SCAN_REQUEST_HEADER_SIZE || msg[0] != PPS_OP_PREFIX || msg[1] != PPS_OP_SCAN) {
+        return 0;
+    }
+    if (table == NULL || from == NULL) {
+        return 1;
+    }
+
+    //Large, and the server handles one request at a time
+    static scan_page_t page;
+    const unsigned char *in = (const unsigned char *) msg;
+    const uint16_t wanted = read_u16(in + 10);
+
+    page.pattern     = msg + SCAN_REQUEST_HEADER_SIZE;
+    page.pattern_len = strnlen(page.pattern, len - SCAN_REQUEST_HEADER_SIZE);
+    page.flags       = in[12];
+    page.socket      = socket;
+    page.from        = from;
+    page.id          = read_u32(in + 2);
+    page.number      = 0;
+    page.count       = 0;
+    page.found       = 0;
+    page.size        = SCAN_PART_HEADER_SIZE;
+
+    const size_t limit = wanted == 0 ? SCAN_DEFAULT_LIMIT : wanted < SCAN_MAX_LIMIT ? wanted : SCAN_MAX_LIMIT;
+
+    //Whole buckets only, so that the next page starts at a bucket
+    size_t bucket = read_u32(in + 6);
+    while (bucket < table->size && page.found < limit) {
+        visit_Htable_bucket(table, bucket, visit, &page);
+        ++bucket;
+    }
+
+    send_part(&page, 1, bucket < table->size ? (uint32_t) bucket : SCAN_CURSOR_END);
+    return 1;
+}
+
+size_t range_request(char *out, uint32_t id, uint16_t limit, const char *prefix, const char *after) {
+
+    const size_t prefix_len = prefix != NULL ? strnlen(prefix, MAX_MSG_ELEM_SIZE) : 0;
+    const size_t after_len  = after != NULL ? strnlen(after, MAX_MSG_ELEM_SIZE) : 0;
+    unsigned char *msg = (unsigned char *) out;
+    msg[0] = PPS_OP_PREFIX;
+    msg[1] = PPS_OP_RANGE;
+    write_u32(msg + 2, id);
+    write_u16(msg + 6, limit);
+    memcpy(msg + RANGE_REQUEST_HEADER_SIZE, prefix != NULL ? prefix : "", prefix_len);
+    msg[RANGE_REQUEST_HEADER_SIZE + prefix_len] = '\0';
+    memcpy(msg + RANGE_REQUEST_HEADER_SIZE + prefix_len + 1, after != NULL ? after : "", after_len);
+    return RANGE_REQUEST_HEADER_SIZE + prefix_len + 1 + after_len;
+}
+
+int range_handle(Htable_t table, int socket, const char *msg, size_t len, const struct sockaddr_in *from) {
+
+    if (msg == NULL || len < RANGE_REQUEST_HEADER_SIZE || msg[0] != PPS_OP_PREFIX || msg[1] != PPS_OP_RANGE) {
+        return 0;
+    }
+    const char *prefix = msg + RANGE_REQUEST_HEADER_SIZE;
+    const char *nul    = memchr(prefix, '\0', len - RANGE_REQUEST_HEADER_SIZE);
+    if (table == NULL || from == NULL || nul == NULL) {
+        return 1;
+    }
+
+    //The last key of the previous page, nul-terminated by a copy
+    char after[MAX_MSG_ELEM_SIZE + 1];
+    const size_t after_len = len - (size_t) (nul + 1 - msg);
+    if (after_len > MAX_MSG_ELEM_SIZE) {
+        return 1;
+    }
+    memcpy(after, nul + 1, after_len);
+    after[after_len] = '\0';
+
+    static scan_page_t page;
+    const unsigned char *in = (const unsigned char *) msg;
+    const uint16_t wanted = read_u16(in + 6);
+    const size_t limit = wanted == 0 ? SCAN_DEFAULT_LIMIT : wanted < SCAN_MAX_LIMIT ? wanted : SCAN_MAX_LIMIT;
+
+    page.socket = socket;
+    page.from   = from;
+    page.id     = read_u32(in + 2);
+    page.number = 0;               // set by visit_range once a key does not fit
+    page.count  = 0;
+    page.size   = SCAN_PART_HEADER_SIZE;
+
+    if (range_Htable(table, prefix, after_len > 0 ? after : NULL, limit, visit_range, &page) != ERR_NONE) {
+        page.count = 0;
+        page.size  = SCAN_PART_HEADER_SIZE;
+    }
+    const int full = page.number > 0 || page.count >= limit;
+    page.number = 0;
+    send_part(&page, !full, 0);
+    return 1;
+}
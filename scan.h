@@ -0,0 +1,120 @@
+#pragma once
+
+/**
+ * @file scan.h
+ * @brief Scan of the table of a server for the keys matching a pattern (a substring or a prefix of
+ *        the key and/or of the value). A scan goes by pages: a request starts at a cursor (a bucket
+ *        of the table) and ends after the bucket where the limit of keys is reached, so that a key
+ *        present during the whole scan is returned whatever is written meanwhile. The keys of a page
+ *        stream back in parts as they are found, the last part giving the cursor of the next page.
+ *        A range query returns the keys under a prefix in key order, by pages of one part: the
+ *        next page starts after the last key of the previous one.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "hashtable.h"
+
+/**
+ * @brief what a pattern is matched against (the key if neither), and how
+ */
+#define SCAN_MATCH_KEY    0x01
+#define SCAN_MATCH_VALUE  0x02
+#define SCAN_MATCH_PREFIX 0x04 // a prefix instead of a substring
+
+/**
+ * @brief cursor of the first page, and the one returned after the last page
+ */
+#define SCAN_CURSOR_START 0
+#define SCAN_CURSOR_END   UINT32_MAX
+
+/**
+ * @brief keys per page when the request does not say, and at most
+ */
+#define SCAN_DEFAULT_LIMIT 256
+#define SCAN_MAX_LIMIT     4096
+
+/**
+ * @brief a part is sent once its keys take this many bytes
+ */
+#define SCAN_PART_SIZE 4096
+
+/**
+ * @brief sizes of the headers of a request (opcode, id, cursor, limit, flags) and of a part
+ *        (opcode, id, part number, next cursor, last flag, number of keys)
+ */
+#define SCAN_REQUEST_HEADER_SIZE 13
+#define SCAN_PART_HEADER_SIZE 15
+
+/**
+ * @brief size of the header of a range query (opcode, id, limit)
+ */
+#define RANGE_REQUEST_HEADER_SIZE 8
+
+/**
+ * @brief a part of a page, as received by a client
+ */
+typedef struct {
+    uint32_t id;              // of the request
+    uint16_t number;          // parts of a page are numbered from 0
+    uint32_t next;            // cursor of the next page (only in the last part)
+    int last;
+    size_t count;             // number of keys
+    const unsigned char *keys; // each one is its length (2 bytes) then its bytes
+    size_t keys_len;
+} scan_part_t;
+
+/**
+ * @brief write a request of a page
+ * @param out where to write, of SCAN_REQUEST_HEADER_SIZE + MAX_MSG_ELEM_SIZE bytes
+ * @param id identifier of the request, repeated in the parts
+ * @param cursor where the page starts (SCAN_CURSOR_START or the next cursor of the previous page)
+ * @param limit number of keys after which the page ends (0 for SCAN_DEFAULT_LIMIT)
+ * @param flags SCAN_MATCH_* flags
+ * @param pattern what to match (the empty pattern matches every key)
+ * @return the length of the request
+ */
+size_t scan_request(char *out, uint32_t id, uint32_t cursor, uint16_t limit, uint8_t flags, const char *pattern);
+
+/**
+ * @brief read a part of a page
+ * @param msg the message received
+ * @param len its length
+ * @param part (OUT) the part
+ * @return 1 if the message is a well-formed part, 0 otherwise
+ */
+int scan_parse_part(const char *msg, size_t len, scan_part_t *part);
+
+/**
+ * @brief read the next key of a part
+ * @param part the part, advanced past the key
+ * @param key (OUT) the key, nul-terminated, of MAX_MSG_ELEM_SIZE + 1 bytes
+ * @return 1 if a key was read, 0 at the end of the part
+ */
+int scan_next_key(scan_part_t *part, char *key);
+
+/**
+ * @brief handle a message if it is a scan request: the page is scanned and sent in parts to the sender
+ * @return 1 if the message was a scan request, 0 otherwise
+ */
+int scan_handle(Htable_t table, int socket, const char *msg, size_t len, const struct sockaddr_in *from);
+
+/**
+ * @brief write a range query
+ * @param out where to write, of RANGE_REQUEST_HEADER_SIZE + 2 * MAX_MSG_ELEM_SIZE + 1 bytes
+ * @param id identifier of the query, repeated in the reply
+ * @param limit maximum number of keys of the page (0 for SCAN_DEFAULT_LIMIT)
+ * @param prefix prefix of the keys
+ * @param after last key of the previous page (NULL for the first page)
+ * @return the length of the query
+ */
+size_t range_request(char *out, uint32_t id, uint16_t limit, const char *prefix, const char *after);
+
+/**
+ * @brief handle a message if it is a range query: the page is sent back as a single part, the
+ *        last one unless the page is full
+ * @return 1 if the message was a range query, 0 otherwise
+ */
+int range_handle(Htable_t table, int socket, const char *msg, size_t len, const struct sockaddr_in *from);
@@ -0,0 +1,121 @@
+/**
+ * @file selection.c
+ * @brief Implementation of selection.h
+ *
+ */
+
+#include <stdlib.h>
+
+#include "selection.h"
+
+static double ewma(double average, double sample, int measured) {
+    return measured ? SELECTION_EWMA_WEIGHT * average + (1.0 - SELECTION_EWMA_WEIGHT) * sample : sample;
+}
+
+selection_t *selection_alloc(const ring_t *ring) {
+
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(ring, NULL);
+
+    selection_t *selection = calloc(1, sizeof(selection_t));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(selection, NULL);
+
+    selection->servers = calloc(ring->nb_servers, sizeof(replica_stats_t));
+    if (selection->servers == NULL) {
+        free(selection);
+        return NULL;
+    }
+    selection->nb_servers = ring->nb_servers;
+
+    return selection;
+}
+
+void selection_free(selection_t *selection) {
+    if (selection != NULL) {
+        free(selection->servers);
+        free(selection);
+    }
+}
+
+double selection_score(const selection_t *selection, size_t server) {
+
+    if (selection == NULL || server >= selection->nb_servers || !selection->servers[server].measured) {
+        return 0;
+    }
+    const replica_stats_t *stats = &selection->servers[server];
+
+    //Our own outstanding requests are ahead of the new one, as well as the server's queue
+    const double queue = 1.0 + (double) stats->outstanding + stats->queue;
+
+    return stats->response_ms - stats->service_ms + queue * queue * queue * stats->service_ms;
+}
+
+void selection_sort(const selection_t *selection, const ring_t *ring, node_t *nodes, size_t size) {
+
+    if (selection == NULL || ring == NULL || nodes == NULL) {
+        return;
+    }
+
+    //Insertion sort: at most RING_MAX_PREFERENCE_SIZE nodes, and stable
+    for (size_t i = 1; i < size; ++i) {
+        node_t current = nodes[i];
+        double score   = selection_score(selection, ring_server_index(ring, &current));
+        size_t j = i;
+        while (j > 0 && selection_score(selection, ring_server_index(ring, &nodes[j - 1])) > score) {
+            nodes[j] = nodes[j - 1];
+            --j;
+        }
+        nodes[j] = current;
+    }
+}
+
+double selection_timeout_ms(const selection_t *selection, size_t server) {
+
+    if (selection == NULL || server >= selection->nb_servers || !selection->servers[server].measured) {
+        return SELECTION_DEFAULT_TIMEOUT_MS;
+    }
+
+    double timeout = SELECTION_TIMEOUT_FACTOR * selection->servers[server].response_ms;
+    if (timeout < SELECTION_MIN_TIMEOUT_MS) {
+        timeout = SELECTION_MIN_TIMEOUT_MS;
+    } else if (timeout > SELECTION_MAX_TIMEOUT_MS) {
+        timeout = SELECTION_MAX_TIMEOUT_MS;
+    }
+
+    return timeout;
+}
+
+void selection_sent(selection_t *selection, size_t server) {
+    if (selection != NULL && server < selection->nb_servers) {
+        selection->servers[server].outstanding += 1;
+    }
+}
+
+void selection_answered(selection_t *selection, size_t server, double response_ms, double service_ms, double queue) {
+
+    if (selection == NULL || server >= selection->nb_servers) {
+        return;
+    }
+    replica_stats_t *stats = &selection->servers[server];
+
+    stats->response_ms = ewma(stats->response_ms, response_ms, stats->measured);
+    stats->service_ms  = ewma(stats->service_ms, service_ms, stats->measured);
+    stats->queue       = ewma(stats->queue, queue, stats->measured);
+    stats->measured    = 1;
+    if (stats->outstanding > 0) {
+        stats->outstanding -= 1;
+    }
+}
+
+void selection_timed_out(selection_t *selection, size_t server, double timeout_ms) {
+
+    if (selection == NULL || server >= selection->nb_servers) {
+        return;
+    }
+    replica_stats_t *stats = &selection->servers[server];
+
+    stats->response_ms = ewma(stats->response_ms, timeout_ms, stats->measured);
+    stats->measured    = 1;
+    if (stats->outstanding > 0) {
+        stats->outstanding -= 1;
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+/**
+ * @file selection.h
+ * @brief Latency-aware replica selection for reads (C3): each client keeps, per server,
+ *        moving averages of the response time it sees and of the service time and queue
+ *        length the server reports, and reads from the replicas with the best scores.
+ *        The averages live in the client process and start empty: they pay off in clients
+ *        that read many times, such as pps-client-batch and pps-bench, not in a one-shot
+ *        pps-client-get, which reads once with no history.
+ */
+
+#include <stddef.h>
+
+#include "error.h"
+#include "node.h"
+#include "ring.h"
+
+/**
+ * @brief weight of the past in the moving averages
+ */
+#define SELECTION_EWMA_WEIGHT 0.9
+
+/**
+ * @brief a replica is considered late after SELECTION_TIMEOUT_FACTOR times its average
+ *        response time (within the bounds below, SELECTION_DEFAULT_TIMEOUT_MS if unknown)
+ */
+#define SELECTION_TIMEOUT_FACTOR 4
+#define SELECTION_MIN_TIMEOUT_MS 20
+#define SELECTION_MAX_TIMEOUT_MS 1000
+#define SELECTION_DEFAULT_TIMEOUT_MS 200
+
+/**
+ * @brief what a client knows of a server
+ */
+typedef struct {
+    double response_ms;       // moving average of the response time seen by the client
+    double service_ms;        // moving average of the service time reported by the server
+    double queue;             // moving average of the queue length reported by the server
+    size_t outstanding;       // requests sent to the server and not answered yet
+    int measured;             // whether the averages hold at least one sample
+} replica_stats_t;
+
+/**
+ * @brief the statistics of every server of the ring
+ */
+typedef struct {
+    replica_stats_t *servers; // in the order of ring->servers
+    size_t nb_servers;
+} selection_t;
+
+/**
+ * @brief allocate the statistics of every server of a ring
+ * @param ring the (initialized) ring
+ * @return the statistics, NULL on error
+ */
+selection_t *selection_alloc(const ring_t *ring);
+
+/**
+ * @brief free the statistics
+ * @param selection the statistics to free
+ */
+void selection_free(selection_t *selection);
+
+/**
+ * @brief C3 score of a server (lower is better): response time, minus service time,
+ *        plus the cube of the estimated queue length times the service time
+ * @param selection the statistics
+ * @param server index of the server in ring->servers
+ * @return the score; servers never measured get 0, so they are tried
+ */
+double selection_score(const selection_t *selection, size_t server);
+
+/**
+ * @brief sort nodes by increasing score (keeping the preference order between equal scores)
+ * @param selection the statistics
+ * @param ring the ring of the nodes
+ * @param nodes the nodes to sort
+ * @param size number of nodes
+ */
+void selection_sort(const selection_t *selection, const ring_t *ring, node_t *nodes, size_t size);
+
+/**
+ * @brief time after which a request to the server is considered late
+ * @param selection the statistics
+ * @param server index of the server in ring->servers
+ * @return the timeout in milliseconds
+ */
+double selection_timeout_ms(const selection_t *selection, size_t server);
+
+/**
+ * @brief record a request sent to a server
+ * @param selection the statistics
+ * @param server index of the server in ring->servers
+ */
+void selection_sent(selection_t *selection, size_t server);
+
+/**
+ * @brief record the answer of a server
+ * @param selection the statistics
+ * @param server index of the server in ring->servers
+ * @param response_ms response time seen by the client
+ * @param service_ms service time reported by the server
+ * @param queue queue length reported by the server
+ */
+void selection_answered(selection_t *selection, size_t server, double response_ms, double service_ms, double queue);
+
+/**
+ * @brief record a request that timed out (counted as a response after the timeout)
+ * @param selection the statistics
+ * @param server index of the server in ring->servers
+ * @param timeout_ms the timeout that expired
+ */
+void selection_timed_out(selection_t *selection, size_t server, double timeout_ms);
@@ -0,0 +1,843 @@
+/**
+ * @file server.c
+ * @brief Implementation of server.h
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// for basic socket communication
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "server.h"
+#include "config.h"
+#include "system.h" // for get_socket & get_time_ms
+#include "util.h" // for free_const_ptr
+#include "strsearch.h"
+#include "scan.h"
+#include "dump.h"
+#include "bulk.h"
+
+#define LOAD_EWMA_WEIGHT 0.9
+#define LOAD_MAX_QUEUE 100.0
+
+static void load_update(server_load_t *load, double arrival, double service_ms) {
+    if (load->last_arrival > 0) {
+        load->interarrival_ms = LOAD_EWMA_WEIGHT * load->interarrival_ms + (1 - LOAD_EWMA_WEIGHT) * (arrival - load->last_arrival);
+    }
+    load->service_ms   = LOAD_EWMA_WEIGHT * load->service_ms + (1 - LOAD_EWMA_WEIGHT) * service_ms;
+    load->last_arrival = arrival;
+}
+
+static double load_queue(const server_load_t *load) {
+    if (load->interarrival_ms <= 0) {
+        return 0;
+    }
+    const double utilization = load->service_ms / load->interarrival_ms;
+    return utilization >= LOAD_MAX_QUEUE / (1 + LOAD_MAX_QUEUE) ? LOAD_MAX_QUEUE : utilization / (1 - utilization);
+}
+
+//Value of a key, or of the copies of the hot keys of other servers
+static pps_value_t lookup_value(Htable_t table, const hotcopies_t *copies, pps_key_t key) {
+    pps_value_t value = get_Htable_value(table, key);
+    return value != NULL ? value : hotcopies_get(copies, key, get_time_ms());
+}
+
+//Reply of a wide get: the width of the key (0 if it is not hot), whether the key was found, then the value
+static void send_wide(pps_value_t value, size_t width, int s, struct sockaddr_in cli_addr, socklen_t addr_len) {
+
+    char reply[MAX_MSG_SIZE];
+    reply[0] = PPS_OP_PREFIX;
+    reply[1] = PPS_OP_GET_WIDE;
+    reply[2] = (char) (width < UINT8_MAX ? width : UINT8_MAX);
+    reply[3] = value != NULL;
+
+    size_t len = 4;
+    if (value != NULL) {
+        const size_t value_len = strlen(value);
+        memcpy(reply + len, value, value_len < sizeof(reply) - len ? value_len : sizeof(reply) - len);
+        len += value_len < sizeof(reply) - len ? value_len : sizeof(reply) - len;
+    }
+
+    sendto(s, reply, len, 0, (struct sockaddr *) &cli_addr, addr_len);
+}
+
+void serve_get_request(Htable_t table, const hotcopies_t *copies, char *in_msg,
+                       int s, struct sockaddr_in cli_addr, socklen_t addr_len) {
+
+    //Get value corresponding to key
+    pps_value_t value = lookup_value(table, copies, in_msg);
+
+    //A hot key is answered like a wide get, so that the client learns its width (see spread.h)
+    const size_t width = hotcopies_width(copies, in_msg, get_time_ms());
+    if (width > 0) {
+        send_wide(value, width, s, cli_addr, addr_len);
+    } else if (value != NULL) {
+        sendto(s, value, strlen(value), 0, (struct sockaddr *) &cli_addr, addr_len);
+    } else {
+        //No value found
+        sendto(s, "\0", 1, 0, (struct sockaddr *) &cli_addr, addr_len);
+    }
+    free_const_ptr(value);
+
+}
+
+/**
+ * @brief get with load feedback, for latency-aware clients: the reply holds the queue length
+ *        (in thousandths) and service time (in microseconds) of the server, whether the key was found,
+ *        then the value
+ */
+void serve_get_feedback(Htable_t table, const hotcopies_t *copies, const server_load_t *load,
+                        char *in_msg, int s, struct sockaddr_in cli_addr, socklen_t addr_len) {
+
+    //in_msg is initialized with zeros: the key is nul-terminated
+    pps_value_t value = lookup_value(table, copies, in_msg + 2);
+
+    char reply[MAX_MSG_SIZE];
+    const uint32_t queue   = (uint32_t) (load_queue(load) * 1e3);
+    const uint32_t service = (uint32_t) (load->service_ms * 1e3);
+    reply[0] = PPS_OP_PREFIX;
+    reply[1] = PPS_OP_GET_FEEDBACK;
+    for (int i = 0; i < 4; ++i) {
+        reply[2 + i] = (char) (queue >> (24 - 8 * i));
+        reply[6 + i] = (char) (service >> (24 - 8 * i));
+    }
+    reply[10] = value != NULL;
+
+    size_t len = 11;
+    if (value != NULL) {
+        const size_t value_len = strlen(value);
+        memcpy(reply + len, value, value_len < sizeof(reply) - len ? value_len : sizeof(reply) - len);
+        len += value_len < sizeof(reply) - len ? value_len : sizeof(reply) - len;
+        free_const_ptr(value);
+    }
+
+    sendto(s, reply, len, 0, (struct sockaddr *) &cli_addr, addr_len);
+}
+
+/**
+ * @brief get with a read lease, for caching clients: the reply echoes the sequence number of the
+ *        request, then holds the duration of the lease in milliseconds (0 if none is granted),
+ *        whether the key was found, then the value
+ */
+void serve_get_lease(Htable_t table, const hotcopies_t *copies, lease_table_t *leases,
+                     char *in_msg, int s, struct sockaddr_in cli_addr, socklen_t addr_len) {
+
+    //in_msg is initialized with zeros: the key is nul-terminated
+    pps_value_t value = lookup_value(table, copies, in_msg + 6);
+
+    //Only values are cached: a missing key gets no lease
+    const uint32_t lease_ms = value != NULL ? (uint32_t) lease_grant(leases, in_msg + 6, &cli_addr, get_time_ms()) : 0;
+
+    char reply[MAX_MSG_SIZE];
+    memcpy(reply, in_msg, 6);
+    for (int i = 0; i < 4; ++i) {
+        reply[6 + i] = (char) (lease_ms >> (24 - 8 * i));
+    }
+    reply[10] = value != NULL;
+
+    size_t len = 11;
+    if (value != NULL) {
+        const size_t value_len = strlen(value);
+        memcpy(reply + len, value, value_len < sizeof(reply) - len ? value_len : sizeof(reply) - len);
+        len += value_len < sizeof(reply) - len ? value_len : sizeof(reply) - len;
+        free_const_ptr(value);
+    }
+
+    sendto(s, reply, len, 0, (struct sockaddr *) &cli_addr, addr_len);
+}
+
+/**
+ * @brief get of a pipelined client: the reply echoes the sequence number of the request, then
+ *        holds whether the key was found, then the value
+ */
+void serve_get_seq(Htable_t table, const hotcopies_t *copies, char *in_msg,
+                   int s, struct sockaddr_in cli_addr, socklen_t addr_len) {
+
+    //in_msg is initialized with zeros: the key is nul-terminated
+    pps_value_t value = lookup_value(table, copies, in_msg + 6);
+
+    char reply[MAX_MSG_SIZE];
+    memcpy(reply, in_msg, 6);
+    reply[6] = value != NULL;
+
+    size_t len = 7;
+    if (value != NULL) {
+        const size_t value_len = strlen(value);
+        memcpy(reply + len, value, value_len < sizeof(reply) - len ? value_len : sizeof(reply) - len);
+        len += value_len < sizeof(reply) - len ? value_len : sizeof(reply) - len;
+        free_const_ptr(value);
+    }
+
+    sendto(s, reply, len, 0, (struct sockaddr *) &cli_addr, addr_len);
+}
+
+/**
+ * @brief get whose reply advertises the number of replicas of the key (see send_wide), for the
+ *        clients reading a key they know is hot
+ */
+void serve_get_wide(Htable_t table, const hotcopies_t *copies, char *in_msg,
+                    int s, struct sockaddr_in cli_addr, socklen_t addr_len) {
+
+    //in_msg is initialized with zeros: the key is nul-terminated
+    pps_value_t value = lookup_value(table, copies, in_msg + 2);
+    send_wide(value, hotcopies_width(copies, in_msg + 2, get_time_ms()), s, cli_addr, addr_len);
+    free_const_ptr(value);
+}
+
+//Write a value: the cached copies are stale from now on, those of a hot key are replaced, and the
+//hints of older writes are skipped
+static error_code store_value(Htable_t table, lease_table_t *leases, hotcopies_t *copies, hint_table_t *hints,
+                              const ring_t *ring, pps_key_t key, pps_value_t value, int s) {
+    error_code error = add_Htable_value(table, key, value);
+    if (error == ERR_NONE) {
+        lease_revoke(leases, key, s, get_time_ms());
+        hotcopies_written(copies, ring, key, value, s);
+        hints_written(hints, key, get_time_ms());
+    }
+    return error;
+}
+
+//Write a hint meant for the local server like a put (see hints_handle)
+static error_code store_hint(void *arg, pps_key_t key, pps_value_t value) {
+    server_t *server = arg;
+    return store_value(server->table, &server->leases, &server->hot_copies, &server->hints, server->ring, key, value,
+                       server->socket);
+}
+
+void serve_write_request(Htable_t table, lease_table_t *leases, hotcopies_t *copies, hint_table_t *hints,
+                         const ring_t *ring, char *in_msg, int s, struct sockaddr_in cli_addr, socklen_t addr_len) {
+
+    //in_msg is initialized with zeros, only overwritten by the key and the value
+    if (store_value(table, leases, copies, hints, ring, in_msg, in_msg + strlen(in_msg) + 1, s) == ERR_NONE) {
+        // Send response back to sender (an empty datagram)
+        sendto(s, NULL, 0, 0, (struct sockaddr *) &cli_addr, addr_len);
+    }
+}
+
+static void send_status(int s, char op, char status, struct sockaddr_in cli_addr, socklen_t addr_len) {
+    const char reply[3] = {PPS_OP_PREFIX, op, status};
+    sendto(s, reply, sizeof(reply), 0, (struct sockaddr *) &cli_addr, addr_len);
+}
+
+/**
+ * @brief append a suffix to the value of a key in place (a missing key is created with the suffix):
+ *        the server handles one request at a time, so the append is atomic on each replica
+ */
+void serve_append(Htable_t table, lease_table_t *leases, hotcopies_t *copies, hint_table_t *hints,
+                  const ring_t *ring, char *in_msg, int s, struct sockaddr_in cli_addr, socklen_t addr_len) {
+
+    //in_msg is initialized with zeros: the key and the suffix are nul-terminated
+    pps_key_t   key    = in_msg + 2;
+    pps_value_t suffix = key + strlen(key) + 1;
+
+    pps_value_t old = get_Htable_value(table, key);
+    const size_t old_len    = old != NULL ? strlen(old) : 0;
+    const size_t suffix_len = strlen(suffix);
+    if (old_len + suffix_len > MAX_MSG_ELEM_SIZE) {
+        free_const_ptr(old);
+        send_status(s, PPS_OP_APPEND, PPS_STATUS_TOO_LONG, cli_addr, addr_len);
+        return;
+    }
+
+    char value[MAX_MSG_ELEM_SIZE + 1];
+    memcpy(value, old != NULL ? old : "", old_len);
+    memcpy(value + old_len, suffix, suffix_len + 1);
+    free_const_ptr(old);
+
+    if (store_value(table, leases, copies, hints, ring, key, value, s) == ERR_NONE) {
+        send_status(s, PPS_OP_APPEND, PPS_STATUS_OK, cli_addr, addr_len);
+    }
+}
+
+/**
+ * @brief concatenate the values of the sources into the destination: the sources are pulled from
+ *        their replicas, and the request answered by finish_concat once they are in
+ */
+void serve_concat(pull_table_t *pulls, Htable_t table, const ring_t *ring, size_t n, const struct sockaddr_in *self,
+                  char *in_msg, size_t in_msg_len, int s, struct sockaddr_in cli_addr, socklen_t addr_len) {
+
+    //in_msg is initialized with zeros: every key is nul-terminated
+    pps_key_t dest = in_msg + 2;
+
+    if (ring == NULL
+        || pull_start(pulls, table, ring, n, self, s, in_msg, in_msg_len, 2 + strlen(dest) + 1, &cli_addr, addr_len,
+                      get_time_ms()) != ERR_NONE) {
+        send_status(s, PPS_OP_CONCAT, PPS_STATUS_NOT_FOUND, cli_addr, addr_len);
+    }
+}
+
+static void finish_concat(const pull_t *pull, Htable_t table, lease_table_t *leases, hotcopies_t *copies,
+                          hint_table_t *hints, const ring_t *ring, int s) {
+
+    pps_key_t dest = pull->request + 2;
+
+    char   value[MAX_MSG_ELEM_SIZE + 1];
+    size_t len = 0;
+    char   status = PPS_STATUS_OK;
+    for (size_t i = 0; i < pull->nb_keys && status == PPS_STATUS_OK; ++i) {
+        pps_value_t part = pull->values[i];
+        if (part == NULL) {
+            status = PPS_STATUS_NOT_FOUND;
+            break;
+        }
+        const size_t part_len = strlen(part);
+        if (len + part_len > MAX_MSG_ELEM_SIZE) {
+            status = PPS_STATUS_TOO_LONG;
+        } else {
+            memcpy(value + len, part, part_len);
+            len += part_len;
+        }
+    }
+    value[len] = '\0';
+
+    if (status != PPS_STATUS_OK || store_value(table, leases, copies, hints, ring, dest, value, s) == ERR_NONE) {
+        send_status(s, PPS_OP_CONCAT, status, pull->cli_addr, pull->addr_len);
+    }
+}
+
+/**
+ * @brief find the value of a key in the value of another one, next to the latter: only the offset
+ *        goes back to the client. The pattern is pulled from its replicas like the sources of a
+ *        concatenation, and the request answered by finish_find once it is in.
+ */
+void serve_find(pull_table_t *pulls, Htable_t table, const hotcopies_t *copies,
+                const ring_t *ring, size_t n, const struct sockaddr_in *self, char *in_msg, size_t in_msg_len,
+                int s, struct sockaddr_in cli_addr, socklen_t addr_len) {
+
+    //in_msg is initialized with zeros: both keys are nul-terminated
+    pps_key_t key = in_msg + 2;
+
+    pps_value_t haystack = lookup_value(table, copies, key);
+    if (haystack == NULL || ring == NULL
+        || pull_start(pulls, table, ring, n, self, s, in_msg, in_msg_len, 2 + strlen(key) + 1, &cli_addr, addr_len,
+                      get_time_ms()) != ERR_NONE) {
+        const char reply[7] = {PPS_OP_PREFIX, PPS_OP_FIND, PPS_STATUS_NOT_FOUND, '\xFF', '\xFF', '\xFF', '\xFF'};
+        sendto(s, reply, sizeof(reply), 0, (struct sockaddr *) &cli_addr, addr_len);
+    }
+    free_const_ptr(haystack);
+}
+
+static void finish_find(const pull_t *pull, Htable_t table, const hotcopies_t *copies, int s) {
+
+    pps_value_t haystack = lookup_value(table, copies, pull->request + 2);
+    pps_value_t needle   = pull->nb_keys > 0 ? pull->values[0] : NULL;
+
+    unsigned char reply[7] = {PPS_OP_PREFIX, PPS_OP_FIND, PPS_STATUS_NOT_FOUND, 0xFF, 0xFF, 0xFF, 0xFF};
+    if (haystack != NULL && needle != NULL) {
+        const size_t haystack_len = strlen(haystack);
+        const char *found = str_search(haystack, haystack_len, needle, strlen(needle));
+        reply[2] = PPS_STATUS_OK;
+        if (found != NULL) {
+            const uint32_t offset = (uint32_t) (found - haystack);
+            for (int i = 0; i < 4; ++i) {
+                reply[3 + i] = (unsigned char) (offset >> (24 - 8 * i));
+            }
+        }
+    }
+    free_const_ptr(haystack);
+
+    sendto(s, reply, sizeof(reply), 0, (const struct sockaddr *) &pull->cli_addr, pull->addr_len);
+}
+
+/**
+ * @brief value of a key another server needs for a concatenation or a search (see pull.h): the
+ *        reply echoes the identifier and index of the request, then holds whether the key was found
+ *        and the value
+ */
+void serve_pull(Htable_t table, const hotcopies_t *copies, char *in_msg,
+                int s, struct sockaddr_in cli_addr, socklen_t addr_len) {
+
+    //in_msg is initialized with zeros: the key is nul-terminated
+    pps_value_t value = lookup_value(table, copies, in_msg + PULL_HEADER_SIZE);
+
+    char reply[PULL_REPLY_HEADER_SIZE + MAX_MSG_ELEM_SIZE];
+    memcpy(reply, in_msg, PULL_HEADER_SIZE);
+    reply[1] = PPS_OP_PULL_REPLY;
+    reply[PULL_HEADER_SIZE] = value != NULL;
+
+    size_t len = PULL_REPLY_HEADER_SIZE;
+    if (value != NULL) {
+        const size_t value_len = strlen(value);
+        memcpy(reply + len, value, value_len < sizeof(reply) - len ? value_len : sizeof(reply) - len);
+        len += value_len < sizeof(reply) - len ? value_len : sizeof(reply) - len;
+        free_const_ptr(value);
+    }
+
+    sendto(s, reply, len, 0, (struct sockaddr *) &cli_addr, addr_len);
+}
+
+//Answer the concatenations and searches whose values are in, or that waited long enough
+static void finish_pulls(server_t *server, double now) {
+    pull_t *pull = NULL;
+    while ((pull = pull_next_done(&server->pulls, now)) != NULL) {
+        if (pull->request[1] == PPS_OP_CONCAT) {
+            finish_concat(pull, server->table, &server->leases, &server->hot_copies, &server->hints, server->ring,
+                          server->socket);
+        } else {
+            finish_find(pull, server->table, &server->hot_copies, server->socket);
+        }
+        pull_free(pull);
+    }
+}
+
+/**
+ * @brief write the pairs of a batch (pps-import): the batch is checked whole before any pair is
+ *        written, and acknowledged once all are, with its sequence number
+ */
+void serve_put_batch(Htable_t table, lease_table_t *leases, hotcopies_t *copies, hint_table_t *hints,
+                     const ring_t *ring, const char *in_msg, size_t in_msg_len, int s, struct sockaddr_in cli_addr,
+                     socklen_t addr_len) {
+
+    const unsigned char *in = (const unsigned char *) in_msg;
+    const size_t count = (size_t) (in[6] << 8 | in[7]);
+    const char  *pairs = in_msg + BULK_BATCH_HEADER_SIZE;
+    const char  *end   = in_msg + in_msg_len;
+
+    //Every key and value must be nul-terminated within the message
+    const char *cursor = pairs;
+    for (size_t i = 0; i < 2 * count; ++i) {
+        const char *nul = cursor < end ? memchr(cursor, '\0', (size_t) (end - cursor)) : NULL;
+        if (nul == NULL || (i % 2 == 0 && nul == cursor)) {
+            return;
+        }
+        cursor = nul + 1;
+    }
+
+    cursor = pairs;
+    for (size_t i = 0; i < count; ++i) {
+        pps_key_t   key   = cursor;
+        pps_value_t value = key + strlen(key) + 1;
+        if (store_value(table, leases, copies, hints, ring, key, value, s) != ERR_NONE) {
+            return;
+        }
+        cursor = value + strlen(value) + 1;
+    }
+
+    unsigned char reply[BULK_BATCH_REPLY_SIZE] = {PPS_OP_PREFIX, PPS_OP_PUT_BATCH, in[2], in[3], in[4], in[5], PPS_STATUS_OK};
+    sendto(s, reply, sizeof(reply), 0, (struct sockaddr *) &cli_addr, addr_len);
+}
+
+error_code serve_dump_node(Htable_t table, int s, struct sockaddr_in cli_addr, socklen_t addr_len) {
+
+    kv_list_t* list = get_Htable_content(table);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(list, ERR_NOMEM);
+
+    char msg[MAX_MSG_SIZE];
+    (void) memset(msg, '\0', MAX_MSG_SIZE);
+
+    sprintf(msg, "%zu", list->size);
+    size_t index = strlen(msg) + 1;
+
+    size_t index_list = 0;
+    size_t next_len   = 0;
+
+    while (index_list < list->size) {
+        do {
+            kv_pair_t current = list->elems[index_list];
+
+            size_t key_len = strlen(current.key);
+            strncpy(msg + index, current.key, key_len);
+            index += key_len + 1;
+
+            size_t value_len = strlen(current.value);
+            strncpy(msg + index, current.value, value_len);
+            index += value_len + 1;
+
+            index_list += 1;
+            if (index_list < list->size) {
+                next_len = strlen(list->elems[index_list].key) + strlen(list->elems[index_list].value) + 2;
+            }
+        } while (index_list < list->size && next_len < MAX_MSG_SIZE - index);
+
+        sendto(s, msg, index, 0, (struct sockaddr *) &cli_addr, addr_len);
+
+        (void) memset(msg, '\0', MAX_MSG_SIZE);
+        index = 0;
+    }
+
+    kv_list_free(list);
+    return ERR_NONE;
+}
+
+void server_default_config(server_config_t *config) {
+    gossip_default_config(&config->gossip);
+    migration_default_config(&config->migration);
+    hotcopies_default_config(&config->hot);
+    config->lease_ms = LEASE_DEFAULT_MS;
+    config->buckets  = HTABLE_SIZE;
+}
+
+error_code server_parse_config(int argc, char *argv[], server_config_t *config) {
+
+    for (int i = 1; i < argc; i += 2) {
+        double value = 0;
+        M_REQUIRE(i + 1 < argc && strlen(argv[i]) == 2 && argv[i][0] == '-'
+                  && sscanf(argv[i + 1], "%lf", &value) == 1 && value >= 0,
+                  ERR_BAD_PARAMETER, "bad option %s", argv[i]);
+
+        switch (argv[i][1]) {
+        case 'p':
+            config->gossip.period_ms = value;
+            break;
+        case 't':
+            config->gossip.ack_timeout_ms = value;
+            break;
+        case 'k':
+            config->gossip.indirect_probes = (size_t) value;
+            break;
+        case 's':
+            config->gossip.suspicion_periods = (size_t) value;
+            break;
+        case 'g':
+            config->gossip.max_piggyback = (size_t) value;
+            break;
+        case 'n':
+            config->migration.replication = (size_t) value;
+            break;
+        case 'm':
+            config->migration.rate = value;
+            break;
+        case 'l':
+            config->lease_ms = value;
+            break;
+        case 'r':
+            config->hot.threshold = value;
+            break;
+        case 'w':
+            config->hot.max_width = (size_t) value;
+            break;
+        case 'b':
+            M_REQUIRE(value >= 1, ERR_BAD_PARAMETER, "bad option %s", argv[i]);
+            config->buckets = (size_t) value;
+            break;
+        default:
+            return ERR_BAD_PARAMETER;
+        }
+    }
+
+    return ERR_NONE;
+}
+
+/**
+ * @brief load the ring of the servers file
+ * @return the initialized ring, NULL if the file cannot be read
+ */
+static ring_t *load_ring(void) {
+    ring_t *ring = ring_alloc();
+    if (ring != NULL && ring_init(ring) != ERR_NONE) {
+        ring_free(ring);
+        ring = NULL;
+    }
+    return ring;
+}
+
+/**
+ * @brief (re)start the gossip protocol if the server is in the ring
+ * @return the gossip state, NULL if the server runs without it
+ */
+static gossip_t *start_gossip(gossip_t *gossip, const gossip_config_t *config, const ring_t *ring,
+                              const struct sockaddr_in *srv_addr) {
+
+    if (ring == NULL || gossip_init(gossip, config, ring, srv_addr, get_time_ms()) != ERR_NONE) {
+        fprintf(stderr, "not in " PPS_SERVERS_LIST_FILENAME ": running without membership gossip\n");
+        return NULL;
+    }
+
+    return gossip;
+}
+
+//Modification time of the servers file, 0 if it cannot be read
+static time_t servers_file_mtime(void) {
+    struct stat info;
+    return stat(PPS_SERVERS_LIST_FILENAME, &info) == 0 ? info.st_mtime : 0;
+}
+
+error_code server_init(server_t *server, const server_config_t *config, int socket, const struct sockaddr_in *addr,
+                       ring_t *ring) {
+
+    M_REQUIRE_NON_NULL(server);
+    M_REQUIRE_NON_NULL(config);
+    M_REQUIRE_NON_NULL(addr);
+
+    memset(server, 0, sizeof(*server));
+    server->config = *config;
+    server->socket = socket;
+    server->addr   = *addr;
+
+    // Create and initialize new empty Htable
+    server->table = construct_ordered_Htable(config->buckets);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(server->table, ERR_NOMEM);
+
+    error_code error = hints_init(&server->hints, addr);
+    if (error != ERR_NONE) {
+        delete_Htable_and_content(&server->table);
+        return error;
+    }
+
+    server->servers_mtime = servers_file_mtime();
+    server->ring          = ring != NULL ? ring_retain(ring) : load_ring();
+    server->gossip        = start_gossip(&server->gossip_state, &config->gossip, server->ring, addr);
+
+    migration_init(&server->migration, &config->migration, addr);
+    server->next_reload_check = get_time_ms() + MIGRATION_RELOAD_CHECK_MS;
+
+    lease_init(&server->leases, config->lease_ms);
+    pull_init(&server->pulls);
+    hotkeys_init(&server->sketch);
+    hotcopies_init(&server->hot_copies, &config->hot, addr, config->migration.replication, get_time_ms());
+
+    return ERR_NONE;
+}
+
+void server_end(server_t *server) {
+    if (server == NULL) {
+        return;
+    }
+    hotcopies_end(&server->hot_copies);
+    pull_end(&server->pulls);
+    lease_end(&server->leases);
+    hints_end(&server->hints);
+    migration_end(&server->migration);
+    gossip_end(server->gossip);
+    ring_free(server->ring);
+    delete_Htable_and_content(&server->table);
+}
+
+double server_next_timeout_ms(const server_t *server, double now) {
+    double wait = server->next_reload_check - now;
+    if (server->gossip != NULL && gossip_next_timeout_ms(server->gossip, now) < wait) {
+        wait = gossip_next_timeout_ms(server->gossip, now);
+    }
+    if (migration_next_timeout_ms(&server->migration, now) < wait) {
+        wait = migration_next_timeout_ms(&server->migration, now);
+    }
+    if (server->hints.size > 0 && server->hints.next_replay - now < wait) {
+        wait = server->hints.next_replay - now;
+    }
+    if (hotcopies_next_timeout_ms(&server->hot_copies, now) < wait) {
+        wait = hotcopies_next_timeout_ms(&server->hot_copies, now);
+    }
+    if (pull_next_timeout_ms(&server->pulls, now) < wait) {
+        wait = pull_next_timeout_ms(&server->pulls, now);
+    }
+    return wait;
+}
+
+//Offset of the key of a request that reads or updates a key, SIZE_MAX for the other messages
+static size_t request_key(const char *in_msg, size_t in_msg_len) {
+    if (in_msg[0] != PPS_OP_PREFIX) {
+        return memchr(in_msg, '\0', in_msg_len) == NULL ? 0 : SIZE_MAX;
+    }
+    switch (in_msg_len >= 2 ? in_msg[1] : 0) {
+    case PPS_OP_GET_FEEDBACK:
+    case PPS_OP_GET_WIDE:
+    case PPS_OP_APPEND:
+    case PPS_OP_FIND:
+        return 2;
+    case PPS_OP_GET_LEASE:
+    case PPS_OP_GET_SEQ:
+        return 6;
+    case PPS_OP_PULL:
+        return PULL_HEADER_SIZE;
+    default:
+        return SIZE_MAX;
+    }
+}
+
+//Whether a request is an append to a key that is not here: during a handoff, it would start over
+//the value on its way here, which would then not replace it (see store_batch)
+static int append_to_missing(server_t *server, const char *in_msg, size_t in_msg_len) {
+    if (in_msg_len < 2 || in_msg[0] != PPS_OP_PREFIX || in_msg[1] != PPS_OP_APPEND) {
+        return 0;
+    }
+    pps_value_t value = lookup_value(server->table, &server->hot_copies, in_msg + 2);
+    free_const_ptr(value);
+    return value == NULL;
+}
+
+//During a handoff, a request for a key that is not here yet waits for the servers streaming to us
+static int defer_request(server_t *server, const char *in_msg, size_t in_msg_len, struct sockaddr_in cli_addr,
+                         socklen_t addr_len) {
+    const double now = get_time_ms();
+    const size_t key = request_key(in_msg, in_msg_len);
+    if (server->replaying || key >= in_msg_len || !migration_receiving(&server->migration, now)) {
+        return 0;
+    }
+    pps_value_t value = lookup_value(server->table, &server->hot_copies, in_msg + key);
+    if (value != NULL) {
+        free_const_ptr(value);
+        return 0;
+    }
+    if (migration_defer(&server->migration, server->socket, in_msg, in_msg_len, key, &cli_addr, addr_len, now)) {
+        return 1;
+    }
+    //Too many requests wait already: an append is refused rather than applied to nothing
+    if (append_to_missing(server, in_msg, in_msg_len)) {
+        send_status(server->socket, PPS_OP_APPEND, PPS_STATUS_AGAIN, cli_addr, addr_len);
+        return 1;
+    }
+    return 0;
+}
+
+//Serve again the requests whose key arrived, or that waited long enough
+static void finish_waits(server_t *server, double now) {
+    migration_wait_t *wait = NULL;
+    while ((wait = migration_next_ready(&server->migration, now)) != NULL) {
+        //Requests are followed by zeros, as received
+        char in_msg[MAX_MSG_SIZE];
+        memset(in_msg, 0, sizeof(in_msg));
+        memcpy(in_msg, wait->request, wait->len);
+        if (wait->waiting > 0 && append_to_missing(server, in_msg, wait->len)) {
+            //Some servers did not answer: the key may still come, the append is refused
+            send_status(server->socket, PPS_OP_APPEND, PPS_STATUS_AGAIN, wait->cli_addr, wait->addr_len);
+        } else {
+            server->replaying = 1;
+            server_handle(server, in_msg, wait->len, wait->cli_addr, wait->addr_len);
+            server->replaying = 0;
+        }
+        migration_wait_free(wait);
+    }
+}
+
+void server_tick(server_t *server, double now) {
+    const int s = server->socket;
+    if (server->gossip != NULL) {
+        gossip_tick(server->gossip, s, now);
+    }
+    migration_tick(&server->migration, server->table, s, now);
+    finish_waits(server, now);
+    hints_tick(&server->hints, server->gossip, s, now);
+    hotcopies_tick(&server->hot_copies, &server->sketch, server->ring, server->table, s, now);
+    finish_pulls(server, now);
+
+    //The servers file changed: move the keys to their new owners
+    if (now >= server->next_reload_check) {
+        server->next_reload_check = now + MIGRATION_RELOAD_CHECK_MS;
+        time_t mtime = servers_file_mtime();
+        ring_t *new_ring = mtime != server->servers_mtime ? load_ring() : NULL;
+        if (new_ring != NULL) {
+            server->servers_mtime = mtime;
+            gossip_end(server->gossip);
+            server->gossip = start_gossip(&server->gossip_state, &server->config.gossip, new_ring, &server->addr);
+            if (server->ring != NULL) {
+                //Takes over the old ring, whether it starts or not
+                migration_start(&server->migration, server->ring, new_ring, server->table, s, now);
+            }
+            server->ring = new_ring;
+        }
+    }
+}
+
+void server_handle(server_t *server, char *in_msg, size_t in_msg_len, struct sockaddr_in cli_addr,
+                   socklen_t addr_len) {
+
+    const int s = server->socket;
+    Htable_t table = server->table;
+    const size_t replication = server->config.migration.replication;
+
+    const double arrival = get_time_ms();
+    char *nul = memchr(in_msg, '\0', in_msg_len);
+
+    /** Here, we check if the message is empty -> it's a message to check if the server is responsive (pps-list-nodes) */
+    if (in_msg_len == 0) {
+        sendto(s, NULL, 0, 0, (struct sockaddr *) &cli_addr, addr_len);
+        /** Here, we check if the message is of length 1 -> print all key-value pairs associated to the node (pps-dump-node) */
+    } else if (in_msg_len == 1 && strncmp("\0", in_msg, 1) == 0) {
+        serve_dump_node(table, s, cli_addr, addr_len);
+
+    } else if (defer_request(server, in_msg, in_msg_len, cli_addr, addr_len)) {
+        //The key is on its way here: the request is served once it arrived (see finish_waits)
+
+        /** A nul byte followed by an opcode is a control message (gossip, membership, migration, hints, hot keys, scans, dumps) */
+    } else if (in_msg_len >= 2 && in_msg[0] == PPS_OP_PREFIX && in_msg[1] == PPS_OP_GET_FEEDBACK) {
+        hotkeys_record(&server->sketch, in_msg + 2, strnlen(in_msg + 2, in_msg_len - 2));
+        serve_get_feedback(table, &server->hot_copies, &server->load, in_msg, s, cli_addr, addr_len);
+        load_update(&server->load, arrival, get_time_ms() - arrival);
+
+    } else if (in_msg_len >= 2 && in_msg[0] == PPS_OP_PREFIX && in_msg[1] == PPS_OP_GET_WIDE) {
+        hotkeys_record(&server->sketch, in_msg + 2, strnlen(in_msg + 2, in_msg_len - 2));
+        serve_get_wide(table, &server->hot_copies, in_msg, s, cli_addr, addr_len);
+        load_update(&server->load, arrival, get_time_ms() - arrival);
+
+    } else if (in_msg_len >= 6 && in_msg[0] == PPS_OP_PREFIX && in_msg[1] == PPS_OP_GET_LEASE) {
+        hotkeys_record(&server->sketch, in_msg + 6, strnlen(in_msg + 6, in_msg_len - 6));
+        serve_get_lease(table, &server->hot_copies, &server->leases, in_msg, s, cli_addr, addr_len);
+        load_update(&server->load, arrival, get_time_ms() - arrival);
+
+    } else if (in_msg_len >= 6 && in_msg[0] == PPS_OP_PREFIX && in_msg[1] == PPS_OP_GET_SEQ) {
+        hotkeys_record(&server->sketch, in_msg + 6, strnlen(in_msg + 6, in_msg_len - 6));
+        serve_get_seq(table, &server->hot_copies, in_msg, s, cli_addr, addr_len);
+        load_update(&server->load, arrival, get_time_ms() - arrival);
+
+    } else if (in_msg_len >= 3 && in_msg[0] == PPS_OP_PREFIX && in_msg[1] == PPS_OP_APPEND
+               && memchr(in_msg + 2, '\0', in_msg_len - 2) != NULL) {
+        hotkeys_record(&server->sketch, in_msg + 2, strlen(in_msg + 2));
+        serve_append(table, &server->leases, &server->hot_copies, &server->hints, server->ring, in_msg, s, cli_addr,
+                     addr_len);
+        load_update(&server->load, arrival, get_time_ms() - arrival);
+
+    } else if (in_msg_len >= 3 && in_msg[0] == PPS_OP_PREFIX && in_msg[1] == PPS_OP_FIND
+               && memchr(in_msg + 2, '\0', in_msg_len - 2) != NULL) {
+        hotkeys_record(&server->sketch, in_msg + 2, strlen(in_msg + 2));
+        serve_find(&server->pulls, table, &server->hot_copies, server->ring, replication,
+                   &server->addr, in_msg, in_msg_len, s, cli_addr, addr_len);
+        finish_pulls(server, get_time_ms());
+        load_update(&server->load, arrival, get_time_ms() - arrival);
+
+    } else if (in_msg_len >= 3 && in_msg[0] == PPS_OP_PREFIX && in_msg[1] == PPS_OP_CONCAT
+               && in_msg_len < MAX_MSG_SIZE) {
+        hotkeys_record(&server->sketch, in_msg + 2, strlen(in_msg + 2));
+        serve_concat(&server->pulls, table, server->ring, replication, &server->addr, in_msg, in_msg_len, s,
+                     cli_addr, addr_len);
+        finish_pulls(server, get_time_ms());
+        load_update(&server->load, arrival, get_time_ms() - arrival);
+
+    } else if (in_msg_len >= PULL_HEADER_SIZE && in_msg[0] == PPS_OP_PREFIX && in_msg[1] == PPS_OP_PULL) {
+        serve_pull(table, &server->hot_copies, in_msg, s, cli_addr, addr_len);
+        load_update(&server->load, arrival, get_time_ms() - arrival);
+
+    } else if (pull_handle(&server->pulls, in_msg, in_msg_len)) {
+        finish_pulls(server, get_time_ms());
+
+    } else if (in_msg_len >= BULK_BATCH_HEADER_SIZE && in_msg[0] == PPS_OP_PREFIX && in_msg[1] == PPS_OP_PUT_BATCH) {
+        serve_put_batch(table, &server->leases, &server->hot_copies, &server->hints, server->ring, in_msg, in_msg_len,
+                        s, cli_addr, addr_len);
+        load_update(&server->load, arrival, get_time_ms() - arrival);
+
+    } else if (in_msg[0] == PPS_OP_PREFIX) {
+        const double now = get_time_ms();
+        if (!hotkeys_handle(&server->sketch, s, in_msg, in_msg_len, &cli_addr)
+            && !scan_handle(table, s, in_msg, in_msg_len, &cli_addr)
+            && !range_handle(table, s, in_msg, in_msg_len, &cli_addr)
+            && !dump_handle(table, s, in_msg, in_msg_len, &cli_addr)
+            && !hotcopies_handle(&server->hot_copies, in_msg, in_msg_len, now)
+            && !gossip_handle(server->gossip, s, in_msg, in_msg_len, &cli_addr, now)
+            && !migration_handle(&server->migration, table, s, in_msg, in_msg_len, &cli_addr, now)) {
+            hints_handle(&server->hints, table, store_hint, server, s, in_msg, in_msg_len, &cli_addr, now);
+        }
+        finish_waits(server, now);
+
+    } else {
+        /** Here, we check if the message contains a nul character.
+         * If it does, it's a write request -> add the value associated with the key to the Htable.
+         * If it doesn't, it's a read request -> send the value associated with the key received.
+         */
+        hotkeys_record(&server->sketch, in_msg, nul != NULL ? (size_t) (nul - in_msg) : in_msg_len);
+        if (nul != NULL) {
+            serve_write_request(table, &server->leases, &server->hot_copies, &server->hints, server->ring, in_msg, s,
+                                cli_addr, addr_len);
+        } else {
+            serve_get_request(table, &server->hot_copies, in_msg, s, cli_addr, addr_len);
+        }
+        load_update(&server->load, arrival, get_time_ms() - arrival);
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+/**
+ * @file server.h
+ * @brief A server of the DHT, apart from its socket: its keys, its membership, migration,
+ *        hint, lease and hot key state, and the dispatch of the requests it receives.
+ *        pps-launch-server runs one over a UDP socket; pps-sim runs many in one process.
+ */
+
+#include <stddef.h>
+#include <sys/types.h> // for time_t
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "error.h"
+#include "hashtable.h"
+#include "ring.h"
+#include "gossip.h"
+#include "migration.h"
+#include "hints.h"
+#include "lease.h"
+#include "hotkeys.h"
+#include "hotcopies.h"
+#include "pull.h"
+
+/**
+ * @brief settings of a server (see pps-launch-server)
+ */
+typedef struct {
+    gossip_config_t gossip;
+    migration_config_t migration;
+    hotcopies_config_t hot;
+    double lease_ms;
+    size_t buckets;           // of the table of the pairs
+} server_config_t;
+
+/**
+ * @brief moving averages of the service time and of the time between two requests,
+ *        from which the queue length reported to clients is estimated (M/M/1)
+ */
+typedef struct {
+    double service_ms;
+    double interarrival_ms;
+    double last_arrival;
+} server_load_t;
+
+/**
+ * @brief state of a server
+ */
+typedef struct {
+    server_config_t config;
+    int socket;
+    struct sockaddr_in addr;
+    Htable_t table;
+    time_t servers_mtime;       // of the servers file the ring was loaded from
+    ring_t *ring;               // NULL if the servers file cannot be read
+    gossip_t gossip_state;
+    gossip_t *gossip;           // &gossip_state, NULL if the server is not in the ring
+    migration_t migration;
+    int replaying;              // whether a request that waited for a key is served again
+    double next_reload_check;
+    server_load_t load;
+    hint_table_t hints;         // writes clients could not deliver to other servers, until these are back
+    lease_table_t leases;       // clients caching values read here, to be told when these change
+    hotkeys_t sketch;           // most requested keys, reported to pps-hot-keys
+    hotcopies_t hot_copies;     // and replicated to more servers when too hot
+    pull_table_t pulls;         // concatenations and searches waiting for the values of other keys
+} server_t;
+
+/**
+ * @brief the default settings
+ */
+void server_default_config(server_config_t *config);
+
+/**
+ * @brief read the gossip, migration, lease, hot key and table settings from the command line
+ *        (pairs of an option and its value, from argv[1] on)
+ * @return ERR_NONE or ERR_BAD_PARAMETER on an unknown option or value
+ */
+error_code server_parse_config(int argc, char *argv[], server_config_t *config);
+
+/**
+ * @brief initialize a server: an empty table, and the ring of the servers file
+ * @param server the server
+ * @param config its settings
+ * @param socket its socket, bound to addr
+ * @param addr its address
+ * @param ring the ring of the servers file, shared with the server (see ring_retain), NULL to
+ *        load it
+ * @return some error code
+ */
+error_code server_init(server_t *server, const server_config_t *config, int socket, const struct sockaddr_in *addr,
+                       ring_t *ring);
+
+/**
+ * @brief free a server (not its socket)
+ */
+void server_end(server_t *server);
+
+/**
+ * @brief time before the next gossip, migration, hint, hot key, pull or reload timer
+ * @return the time in milliseconds (at most 0 if one is due)
+ */
+double server_next_timeout_ms(const server_t *server, double now);
+
+/**
+ * @brief run the timers that are due, and move the keys to their new owners if the servers
+ *        file changed
+ */
+void server_tick(server_t *server, double now);
+
+/**
+ * @brief serve a request
+ * @param server the server
+ * @param in_msg the request, followed by zeros up to MAX_MSG_SIZE bytes
+ * @param in_msg_len its length
+ * @param cli_addr where it comes from
+ * @param addr_len length of cli_addr
+ */
+void server_handle(server_t *server, char *in_msg, size_t in_msg_len, struct sockaddr_in cli_addr,
+                   socklen_t addr_len);
@@ -0,0 +1,961 @@
+/**
+ * @file pps-sim.c
+ * @brief run many servers (see server.h) and a client (see network.h) in one process, over a
+ *        simulated network and in virtual time, and report the latency percentiles and the
+ *        failures of a workload: a run of millions of operations, with lost datagrams and crashed
+ *        servers, takes seconds, and is the same every time for the same seed.
+ *        Usage: pps-sim [-n N] [-w W] [-r R] [-m servers] [-V vnodes] [-o operations] [-k keys]
+ *                       [-z theta] [-v size[:max]] [-g get_ratio] [-s seed] [-l] [-d delay_ms]
+ *                       [-j jitter_ms] [-x loss] [-f mtbf_s:down_s] [-p base_port] [-D dir]
+ *                       [-- server options]
+ *        The servers (5 by default, with 3 virtual nodes each) are on 127.0.0.1 from base_port on
+ *        (21000 by default), in a servers file written in dir (a new directory in /tmp by
+ *        default), and run with the server options (see pps-launch-server). The client runs the
+ *        operations (100000 by default) one after the other, drawn as by pps-bench (-k, -z, -v,
+ *        -g, -l: see there). Each datagram takes delay_ms (0.1 by default) plus up to jitter_ms
+ *        (drawn uniformly) to arrive, and a share loss of them is dropped. With -f, each server
+ *        crashes after an exponential time of mean mtbf_s seconds, and comes back (empty)
+ *        down_s seconds later.
+ *        The socket calls and the clock are wrapped at link time (see the Makefile): the sockets
+ *        are in the simulator, and the client and the servers read its virtual clock. A server
+ *        handles a datagram when it arrives, and runs its timers when they are due, as the loop
+ *        of pps-launch-server would; the time only moves while someone waits for a datagram.
+ *        The last line is a digest of all the datagrams delivered, to check that two runs are
+ *        the same.
+ *
+ */
+
+#define _GNU_SOURCE // for mkdtemp
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "config.h"
+#include "error.h"
+#include "system.h"
+#include "util.h" // for argv_size & free_const_ptr
+#include "args.h"
+#include "client.h"
+#include "network.h"
+#include "server.h"
+#include "histogram.h"
+#include "workload.h"
+
+#define USAGE "usage: pps-sim [-n N] [-w W] [-r R] [-m servers] [-V vnodes] [-o operations] [-k keys] " \
+              "[-z theta] [-v size[:max]] [-g get_ratio] [-s seed] [-l] [-d delay_ms] [-j jitter_ms] " \
+              "[-x loss] [-f mtbf_s:down_s] [-p base_port] [-D dir] [-- server options]"
+
+#define SIM_DEFAULT_SERVERS 5
+#define SIM_DEFAULT_VNODES 3
+#define SIM_DEFAULT_OPERATIONS 100000
+#define SIM_DEFAULT_KEYS 1000
+#define SIM_DEFAULT_VALUE_SIZE 16
+#define SIM_DEFAULT_GET_RATIO 0.9
+#define SIM_DEFAULT_DELAY_MS 0.1
+#define SIM_DEFAULT_PORT 21000
+
+/**
+ * @brief the simulated sockets are numbered from SIM_FD_BASE, above any real descriptor
+ */
+#define SIM_FD_BASE (1 << 20)
+
+/**
+ * @brief ports given in turn to the sockets that send before being bound
+ */
+#define SIM_EPHEMERAL_FIRST 32768
+#define SIM_EPHEMERAL_LAST 60999
+
+/**
+ * @brief virtual time at the start, in milliseconds (some timers take 0 for "not set")
+ */
+#define SIM_START_MS 1e6
+
+/**
+ * @brief longest a receive without timeout waits, in virtual milliseconds
+ */
+#define SIM_MAX_WAIT_MS 60000
+
+/**
+ * @brief owner of the sockets of the client
+ */
+#define SIM_CLIENT SIZE_MAX
+
+int __real_close(int fd);
+int __real_socket(int domain, int type, int protocol);
+int __real_setsockopt(int fd, int level, int name, const void *value, socklen_t len);
+ssize_t __real_sendto(int fd, const void *message, size_t length, int flags, const struct sockaddr *dest_addr,
+                      socklen_t dest_len);
+ssize_t __real_recvfrom(int fd, void *buffer, size_t length, int flags, struct sockaddr *src_addr,
+                        socklen_t *src_len);
+ssize_t __real_recv(int fd, void *buffer, size_t length, int flags);
+int __real_clock_gettime(clockid_t clock, struct timespec *time);
+
+/**
+ * @brief options of a run
+ */
+typedef struct {
+    size_t nb_servers;
+    size_t vnodes;
+    size_t nb_operations;
+    size_t nb_keys;
+    double theta;
+    size_t min_value_size;
+    size_t max_value_size;
+    double get_ratio;
+    uint64_t seed;
+    int preload;
+    double delay_ms;
+    double jitter_ms;
+    double loss;
+    double mtbf_s;          // 0 for no crash
+    double down_s;
+    int base_port;
+    const char *dir;        // NULL for a new directory
+    int server_argc;        // the server options, from server_argv[1] on
+    char **server_argv;
+} sim_options_t;
+
+/**
+ * @brief a datagram, from its sending to its reading
+ */
+typedef struct datagram {
+    struct datagram *next;
+    struct sockaddr_in from;
+    size_t len;
+    char data[];
+} datagram_t;
+
+typedef struct {
+    int open;
+    uint16_t port;          // 0 until bound, or until it sends
+    size_t owner;           // the server it belongs to, SIM_CLIENT for the client
+    double timeout_ms;      // SO_RCVTIMEO, 0 for none
+    datagram_t *head;       // arrived, not read yet
+    datagram_t *tail;
+} sim_socket_t;
+
+typedef enum {
+    EVENT_DELIVER,
+    EVENT_TIMER,
+    EVENT_CRASH,
+    EVENT_RESTART
+} event_kind_t;
+
+typedef struct {
+    double at;
+    uint64_t order;         // of scheduling, among the events at the same time
+    event_kind_t kind;
+    size_t node;            // of a timer, a crash or a restart
+    uint16_t port;          // destination of a datagram
+    datagram_t *datagram;
+} event_t;
+
+typedef struct {
+    server_t server;
+    size_t socket;          // index of its socket
+    char *in_msg;           // MAX_MSG_SIZE bytes, zeros but while it handles a request
+    int up;
+    int busy;               // in server_tick or server_handle, maybe waiting for other servers
+    double timer_at;        // of its timer event, 0 if none
+} sim_node_t;
+
+/**
+ * @brief the simulator
+ */
+static struct {
+    double now;
+    uint64_t state;         // of the generator of the network (xorshift64*)
+    const sim_options_t *options;
+    server_config_t config;
+
+    sim_socket_t *sockets;
+    size_t nb_sockets;
+    size_t max_sockets;
+    size_t *free_sockets;   // closed, reused last closed first
+    size_t nb_free;
+    size_t by_port[UINT16_MAX + 1]; // index of the socket bound to a port, plus one (0 for none)
+    uint16_t next_port;
+
+    event_t *events;        // a binary heap, by time then order
+    size_t nb_events;
+    size_t max_events;
+    uint64_t next_order;
+
+    sim_node_t *nodes;
+    ring_t *ring;           // of the servers file, shared by the servers
+    size_t current;         // the node running, SIM_CLIENT for the client
+
+    uint64_t nb_run;        // events
+    uint64_t nb_sent;       // datagrams
+    uint64_t nb_dropped;    // lost, or to or from a server down
+    uint64_t nb_unread;     // to a port no socket is bound to, or closed before reading them
+    uint64_t nb_crashes;
+    uint64_t digest;        // FNV-1a of the datagrams delivered
+} sim;
+
+static int is_sim_fd(int fd) {
+    return fd >= SIM_FD_BASE && (size_t) (fd - SIM_FD_BASE) < sim.nb_sockets && sim.sockets[fd - SIM_FD_BASE].open;
+}
+
+static double uniform(void) {
+    sim.state ^= sim.state >> 12;
+    sim.state ^= sim.state << 25;
+    sim.state ^= sim.state >> 27;
+    return (double) ((sim.state * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0;
+}
+
+static void digest_bytes(const void *bytes, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        sim.digest = (sim.digest ^ ((const unsigned char *) bytes)[i]) * 0x100000001B3ULL;
+    }
+}
+
+// ======================================================================
+// Events
+
+static int event_before(const event_t *a, const event_t *b) {
+    return a->at < b->at || (a->at == b->at && a->order < b->order);
+}
+
+static void schedule(event_t event) {
+    if (sim.nb_events == sim.max_events) {
+        const size_t max = sim.max_events > 0 ? 2 * sim.max_events : 1024;
+        event_t *events = realloc(sim.events, max * sizeof(event_t));
+        if (events == NULL) {
+            free(event.datagram);
+            return;
+        }
+        sim.events     = events;
+        sim.max_events = max;
+    }
+    event.order = sim.next_order++;
+
+    size_t i = sim.nb_events++;
+    while (i > 0 && event_before(&event, &sim.events[(i - 1) / 2])) {
+        sim.events[i] = sim.events[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    sim.events[i] = event;
+}
+
+static event_t next_event(void) {
+    const event_t first = sim.events[0];
+    const event_t last  = sim.events[--sim.nb_events];
+    size_t i = 0;
+    for (size_t child = 1; child < sim.nb_events; child = 2 * i + 1) {
+        if (child + 1 < sim.nb_events && event_before(&sim.events[child + 1], &sim.events[child])) {
+            ++child;
+        }
+        if (!event_before(&sim.events[child], &last)) {
+            break;
+        }
+        sim.events[i] = sim.events[child];
+        i = child;
+    }
+    sim.events[i] = last;
+    return first;
+}
+
+// ======================================================================
+// Sockets
+
+static void drop_queue(sim_socket_t *socket, uint64_t *count) {
+    while (socket->head != NULL) {
+        datagram_t *next = socket->head->next;
+        free(socket->head);
+        socket->head = next;
+        ++*count;
+    }
+    socket->tail = NULL;
+}
+
+static int open_socket(void) {
+    size_t index = 0;
+    if (sim.nb_free > 0) {
+        index = sim.free_sockets[--sim.nb_free];
+    } else {
+        if (sim.nb_sockets == sim.max_sockets) {
+            const size_t max = sim.max_sockets > 0 ? 2 * sim.max_sockets : 64;
+            sim_socket_t *sockets = realloc(sim.sockets, max * sizeof(sim_socket_t));
+            size_t *free_sockets  = sockets != NULL ? realloc(sim.free_sockets, max * sizeof(size_t)) : NULL;
+            if (sockets != NULL) {
+                sim.sockets = sockets;
+            }
+            if (free_sockets == NULL) {
+                errno = ENOMEM;
+                return -1;
+            }
+            sim.free_sockets = free_sockets;
+            sim.max_sockets  = max;
+        }
+        index = sim.nb_sockets++;
+    }
+
+    sim_socket_t *socket = &sim.sockets[index];
+    memset(socket, 0, sizeof(*socket));
+    socket->open  = 1;
+    socket->owner = sim.current;
+    return SIM_FD_BASE + (int) index;
+}
+
+static int bind_port(sim_socket_t *socket, uint16_t port) {
+    if (sim.by_port[port] != 0) {
+        errno = EADDRINUSE;
+        return -1;
+    }
+    socket->port = port;
+    sim.by_port[port] = (size_t) (socket - sim.sockets) + 1;
+    return 0;
+}
+
+//A port no socket is bound to, as the kernel gives one to a socket that sends first
+static uint16_t ephemeral_port(void) {
+    for (int i = SIM_EPHEMERAL_FIRST; i <= SIM_EPHEMERAL_LAST; ++i) {
+        const uint16_t port = sim.next_port;
+        sim.next_port = sim.next_port < SIM_EPHEMERAL_LAST ? sim.next_port + 1 : SIM_EPHEMERAL_FIRST;
+        if (sim.by_port[port] == 0) {
+            return port;
+        }
+    }
+    return 0;
+}
+
+static struct sockaddr_in sim_addr(uint16_t port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return addr;
+}
+
+// ======================================================================
+// Servers
+
+//Run the timers of a server when its timer event is due
+static void schedule_timer(size_t i) {
+    sim_node_t *node = &sim.nodes[i];
+    const double wait = server_next_timeout_ms(&node->server, sim.now);
+    //To the millisecond, as the poll of pps-launch-server
+    const double at = sim.now + (wait > 0 ? 1 + floor(wait) : 1);
+    if (node->timer_at > sim.now && node->timer_at <= at) {
+        return;
+    }
+    node->timer_at = at;
+    schedule((event_t) {at, 0, EVENT_TIMER, i, 0, NULL});
+}
+
+//Run the due timers of a server, then serve the datagrams that arrived, as its loop would
+static void run_node(size_t i) {
+    sim_node_t *node = &sim.nodes[i];
+    if (node->busy || !node->up) {
+        return;
+    }
+    node->busy = 1;
+    const size_t caller = sim.current;
+    sim.current = i;
+
+    //The loop of pps-launch-server runs the timers before each request, but they only have
+    //something to do once due: a gossip tick alone goes over all the members
+    if (server_next_timeout_ms(&node->server, sim.now) <= 0) {
+        server_tick(&node->server, sim.now);
+    }
+    //The datagrams of a server go to its socket, and only it reads it: none is read elsewhere
+    while (node->up && sim.sockets[node->socket].head != NULL) {
+        sim_socket_t *socket = &sim.sockets[node->socket];
+        datagram_t *datagram = socket->head;
+        socket->head = datagram->next;
+        socket->tail = socket->head != NULL ? socket->tail : NULL;
+
+        const size_t len = datagram->len < MAX_MSG_SIZE ? datagram->len : MAX_MSG_SIZE;
+        memcpy(node->in_msg, datagram->data, len);
+        server_handle(&node->server, node->in_msg, len, datagram->from, sizeof(datagram->from));
+        memset(node->in_msg, '\0', len);
+        free(datagram);
+
+        if (node->up && sim.sockets[node->socket].head != NULL && server_next_timeout_ms(&node->server, sim.now) <= 0) {
+            server_tick(&node->server, sim.now);
+        }
+    }
+
+    sim.current = caller;
+    node->busy  = 0;
+    if (node->up) {
+        schedule_timer(i);
+    }
+}
+
+static error_code start_node(size_t i) {
+    sim_node_t *node = &sim.nodes[i];
+    const struct sockaddr_in addr = sim_addr((uint16_t) (sim.options->base_port + (int) i));
+
+    const size_t caller = sim.current;
+    sim.current = i;
+    error_code error = server_init(&node->server, &sim.config, SIM_FD_BASE + (int) node->socket, &addr, sim.ring);
+    sim.current = caller;
+
+    node->up       = error == ERR_NONE;
+    node->timer_at = 0;
+    if (node->up) {
+        schedule_timer(i);
+        if (sim.options->mtbf_s > 0) {
+            const double up_ms = -log(1 - uniform()) * sim.options->mtbf_s * 1000;
+            schedule((event_t) {sim.now + up_ms, 0, EVENT_CRASH, i, 0, NULL});
+        }
+    }
+    return error;
+}
+
+//Its datagrams are lost from now on; its state is lost when it comes back
+static void crash_node(size_t i) {
+    sim_node_t *node = &sim.nodes[i];
+    if (!node->up) {
+        return;
+    }
+    node->up = 0;
+    ++sim.nb_crashes;
+    for (size_t s = 0; s < sim.nb_sockets; ++s) {
+        if (sim.sockets[s].open && sim.sockets[s].owner == i) {
+            drop_queue(&sim.sockets[s], &sim.nb_dropped);
+        }
+    }
+    schedule((event_t) {sim.now + sim.options->down_s * 1000, 0, EVENT_RESTART, i, 0, NULL});
+}
+
+static void restart_node(size_t i) {
+    sim_node_t *node = &sim.nodes[i];
+    if (node->busy) {
+        //Still waiting in a request it got before crashing
+        schedule((event_t) {sim.now + 1, 0, EVENT_RESTART, i, 0, NULL});
+        return;
+    }
+    server_end(&node->server);
+    if (start_node(i) != ERR_NONE) {
+        fprintf(stderr, "server %zu cannot restart\n", i);
+    }
+}
+
+// ======================================================================
+// Network
+
+static void deliver(event_t *event) {
+    datagram_t *datagram = event->datagram;
+    const size_t index = sim.by_port[event->port];
+    sim_socket_t *socket = index > 0 ? &sim.sockets[index - 1] : NULL;
+    if (socket == NULL) {
+        ++sim.nb_unread;
+        free(datagram);
+        return;
+    }
+    if (socket->owner != SIM_CLIENT && !sim.nodes[socket->owner].up) {
+        ++sim.nb_dropped;
+        free(datagram);
+        return;
+    }
+
+    digest_bytes(&event->at, sizeof(event->at));
+    digest_bytes(&event->port, sizeof(event->port));
+    digest_bytes(&datagram->from.sin_port, sizeof(datagram->from.sin_port));
+    digest_bytes(datagram->data, datagram->len);
+
+    datagram->next = NULL;
+    if (socket->tail != NULL) {
+        socket->tail->next = datagram;
+    } else {
+        socket->head = datagram;
+    }
+    socket->tail = datagram;
+
+    if (socket->owner != SIM_CLIENT && sim.nodes[socket->owner].socket == index - 1) {
+        run_node(socket->owner);
+    }
+}
+
+static void run_event(event_t *event) {
+    ++sim.nb_run;
+    switch (event->kind) {
+    case EVENT_DELIVER:
+        deliver(event);
+        break;
+    case EVENT_TIMER:
+        if (event->at == sim.nodes[event->node].timer_at) {
+            sim.nodes[event->node].timer_at = 0;
+            run_node(event->node);
+        }
+        break;
+    case EVENT_CRASH:
+        crash_node(event->node);
+        break;
+    case EVENT_RESTART:
+        restart_node(event->node);
+        break;
+    }
+}
+
+/**
+ * @brief run the events until a datagram is there for a socket, or until a deadline
+ * @return whether a datagram is there
+ */
+static int wait_for(size_t index, double deadline) {
+    while (sim.sockets[index].head == NULL) {
+        if (sim.nb_events == 0 || sim.events[0].at > deadline) {
+            sim.now = deadline > sim.now ? deadline : sim.now;
+            return 0;
+        }
+        event_t event = next_event();
+        sim.now = event.at > sim.now ? event.at : sim.now;
+        run_event(&event);
+    }
+    return 1;
+}
+
+// ======================================================================
+// Wrapped calls
+
+int __wrap_socket(int domain, int type, int protocol) {
+    if (domain != AF_INET || type != SOCK_DGRAM) {
+        return __real_socket(domain, type, protocol);
+    }
+    return open_socket();
+}
+
+int __wrap_close(int fd) {
+    if (!is_sim_fd(fd)) {
+        return __real_close(fd);
+    }
+    sim_socket_t *socket = &sim.sockets[fd - SIM_FD_BASE];
+    drop_queue(socket, &sim.nb_unread);
+    if (socket->port != 0) {
+        sim.by_port[socket->port] = 0;
+    }
+    socket->open = 0;
+    sim.free_sockets[sim.nb_free++] = (size_t) (fd - SIM_FD_BASE);
+    return 0;
+}
+
+int __wrap_setsockopt(int fd, int level, int name, const void *value, socklen_t len) {
+    if (!is_sim_fd(fd)) {
+        return __real_setsockopt(fd, level, name, value, len);
+    }
+    if (level == SOL_SOCKET && name == SO_RCVTIMEO && len >= sizeof(struct timeval)) {
+        const struct timeval *timeout = value;
+        sim.sockets[fd - SIM_FD_BASE].timeout_ms = (double) timeout->tv_sec * 1e3 + (double) timeout->tv_usec * 1e-3;
+    }
+    //The buffers have no limit
+    return 0;
+}
+
+ssize_t __wrap_sendto(int fd, const void *message, size_t length, int flags, const struct sockaddr *dest_addr,
+                      socklen_t dest_len) {
+    if (!is_sim_fd(fd)) {
+        return __real_sendto(fd, message, length, flags, dest_addr, dest_len);
+    }
+    if (dest_addr == NULL || dest_addr->sa_family != AF_INET || dest_len < sizeof(struct sockaddr_in)) {
+        errno = EINVAL;
+        return -1;
+    }
+    sim_socket_t *socket = &sim.sockets[fd - SIM_FD_BASE];
+    if (socket->port == 0 && bind_port(socket, ephemeral_port()) == -1) {
+        return -1;
+    }
+
+    ++sim.nb_sent;
+    if ((socket->owner != SIM_CLIENT && !sim.nodes[socket->owner].up)
+        || (sim.options->loss > 0 && uniform() < sim.options->loss)) {
+        ++sim.nb_dropped;
+        return (ssize_t) length;
+    }
+
+    datagram_t *datagram = malloc(sizeof(datagram_t) + length);
+    if (datagram == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    datagram->next = NULL;
+    datagram->from = sim_addr(socket->port);
+    datagram->len  = length;
+    memcpy(datagram->data, message, length);
+
+    double delay = sim.options->delay_ms;
+    if (sim.options->jitter_ms > 0) {
+        delay += uniform() * sim.options->jitter_ms;
+    }
+    const uint16_t port = ntohs(((const struct sockaddr_in *) dest_addr)->sin_port);
+    schedule((event_t) {sim.now + delay, 0, EVENT_DELIVER, 0, port, datagram});
+
+    return (ssize_t) length;
+}
+
+ssize_t __wrap_recvfrom(int fd, void *buffer, size_t length, int flags, struct sockaddr *src_addr,
+                        socklen_t *src_len) {
+    if (!is_sim_fd(fd)) {
+        return __real_recvfrom(fd, buffer, length, flags, src_addr, src_len);
+    }
+    const size_t index = (size_t) (fd - SIM_FD_BASE);
+    const double timeout = sim.sockets[index].timeout_ms > 0 ? sim.sockets[index].timeout_ms : SIM_MAX_WAIT_MS;
+    if (!wait_for(index, flags & MSG_DONTWAIT ? sim.now : sim.now + timeout)) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    sim_socket_t *socket = &sim.sockets[index];
+    datagram_t *datagram = socket->head;
+    socket->head = datagram->next;
+    socket->tail = socket->head != NULL ? socket->tail : NULL;
+
+    const size_t len = datagram->len < length ? datagram->len : length;
+    memcpy(buffer, datagram->data, len);
+    if (src_addr != NULL && src_len != NULL) {
+        const socklen_t from_len = *src_len < sizeof(datagram->from) ? *src_len : sizeof(datagram->from);
+        memcpy(src_addr, &datagram->from, from_len);
+        *src_len = sizeof(datagram->from);
+    }
+    free(datagram);
+    return (ssize_t) len;
+}
+
+ssize_t __wrap_recv(int fd, void *buffer, size_t length, int flags) {
+    if (!is_sim_fd(fd)) {
+        return __real_recv(fd, buffer, length, flags);
+    }
+    return __wrap_recvfrom(fd, buffer, length, flags, NULL, NULL);
+}
+
+int __wrap_clock_gettime(clockid_t clock, struct timespec *time) {
+    (void) clock;
+    time->tv_sec  = (time_t) (sim.now / 1e3);
+    time->tv_nsec = (long) ((sim.now - (double) time->tv_sec * 1e3) * 1e6);
+    return 0;
+}
+
+// ======================================================================
+// The run
+
+/**
+ * @brief what the client measured, in microseconds of virtual time
+ */
+typedef struct {
+    histogram_t latencies[2]; // of the gets and of the puts that succeeded
+    uint64_t failed[2];
+} sim_result_t;
+
+enum { SIM_GET, SIM_PUT };
+
+static error_code run_operation(client_t *client, sim_result_t *result, int op, const char *key, const char *value) {
+    const double start = get_time_ms();
+    error_code error = ERR_NONE;
+    if (op == SIM_GET) {
+        pps_value_t got = NULL;
+        error = network_get(*client, key, &got);
+        free_const_ptr(got);
+    } else {
+        error = network_put(*client, key, value);
+    }
+
+    if (error != ERR_NONE) {
+        result->failed[op] += 1;
+    } else {
+        histogram_record(&result->latencies[op], (uint64_t) ((get_time_ms() - start) * 1000));
+    }
+    return error;
+}
+
+static void run_workload(client_t *client, sim_result_t *result, workload_t *workload, const sim_options_t *options) {
+    char key[WORKLOAD_KEY_SIZE];
+    if (options->preload) {
+        static sim_result_t preload;
+        for (size_t k = 0; k < workload->nb_keys; ++k) {
+            snprintf(key, sizeof(key), WORKLOAD_KEY_FORMAT, k);
+            run_operation(client, &preload, SIM_PUT, key, workload_next_value(workload));
+        }
+        if (preload.failed[SIM_PUT] > 0) {
+            fprintf(stderr, "%llu of the %zu keys could not be written\n",
+                    (unsigned long long) preload.failed[SIM_PUT], workload->nb_keys);
+        }
+    }
+
+    for (size_t i = 0; i < options->nb_operations; ++i) {
+        const int op = workload_uniform(workload) < options->get_ratio ? SIM_GET : SIM_PUT;
+        snprintf(key, sizeof(key), WORKLOAD_KEY_FORMAT, workload_next_key(workload));
+        run_operation(client, result, op, key, op == SIM_PUT ? workload_next_value(workload) : NULL);
+    }
+}
+
+static void print_row(const char *name, const histogram_t *latencies, uint64_t failed, double seconds) {
+    static const double percentiles[] = {50, 90, 99, 99.9, 99.99};
+    printf("%-4s %10llu %8llu %10.0f %8.3f", name, (unsigned long long) latencies->total,
+           (unsigned long long) failed, (double) latencies->total / seconds, histogram_mean(latencies) / 1000);
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i) {
+        printf(" %8.3f", (double) histogram_percentile(latencies, percentiles[i]) / 1000);
+    }
+    printf(" %8.3f\n", (double) latencies->max / 1000 * (latencies->total > 0));
+}
+
+static void report(const sim_result_t *result, double seconds) {
+    printf("%-4s %10s %8s %10s %8s %8s %8s %8s %8s %8s %8s\n", "op", "ok", "failed", "ops/s", "mean_ms",
+           "p50", "p90", "p99", "p99.9", "p99.99", "max");
+    print_row("get", &result->latencies[SIM_GET], result->failed[SIM_GET], seconds);
+    print_row("put", &result->latencies[SIM_PUT], result->failed[SIM_PUT], seconds);
+
+    histogram_t all;
+    histogram_init(&all);
+    histogram_merge(&all, &result->latencies[SIM_GET]);
+    histogram_merge(&all, &result->latencies[SIM_PUT]);
+    print_row("all", &all, result->failed[SIM_GET] + result->failed[SIM_PUT], seconds);
+}
+
+//Options after the ones of the client, up to "--", 0 if they are not valid
+static int parse_options(char **argv, sim_options_t *options) {
+
+    const size_t argc = argv_size(argv);
+    for (size_t i = 0; i < argc; ++i) {
+        const char *option = argv[i];
+        if (strcmp(option, "--") == 0) {
+            //The server options are read as a command line: from the one after the "--"
+            options->server_argc = (int) (argc - i);
+            options->server_argv = argv + i;
+            return 1;
+        }
+        if (strcmp(option, "-l") == 0) {
+            options->preload = 1;
+            continue;
+        }
+        const char *value = argv[++i];
+        if (value == NULL || strlen(option) != 2 || option[0] != '-') {
+            return 0;
+        }
+        int valid = 0;
+        switch (option[1]) {
+        case 'm':
+            valid = sscanf(value, "%zu", &options->nb_servers) == 1 && options->nb_servers > 0
+                    && options->nb_servers <= SIM_EPHEMERAL_FIRST - 1024;
+            break;
+        case 'V':
+            valid = sscanf(value, "%zu", &options->vnodes) == 1 && options->vnodes > 0;
+            break;
+        case 'o':
+            valid = sscanf(value, "%zu", &options->nb_operations) == 1;
+            break;
+        case 'k':
+            valid = sscanf(value, "%zu", &options->nb_keys) == 1 && options->nb_keys > 0;
+            break;
+        case 'z':
+            valid = sscanf(value, "%lf", &options->theta) == 1 && options->theta >= 0 && options->theta < 1;
+            break;
+        case 'v':
+            valid = sscanf(value, "%zu", &options->min_value_size) == 1;
+            options->max_value_size = options->min_value_size;
+            if (valid && strchr(value, ':') != NULL) {
+                valid = sscanf(strchr(value, ':') + 1, "%zu", &options->max_value_size) == 1;
+            }
+            valid = valid && options->min_value_size <= options->max_value_size
+                    && options->max_value_size <= MAX_MSG_ELEM_SIZE;
+            break;
+        case 'g':
+            valid = sscanf(value, "%lf", &options->get_ratio) == 1 && options->get_ratio >= 0 && options->get_ratio <= 1;
+            break;
+        case 's':
+            valid = sscanf(value, "%llu", (unsigned long long *) &options->seed) == 1;
+            break;
+        case 'd':
+            valid = sscanf(value, "%lf", &options->delay_ms) == 1 && options->delay_ms >= 0;
+            break;
+        case 'j':
+            valid = sscanf(value, "%lf", &options->jitter_ms) == 1 && options->jitter_ms >= 0;
+            break;
+        case 'x':
+            valid = sscanf(value, "%lf", &options->loss) == 1 && options->loss >= 0 && options->loss <= 1;
+            break;
+        case 'f':
+            valid = sscanf(value, "%lf:%lf", &options->mtbf_s, &options->down_s) == 2
+                    && options->mtbf_s > 0 && options->down_s >= 0;
+            break;
+        case 'p':
+            valid = sscanf(value, "%d", &options->base_port) == 1 && options->base_port > 0;
+            break;
+        case 'D':
+            options->dir = value;
+            valid = 1;
+            break;
+        default:
+            break;
+        }
+        if (!valid) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static error_code write_servers_file(const sim_options_t *options) {
+    FILE *file = fopen(PPS_SERVERS_LIST_FILENAME, "w");
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(file, ERR_IO);
+    for (size_t i = 0; i < options->nb_servers; ++i) {
+        fprintf(file, "127.0.0.1 %d %zu\n", options->base_port + (int) i, options->vnodes);
+    }
+    return fclose(file) == 0 ? ERR_NONE : ERR_IO;
+}
+
+static error_code start_servers(const sim_options_t *options) {
+    sim.nodes = calloc(options->nb_servers, sizeof(sim_node_t));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(sim.nodes, ERR_NOMEM);
+
+    //Loaded once: the preference lists of a large ring take a while to compute
+    sim.ring = ring_alloc();
+    if (sim.ring != NULL && ring_init(sim.ring) != ERR_NONE) {
+        ring_free(sim.ring);
+        sim.ring = NULL;
+    }
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(sim.ring, ERR_IO);
+
+    for (size_t i = 0; i < options->nb_servers; ++i) {
+        sim.current = i;
+        const int fd = open_socket();
+        sim.current = SIM_CLIENT;
+        M_REQUIRE(fd != -1, ERR_NOMEM, "%s", "no socket");
+        M_REQUIRE(bind_port(&sim.sockets[fd - SIM_FD_BASE], (uint16_t) (options->base_port + (int) i)) == 0,
+                  ERR_NETWORK, "port %d taken", options->base_port + (int) i);
+
+        sim.nodes[i].socket = (size_t) (fd - SIM_FD_BASE);
+        sim.nodes[i].in_msg = calloc(MAX_MSG_SIZE, 1);
+        M_REQUIRE_NON_NULL_CUSTOM_ERR(sim.nodes[i].in_msg, ERR_NOMEM);
+        error_code error = start_node(i);
+        M_REQUIRE(error == ERR_NONE, error, "server %zu cannot start", i);
+    }
+    return ERR_NONE;
+}
+
+static void stop_servers(const sim_options_t *options) {
+    for (size_t i = 0; sim.nodes != NULL && i < options->nb_servers; ++i) {
+        server_end(&sim.nodes[i].server);
+        free(sim.nodes[i].in_msg);
+    }
+    free(sim.nodes);
+    ring_free(sim.ring);
+    while (sim.nb_events > 0) {
+        free(next_event().datagram);
+    }
+    free(sim.events);
+    for (size_t s = 0; s < sim.nb_sockets; ++s) {
+        drop_queue(&sim.sockets[s], &sim.nb_unread);
+    }
+    free(sim.sockets);
+    free(sim.free_sockets);
+}
+
+static double wall_time_s(void) {
+    struct timespec now;
+    __real_clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+
+    //The servers must be there before the client starts: its options are skipped for now
+    char **options_argv = argv + 1;
+    args_t *client_args = parse_opt_args(TOTAL_SERVERS | PUT_NEEDED | GET_NEEDED, &options_argv);
+    M_EXIT_IF(client_args == NULL, ERR_BAD_PARAMETER, "pps-sim", "%s", USAGE);
+    free(client_args);
+
+    static char default_argv0[] = "pps-sim";
+    static char *no_server_options[] = {default_argv0, NULL};
+    sim_options_t options = {SIM_DEFAULT_SERVERS, SIM_DEFAULT_VNODES, SIM_DEFAULT_OPERATIONS, SIM_DEFAULT_KEYS, 0,
+                             SIM_DEFAULT_VALUE_SIZE, SIM_DEFAULT_VALUE_SIZE, SIM_DEFAULT_GET_RATIO, 0, 0,
+                             SIM_DEFAULT_DELAY_MS, 0, 0, 0, 0, SIM_DEFAULT_PORT, NULL, 1, no_server_options};
+    M_EXIT_IF(!parse_options(options_argv, &options), ERR_BAD_PARAMETER, "pps-sim", "%s", USAGE);
+    M_EXIT_IF(options.base_port + (int) options.nb_servers > SIM_EPHEMERAL_FIRST, ERR_BAD_PARAMETER, "pps-sim",
+              "the ports of the servers must be below %d", SIM_EPHEMERAL_FIRST);
+
+    server_default_config(&sim.config);
+    M_EXIT_IF(server_parse_config(options.server_argc, options.server_argv, &sim.config) != ERR_NONE,
+              ERR_BAD_PARAMETER, "pps-sim", "%s", "bad server options (see pps-launch-server)");
+
+    static char dir[] = "/tmp/pps-sim-XXXXXX";
+    const char *work_dir = options.dir;
+    if (work_dir == NULL) {
+        work_dir = mkdtemp(dir);
+    } else if (mkdir(work_dir, 0755) == -1 && errno != EEXIST) {
+        work_dir = NULL;
+    }
+    M_EXIT_IF(work_dir == NULL || chdir(work_dir) == -1, ERR_IO, "pps-sim", "%s", "cannot create the directory");
+    M_EXIT_IF(write_servers_file(&options) != ERR_NONE, ERR_IO, "pps-sim", "%s", "cannot write the servers file");
+
+    sim.now       = SIM_START_MS;
+    sim.state     = (options.seed + 1) * 0xD1B54A32D192ED03ULL;
+    sim.state     = sim.state == 0 ? 1 : sim.state;
+    sim.options   = &options;
+    sim.current   = SIM_CLIENT;
+    sim.next_port = SIM_EPHEMERAL_FIRST;
+    sim.digest    = 0xCBF29CE484222325ULL;
+    //The servers and the client share the generator of the C library
+    srand((unsigned int) options.seed);
+
+    const double wall_start = wall_time_s();
+    error_code error = start_servers(&options);
+    if (error != ERR_NONE) {
+        stop_servers(&options);
+    }
+    M_EXIT_IF_ERR(error, "cannot start the servers");
+
+    client_t client;
+    client_init_args_t init = {&argv, (size_t) argc, SIZE_MAX, TOTAL_SERVERS | PUT_NEEDED | GET_NEEDED, &client};
+    error = client_init(init);
+    if (error != ERR_NONE) {
+        stop_servers(&options);
+    }
+    M_EXIT_IF_ERR(error, "problem while initializing the client");
+
+    workload_t workload;
+    error = workload_init(&workload, options.seed, options.nb_keys, options.theta, options.min_value_size,
+                          options.max_value_size);
+    if (error != ERR_NONE) {
+        client_end(&client);
+        stop_servers(&options);
+    }
+    M_EXIT_IF_ERR(error, "cannot start the workload");
+
+    printf("%zu servers of %zu virtual nodes in %s, N=%zu R=%zu W=%zu, datagrams of %g ms", options.nb_servers,
+           options.vnodes, work_dir, client.args->N, client.args->R, client.args->W, options.delay_ms);
+    if (options.jitter_ms > 0) {
+        printf(" (up to %g ms more)", options.jitter_ms);
+    }
+    printf(", %g%% lost", options.loss * 100);
+    if (options.mtbf_s > 0) {
+        printf(", servers crashing every %g s on average for %g s", options.mtbf_s, options.down_s);
+    }
+    printf(", seed %llu\n", (unsigned long long) options.seed);
+    printf("%zu operations: %zu keys, Zipfian exponent %.2f, values of %zu to %zu bytes, %.0f%% gets\n",
+           options.nb_operations, options.nb_keys, options.theta, options.min_value_size, options.max_value_size,
+           options.get_ratio * 100);
+    fflush(stdout);
+
+    static sim_result_t result;
+    histogram_init(&result.latencies[SIM_GET]);
+    histogram_init(&result.latencies[SIM_PUT]);
+    run_workload(&client, &result, &workload, &options);
+    const double start   = SIM_START_MS;
+    const double seconds = (sim.now - start) / 1000;
+
+    report(&result, seconds);
+    const double wall_s = wall_time_s() - wall_start;
+    printf("%.1f s of virtual time in %.1f s: %llu events (%.0f/s), %llu datagrams sent, %llu lost, %llu unread, "
+           "%llu crashes\n", seconds, wall_s, (unsigned long long) sim.nb_run, (double) sim.nb_run / wall_s,
+           (unsigned long long) sim.nb_sent, (unsigned long long) sim.nb_dropped, (unsigned long long) sim.nb_unread,
+           (unsigned long long) sim.nb_crashes);
+    printf("digest %016llx\n", (unsigned long long) sim.digest);
+
+    workload_end(&workload);
+    client_end(&client);
+    stop_servers(&options);
+
+    return ERR_NONE;
+}
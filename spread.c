@@ -0,0 +1,40 @@
+/**
+ * @file spread.c
+ * @brief Implementation of spread.h
+ *
+ */
+
+#include <string.h>
+
+#include "spread.h"
+#include "hash.h"
+
+size_t spread_width(const spread_t *spread, pps_key_t key, size_t n, double now) {
+
+    if (spread == NULL || key == NULL) {
+        return n;
+    }
+
+    const uint64_t hash = fast_hash64(key, strlen(key));
+    const spread_entry_t *entry = &spread->entries[hash % SPREAD_SLOTS];
+
+    return entry->width > n && entry->hash == hash && entry->expires > now ? entry->width : n;
+}
+
+void spread_learn(spread_t *spread, pps_key_t key, size_t width, double now) {
+
+    if (spread == NULL || key == NULL) {
+        return;
+    }
+
+    const uint64_t hash = fast_hash64(key, strlen(key));
+    spread_entry_t *entry = &spread->entries[hash % SPREAD_SLOTS];
+
+    //Only the first replica of a key and the servers holding its copies know it is hot:
+    //the others advertising nothing does not mean it cooled down, the width expires instead
+    if (width > 0) {
+        entry->hash    = hash;
+        entry->width   = width;
+        entry->expires = now + SPREAD_TTL_MS;
+    }
+}
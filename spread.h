@@ -0,0 +1,59 @@
+#pragma once
+
+/**
+ * @file spread.h
+ * @brief Client memory of the hot keys: the replicas of a hot key answer its plain gets like wide
+ *        gets, advertising how many replicas it currently has (see hotcopies.h), and later reads of
+ *        the key are wide gets to R of them, chosen at random, instead of plain gets to its N replicas.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hashtable.h"
+
+/**
+ * @brief number of hot keys remembered (direct-mapped by key hash)
+ */
+#define SPREAD_SLOTS 256
+
+/**
+ * @brief an advertised width is forgotten after this long: servers stop copying a key
+ *        a few periods after it cools down
+ */
+#define SPREAD_TTL_MS 2000
+
+/**
+ * @brief a remembered hot key
+ */
+typedef struct {
+    uint64_t hash;
+    size_t width;             // 0 if the slot is free
+    double expires;
+} spread_entry_t;
+
+/**
+ * @brief the hot keys of a client
+ */
+typedef struct {
+    spread_entry_t entries[SPREAD_SLOTS];
+} spread_t;
+
+/**
+ * @brief number of replicas to read a key from
+ * @param spread the hot keys
+ * @param key the key
+ * @param n number of replicas of a key that is not hot
+ * @param now current time (get_time_ms)
+ * @return the advertised width of the key if it is larger than n, n otherwise
+ */
+size_t spread_width(const spread_t *spread, pps_key_t key, size_t n, double now);
+
+/**
+ * @brief remember the width a server advertised for a key
+ * @param spread the hot keys
+ * @param key the key
+ * @param width the advertised width, 0 (ignored) if the server does not know the key as hot
+ * @param now current time
+ */
+void spread_learn(spread_t *spread, pps_key_t key, size_t width, double now);
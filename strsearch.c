@@ -0,0 +1,142 @@
+/**
+ * @file strsearch.c
+ * @brief Implementation of strsearch.h
+ *
+ * The vectorized kernels follow the "generic SIMD" algorithm of W. Muła: for each block of
+ * positions, compare the block starting there with the first byte of the needle and the block
+ * starting m - 1 bytes further with its last byte, and only check the candidates where both match.
+ */
+
+#include <string.h>
+
+#include "strsearch.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define STRSEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+//Check a candidate position found by the filter (its first and last bytes already match):
+//a byte loop, as most candidates differ at once and a call to memcmp costs more than that
+static inline int match_middle(const char *position, const char *needle, size_t m) {
+    for (size_t j = 1; j + 1 < m; ++j) {
+        if (position[j] != needle[j]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+const char *str_search_scalar(const char *haystack, size_t n, const char *needle, size_t m) {
+
+    if (m == 0) {
+        return haystack;
+    }
+    if (m > n) {
+        return NULL;
+    }
+
+    const char *end = haystack + n - m + 1;
+    for (const char *p = haystack; p < end; ++p) {
+        p = memchr(p, needle[0], (size_t) (end - p));
+        if (p == NULL) {
+            return NULL;
+        }
+        if (p[m - 1] == needle[m - 1] && match_middle(p, needle, m)) {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+#ifdef STRSEARCH_X86
+
+const char *str_search_sse2(const char *haystack, size_t n, const char *needle, size_t m) {
+
+    if (m < 2 || m > n) {
+        return str_search_scalar(haystack, n, needle, m);
+    }
+
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last  = _mm_set1_epi8(needle[m - 1]);
+
+    //Blocks of 16 positions, as long as the block of their last bytes is in the haystack
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        const __m128i block_first = _mm_loadu_si128((const __m128i *) (haystack + i));
+        const __m128i block_last  = _mm_loadu_si128((const __m128i *) (haystack + i + m - 1));
+        unsigned mask = (unsigned) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+                                                                   _mm_cmpeq_epi8(last, block_last)));
+        while (mask != 0) {
+            const unsigned bit = (unsigned) __builtin_ctz(mask);
+            if (match_middle(haystack + i + bit, needle, m)) {
+                return haystack + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    //Remaining positions
+    return str_search_scalar(haystack + i, n - i, needle, m);
+}
+
+__attribute__((target("avx2")))
+static const char *search_avx2(const char *haystack, size_t n, const char *needle, size_t m) {
+
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last  = _mm256_set1_epi8(needle[m - 1]);
+
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        const __m256i block_first = _mm256_loadu_si256((const __m256i *) (haystack + i));
+        const __m256i block_last  = _mm256_loadu_si256((const __m256i *) (haystack + i + m - 1));
+        unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, block_first),
+                                                                         _mm256_cmpeq_epi8(last, block_last)));
+        while (mask != 0) {
+            const unsigned bit = (unsigned) __builtin_ctz(mask);
+            if (match_middle(haystack + i + bit, needle, m)) {
+                return haystack + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return str_search_sse2(haystack + i, n - i, needle, m);
+}
+
+int str_search_has_avx2(void) {
+    static int has_avx2 = -1;
+    if (has_avx2 == -1) {
+        __builtin_cpu_init();
+        has_avx2 = __builtin_cpu_supports("avx2") != 0;
+    }
+    return has_avx2;
+}
+
+const char *str_search_avx2(const char *haystack, size_t n, const char *needle, size_t m) {
+    if (m < 2 || m > n || !str_search_has_avx2()) {
+        return str_search_sse2(haystack, n, needle, m);
+    }
+    return search_avx2(haystack, n, needle, m);
+}
+
+#else
+
+const char *str_search_sse2(const char *haystack, size_t n, const char *needle, size_t m) {
+    return str_search_scalar(haystack, n, needle, m);
+}
+
+int str_search_has_avx2(void) {
+    return 0;
+}
+
+const char *str_search_avx2(const char *haystack, size_t n, const char *needle, size_t m) {
+    return str_search_scalar(haystack, n, needle, m);
+}
+
+#endif
+
+const char *str_search(const char *haystack, size_t n, const char *needle, size_t m) {
+    return str_search_avx2(haystack, n, needle, m);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+/**
+ * @file strsearch.h
+ * @brief Substring search kernel for the values of the DHT (up to MAX_MSG_ELEM_SIZE bytes).
+ *        The vectorized versions compare the first and the last byte of the needle with 16
+ *        (SSE2) or 32 (AVX2) positions of the haystack at once, and only compare the rest of
+ *        the needle where both match.
+ */
+
+#include <stddef.h>
+
+/**
+ * @brief position of the first occurrence of a needle in a haystack, with the best kernel
+ *        the processor supports
+ * @param haystack where to search
+ * @param n length of the haystack
+ * @param needle what to search
+ * @param m length of the needle
+ * @return the position of the needle, haystack if m is 0, NULL if it does not occur
+ */
+const char *str_search(const char *haystack, size_t n, const char *needle, size_t m);
+
+/**
+ * @brief the kernels behind str_search, with the same interface, for benchmarks:
+ *        the vectorized ones fall back to the scalar one where they are not available
+ */
+const char *str_search_scalar(const char *haystack, size_t n, const char *needle, size_t m);
+const char *str_search_sse2(const char *haystack, size_t n, const char *needle, size_t m);
+const char *str_search_avx2(const char *haystack, size_t n, const char *needle, size_t m);
+
+/**
+ * @brief whether str_search_avx2 really uses AVX2 on this processor
+ * @return 1 if it does, 0 otherwise
+ */
+int str_search_has_avx2(void);
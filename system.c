@@ -5,7 +5,10 @@
  * @author Luis D. Pedrosa
  */
 
+#define _POSIX_C_SOURCE 200809L // for clock_gettime
+
 #include <string.h> // for memset
+#include <time.h> // for clock_gettime
 #include <sys/socket.h> // for sockets
 #include <netinet/in.h> // for IPPROTO_UDP
 #include <sys/time.h> // for struct timeval
@@ -34,6 +37,29 @@ int get_socket(time_t t)
     return fd;
 }
 
+// ======================================================================
+error_code set_receive_timeout_ms(int socket, long t)
+{
+    M_REQUIRE(t >= 0, ERR_BAD_PARAMETER, "negative timeout %ld", t);
+
+    struct timeval timeout;
+    memset(&timeout, 0, sizeof(timeout));
+    timeout.tv_sec  = t / 1000;
+    timeout.tv_usec = (t % 1000) * 1000;
+    if (setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == -1)
+        return ERR_NETWORK;
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+double get_time_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec * 1e3 + (double) now.tv_nsec * 1e-6;
+}
+
 // ======================================================================
 error_code get_server_addr(const char *ip, uint16_t port, struct sockaddr_in *p_server_addr)
 {
@@ -20,6 +20,20 @@
  */
 int get_socket(time_t receive_timeout_in_seconds);
 
+/**
+ * @brief set the reception timeout of a socket with a millisecond precision
+ * @param socket the socket
+ * @param timeout_in_ms receive timeout in milliseconds, 0 means infinity (no timeout)
+ * @return an error code != ERR_NONE if anything went wrong
+ */
+error_code set_receive_timeout_ms(int socket, long timeout_in_ms);
+
+/**
+ * @brief monotonic clock, for timeouts and rates
+ * @return the current time in milliseconds
+ */
+double get_time_ms(void);
+
 /**
  * @brief transform server human-format address to internal format
  * @param ip IP address to connect to
@@ -6,16 +6,465 @@
  * @date 02 Oct 2017
  */
 
-#include <stdio.h> // for puts(). to be removed when no longer needed.
+#include <stdio.h>
+#include <stdint.h> // for SIZE_MAX
+#include <string.h>
 
 #include <check.h>
 
 #include "tests.h"
 #include "hashtable.h"
+#include "util.h"
+
+#define NB_WALK_KEYS 40
+
+//The keys visited, each followed by a space
+typedef struct {
+    char text[1024];
+    size_t count;
+} keys_t;
+
+static void collect_key(const kv_pair_t *pair, void *arg) {
+    keys_t *keys = arg;
+    strcat(keys->text, pair->key);
+    strcat(keys->text, " ");
+    ++keys->count;
+}
+
+static const char *range_keys(Htable_t table, pps_key_t prefix, pps_key_t after, size_t limit, keys_t *keys) {
+    memset(keys, 0, sizeof(*keys));
+    ck_assert_err_none(range_Htable(table, prefix, after, limit, collect_key, keys));
+    return keys->text;
+}
+
+static void add_keys(Htable_t table, const char *const *keys, size_t nb_keys) {
+    for (size_t i = 0; i < nb_keys; ++i) {
+        ck_assert_err_none(add_Htable_value(table, keys[i], keys[i]));
+    }
+}
+
+static void assert_value(Htable_t table, pps_key_t key, const char *expected) {
+    pps_value_t value = get_Htable_value(table, key);
+    if (expected == NULL) {
+        ck_assert_ptr_null(value);
+    } else {
+        ck_assert_ptr_nonnull(value);
+        ck_assert_str_eq(value, expected);
+    }
+    free_const_ptr(value);
+}
+
+//A walk of visit_Htable_from: how many times each key of walk_key was visited, at most limit per call
+typedef struct {
+    size_t seen[NB_WALK_KEYS];
+    size_t limit;
+    size_t visited;
+    char last[8];             // the last key visited, the keys come in order
+} walk_t;
+
+static void walk_key(char *key, size_t i) {
+    snprintf(key, 8, "k%02zu", i);
+}
+
+static int count_visit(const kv_pair_t *pair, void *arg) {
+    walk_t *walk = arg;
+    if (walk->visited == walk->limit) {
+        return 0;
+    }
+    size_t i = 0;
+    ck_assert_int_eq(sscanf(pair->key, "k%zu", &i), 1);
+    ck_assert_uint_lt(i, NB_WALK_KEYS);
+    ck_assert_int_gt(strcmp(pair->key, walk->last), 0);
+    strcpy(walk->last, pair->key);
+    ++walk->seen[i];
+    ++walk->visited;
+    return 1;
+}
+
+//Resume a walk for at most limit pairs, keeping the key to resume after in a buffer of its own,
+//and tell whether every pair is visited
+static int walk_step(Htable_t table, char *after, size_t limit, walk_t *walk) {
+    pps_key_t from = after;
+    walk->limit   = limit;
+    walk->visited = 0;
+    ck_assert_err_none(visit_Htable_from(table, &from, count_visit, walk));
+    if (from == NULL) {
+        return 1;
+    }
+    if (from != after) {
+        strcpy(after, from);
+    }
+    return 0;
+}
 
 START_TEST(add_value_does_retrieve_same_value)
 {
-    puts("Ecrivez ici vos tests et SUPPRIMEZ ce puts");
+    Htable_t table = construct_Htable(HTABLE_SIZE);
+    ck_assert_ptr_nonnull(table);
+
+    ck_assert_err_none(add_Htable_value(table, "key", "value"));
+    assert_value(table, "key", "value");
+
+    ck_assert_err_none(add_Htable_value(table, "key", "other"));
+    assert_value(table, "key", "other");
+
+    ck_assert_err_none(add_Htable_value(table, "", "empty"));
+    assert_value(table, "", "empty");
+    assert_value(table, "missing", NULL);
+
+    delete_Htable_and_content(&table);
+    ck_assert_ptr_null(table);
+}
+END_TEST
+
+START_TEST(get_matches_whole_keys)
+{
+    //A single bucket: the keys are told apart by the comparison only
+    Htable_t table = construct_Htable(1);
+    ck_assert_ptr_nonnull(table);
+
+    ck_assert_err_none(add_Htable_value(table, "abc", "long"));
+    assert_value(table, "ab", NULL);
+    assert_value(table, "abcd", NULL);
+
+    ck_assert_err_none(add_Htable_value(table, "ab", "short"));
+    assert_value(table, "ab", "short");
+    assert_value(table, "abc", "long");
+
+    delete_Htable_and_content(&table);
+}
+END_TEST
+
+START_TEST(delete_keeps_the_rest_of_the_bucket)
+{
+    Htable_t table = construct_Htable(1);
+    ck_assert_ptr_nonnull(table);
+    const char *keys[] = { "a", "b", "c", "d" };
+    add_keys(table, keys, 4);
+
+    //"d" was added last, at the head of the bucket
+    ck_assert_err_none(del_Htable_key(table, "d"));
+    assert_value(table, "d", NULL);
+    assert_value(table, "a", "a");
+    assert_value(table, "b", "b");
+    assert_value(table, "c", "c");
+
+    //The middle and the tail
+    ck_assert_err_none(del_Htable_key(table, "b"));
+    ck_assert_err_none(del_Htable_key(table, "a"));
+    assert_value(table, "b", NULL);
+    assert_value(table, "a", NULL);
+    assert_value(table, "c", "c");
+
+    //Absent keys
+    ck_assert_err_none(del_Htable_key(table, "a"));
+    ck_assert_err_none(del_Htable_key(table, "cc"));
+    assert_value(table, "c", "c");
+
+    //The last one, then again
+    ck_assert_err_none(del_Htable_key(table, "c"));
+    assert_value(table, "c", NULL);
+    ck_assert_err_none(add_Htable_value(table, "c", "again"));
+    assert_value(table, "c", "again");
+
+    delete_Htable_and_content(&table);
+}
+END_TEST
+
+START_TEST(delete_frees_every_node)
+{
+    //Run under valgrind: the deleted nodes and the table leave nothing behind
+    Htable_t table = construct_Htable(4);
+    ck_assert_ptr_nonnull(table);
+    char key[8];
+    for (size_t round = 0; round < 3; ++round) {
+        for (size_t i = 0; i < NB_WALK_KEYS; ++i) {
+            walk_key(key, i);
+            ck_assert_err_none(add_Htable_value(table, key, key));
+        }
+        for (size_t i = 0; i < NB_WALK_KEYS; i += 2) {
+            walk_key(key, i);
+            ck_assert_err_none(del_Htable_key(table, key));
+        }
+    }
+    for (size_t i = 0; i < NB_WALK_KEYS; ++i) {
+        walk_key(key, i);
+        assert_value(table, key, i % 2 == 0 ? NULL : key);
+    }
+
+    delete_Htable_and_content(&table);
+    ck_assert_ptr_null(table);
+}
+END_TEST
+
+START_TEST(index_keeps_keys_in_order)
+{
+    Htable_t table = construct_ordered_Htable(HTABLE_SIZE);
+    ck_assert_ptr_nonnull(table);
+    keys_t keys;
+    ck_assert_str_eq(range_keys(table, "", NULL, SIZE_MAX, &keys), "");
+
+    const char *added[] = { "m", "b", "ba", "z", "", "a", "bab", "y", "\x7f", "\xc3\xa9" };
+    add_keys(table, added, 10);
+    ck_assert_str_eq(range_keys(table, "", NULL, SIZE_MAX, &keys), " a b ba bab m y z \x7f \xc3\xa9 ");
+    ck_assert_uint_eq(keys.count, 10);
+
+    //An update is not a new key
+    ck_assert_err_none(add_Htable_value(table, "ba", "new"));
+    ck_assert_str_eq(range_keys(table, "b", NULL, SIZE_MAX, &keys), "b ba bab ");
+
+    const char *deleted[] = { "ba", "", "z", "missing" };
+    for (size_t i = 0; i < 4; ++i) {
+        ck_assert_err_none(del_Htable_key(table, deleted[i]));
+    }
+    ck_assert_str_eq(range_keys(table, "", NULL, SIZE_MAX, &keys), "a b bab m y \x7f \xc3\xa9 ");
+
+    delete_Htable_and_content(&table);
+}
+END_TEST
+
+START_TEST(range_of_a_prefix)
+{
+    Htable_t table = construct_ordered_Htable(HTABLE_SIZE);
+    ck_assert_ptr_nonnull(table);
+    const char *added[] = { "a", "ab", "abc", "abd", "abda", "ac", "b" };
+    add_keys(table, added, 7);
+    keys_t keys;
+
+    //The prefix is a key itself
+    ck_assert_str_eq(range_keys(table, "ab", NULL, SIZE_MAX, &keys), "ab abc abd abda ");
+    ck_assert_str_eq(range_keys(table, "abd", NULL, SIZE_MAX, &keys), "abd abda ");
+    ck_assert_str_eq(range_keys(table, "abc", NULL, SIZE_MAX, &keys), "abc ");
+    ck_assert_str_eq(range_keys(table, "b", NULL, SIZE_MAX, &keys), "b ");
+
+    //It is not: the keys after it, or none
+    ck_assert_str_eq(range_keys(table, "abb", NULL, SIZE_MAX, &keys), "");
+    ck_assert_str_eq(range_keys(table, "abe", NULL, SIZE_MAX, &keys), "");
+    ck_assert_str_eq(range_keys(table, "0", NULL, SIZE_MAX, &keys), "");
+    ck_assert_str_eq(range_keys(table, "c", NULL, SIZE_MAX, &keys), "");
+    ck_assert_str_eq(range_keys(table, "abdab", NULL, SIZE_MAX, &keys), "");
+    ck_assert_err_none(del_Htable_key(table, "ab"));
+    ck_assert_str_eq(range_keys(table, "ab", NULL, SIZE_MAX, &keys), "abc abd abda ");
+
+    ck_assert_str_eq(range_keys(table, "ab", NULL, 2, &keys), "abc abd ");
+    ck_assert_str_eq(range_keys(table, "ab", NULL, 0, &keys), "");
+
+    delete_Htable_and_content(&table);
+}
+END_TEST
+
+START_TEST(range_goes_on_after_a_key)
+{
+    Htable_t table = construct_ordered_Htable(HTABLE_SIZE);
+    ck_assert_ptr_nonnull(table);
+    const char *added[] = { "p", "p1", "p2", "p3", "p4", "p5", "q" };
+    add_keys(table, added, 7);
+    keys_t keys;
+
+    //Pages of two keys, each one after the last key of the previous one
+    ck_assert_str_eq(range_keys(table, "p", NULL, 2, &keys), "p p1 ");
+    ck_assert_str_eq(range_keys(table, "p", "p1", 2, &keys), "p2 p3 ");
+
+    //A key added before the next page is in it, one deleted is not
+    ck_assert_err_none(add_Htable_value(table, "p35", "x"));
+    ck_assert_err_none(del_Htable_key(table, "p4"));
+    ck_assert_str_eq(range_keys(table, "p", "p3", 2, &keys), "p35 p5 ");
+    ck_assert_str_eq(range_keys(table, "p", "p5", 2, &keys), "");
+
+    //After a key that is no longer there, or is outside the prefix
+    ck_assert_str_eq(range_keys(table, "p", "p4", 2, &keys), "p5 ");
+    ck_assert_str_eq(range_keys(table, "p", "a", 2, &keys), "p p1 ");
+    ck_assert_str_eq(range_keys(table, "p", "pz", 2, &keys), "");
+    ck_assert_str_eq(range_keys(table, "", "p5", 5, &keys), "q ");
+
+    delete_Htable_and_content(&table);
+}
+END_TEST
+
+START_TEST(delete_the_root_and_the_last_key)
+{
+    Htable_t table = construct_ordered_Htable(HTABLE_SIZE);
+    ck_assert_ptr_nonnull(table);
+    keys_t keys;
+
+    //A single key is the root of the index
+    ck_assert_err_none(add_Htable_value(table, "only", "v"));
+    ck_assert_str_eq(range_keys(table, "", NULL, SIZE_MAX, &keys), "only ");
+    ck_assert_err_none(del_Htable_key(table, "only"));
+    ck_assert_str_eq(range_keys(table, "", NULL, SIZE_MAX, &keys), "");
+    ck_assert_str_eq(range_keys(table, "only", NULL, SIZE_MAX, &keys), "");
+    ck_assert_err_none(del_Htable_key(table, "only"));
+
+    //The inner root goes when one side does
+    const char *added[] = { "a", "b", "c" };
+    add_keys(table, added, 3);
+    ck_assert_err_none(del_Htable_key(table, "a"));
+    ck_assert_str_eq(range_keys(table, "", NULL, SIZE_MAX, &keys), "b c ");
+    ck_assert_err_none(del_Htable_key(table, "c"));
+    ck_assert_str_eq(range_keys(table, "", NULL, SIZE_MAX, &keys), "b ");
+    ck_assert_err_none(del_Htable_key(table, "b"));
+    ck_assert_str_eq(range_keys(table, "", NULL, SIZE_MAX, &keys), "");
+
+    add_keys(table, added, 3);
+    ck_assert_str_eq(range_keys(table, "", NULL, SIZE_MAX, &keys), "a b c ");
+
+    delete_Htable_and_content(&table);
+}
+END_TEST
+
+START_TEST(delete_an_ordered_table)
+{
+    //Run under valgrind: the inner nodes of the index go with the table
+    Htable_t table = construct_ordered_Htable(HTABLE_SIZE);
+    ck_assert_ptr_nonnull(table);
+    char key[8];
+    for (size_t i = 0; i < NB_WALK_KEYS; ++i) {
+        walk_key(key, NB_WALK_KEYS - 1 - i);
+        ck_assert_err_none(add_Htable_value(table, key, key));
+    }
+    keys_t keys;
+    range_keys(table, "k", NULL, SIZE_MAX, &keys);
+    ck_assert_uint_eq(keys.count, NB_WALK_KEYS);
+    ck_assert_str_eq(range_keys(table, "k", NULL, 3, &keys), "k00 k01 k02 ");
+
+    delete_Htable_and_content(&table);
+    ck_assert_ptr_null(table);
+
+    //Empty too
+    table = construct_ordered_Htable(HTABLE_SIZE);
+    ck_assert_ptr_nonnull(table);
+    delete_Htable_and_content(&table);
+    ck_assert_ptr_null(table);
+}
+END_TEST
+
+START_TEST(range_needs_an_index)
+{
+    Htable_t table = construct_Htable(HTABLE_SIZE);
+    ck_assert_ptr_nonnull(table);
+    keys_t keys;
+    memset(&keys, 0, sizeof(keys));
+    ck_assert_bad_param(range_Htable(table, "", NULL, SIZE_MAX, collect_key, &keys));
+    ck_assert_bad_param(range_Htable(NULL, "", NULL, SIZE_MAX, collect_key, &keys));
+    delete_Htable_and_content(&table);
+}
+END_TEST
+
+START_TEST(visit_every_pair_of_a_bucket)
+{
+    Htable_t table = construct_Htable(1);
+    ck_assert_ptr_nonnull(table);
+    keys_t keys;
+    memset(&keys, 0, sizeof(keys));
+    ck_assert_err_none(visit_Htable_bucket(table, 0, collect_key, &keys));
+    ck_assert_uint_eq(keys.count, 0);
+
+    const char *added[] = { "x", "y", "z" };
+    add_keys(table, added, 3);
+    ck_assert_err_none(visit_Htable_bucket(table, 0, collect_key, &keys));
+    ck_assert_uint_eq(keys.count, 3);
+    ck_assert_ptr_nonnull(strstr(keys.text, "x "));
+    ck_assert_ptr_nonnull(strstr(keys.text, "y "));
+    ck_assert_ptr_nonnull(strstr(keys.text, "z "));
+
+    ck_assert_bad_param(visit_Htable_bucket(table, 1, collect_key, &keys));
+    ck_assert_bad_param(visit_Htable_bucket(table, 0, NULL, &keys));
+    delete_Htable_and_content(&table);
+}
+END_TEST
+
+START_TEST(walk_visits_every_pair_once)
+{
+    Htable_t table = construct_ordered_Htable(4);
+    ck_assert_ptr_nonnull(table);
+    char key[8];
+    for (size_t i = 0; i < NB_WALK_KEYS; ++i) {
+        walk_key(key, i);
+        ck_assert_err_none(add_Htable_value(table, key, key));
+    }
+
+    //In one go
+    walk_t walk;
+    memset(&walk, 0, sizeof(walk));
+    pps_key_t after = "";
+    walk.limit = SIZE_MAX;
+    ck_assert_err_none(visit_Htable_from(table, &after, count_visit, &walk));
+    ck_assert_ptr_null(after);
+    for (size_t i = 0; i < NB_WALK_KEYS; ++i) {
+        ck_assert_uint_eq(walk.seen[i], 1);
+    }
+
+    //Three pairs at a time, each step after the last key of the previous one
+    memset(&walk, 0, sizeof(walk));
+    char from[8] = "";
+    size_t nb_steps = 0;
+    while (!walk_step(table, from, 3, &walk)) {
+        ck_assert_str_eq(from, walk.last);
+        ck_assert_uint_le(++nb_steps, NB_WALK_KEYS);
+    }
+    for (size_t i = 0; i < NB_WALK_KEYS; ++i) {
+        ck_assert_uint_eq(walk.seen[i], 1);
+    }
+
+    //Nothing past the end
+    walk_key(from, NB_WALK_KEYS - 1);
+    ck_assert_int_eq(walk_step(table, from, 3, &walk), 1);
+    ck_assert_uint_eq(walk.visited, 0);
+
+    ck_assert_bad_param(visit_Htable_from(table, NULL, count_visit, &walk));
+    after = NULL;
+    ck_assert_bad_param(visit_Htable_from(table, &after, count_visit, &walk));
+    delete_Htable_and_content(&table);
+
+    //The walk needs the index
+    table = construct_Htable(4);
+    ck_assert_ptr_nonnull(table);
+    after = "";
+    ck_assert_bad_param(visit_Htable_from(table, &after, count_visit, &walk));
+    delete_Htable_and_content(&table);
+}
+END_TEST
+
+START_TEST(walk_resumes_after_changes)
+{
+    Htable_t table = construct_ordered_Htable(2);
+    ck_assert_ptr_nonnull(table);
+    char key[8];
+    for (size_t i = 0; i < NB_WALK_KEYS; i += 2) {
+        walk_key(key, i);
+        ck_assert_err_none(add_Htable_value(table, key, key));
+    }
+
+    //Between two steps, the pair the walk stopped after goes, other pairs come and go
+    walk_t walk;
+    memset(&walk, 0, sizeof(walk));
+    char from[8] = "";
+    size_t next_odd = 1;
+    while (!walk_step(table, from, 2, &walk)) {
+        if (from[0] != '\0') {
+            ck_assert_err_none(del_Htable_key(table, from));
+        }
+        if (next_odd < NB_WALK_KEYS) {
+            walk_key(key, next_odd);
+            ck_assert_err_none(add_Htable_value(table, key, key));
+            if (next_odd > 2) {
+                walk_key(key, next_odd - 2);
+                ck_assert_err_none(del_Htable_key(table, key));
+            }
+            next_odd += 2;
+        }
+    }
+
+    //The even keys were there all along: each one once; the odd ones at most once
+    for (size_t i = 0; i < NB_WALK_KEYS; ++i) {
+        if (i % 2 == 0) {
+            ck_assert_uint_eq(walk.seen[i], 1);
+        } else {
+            ck_assert_uint_le(walk.seen[i], 1);
+        }
+    }
+
+    delete_Htable_and_content(&table);
 }
 END_TEST
 
@@ -28,6 +477,26 @@ Suite *hashtable_suite()
     suite_add_tcase(s, tc_ht);
 
     tcase_add_test(tc_ht, add_value_does_retrieve_same_value);
+    tcase_add_test(tc_ht, get_matches_whole_keys);
+    tcase_add_test(tc_ht, delete_keeps_the_rest_of_the_bucket);
+    tcase_add_test(tc_ht, delete_frees_every_node);
+
+    TCase *tc_index = tcase_create("ordered index");
+    suite_add_tcase(s, tc_index);
+
+    tcase_add_test(tc_index, index_keeps_keys_in_order);
+    tcase_add_test(tc_index, range_of_a_prefix);
+    tcase_add_test(tc_index, range_goes_on_after_a_key);
+    tcase_add_test(tc_index, delete_the_root_and_the_last_key);
+    tcase_add_test(tc_index, delete_an_ordered_table);
+    tcase_add_test(tc_index, range_needs_an_index);
+
+    TCase *tc_visit = tcase_create("walks");
+    suite_add_tcase(s, tc_visit);
+
+    tcase_add_test(tc_visit, visit_every_pair_of_a_bucket);
+    tcase_add_test(tc_visit, walk_visits_every_pair_once);
+    tcase_add_test(tc_visit, walk_resumes_after_changes);
 
     return s;
 }
@@ -0,0 +1,425 @@
+/**
+ * @file pps-trace.c
+ * @brief read the binary packet traces of log-packets.so (see trace_format.h).
+ *        Usage: pps-trace decode file...
+ *               pps-trace latency file...
+ *               pps-trace replay [-x speed] file...
+ *        decode prints the datagrams of the traces in time order. latency reports, per server of
+ *        the servers file, the time between a request of a client and its reply, as the client
+ *        saw them (the clients must be traced as well): replies to PPS_OP_GET_SEQ and
+ *        PPS_OP_PUT_BATCH are matched with their sequence numbers, the others with the oldest
+ *        request not yet answered between the same client and server. replay sends the requests
+ *        of the clients again to the same servers, from one socket, at their original times (speed
+ *        times faster with -x), and reports their latencies the same way. A request longer than
+ *        its record is sent with its missing bytes as 'x'.
+ *
+ */
+
+#define _GNU_SOURCE // for inet_ntop
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "config.h"
+#include "error.h"
+#include "system.h"
+#include "node_list.h"
+#include "histogram.h"
+#include "trace_format.h"
+
+#define USAGE "usage: pps-trace decode file... | latency file... | replay [-x speed] file..."
+
+/**
+ * @brief a request not answered after this long is counted as lost
+ */
+#define TRACE_MATCH_TIMEOUT_MS 2000
+
+#define TRACE_MAX_SERVERS 256
+#define TRACE_REPLAY_BUFFER_SIZE (16 * 1024 * 1024)
+
+/**
+ * @brief records of traces, in time order
+ */
+typedef struct {
+    trace_record_t *records;
+    size_t size;
+    size_t allocated;
+} trace_t;
+
+/**
+ * @brief the distinct addresses of the servers file
+ */
+typedef struct {
+    uint32_t ip[TRACE_MAX_SERVERS];
+    uint16_t port[TRACE_MAX_SERVERS];
+    size_t size;
+} servers_t;
+
+/**
+ * @brief a request waiting for its reply
+ */
+typedef struct {
+    uint32_t client_ip;
+    uint16_t client_port;
+    size_t server;
+    int64_t seq;              // -1 for a request without sequence number
+    uint64_t t_ns;
+    int answered;
+} pending_t;
+
+/**
+ * @brief requests and latencies of a server
+ */
+typedef struct {
+    uint64_t requests;
+    histogram_t latencies;    // in microseconds
+} server_stats_t;
+
+static error_code trace_add(trace_t *trace, const trace_record_t *record) {
+    if (trace->size == trace->allocated) {
+        const size_t allocated = trace->allocated == 0 ? 1024 : 2 * trace->allocated;
+        trace_record_t *records = realloc(trace->records, allocated * sizeof(trace_record_t));
+        M_REQUIRE_NON_NULL_CUSTOM_ERR(records, ERR_NOMEM);
+        trace->records   = records;
+        trace->allocated = allocated;
+    }
+    trace->records[trace->size++] = *record;
+    return ERR_NONE;
+}
+
+//Add the records of a trace file, oldest first
+static error_code trace_load(trace_t *trace, const char *path) {
+
+    FILE *file = fopen(path, "rb");
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(file, ERR_IO);
+    trace_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0
+        || header.record_size != sizeof(trace_record_t) || header.capacity == 0) {
+        fclose(file);
+        return ERR_IO;
+    }
+
+    const uint64_t first = header.head > header.capacity ? header.head - header.capacity : 0;
+    error_code error = ERR_NONE;
+    trace_record_t record;
+    for (uint64_t i = first; i < header.head && error == ERR_NONE; ++i) {
+        const long offset = (long) (sizeof(header) + (i % header.capacity) * sizeof(record));
+        if (fseek(file, offset, SEEK_SET) != 0 || fread(&record, sizeof(record), 1, file) != 1) {
+            error = ERR_IO;
+        } else {
+            error = trace_add(trace, &record);
+        }
+    }
+    fclose(file);
+    return error;
+}
+
+static int by_time(const void *a, const void *b) {
+    const uint64_t ta = ((const trace_record_t *) a)->t_ns;
+    const uint64_t tb = ((const trace_record_t *) b)->t_ns;
+    return ta < tb ? -1 : ta > tb;
+}
+
+static error_code load_all(trace_t *trace, char **paths) {
+    for (; *paths != NULL; ++paths) {
+        error_code error = trace_load(trace, *paths);
+        if (error != ERR_NONE) {
+            fprintf(stderr, "%s is not a trace of log-packets.so\n", *paths);
+            return error;
+        }
+    }
+    qsort(trace->records, trace->size, sizeof(trace_record_t), by_time);
+    return ERR_NONE;
+}
+
+static error_code load_servers(servers_t *servers) {
+    //Only the addresses are used: the cheapest hash
+    node_list_t *nodes = get_nodes(RING_HASH_FAST);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(nodes, ERR_IO);
+    servers->size = 0;
+    for (size_t i = 0; i < nodes->size; ++i) {
+        const struct sockaddr_in *addr = (const struct sockaddr_in *) &nodes->nodes[i].addr;
+        size_t k = 0;
+        while (k < servers->size && (servers->ip[k] != addr->sin_addr.s_addr || servers->port[k] != addr->sin_port)) {
+            ++k;
+        }
+        if (k == servers->size && k < TRACE_MAX_SERVERS) {
+            servers->ip[k]   = addr->sin_addr.s_addr;
+            servers->port[k] = addr->sin_port;
+            ++servers->size;
+        }
+    }
+    node_list_free(nodes);
+    return ERR_NONE;
+}
+
+//Index of a server, servers->size if the address is not one
+static size_t server_index(const servers_t *servers, uint32_t ip, uint16_t port) {
+    size_t k = 0;
+    while (k < servers->size && (servers->ip[k] != ip || servers->port[k] != port)) {
+        ++k;
+    }
+    return k;
+}
+
+static const char *address(uint32_t ip, uint16_t port, char *out, size_t size) {
+    char str[INET_ADDRSTRLEN];
+    struct in_addr in = {ip};
+    snprintf(out, size, "%s:%d", inet_ntop(AF_INET, &in, str, sizeof(str)), ntohs(port));
+    return out;
+}
+
+static void decode(const trace_t *trace) {
+
+    const uint64_t t0 = trace->size > 0 ? trace->records[0].t_ns : 0;
+    for (size_t i = 0; i < trace->size; ++i) {
+        const trace_record_t *r = &trace->records[i];
+        char src[32], dst[32];
+        printf("%12.3f %-4s %21s -> %-21s %6" PRIu32, (double) (r->t_ns - t0) / 1e6,
+               r->direction == TRACE_SENT ? "send" : "recv", address(r->src_ip, r->src_port, src, sizeof(src)),
+               address(r->dst_ip, r->dst_port, dst, sizeof(dst)), r->length);
+
+        size_t from = 0;
+        if (r->kind == TRACE_EMPTY) {
+            printf(" ping");
+        } else if (r->kind == TRACE_CONTROL) {
+            printf(" op 0x%02X", r->opcode);
+            from = 2;
+        } else {
+            printf(" data");
+        }
+        if (r->captured > from) {
+            putchar(' ');
+            for (size_t k = from; k < r->captured; ++k) {
+                const uint8_t c = r->payload[k];
+                putchar(c >= 0x20 && c < 0x7F ? c : '.');
+            }
+            if (r->captured < r->length) {
+                printf("...");
+            }
+        }
+        putchar('\n');
+    }
+}
+
+//Sequence number of a request or reply, -1 if it has none
+static int64_t sequence(const trace_record_t *r) {
+    if (r->kind != TRACE_CONTROL || (r->opcode != PPS_OP_GET_SEQ && r->opcode != PPS_OP_PUT_BATCH) || r->captured < 6) {
+        return -1;
+    }
+    return (int64_t) ((uint32_t) r->payload[2] << 24 | (uint32_t) r->payload[3] << 16
+                      | (uint32_t) r->payload[4] << 8 | r->payload[5]);
+}
+
+//Match the replies of the servers to the requests of the clients, as the clients saw them
+static error_code measure(const trace_t *trace, const servers_t *servers, server_stats_t *stats) {
+
+    pending_t *pending = calloc(trace->size + 1, sizeof(pending_t));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(pending, ERR_NOMEM);
+    size_t nb_pending = 0;
+    size_t oldest     = 0;
+
+    for (size_t i = 0; i < trace->size; ++i) {
+        const trace_record_t *r = &trace->records[i];
+        const size_t src = server_index(servers, r->src_ip, r->src_port);
+        const size_t dst = server_index(servers, r->dst_ip, r->dst_port);
+
+        if (r->direction == TRACE_SENT && src == servers->size && dst < servers->size) {
+            pending[nb_pending++] = (pending_t) {r->src_ip, r->src_port, dst, sequence(r), r->t_ns, 0};
+            stats[dst].requests += 1;
+            continue;
+        }
+        if (r->direction != TRACE_RECEIVED || src == servers->size || dst < servers->size) {
+            continue;
+        }
+
+        while (oldest < nb_pending && (pending[oldest].answered
+               || r->t_ns - pending[oldest].t_ns > (uint64_t) TRACE_MATCH_TIMEOUT_MS * 1000000)) {
+            ++oldest;
+        }
+        const int64_t seq = sequence(r);
+        for (size_t k = oldest; k < nb_pending; ++k) {
+            pending_t *p = &pending[k];
+            if (!p->answered && p->server == src && p->client_ip == r->dst_ip && p->client_port == r->dst_port
+                && p->seq == seq) {
+                p->answered = 1;
+                histogram_record(&stats[src].latencies, (r->t_ns - p->t_ns) / 1000);
+                break;
+            }
+        }
+    }
+
+    free(pending);
+    return ERR_NONE;
+}
+
+static error_code report_latency(const trace_t *trace, const servers_t *servers) {
+
+    server_stats_t *stats = calloc(servers->size, sizeof(server_stats_t));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(stats, ERR_NOMEM);
+    for (size_t k = 0; k < servers->size; ++k) {
+        histogram_init(&stats[k].latencies);
+    }
+    error_code error = measure(trace, servers, stats);
+
+    printf("%-21s %10s %10s %9s %8s %8s %8s %8s\n", "server", "requests", "answered", "mean_ms", "p50", "p99",
+           "p99.9", "max");
+    for (size_t k = 0; k < servers->size && error == ERR_NONE; ++k) {
+        const histogram_t *h = &stats[k].latencies;
+        char name[32];
+        printf("%-21s %10" PRIu64 " %10" PRIu64 " %9.3f %8.3f %8.3f %8.3f %8.3f\n",
+               address(servers->ip[k], servers->port[k], name, sizeof(name)), stats[k].requests, h->total,
+               histogram_mean(h) / 1000, (double) histogram_percentile(h, 50) / 1000,
+               (double) histogram_percentile(h, 99) / 1000, (double) histogram_percentile(h, 99.9) / 1000,
+               (double) (h->total > 0 ? h->max : 0) / 1000);
+    }
+    free(stats);
+    return error;
+}
+
+//Record a datagram of the replay as log-packets.so would
+static error_code replay_record(trace_t *replayed, trace_direction_t direction, const struct sockaddr_in *local,
+                                const struct sockaddr_in *peer, const char *msg, size_t len) {
+    trace_record_t r;
+    memset(&r, 0, sizeof(r));
+    r.t_ns = (uint64_t) (get_time_ms() * 1e6);
+    const struct sockaddr_in *src = direction == TRACE_SENT ? local : peer;
+    const struct sockaddr_in *dst = direction == TRACE_SENT ? peer : local;
+    r.src_ip    = src->sin_addr.s_addr;
+    r.src_port  = src->sin_port;
+    r.dst_ip    = dst->sin_addr.s_addr;
+    r.dst_port  = dst->sin_port;
+    r.length    = (uint32_t) len;
+    r.captured  = (uint16_t) (len < TRACE_PAYLOAD_SIZE ? len : TRACE_PAYLOAD_SIZE);
+    r.direction = (uint8_t) direction;
+    r.kind      = len == 0 ? TRACE_EMPTY : len >= 2 && msg[0] == '\0' ? TRACE_CONTROL : TRACE_DATA;
+    r.opcode    = r.kind == TRACE_CONTROL ? (uint8_t) msg[1] : 0;
+    memcpy(r.payload, msg, r.captured);
+    return trace_add(replayed, &r);
+}
+
+//Receive the replies arrived within timeout_ms
+static error_code replay_receive(int s, const struct sockaddr_in *local, trace_t *replayed, double timeout_ms) {
+    static char reply[MAX_MSG_SIZE];
+    struct pollfd fd = {s, POLLIN, 0};
+    if (poll(&fd, 1, timeout_ms > 0 ? (int) timeout_ms : 0) <= 0) {
+        return ERR_NONE;
+    }
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    ssize_t len = 0;
+    while ((len = recvfrom(s, reply, sizeof(reply), MSG_DONTWAIT, (struct sockaddr *) &from, &from_len)) >= 0) {
+        error_code error = replay_record(replayed, TRACE_RECEIVED, local, &from, reply, (size_t) len);
+        if (error != ERR_NONE) {
+            return error;
+        }
+        from_len = sizeof(from);
+    }
+    return ERR_NONE;
+}
+
+static error_code replay(const trace_t *trace, const servers_t *servers, double speed) {
+
+    const int s = get_socket(0);
+    M_REQUIRE(s != -1, ERR_NETWORK, "%s", "no socket");
+    //The replies of many clients come to this socket (the system may give less room)
+    int buffer_size = TRACE_REPLAY_BUFFER_SIZE;
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    //Bound by a first datagram: its address is the one of the requests recorded
+    struct sockaddr_in local;
+    socklen_t local_len = sizeof(local);
+    memset(&local, 0, sizeof(local));
+    trace_t replayed = {NULL, 0, 0};
+    static char msg[MAX_MSG_SIZE];
+    size_t nb_sent = 0;
+    size_t nb_truncated = 0;
+    error_code error = ERR_NONE;
+
+    const double start = get_time_ms();
+    uint64_t t0 = 0;
+    for (size_t i = 0; i < trace->size && error == ERR_NONE; ++i) {
+        const trace_record_t *r = &trace->records[i];
+        if (r->direction != TRACE_SENT || server_index(servers, r->src_ip, r->src_port) < servers->size
+            || server_index(servers, r->dst_ip, r->dst_port) == servers->size || r->length > MAX_MSG_SIZE) {
+            continue;
+        }
+        t0 = nb_sent == 0 ? r->t_ns : t0;
+        const double due = start + (double) (r->t_ns - t0) / 1e6 / speed;
+        for (double now = get_time_ms(); now < due && error == ERR_NONE; now = get_time_ms()) {
+            error = replay_receive(s, &local, &replayed, due - now);
+        }
+
+        memcpy(msg, r->payload, r->captured);
+        memset(msg + r->captured, 'x', r->length - r->captured);
+        nb_truncated += r->captured < r->length;
+        struct sockaddr_in server;
+        memset(&server, 0, sizeof(server));
+        server.sin_family      = AF_INET;
+        server.sin_addr.s_addr = r->dst_ip;
+        server.sin_port        = r->dst_port;
+        sendto(s, msg, r->length, 0, (struct sockaddr *) &server, sizeof(server));
+        if (nb_sent++ == 0) {
+            getsockname(s, (struct sockaddr *) &local, &local_len);
+        }
+        if (error == ERR_NONE) {
+            error = replay_record(&replayed, TRACE_SENT, &local, &server, msg, r->length);
+        }
+    }
+    //The last replies
+    const double end = get_time_ms() + TRACE_MATCH_TIMEOUT_MS;
+    for (double now = get_time_ms(); now < end && error == ERR_NONE && nb_sent > 0; now = get_time_ms()) {
+        error = replay_receive(s, &local, &replayed, end - now);
+    }
+
+    if (error == ERR_NONE) {
+        printf("%zu requests replayed in %.3f s (%zu longer than their record, completed with 'x')\n", nb_sent,
+               (get_time_ms() - start - TRACE_MATCH_TIMEOUT_MS) / 1000, nb_truncated);
+        error = report_latency(&replayed, servers);
+    }
+    free(replayed.records);
+    return error;
+}
+
+int main(int argc, char *argv[]) {
+
+    M_EXIT_IF(argc < 3, ERR_BAD_PARAMETER, "pps-trace", "%s", USAGE);
+    const char *command = argv[1];
+    char **files = argv + 2;
+    double speed = 1;
+    if (strcmp(command, "replay") == 0 && strcmp(files[0], "-x") == 0) {
+        M_EXIT_IF(files[1] == NULL || sscanf(files[1], "%lf", &speed) != 1 || speed <= 0, ERR_BAD_PARAMETER,
+                  "pps-trace", "%s", USAGE);
+        files += 2;
+    }
+    M_EXIT_IF(*files == NULL || (strcmp(command, "decode") != 0 && strcmp(command, "latency") != 0
+                                 && strcmp(command, "replay") != 0), ERR_BAD_PARAMETER, "pps-trace", "%s", USAGE);
+
+    trace_t trace = {NULL, 0, 0};
+    error_code error = load_all(&trace, files);
+    servers_t servers;
+    if (error == ERR_NONE && strcmp(command, "decode") != 0) {
+        error = load_servers(&servers);
+        if (error != ERR_NONE) {
+            fprintf(stderr, "cannot read the servers of %s\n", PPS_SERVERS_LIST_FILENAME);
+        }
+    }
+
+    if (error == ERR_NONE) {
+        if (strcmp(command, "decode") == 0) {
+            decode(&trace);
+        } else if (strcmp(command, "latency") == 0) {
+            error = report_latency(&trace, &servers);
+        } else {
+            error = replay(&trace, &servers, speed);
+        }
+    }
+
+    free(trace.records);
+    return error;
+}
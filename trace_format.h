@@ -0,0 +1,76 @@
+#pragma once
+
+/**
+ * @file trace_format.h
+ * @brief Binary packet traces, written by log-packets.so when PPS_TRACE_DIR_ENV is set and read
+ *        by pps-trace. Each thread of a traced process writes the datagrams it sends and receives
+ *        to its own file, trace-<pid>-<tid>.bin in that directory: a header then a ring of
+ *        fixed-size records, mapped in memory, so that tracing costs no lock and no write call,
+ *        and the last records survive a crash. Once the ring is full, the oldest records are
+ *        overwritten.
+ */
+
+#include <stdint.h>
+
+/**
+ * @brief directory of the traces, and number of records of each ring (TRACE_DEFAULT_RECORDS
+ *        if not set)
+ */
+#define PPS_TRACE_DIR_ENV "PPS_TRACE_DIR"
+#define PPS_TRACE_RECORDS_ENV "PPS_TRACE_RECORDS"
+#define TRACE_DEFAULT_RECORDS (1 << 16)
+
+#define TRACE_MAGIC "PPSTRC01"
+#define TRACE_MAGIC_SIZE 8
+
+/**
+ * @brief bytes of a datagram kept in its record
+ */
+#define TRACE_PAYLOAD_SIZE 96
+
+typedef enum {
+    TRACE_SENT,
+    TRACE_RECEIVED
+} trace_direction_t;
+
+/**
+ * @brief what a datagram is: a ping (empty), a control message ("\0" then its opcode, see
+ *        config.h), or data (a get, a put, or a reply)
+ */
+typedef enum {
+    TRACE_EMPTY,
+    TRACE_CONTROL,
+    TRACE_DATA
+} trace_kind_t;
+
+/**
+ * @brief a datagram, 128 bytes. The addresses and ports are in network order; src is the
+ *        sender (the traced socket for a datagram sent, the peer for one received).
+ */
+typedef struct {
+    uint64_t t_ns;            // CLOCK_MONOTONIC, the same for all the processes of the host
+    uint32_t src_ip;
+    uint32_t dst_ip;
+    uint16_t src_port;
+    uint16_t dst_port;
+    uint32_t length;          // of the datagram
+    uint16_t captured;        // bytes of it in payload, at most TRACE_PAYLOAD_SIZE
+    uint8_t direction;        // trace_direction_t
+    uint8_t kind;             // trace_kind_t
+    uint8_t opcode;           // of a control message, 0 otherwise
+    uint8_t reserved[3];
+    uint8_t payload[TRACE_PAYLOAD_SIZE];
+} trace_record_t;
+
+/**
+ * @brief the header of a trace file, followed by capacity records: record i is at i % capacity
+ */
+typedef struct {
+    char magic[TRACE_MAGIC_SIZE];
+    uint32_t record_size;     // sizeof(trace_record_t)
+    uint32_t capacity;
+    uint64_t head;            // records written so far
+    int32_t pid;
+    int32_t tid;
+    uint8_t reserved[32];
+} trace_header_t;
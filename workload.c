@@ -0,0 +1,160 @@
+/**
+ * @file workload.c
+ * @brief Implementation of workload.h
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "workload.h"
+
+error_code workload_init(workload_t *workload, uint64_t seed, size_t nb_keys, double theta,
+                         size_t min_value_size, size_t max_value_size) {
+
+    M_REQUIRE_NON_NULL(workload);
+    M_REQUIRE(nb_keys > 0, ERR_BAD_PARAMETER, "%s", "empty key space");
+    M_REQUIRE(theta >= 0 && theta < 1, ERR_BAD_PARAMETER, "Zipfian exponent %f", theta);
+    M_REQUIRE(min_value_size <= max_value_size && max_value_size <= MAX_MSG_ELEM_SIZE, ERR_BAD_PARAMETER,
+              "value sizes %zu:%zu", min_value_size, max_value_size);
+
+    memset(workload, 0, sizeof(*workload));
+    //Mixed so that close seeds give unrelated sequences
+    workload->state = (seed + 1) * 0x9E3779B97F4A7C15ULL;
+    workload->state = workload->state == 0 ? 1 : workload->state;
+    workload->nb_keys = nb_keys;
+    workload->theta   = theta;
+    workload->min_value_size = min_value_size;
+    workload->max_value_size = max_value_size;
+
+    workload->filler = malloc(max_value_size + 1);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(workload->filler, ERR_NOMEM);
+    for (size_t i = 0; i < max_value_size; ++i) {
+        workload->filler[i] = (char) ('a' + i % 26);
+    }
+    workload->filler[max_value_size] = '\0';
+
+    //Constants of Gray et al., "Quickly generating billion-record synthetic databases"
+    if (theta > 0 && nb_keys > 1) {
+        for (size_t i = 1; i <= nb_keys; ++i) {
+            workload->zeta_n += 1 / pow((double) i, theta);
+        }
+        const double zeta_2 = 1 + 1 / pow(2, theta);
+        workload->alpha = 1 / (1 - theta);
+        workload->eta   = (1 - pow(2.0 / (double) nb_keys, 1 - theta)) / (1 - zeta_2 / workload->zeta_n);
+    }
+
+    return ERR_NONE;
+}
+
+double workload_uniform(workload_t *workload) {
+    workload->state ^= workload->state >> 12;
+    workload->state ^= workload->state << 25;
+    workload->state ^= workload->state >> 27;
+    //The 53 highest bits of the product
+    return (double) ((workload->state * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-53;
+}
+
+size_t workload_next_key(workload_t *workload) {
+
+    const double u = workload_uniform(workload);
+    if (workload->zeta_n == 0) {
+        return (size_t) (u * (double) workload->nb_keys);
+    }
+
+    const double uz = u * workload->zeta_n;
+    if (uz < 1) {
+        return 0;
+    }
+    if (uz < 1 + pow(0.5, workload->theta)) {
+        return 1;
+    }
+    const size_t rank = (size_t) ((double) workload->nb_keys * pow(workload->eta * u - workload->eta + 1, workload->alpha));
+    return rank < workload->nb_keys ? rank : workload->nb_keys - 1;
+}
+
+const char *workload_value_of_size(const workload_t *workload, size_t size) {
+    size = size < workload->max_value_size ? size : workload->max_value_size;
+    return workload->filler + workload->max_value_size - size;
+}
+
+const char *workload_next_value(workload_t *workload) {
+    const size_t range = workload->max_value_size - workload->min_value_size + 1;
+    const size_t size  = workload->min_value_size + (size_t) (workload_uniform(workload) * (double) range);
+    return workload_value_of_size(workload, size);
+}
+
+void workload_end(workload_t *workload) {
+    if (workload != NULL) {
+        free(workload->filler);
+        workload->filler = NULL;
+    }
+}
+
+//Position just after the colon following "name", NULL if the field is not there
+static const char *find_field(const char *line, const char *name) {
+    char quoted[32];
+    snprintf(quoted, sizeof(quoted), "\"%s\"", name);
+    const char *field = strstr(line, quoted);
+    if (field == NULL) {
+        return NULL;
+    }
+    field += strlen(quoted);
+    field += strspn(field, " \t");
+    return *field == ':' ? field + 1 + strspn(field + 1, " \t") : NULL;
+}
+
+//Copy the JSON string starting at in (on its opening quote) into out, of size at most max
+static error_code read_string(const char *in, char *out, size_t max) {
+    M_REQUIRE(in != NULL && *in == '"', ERR_BAD_PARAMETER, "%s", "not a string");
+    size_t len = 0;
+    for (++in; *in != '"'; ++in) {
+        if (*in == '\\' && (in[1] == '"' || in[1] == '\\')) {
+            ++in;
+        }
+        M_REQUIRE(*in != '\0' && len < max, ERR_BAD_PARAMETER, "%s", "unterminated or too long string");
+        out[len++] = *in;
+    }
+    out[len] = '\0';
+    return ERR_NONE;
+}
+
+error_code workload_parse_trace_line(const char *line, workload_trace_op_t *op) {
+
+    M_REQUIRE_NON_NULL(line);
+    M_REQUIRE_NON_NULL(op);
+
+    const char *t_ms = find_field(line, "t_ms");
+    M_REQUIRE(t_ms != NULL && sscanf(t_ms, "%lf", &op->t_ms) == 1 && op->t_ms >= 0, ERR_BAD_PARAMETER,
+              "%s", "no time");
+
+    char name[8];
+    M_REQUIRE(read_string(find_field(line, "op"), name, sizeof(name) - 1) == ERR_NONE, ERR_BAD_PARAMETER,
+              "%s", "no operation");
+    M_REQUIRE(strcmp(name, "get") == 0 || strcmp(name, "put") == 0, ERR_BAD_PARAMETER, "operation %s", name);
+    op->op = strcmp(name, "get") == 0 ? PIPELINE_GET : PIPELINE_PUT;
+
+    error_code error = read_string(find_field(line, "key"), op->key, MAX_MSG_ELEM_SIZE);
+    if (error != ERR_NONE) {
+        return error;
+    }
+
+    op->value[0] = '\0';
+    if (op->op == PIPELINE_GET) {
+        return ERR_NONE;
+    }
+    const char *value_size = find_field(line, "value_size");
+    if (value_size == NULL) {
+        return read_string(find_field(line, "value"), op->value, MAX_MSG_ELEM_SIZE);
+    }
+    size_t size = 0;
+    M_REQUIRE(sscanf(value_size, "%zu", &size) == 1 && size <= MAX_MSG_ELEM_SIZE, ERR_BAD_PARAMETER,
+              "%s", "bad value size");
+    for (size_t i = 0; i < size; ++i) {
+        op->value[i] = (char) ('a' + i % 26);
+    }
+    op->value[size] = '\0';
+    return ERR_NONE;
+}
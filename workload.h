@@ -0,0 +1,96 @@
+#pragma once
+
+/**
+ * @file workload.h
+ * @brief Synthetic workloads for pps-bench: keys drawn uniformly or with a Zipfian popularity
+ *        among a key space, values of sizes drawn in a range, and the parsing of recorded traces.
+ *        Everything is drawn from a seeded generator, so that a run can be repeated.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "error.h"
+#include "pipeline.h"
+
+/**
+ * @brief name of the key of rank k, from 0 (the most popular with a Zipfian popularity)
+ */
+#define WORKLOAD_KEY_FORMAT "bench-%zu"
+#define WORKLOAD_KEY_SIZE 32
+
+/**
+ * @brief a key space, its popularity and the sizes of the values
+ */
+typedef struct {
+    uint64_t state;     // of the generator (xorshift64*), never 0
+    size_t nb_keys;
+    double theta;       // Zipfian exponent, 0 for a uniform popularity
+    double alpha;       // the constants of the Zipfian generator (see workload_init)
+    double zeta_n;
+    double eta;
+    size_t min_value_size;
+    size_t max_value_size;
+    char *filler;       // max_value_size letters: a value is one of its tails
+} workload_t;
+
+/**
+ * @brief an operation of a trace
+ */
+typedef struct {
+    double t_ms;        // when it is to be submitted, from the start of the trace
+    pipeline_op_t op;
+    char key[MAX_MSG_ELEM_SIZE + 1];
+    char value[MAX_MSG_ELEM_SIZE + 1];
+} workload_trace_op_t;
+
+/**
+ * @brief initialize a workload
+ * @param workload the workload
+ * @param seed of the generator
+ * @param nb_keys size of the key space
+ * @param theta Zipfian exponent, in [0, 1): the key of rank k is drawn with a probability
+ *        proportional to 1 / (k + 1)^theta (Gray et al., as in YCSB)
+ * @param min_value_size, max_value_size range of the sizes of the values, drawn uniformly
+ * @return some error code
+ */
+error_code workload_init(workload_t *workload, uint64_t seed, size_t nb_keys, double theta,
+                         size_t min_value_size, size_t max_value_size);
+
+/**
+ * @brief uniform double in [0, 1)
+ */
+double workload_uniform(workload_t *workload);
+
+/**
+ * @brief draw the rank of a key, in [0, nb_keys)
+ */
+size_t workload_next_key(workload_t *workload);
+
+/**
+ * @brief draw a value
+ * @return a string of letters of a size in the range of the workload, valid until workload_end
+ */
+const char *workload_next_value(workload_t *workload);
+
+/**
+ * @brief a value of a given size (at most max_value_size), valid until workload_end
+ */
+const char *workload_value_of_size(const workload_t *workload, size_t size);
+
+/**
+ * @brief free a workload
+ */
+void workload_end(workload_t *workload);
+
+/**
+ * @brief parse a line of a trace, a JSON object as
+ *        {"t_ms": 12.5, "op": "put", "key": "k", "value": "v"}
+ *        where a put may give "value_size": n instead of its value (filled with letters). The
+ *        strings may not hold escaped characters other than \" and \\.
+ * @param line the line
+ * @param op set to the operation read
+ * @return ERR_BAD_PARAMETER if the line is not an operation, ERR_NONE otherwise
+ */
+error_code workload_parse_trace_line(const char *line, workload_trace_op_t *op);